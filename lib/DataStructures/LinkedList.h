@@ -10,10 +10,13 @@
     - doubly-linked
     - remove caching stuff in favor of standard linked list iterating
     - remove sorting
+    - pluggable node allocator
 */
 
 #pragma once
 
+#include <memory>
+
 template<class T>
 struct ListNode {
   T data;
@@ -21,13 +24,19 @@ struct ListNode {
   ListNode *prev;
 };
 
-template <typename T>
+template <typename T, typename Allocator = std::allocator<ListNode<T>>>
 class LinkedList final {
 
 protected:
+  typedef std::allocator_traits<Allocator> AllocatorTraits;
+
   size_t _size;
   ListNode<T> *root;
   ListNode<T>  *last;
+  Allocator allocator;
+
+  ListNode<T>* createNode();
+  void destroyNode(ListNode<T>* node);
 
 public:
   LinkedList();
@@ -87,14 +96,14 @@ public:
 
   ListNode<T>* getNode(size_t index);
   void spliceToFront(ListNode<T>* node);
-  ListNode<T>* getHead() { return root; }
+  ListNode<T>* getHead() const { return root; }
   T getLast() const { return last == NULL ? T() : last->data; }
 
 };
 
 
-template<typename T>
-void LinkedList<T>::spliceToFront(ListNode<T>* node) {
+template<typename T, typename Allocator>
+void LinkedList<T, Allocator>::spliceToFront(ListNode<T>* node) {
   // Node is already root
   if (node->prev == NULL) {
     return;
@@ -113,9 +122,22 @@ void LinkedList<T>::spliceToFront(ListNode<T>* node) {
   root = node;
 }
 
+template<typename T, typename Allocator>
+ListNode<T>* LinkedList<T, Allocator>::createNode() {
+  ListNode<T>* node = AllocatorTraits::allocate(allocator, 1);
+  AllocatorTraits::construct(allocator, node);
+  return node;
+}
+
+template<typename T, typename Allocator>
+void LinkedList<T, Allocator>::destroyNode(ListNode<T>* node) {
+  AllocatorTraits::destroy(allocator, node);
+  AllocatorTraits::deallocate(allocator, node, 1);
+}
+
 // Initialize LinkedList with false values
-template<typename T>
-LinkedList<T>::LinkedList()
+template<typename T, typename Allocator>
+LinkedList<T, Allocator>::LinkedList()
 {
   root=NULL;
   last=NULL;
@@ -123,15 +145,15 @@ LinkedList<T>::LinkedList()
 }
 
 // Clear Nodes and free Memory
-template<typename T>
-LinkedList<T>::~LinkedList()
+template<typename T, typename Allocator>
+LinkedList<T, Allocator>::~LinkedList()
 {
   ListNode<T>* tmp;
   while(root!=NULL)
   {
     tmp=root;
     root=root->next;
-    delete tmp;
+    destroyNode(tmp);
   }
   last = NULL;
   _size=0;
@@ -141,8 +163,8 @@ LinkedList<T>::~LinkedList()
   Actualy "logic" coding
 */
 
-template<typename T>
-ListNode<T>* LinkedList<T>::getNode(size_t index){
+template<typename T, typename Allocator>
+ListNode<T>* LinkedList<T, Allocator>::getNode(size_t index){
 
   size_t _pos = 0;
   ListNode<T>* current = root;
@@ -155,13 +177,13 @@ ListNode<T>* LinkedList<T>::getNode(size_t index){
   return current; //might be null
 }
 
-template<typename T>
-size_t LinkedList<T>::size() const{
+template<typename T, typename Allocator>
+size_t LinkedList<T, Allocator>::size() const{
   return _size;
 }
 
-template<typename T>
-bool LinkedList<T>::add(size_t index, T _t){
+template<typename T, typename Allocator>
+bool LinkedList<T, Allocator>::add(size_t index, T _t){
 
   if(index >= _size)
     return add(_t);
@@ -169,7 +191,7 @@ bool LinkedList<T>::add(size_t index, T _t){
   if(index == 0)
     return unshift(_t);
 
-  ListNode<T> *tmp = new ListNode<T>(),
+  ListNode<T> *tmp = createNode(),
          *_prev = getNode(index-1);
   tmp->data = _t;
   tmp->next = _prev->next;
@@ -182,10 +204,10 @@ bool LinkedList<T>::add(size_t index, T _t){
   return true;
 }
 
-template<typename T>
-bool LinkedList<T>::add(T _t){
+template<typename T, typename Allocator>
+bool LinkedList<T, Allocator>::add(T _t){
 
-  auto *tmp = new ListNode<T>();
+  auto *tmp = createNode();
   tmp->data = _t;
   tmp->next = NULL;
 
@@ -205,13 +227,13 @@ bool LinkedList<T>::add(T _t){
   return true;
 }
 
-template<typename T>
-bool LinkedList<T>::unshift(T _t){
+template<typename T, typename Allocator>
+bool LinkedList<T, Allocator>::unshift(T _t){
 
   if(_size == 0)
     return add(_t);
 
-  auto *tmp = new ListNode<T>();
+  auto *tmp = createNode();
   tmp->next = root;
   root->prev = tmp;
   tmp->data = _t;
@@ -222,8 +244,8 @@ bool LinkedList<T>::unshift(T _t){
   return true;
 }
 
-template<typename T>
-bool LinkedList<T>::set(const size_t index, T _t){
+template<typename T, typename Allocator>
+bool LinkedList<T, Allocator>::set(const size_t index, T _t){
   // Check if index position is in bounds
   if(index >= _size)
     return false;
@@ -232,15 +254,15 @@ bool LinkedList<T>::set(const size_t index, T _t){
   return true;
 }
 
-template<typename T>
-T LinkedList<T>::pop(){
+template<typename T, typename Allocator>
+T LinkedList<T, Allocator>::pop(){
   if(_size <= 0)
     return T();
 
   if(_size >= 2){
     ListNode<T> *tmp = last->prev;
     T ret = tmp->next->data;
-    delete(tmp->next);
+    destroyNode(tmp->next);
     tmp->next = NULL;
     last = tmp;
     _size--;
@@ -248,7 +270,7 @@ T LinkedList<T>::pop(){
   }else{
     // Only one element left on the list
     T ret = root->data;
-    delete(root);
+    destroyNode(root);
     root = NULL;
     last = NULL;
     _size = 0;
@@ -256,15 +278,15 @@ T LinkedList<T>::pop(){
   }
 }
 
-template<typename T>
-T LinkedList<T>::shift(){
+template<typename T, typename Allocator>
+T LinkedList<T, Allocator>::shift(){
   if(_size <= 0)
     return T();
 
   if(_size > 1){
     ListNode<T> *_next = root->next;
     T ret = root->data;
-    delete(root);
+    destroyNode(root);
     _next->prev = NULL;
     root = _next;
     _size --;
@@ -277,8 +299,8 @@ T LinkedList<T>::shift(){
 
 }
 
-template<typename T>
-void LinkedList<T>::remove(ListNode<T>* node){
+template<typename T, typename Allocator>
+void LinkedList<T, Allocator>::remove(ListNode<T>* node){
   if (node == root) {
     shift();
   } else if (node == last) {
@@ -290,13 +312,13 @@ void LinkedList<T>::remove(ListNode<T>* node){
     prev->next = next;
     next->prev = prev;
 
-    delete node;
+    destroyNode(node);
     --_size;
   }
 }
 
-template<typename T>
-T LinkedList<T>::remove(const size_t index){
+template<typename T, typename Allocator>
+T LinkedList<T, Allocator>::remove(const size_t index){
   if (index >= _size)
   {
     return T();
@@ -315,21 +337,21 @@ T LinkedList<T>::remove(const size_t index){
   T ret = toDelete->data;
   tmp->next = toDelete->next;
   toDelete->next->prev = tmp;
-  delete(toDelete);
+  destroyNode(toDelete);
   _size--;
   return ret;
 }
 
 
-template<typename T>
-T LinkedList<T>::get(size_t index){
+template<typename T, typename Allocator>
+T LinkedList<T, Allocator>::get(size_t index){
   ListNode<T> *tmp = getNode(index);
 
   return (tmp ? tmp->data : T());
 }
 
-template<typename T>
-void LinkedList<T>::clear(){
+template<typename T, typename Allocator>
+void LinkedList<T, Allocator>::clear(){
   while(size() > 0)
     shift();
 }
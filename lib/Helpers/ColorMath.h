@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Integer RGB <-> HSV conversions.  Hue is in degrees [0, 360], saturation in [0, 100].
+ *
+ * These replace RGBConverter, which used doubles (soft-float on the ESP8266) for every
+ * command and transition step.  Results are within 1 of RGBConverter's for every input.  The
+ * only differences are where the exact result is a tie (rgbToHsv rounds it up) or a whole
+ * number (hsvToRgb keeps it), and rounding error in the doubles used to decide it.
+ */
+class ColorMath {
+public:
+  static void rgbToHsv(const uint8_t r, const uint8_t g, const uint8_t b, uint16_t& hue, uint8_t& saturation) {
+    const uint8_t max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+    const uint8_t min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+    const int32_t delta = max - min;
+
+    saturation = max == 0 ? 0 : roundedDivide(100 * delta, max);
+
+    if (delta == 0) {
+      hue = 0;
+      return;
+    }
+
+    // Hue in sixths of a turn, scaled by delta.  Ties between channels go to r, then g.
+    int32_t sixths;
+    if (max == r) {
+      sixths = 60 * (g - b) + (g < b ? 360 * delta : 0);
+    } else if (max == g) {
+      sixths = 60 * (b - r) + 120 * delta;
+    } else {
+      sixths = 60 * (r - g) + 240 * delta;
+    }
+
+    hue = roundedDivide(sixths, delta);
+  }
+
+  // Converts a fully bright (value = 1) color to RGB
+  static void hsvToRgb(const uint16_t hue, const uint8_t saturation, uint8_t rgb[3]) {
+    const uint16_t sector = hue / 60;
+    const int32_t offset = hue - sector * 60;
+
+    // Scaled by 6000 (100 for saturation * 60 for the offset within the sector)
+    const uint8_t v = 255;
+    const uint8_t p = (255 * (6000 - 60 * saturation)) / 6000;
+    const uint8_t q = (255 * (6000 - offset * saturation)) / 6000;
+    const uint8_t t = (255 * (6000 - (60 - offset) * saturation)) / 6000;
+
+    switch (sector % 6) {
+      case 0: rgb[0] = v; rgb[1] = t; rgb[2] = p; break;
+      case 1: rgb[0] = q; rgb[1] = v; rgb[2] = p; break;
+      case 2: rgb[0] = p; rgb[1] = v; rgb[2] = t; break;
+      case 3: rgb[0] = p; rgb[1] = q; rgb[2] = v; break;
+      case 4: rgb[0] = t; rgb[1] = p; rgb[2] = v; break;
+      default: rgb[0] = v; rgb[1] = p; rgb[2] = q; break;
+    }
+  }
+
+private:
+  // Rounds half up.  Both arguments must be non-negative.
+  static int32_t roundedDivide(const int32_t numerator, const int32_t denominator) {
+    return (2 * numerator + denominator) / (2 * denominator);
+  }
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+/*
+ * Allocation for large, long-lived structures (the state cache and group aliases).  On ESP32 boards with PSRAM (built with BOARD_HAS_PSRAM), these go to external
+ * memory so they don't compete with the network stack for internal heap.  Everywhere else
+ * this is plain malloc/free.
+ *
+ * PSRAM is noticeably slower to access than internal RAM, so anything latency-sensitive should
+ * keep using the regular heap.
+ */
+namespace ExtMemory {
+  inline bool isAvailable() {
+#if defined(ESP32) && defined(BOARD_HAS_PSRAM)
+    return psramFound();
+#else
+    return false;
+#endif
+  }
+
+  inline size_t getFree() {
+#if defined(ESP32) && defined(BOARD_HAS_PSRAM)
+    return isAvailable() ? heap_caps_get_free_size(MALLOC_CAP_SPIRAM) : 0;
+#else
+    return 0;
+#endif
+  }
+
+  // Falls back to the regular heap if external memory is missing or full
+  inline void* allocate(const size_t size) {
+#if defined(ESP32) && defined(BOARD_HAS_PSRAM)
+    if (isAvailable()) {
+      void* ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+      if (ptr != nullptr) {
+        return ptr;
+      }
+    }
+#endif
+    return malloc(size);
+  }
+
+  inline void release(void* ptr) {
+    // heap_caps allocations can be freed with free()
+    free(ptr);
+  }
+
+  template<typename T, typename... Args>
+  T* create(Args&&... args) {
+    void* ptr = allocate(sizeof(T));
+
+    if (ptr == nullptr) {
+      return nullptr;
+    }
+
+    return new (ptr) T(std::forward<Args>(args)...);
+  }
+
+  template<typename T>
+  void destroy(T* ptr) {
+    if (ptr != nullptr) {
+      ptr->~T();
+      release(ptr);
+    }
+  }
+
+  // Standard allocator so containers (std::map, std::allocate_shared, LinkedList) can live in
+  // external memory.
+  template<typename T>
+  struct Allocator {
+    typedef T value_type;
+
+    Allocator() = default;
+
+    template<typename U>
+    Allocator(const Allocator<U>&) { }
+
+    T* allocate(const size_t n) {
+      void* ptr = ExtMemory::allocate(n * sizeof(T));
+
+      if (ptr == nullptr) {
+        std::abort();
+      }
+
+      return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t) {
+      release(ptr);
+    }
+  };
+
+  template<typename T, typename U>
+  bool operator==(const Allocator<T>&, const Allocator<U>&) { return true; }
+
+  template<typename T, typename U>
+  bool operator!=(const Allocator<T>&, const Allocator<U>&) { return false; }
+}
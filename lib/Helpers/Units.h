@@ -9,9 +9,14 @@
 
 class Units {
 public:
+  // Maps value from [0, oldMax] to [0, newMax], rounding half away from zero.  Integer-only,
+  // and gives the same results the float version did for every range used here.
   template <typename T, typename V>
-  static T rescale(T value, V newMax, float oldMax = 255.0) {
-    return round(value * (newMax / oldMax));
+  static T rescale(T value, V newMax, uint16_t oldMax = 255) {
+    const int32_t scaled = 2 * static_cast<int32_t>(value) * static_cast<int32_t>(newMax);
+    const int32_t rounding = scaled < 0 ? -static_cast<int32_t>(oldMax) : oldMax;
+
+    return (scaled + rounding) / (2 * static_cast<int32_t>(oldMax));
   }
 
   static uint8_t miredsToWhiteVal(uint16_t mireds, const uint8_t maxValue = 255) {
@@ -1,9 +1,10 @@
 #include <BulbStateUpdater.h>
 
-BulbStateUpdater::BulbStateUpdater(Settings& settings, MqttClient& mqttClient, GroupStateStore& stateStore)
+BulbStateUpdater::BulbStateUpdater(Settings& settings, MqttClient& mqttClient, GroupStateStore& stateStore, const GroupStateSerializer& serializer)
   : settings(settings),
     mqttClient(mqttClient),
     stateStore(stateStore),
+    serializer(serializer),
     lastFlush(0),
     lastQueue(0),
     enabled(true)
@@ -37,23 +38,12 @@ void BulbStateUpdater::loop() {
 }
 
 inline void BulbStateUpdater::flushGroup(const BulbId &bulbId, const GroupState& state) {
-  StaticJsonDocument<MILIGHT_MQTT_JSON_BUFFER_SIZE> json;
-  const JsonObject message = json.to<JsonObject>();
-  state.applyState(message, bulbId, settings.groupStateFields);
-
-  if (json.overflowed()) {
-    Serial.println(F("ERROR: State is too large for MQTT buffer, continuing anyway. Consider increasing MILIGHT_MQTT_JSON_BUFFER_SIZE."));
-  }
-
-  size_t documentSize = measureJson(message);
-  char buffer[documentSize + 1];
-  serializeJson(json, buffer, sizeof(buffer));
-
   mqttClient.sendState(
     *MiLightRemoteConfig::fromType(bulbId.deviceType),
     bulbId.deviceId,
     bulbId.groupId,
-    buffer
+    serializer.measure(state, bulbId),
+    [this, &bulbId, &state](Print& out) { serializer.write(out, state, bulbId); }
   );
 
   lastFlush = millis();
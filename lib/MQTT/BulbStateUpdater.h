@@ -7,14 +7,11 @@
 #include <MqttClient.h>
 #include <CircularBuffer.h>
 #include <Settings.h>
-
-#ifndef MILIGHT_MQTT_JSON_BUFFER_SIZE
-#define MILIGHT_MQTT_JSON_BUFFER_SIZE 1024
-#endif
+#include <GroupStateSerializer.h>
 
 class BulbStateUpdater {
 public:
-  BulbStateUpdater(Settings& settings, MqttClient& mqttClient, GroupStateStore& stateStore);
+  BulbStateUpdater(Settings& settings, MqttClient& mqttClient, GroupStateStore& stateStore, const GroupStateSerializer& serializer);
 
   void enqueueUpdate(const BulbId &bulbId, GroupState& groupState);
   void loop();
@@ -25,6 +22,7 @@ private:
   Settings& settings;
   MqttClient& mqttClient;
   GroupStateStore& stateStore;
+  const GroupStateSerializer& serializer;
   CircularBuffer<BulbId, MILIGHT_MAX_STALE_MQTT_GROUPS> staleGroups;
   unsigned long lastFlush;
   unsigned long lastQueue;
@@ -12,7 +12,7 @@ HomeAssistantDiscoveryClient::HomeAssistantDiscoveryClient(Settings& settings, M
   , mqttClient(mqttClient)
 { }
 
-void HomeAssistantDiscoveryClient::sendDiscoverableDevices(const std::map<String, GroupAlias>& aliases) const {
+void HomeAssistantDiscoveryClient::sendDiscoverableDevices(const GroupAliasMap& aliases) const {
 #ifdef MQTT_DEBUG
   Serial.printf_P(PSTR("HomeAssistantDiscoveryClient: Sending %d discoverable devices...\n"), aliases.size());
 #endif
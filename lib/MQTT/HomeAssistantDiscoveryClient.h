@@ -11,7 +11,7 @@ public:
   void addConfig(const char* alias, const BulbId& bulbId) const;
   void removeConfig(const BulbId& bulbId) const;
 
-  void sendDiscoverableDevices(const std::map<String, GroupAlias>& aliases) const;
+  void sendDiscoverableDevices(const GroupAliasMap& aliases) const;
   void removeOldDevices(const std::map<uint32_t, BulbId>& aliases) const;
 
 private:
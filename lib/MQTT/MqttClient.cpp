@@ -7,14 +7,16 @@
 #include <ArduinoJson.h>
 #include <WiFiClient.h>
 #include <AboutHelper.h>
+#include <StreamUtils.h>
 
 static auto STATUS_CONNECTED = "connected";
 static auto STATUS_DISCONNECTED = "disconnected_clean";
 static auto STATUS_LWT_DISCONNECTED = "disconnected_unclean";
 
-MqttClient::MqttClient(Settings& settings, MiLightClient*& milightClient)
+MqttClient::MqttClient(Settings& settings, MiLightClient*& milightClient, SceneManager& scenes)
   : mqttClient(tcpClient),
     milightClient(milightClient),
+    scenes(scenes),
     settings(settings),
     lastConnectAttempt(0),
     connected(false)
@@ -134,14 +136,51 @@ void MqttClient::handleClient() {
   }
 }
 
-void MqttClient::sendUpdate(const MiLightRemoteConfig& remoteConfig, const uint16_t deviceId, const uint16_t groupId, const char* update) {
-  publish(settings.mqttUpdateTopicPattern, remoteConfig, deviceId, groupId, update, false);
+void MqttClient::sendUpdate(const MiLightRemoteConfig& remoteConfig, const PacketDelta& delta) {
+  if (settings.mqttUpdateTopicPattern.length() == 0) {
+    return;
+  }
+
+  StaticJsonDocument<200> buffer;
+  delta.toJson(buffer.to<JsonObject>());
+
+  char output[200];
+  serializeJson(buffer, output);
+  publish(settings.mqttUpdateTopicPattern, remoteConfig, delta.bulbId.deviceId, delta.bulbId.groupId, output, false);
 }
 
 void MqttClient::sendState(const MiLightRemoteConfig& remoteConfig, const uint16_t deviceId, const uint16_t groupId, const char* update) {
   publish(settings.mqttStateTopicPattern, remoteConfig, deviceId, groupId, update, true);
 }
 
+void MqttClient::sendState(
+  const MiLightRemoteConfig& remoteConfig,
+  const uint16_t deviceId,
+  const uint16_t groupId,
+  const size_t length,
+  const MessageWriter& writer
+) {
+  if (settings.mqttStateTopicPattern.length() == 0) {
+    return;
+  }
+
+  const BulbId bulbId(deviceId, groupId, remoteConfig.type);
+  const String topic = bindTopicString(settings.mqttStateTopicPattern, bulbId);
+
+#ifdef MQTT_DEBUG
+  printf("MqttClient - streaming %d byte state to %s\n", length, topic.c_str());
+#endif
+
+  if (mqttClient.beginPublish(topic.c_str(), length, settings.mqttRetain)) {
+    // Batch up small writes so they don't each go out as their own TCP write
+    WriteBufferingPrint bufferedClient(mqttClient, MQTT_PACKET_CHUNK_SIZE);
+    writer(bufferedClient);
+    bufferedClient.flush();
+
+    mqttClient.endPublish();
+  }
+}
+
 void MqttClient::subscribe() {
   String topic = settings.mqttTopicPattern;
 
@@ -157,6 +196,14 @@ void MqttClient::subscribe() {
 #endif
 
   mqttClient.subscribe(topic.c_str());
+
+  if (settings.mqttTransitionTopic.length() > 0) {
+    mqttClient.subscribe(settings.mqttTransitionTopic.c_str());
+  }
+
+  if (settings.mqttSceneTopic.length() > 0) {
+    mqttClient.subscribe(settings.mqttSceneTopic.c_str());
+  }
 }
 
 void MqttClient::send(const char* topic, const char* message, const bool retain) {
@@ -220,6 +267,16 @@ void MqttClient::publishCallback(char* topic, const byte* payload, const int len
   printf("MqttClient - Got message on topic: %s\n%s\n", topic, cstrPayload);
 #endif
 
+  if (settings.mqttTransitionTopic.length() > 0 && settings.mqttTransitionTopic == topic) {
+    handleTransitionMessage(cstrPayload);
+    return;
+  }
+
+  if (settings.mqttSceneTopic.length() > 0 && settings.mqttSceneTopic == topic) {
+    handleSceneMessage(cstrPayload);
+    return;
+  }
+
   const auto patternIterator = std::make_shared<TokenIterator>(settings.mqttTopicPattern.c_str(), settings.mqttTopicPattern.length(), '/');
   const auto topicIterator = std::make_shared<TokenIterator>(topic, strlen(topic), '/');
   const UrlTokenBindings tokenBindings(patternIterator, topicIterator);
@@ -270,8 +327,32 @@ void MqttClient::publishCallback(char* topic, const byte* payload, const int len
   printf("MqttClient - device %04X, group %u\n", deviceId, groupId);
 #endif
 
+  const CommandPlan plan = milightClient->planUpdate(obj);
+
   milightClient->prepare(config, deviceId, groupId);
-  milightClient->update(obj);
+  milightClient->setCommandSource(CommandSource::MQTT);
+  milightClient->update(plan);
+  milightClient->clearCommandSource();
+}
+
+void MqttClient::handleTransitionMessage(char* payload) const {
+  DynamicJsonDocument buffer(MQTT_TRANSITION_BUFFER_SIZE);
+  StaticJsonDocument<100> response;
+
+  if (const DeserializationError error = deserializeJson(buffer, payload); error) {
+    Serial.printf_P(PSTR("MqttClient - ERROR: could not parse transition: %s\n"), error.c_str());
+    return;
+  }
+
+  if (! milightClient->handleSceneTransition(buffer.as<JsonObject>(), response)) {
+    Serial.printf_P(PSTR("MqttClient - ERROR: could not start transition: %s\n"), response[F("error")].as<const char*>());
+  }
+}
+
+void MqttClient::handleSceneMessage(const char* payload) const {
+  if (! scenes.recall(payload)) {
+    Serial.printf_P(PSTR("MqttClient - ERROR: could not recall scene: %s\n"), payload);
+  }
 }
 
 String MqttClient::bindTopicString(const String& topicPattern, const BulbId& bulbId) const {
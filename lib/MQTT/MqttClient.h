@@ -1,6 +1,7 @@
 #pragma once
 
 #include <MiLightClient.h>
+#include <SceneManager.h>
 #include <Settings.h>
 #include <PubSubClient.h>
 #include <WiFiClient.h>
@@ -16,6 +17,11 @@
 #define MQTT_PACKET_CHUNK_SIZE 128
 #endif
 
+// Scene transitions list many bulbs, so they need more room than a single command
+#ifndef MQTT_TRANSITION_BUFFER_SIZE
+#define MQTT_TRANSITION_BUFFER_SIZE 1024
+#endif
+
 static const std::map<int, const __FlashStringHelper*> MQTT_STATUS_STRINGS = {
   {MQTT_CONNECTION_TIMEOUT, FPSTR("Connection Timeout")},
   {MQTT_CONNECTION_LOST, FPSTR("Connection Lost")},
@@ -45,15 +51,19 @@ enum MqttConnectionStatus : int {
 class MqttClient {
 public:
   using OnConnectFn = std::function<void()>;
+  using MessageWriter = std::function<void(Print& out)>;
 
-  MqttClient(Settings& settings, MiLightClient*& milightClient);
+  MqttClient(Settings& settings, MiLightClient*& milightClient, SceneManager& scenes);
   ~MqttClient();
 
   void begin();
   void handleClient();
   void reconnect();
-  void sendUpdate(const MiLightRemoteConfig& remoteConfig, uint16_t deviceId, uint16_t groupId, const char* update);
+  // Publishes what a packet changed to the update topic.  Only rendered if the topic is set.
+  void sendUpdate(const MiLightRemoteConfig& remoteConfig, const PacketDelta& delta);
   void sendState(const MiLightRemoteConfig& remoteConfig, uint16_t deviceId, uint16_t groupId, const char* update);
+  // Streams a state message of known length straight into the MQTT connection
+  void sendState(const MiLightRemoteConfig& remoteConfig, uint16_t deviceId, uint16_t groupId, size_t length, const MessageWriter& writer);
   void send(const char* topic, const char* message, bool retain = false);
   void onConnect(const OnConnectFn &fn);
   bool isConnected();
@@ -66,6 +76,7 @@ private:
   WiFiClient tcpClient;
   PubSubClient mqttClient;
   MiLightClient*& milightClient;
+  SceneManager& scenes;
   Settings& settings;
   char* domain;
   unsigned long lastConnectAttempt;
@@ -76,6 +87,8 @@ private:
   bool connect();
   void subscribe();
   void publishCallback(char* topic, const byte* payload, int length) const;
+  void handleTransitionMessage(char* payload) const;
+  void handleSceneMessage(const char* payload) const;
   void publish(
     const String& topic,
     const MiLightRemoteConfig& remoteConfig,
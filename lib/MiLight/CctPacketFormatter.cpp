@@ -40,14 +40,19 @@ void CctPacketFormatter::finalizePacket(uint8_t* packet) {
   // Calculate checksum over packet length .. sequenceNum
   uint8_t checksum = 7; // Packet length is not part of a packet
   for (uint8_t i = 0; i < 6; i++) {
-    checksum += currentPacket[i];
+    checksum += packet[i];
   }
   // Store the checksum in the sixth byte
-  currentPacket[6] = checksum;
+  packet[6] = checksum;
+}
+
+void CctPacketFormatter::restampPacket(uint8_t* packet) {
+  packet[CCT_SEQUENCE_INDEX] = sequenceNum++;
+  finalizePacket(packet);
 }
 
 void CctPacketFormatter::updateBrightness(const uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, REMOTE_TYPE_CCT);
+  const GroupState* state = getKnownState();
   const int8_t knownValue = (state != nullptr && state->isSetBrightness()) ? state->getBrightness() / CCT_INTERVALS : -1;
 
   valueByStepFunction(
@@ -60,7 +65,7 @@ void CctPacketFormatter::updateBrightness(const uint8_t value) {
 }
 
 void CctPacketFormatter::updateTemperature(const uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, REMOTE_TYPE_CCT);
+  const GroupState* state = getKnownState();
   const int8_t knownValue = (state != nullptr && state->isSetKelvin()) ? state->getKelvin() / CCT_INTERVALS : -1;
 
   valueByStepFunction(
@@ -72,6 +77,18 @@ void CctPacketFormatter::updateTemperature(const uint8_t value) {
   );
 }
 
+uint8_t CctPacketFormatter::getIncrementSteps(const GroupStateField field) const {
+  switch (field) {
+    case GroupStateField::BRIGHTNESS:
+    case GroupStateField::LEVEL:
+    case GroupStateField::KELVIN:
+    case GroupStateField::COLOR_TEMP:
+      return CCT_INTERVALS;
+    default:
+      return 0;
+  }
+}
+
 void CctPacketFormatter::command(uint8_t command, uint8_t arg) {
   pushPacket();
   if (held) {
@@ -191,7 +208,7 @@ MiLightStatus CctPacketFormatter::cctCommandToStatus(const uint8_t command) {
   }
 }
 
-BulbId CctPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject result) {
+BulbId CctPacketFormatter::parsePacket(const uint8_t* packet, PacketDelta& result) {
   const uint8_t command = packet[CCT_COMMAND_INDEX] & 0x7F;
 
   const uint8_t onOffGroupId = cctCommandIdToGroup(command);
@@ -203,21 +220,22 @@ BulbId CctPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject r
 
   // Night mode
   if (command & 0x10) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::NIGHT_MODE;
+    result.setCommand(PacketCommand::NIGHT_MODE);
   } else if (onOffGroupId < 255) {
-    result[GroupStateFieldNames::STATE] = cctCommandToStatus(command) == ON ? "ON" : "OFF";
+    result.setState(cctCommandToStatus(command));
   } else if (command == CCT_BRIGHTNESS_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_down";
+    result.setCommand(PacketCommand::BRIGHTNESS_DOWN);
   } else if (command == CCT_BRIGHTNESS_UP) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_up";
+    result.setCommand(PacketCommand::BRIGHTNESS_UP);
   } else if (command == CCT_TEMPERATURE_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::TEMPERATURE_DOWN;
+    result.setCommand(PacketCommand::TEMPERATURE_DOWN);
   } else if (command == CCT_TEMPERATURE_UP) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::TEMPERATURE_UP;
+    result.setCommand(PacketCommand::TEMPERATURE_UP);
   } else {
-    result["button_id"] = command;
+    result.setButtonId(command);
   }
 
+  result.bulbId = bulbId;
   return bulbId;
 }
 
@@ -3,6 +3,7 @@
 #include <PacketFormatter.h>
 
 #define CCT_COMMAND_INDEX 4
+#define CCT_SEQUENCE_INDEX 5
 #define CCT_INTERVALS 10
 
 enum MiLightCctButton {
@@ -45,7 +46,9 @@ public:
   void format(uint8_t const* packet, char* buffer) override;
   void initializePacket(uint8_t* packet) override;
   void finalizePacket(uint8_t* packet) override;
-  BulbId parsePacket(const uint8_t* packet, JsonObject result) override;
+  void restampPacket(uint8_t* packet) override;
+  BulbId parsePacket(const uint8_t* packet, PacketDelta& result) override;
+  uint8_t getIncrementSteps(GroupStateField field) const override;
 
   static uint8_t getCctStatusButton(uint8_t groupId, MiLightStatus status);
   static uint8_t cctCommandIdToGroup(uint8_t command);
@@ -0,0 +1,168 @@
+#include <CommandDebouncer.h>
+
+CommandDebouncer::CommandDebouncer(const Settings& settings, SendFn sendFn)
+  : settings(settings)
+  , sendFn(std::move(sendFn))
+  , numEntries(0)
+  , numPending(0)
+  , stats({0, 0, 0})
+{ }
+
+bool CommandDebouncer::isDebounced(const GroupStateField field) {
+  switch (field) {
+    case GroupStateField::LEVEL:
+    case GroupStateField::HUE:
+    case GroupStateField::SATURATION:
+    case GroupStateField::KELVIN:
+      return true;
+    default:
+      return false;
+  }
+}
+
+GroupStateField CommandDebouncer::slotFor(const GroupStateField field) {
+  switch (field) {
+    case GroupStateField::BRIGHTNESS:
+      return GroupStateField::LEVEL;
+    case GroupStateField::COLOR_TEMP:
+      return GroupStateField::KELVIN;
+    default:
+      return field;
+  }
+}
+
+size_t CommandDebouncer::getWindow(const CommandSource source) const {
+  switch (source) {
+    case CommandSource::HTTP:
+      return settings.httpCommandDebounce;
+    case CommandSource::MQTT:
+      return settings.mqttCommandDebounce;
+    case CommandSource::UDP:
+      return settings.udpCommandDebounce;
+    default:
+      return 0;
+  }
+}
+
+CommandDebouncer::Entry* CommandDebouncer::findEntry(const BulbId& bulbId, const GroupStateField field) {
+  for (size_t i = 0; i < numEntries; ++i) {
+    if (entries[i].field == field && entries[i].bulbId == bulbId) {
+      return &entries[i];
+    }
+  }
+
+  return nullptr;
+}
+
+CommandDebouncer::Entry* CommandDebouncer::allocateEntry() {
+  if (numEntries < MILIGHT_DEBOUNCE_SIZE) {
+    return &entries[numEntries++];
+  }
+
+  const unsigned long now = millis();
+  Entry* oldest = nullptr;
+
+  for (size_t i = 0; i < numEntries; ++i) {
+    if (! entries[i].pending
+      && (oldest == nullptr || (now - entries[i].lastSent) > (now - oldest->lastSent))) {
+      oldest = &entries[i];
+    }
+  }
+
+  return oldest;
+}
+
+bool CommandDebouncer::submit(
+  const CommandSource source,
+  const BulbId& bulbId,
+  const GroupStateField field,
+  const uint16_t value
+) {
+  const size_t window = getWindow(source);
+  Entry* entry = findEntry(bulbId, field);
+
+  if (window == 0 || ! isDebounced(field)) {
+    // This is newer than anything held, so the held value must not be sent after it
+    if (entry != nullptr) {
+      cancel(bulbId, field);
+    }
+    return true;
+  }
+
+  const unsigned long now = millis();
+
+  if (entry == nullptr) {
+    entry = allocateEntry();
+
+    // Nowhere to hold it, so send it
+    if (entry == nullptr) {
+      return true;
+    }
+
+    entry->bulbId = bulbId;
+    entry->field = field;
+    entry->pending = false;
+  } else if ((now - entry->lastSent) < window) {
+    if (entry->pending) {
+      stats.collapsed++;
+    } else {
+      numPending++;
+    }
+
+    stats.deferred++;
+    entry->value = value;
+    entry->window = window;
+    entry->pending = true;
+    return false;
+  }
+
+  // Leading edge.  Anything still held is older than this, so drop it.
+  if (entry->pending) {
+    entry->pending = false;
+    numPending--;
+  }
+
+  entry->lastSent = now;
+  return true;
+}
+
+void CommandDebouncer::cancel(const BulbId& bulbId, const GroupStateField field) {
+  if (Entry* entry = findEntry(bulbId, slotFor(field)); entry != nullptr && entry->pending) {
+    entry->pending = false;
+    numPending--;
+  }
+}
+
+void CommandDebouncer::cancel(const BulbId& bulbId) {
+  for (size_t i = 0; i < numEntries; ++i) {
+    if (entries[i].pending && entries[i].bulbId == bulbId) {
+      entries[i].pending = false;
+      numPending--;
+    }
+  }
+}
+
+void CommandDebouncer::loop() {
+  if (numPending == 0) {
+    return;
+  }
+
+  const unsigned long now = millis();
+
+  for (size_t i = 0; i < numEntries; ++i) {
+    Entry& entry = entries[i];
+
+    if (entry.pending && (now - entry.lastSent) >= entry.window) {
+      entry.pending = false;
+      entry.lastSent = now;
+      numPending--;
+      stats.trailing++;
+
+      sendFn(entry.bulbId, entry.field, entry.value);
+    }
+  }
+}
+
+const CommandDebounceStats& CommandDebouncer::getStats() const {
+  return stats;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include <BulbId.h>
+#include <GroupStateField.h>
+#include <Settings.h>
+
+// Number of (bulb, field) pairs tracked.  When every slot has a held value, further
+// commands are sent right away.
+#ifndef MILIGHT_DEBOUNCE_SIZE
+#define MILIGHT_DEBOUNCE_SIZE 16
+#endif
+
+// Where a command came from.  Each source has its own debounce window in settings.
+enum class CommandSource {
+  // Transitions, scenes and anything else started by the hub itself.  Never debounced.
+  INTERNAL,
+  HTTP,
+  MQTT,
+  UDP
+};
+
+struct CommandDebounceStats {
+  // Commands held because one for the same field was sent too recently
+  size_t deferred;
+  // Held commands that were replaced by a newer one before they were sent
+  size_t collapsed;
+  // Held commands sent when their window ended
+  size_t trailing;
+};
+
+/*
+ * Limits how often a single field of a bulb is sent.  Sliders in Home Assistant or a UDP
+ * remote app can send dozens of brightness updates a second, each of which takes several
+ * repeated packets, so the queue falls behind and the bulb lags the slider.
+ *
+ * The first command for a field is sent right away.  Commands for it in the window after
+ * that are held, each replacing the last, and only the newest is sent when the window ends.
+ * Only fields that take a single value (level, hue, saturation and temperature) are
+ * debounced.  Everything else is always sent right away.
+ *
+ * Off unless a window is set for the command's source in settings.
+ */
+class CommandDebouncer {
+public:
+  using SendFn = std::function<void(const BulbId& bulbId, GroupStateField field, uint16_t value)>;
+
+  CommandDebouncer(const Settings& settings, SendFn sendFn);
+
+  // Returns true if the field should be sent now.  Otherwise, the value is held and passed
+  // to the send function when the window ends.  Brightness and color temperature must be
+  // converted to a level and kelvin first (see slotFor).
+  bool submit(CommandSource source, const BulbId& bulbId, GroupStateField field, uint16_t value);
+
+  // Drops any value held for the field, for example when a transition or newer command
+  // takes over
+  void cancel(const BulbId& bulbId, GroupStateField field);
+  // Drops every value held for the bulb
+  void cancel(const BulbId& bulbId);
+
+  // Sends held values whose window has ended
+  void loop();
+
+  size_t getWindow(CommandSource source) const;
+  const CommandDebounceStats& getStats() const;
+
+  // Fields that are debounced
+  static bool isDebounced(GroupStateField field);
+  // Brightness and color temperature are held in the same slot as level and kelvin, so a
+  // newer value for one replaces the other
+  static GroupStateField slotFor(GroupStateField field);
+
+private:
+  struct Entry {
+    BulbId bulbId;
+    GroupStateField field;
+    uint16_t value;
+    // Window of the command that's held
+    size_t window;
+    unsigned long lastSent;
+    bool pending;
+  };
+
+  const Settings& settings;
+  SendFn sendFn;
+  Entry entries[MILIGHT_DEBOUNCE_SIZE];
+  size_t numEntries;
+  size_t numPending;
+  CommandDebounceStats stats;
+
+  Entry* findEntry(const BulbId& bulbId, GroupStateField field);
+  // Finds a slot for a new pair, replacing the one sent longest ago that isn't holding
+  // anything.  Returns nullptr if every slot is holding a value.
+  Entry* allocateEntry();
+};
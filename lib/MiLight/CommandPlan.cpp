@@ -0,0 +1,118 @@
+#include <CommandPlan.h>
+#include <MiLightClient.h>
+#include <MiLightCommands.h>
+#include <Units.h>
+
+// Fields in the order they're sent.  Status is handled separately: on goes first, off last.
+static const struct {
+  const char* name;
+  GroupStateField field;
+} FIELD_ORDERINGS[] = {
+  {GroupStateFieldNames::HUE, GroupStateField::HUE},
+  {GroupStateFieldNames::SATURATION, GroupStateField::SATURATION},
+  {GroupStateFieldNames::KELVIN, GroupStateField::KELVIN},
+  // Alias for kelvin
+  {GroupStateFieldNames::TEMPERATURE, GroupStateField::KELVIN},
+  {GroupStateFieldNames::COLOR_TEMP, GroupStateField::COLOR_TEMP},
+  {GroupStateFieldNames::MODE, GroupStateField::MODE},
+  {GroupStateFieldNames::EFFECT, GroupStateField::EFFECT},
+  {GroupStateFieldNames::COLOR, GroupStateField::COLOR},
+  // Level/Brightness must be processed last because they're specific to a particular bulb mode.
+  // So make sure bulb mode is set before applying level/brightness.
+  {GroupStateFieldNames::LEVEL, GroupStateField::LEVEL},
+  {GroupStateFieldNames::BRIGHTNESS, GroupStateField::BRIGHTNESS}
+};
+
+CommandPlan::CommandPlan(const JsonObject request, const TransitionPolicy defaultPolicy)
+  : status(MiLightClient::parseStatus(MiLightClient::extractStatus(request)))
+  , rawStatus(MiLightClient::extractStatus(request))
+  , transitionDuration(0)
+  , transitionPolicy(TransitionController::parsePolicy(request[RequestKeys::TRANSITION_POLICY].as<const char*>(), defaultPolicy))
+  , transitionEasing(Easing::parse(request[RequestKeys::TRANSITION_EASING].as<const char*>(), EasingCurve::LINEAR))
+  , force(request[RequestKeys::FORCE] | false)
+  , color()
+  , command(request[GroupStateFieldNames::COMMAND])
+  , commands(request[GroupStateFieldNames::COMMANDS])
+  , hasRawCommand(request.containsKey("button_id") && request.containsKey("argument"))
+  , buttonId(request["button_id"])
+  , argument(request["argument"])
+{
+  const JsonVariant jsonTransition = request[RequestKeys::TRANSITION];
+
+  if (!jsonTransition.isNull()) {
+    if (jsonTransition.is<float>()) {
+      transitionDuration = jsonTransition.as<float>();
+    } else if (jsonTransition.is<size_t>()) {
+      transitionDuration = jsonTransition.as<size_t>();
+    } else {
+      Serial.println(F("MiLightClient - WARN: unsupported transition type.  Must be float or int."));
+    }
+  }
+
+  for (const auto& ordering : FIELD_ORDERINGS) {
+    if (const JsonVariant value = request[ordering.name]; !value.isNull()) {
+      addField(ordering.field, value);
+    }
+  }
+}
+
+void CommandPlan::addField(const GroupStateField field, const JsonVariant value) {
+  uint16_t parsed = 0;
+
+  switch (field) {
+    case GroupStateField::HUE:
+    case GroupStateField::COLOR_TEMP:
+      parsed = value.as<uint16_t>();
+      break;
+    case GroupStateField::LEVEL:
+    case GroupStateField::SATURATION:
+    case GroupStateField::KELVIN:
+    case GroupStateField::MODE:
+      parsed = value.as<uint8_t>();
+      break;
+    case GroupStateField::BRIGHTNESS:
+      parsed = Units::rescale<uint16_t, uint16_t>(value.as<uint16_t>(), 100, 255);
+      break;
+    case GroupStateField::COLOR:
+      color = ParsedColor::fromJson(value);
+
+      if (!color.success) {
+        Serial.println(F("Error parsing color field, unrecognized format"));
+        return;
+      }
+      break;
+    case GroupStateField::EFFECT:
+      if (const char* effect = value.as<const char*>(); effect == nullptr) {
+        parsed = value.as<uint8_t>();
+      } else if (strcmp(effect, MiLightCommandNames::NIGHT_MODE) == 0) {
+        parsed = EFFECT_NIGHT_MODE;
+      } else if (strcmp(effect, "white") == 0 || strcmp(effect, "white_mode") == 0) {
+        parsed = EFFECT_WHITE_MODE;
+      } else {
+        parsed = atoi(effect);
+      }
+      break;
+    default:
+      break;
+  }
+
+  fields.push_back({ field, value, parsed });
+}
+
+const CommandPlan::FieldOp* CommandPlan::findBrightnessField() const {
+  const FieldOp* level = nullptr;
+
+  for (const FieldOp& op : fields) {
+    if (op.field == GroupStateField::BRIGHTNESS) {
+      return &op;
+    } else if (op.field == GroupStateField::LEVEL) {
+      level = &op;
+    }
+  }
+
+  return level;
+}
+
+bool CommandPlan::hasTransition() const {
+  return transitionDuration != 0;
+}
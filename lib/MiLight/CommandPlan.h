@@ -0,0 +1,65 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <GroupStateField.h>
+#include <ParsedColor.h>
+#include <TransitionController.h>
+#include <vector>
+
+/*
+ * An update request, parsed once so it can be sent to many bulbs.  Fields are looked up,
+ * ordered and converted when the plan is built.  MiLightClient::update(const CommandPlan&)
+ * only has to switch on them for each bulb.
+ *
+ * Values that are used to plan transitions or run commands still point into the request, so
+ * the JSON document must outlive the plan.
+ */
+class CommandPlan {
+public:
+  static constexpr uint8_t STATUS_UNDEFINED = 255;
+
+  // Values of FieldOp::value for the effect field that aren't mode numbers
+  static constexpr uint16_t EFFECT_NIGHT_MODE = 0x100;
+  static constexpr uint16_t EFFECT_WHITE_MODE = 0x101;
+
+  struct FieldOp {
+    GroupStateField field;
+    // The value as it was given.  Used to plan transitions.
+    JsonVariant rawValue;
+    // The value to send when there's no transition
+    uint16_t value;
+  };
+
+  CommandPlan(JsonObject request, TransitionPolicy defaultPolicy);
+
+  // Parsed status, or STATUS_UNDEFINED
+  uint8_t status;
+  JsonVariant rawStatus;
+
+  float transitionDuration;
+  TransitionPolicy transitionPolicy;
+  EasingCurve transitionEasing;
+
+  // Send every field, even ones the bulb is already known to be in
+  bool force;
+
+  // In the order they should be sent.  Level and brightness come last, after the bulb mode
+  // has been set.  Bulbs with mode-specific fields reorder these (see ModePlanner).
+  std::vector<FieldOp> fields;
+  // Only valid if there's a color field
+  ParsedColor color;
+
+  JsonVariant command;
+  JsonArray commands;
+
+  bool hasRawCommand;
+  uint8_t buttonId;
+  uint8_t argument;
+
+  // The level or brightness field, if there is one
+  const FieldOp* findBrightnessField() const;
+  bool hasTransition() const;
+
+private:
+  void addField(GroupStateField field, JsonVariant value);
+};
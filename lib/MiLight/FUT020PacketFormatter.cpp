@@ -6,7 +6,7 @@ void FUT020PacketFormatter::updateColorRaw(const uint8_t value) {
 }
 
 void FUT020PacketFormatter::updateHue(const uint16_t value) {
-  uint16_t remapped = Units::rescale<uint16_t, uint16_t>(value, 255.0, 360.0);
+  uint16_t remapped = Units::rescale<uint16_t, uint16_t>(value, 255, 360);
   remapped = (remapped + 0xB0) % 0x100;
 
   updateColorRaw(remapped);
@@ -21,7 +21,7 @@ void FUT020PacketFormatter::nextMode() {
 }
 
 void FUT020PacketFormatter::updateBrightness(const uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, REMOTE_TYPE_FUT020);
+  const GroupState* state = getKnownState();
   const int8_t knownValue = (state != nullptr && state->isSetBrightness())
     ? state->getBrightness() / NUM_BRIGHTNESS_INTERVALS
     : -1;
@@ -35,6 +35,10 @@ void FUT020PacketFormatter::updateBrightness(const uint8_t value) {
   );
 }
 
+uint8_t FUT020PacketFormatter::getIncrementSteps(const GroupStateField field) const {
+  return GroupStateFieldHelpers::isBrightnessField(field) ? NUM_BRIGHTNESS_INTERVALS : 0;
+}
+
 void FUT020PacketFormatter::increaseBrightness() {
   command(static_cast<uint8_t>(FUT020Command::BRIGHTNESS_UP), 0);
 }
@@ -47,7 +51,7 @@ void FUT020PacketFormatter::updateStatus(MiLightStatus status, uint8_t groupId)
   command(static_cast<uint8_t>(FUT020Command::ON_OFF), 0);
 }
 
-BulbId FUT020PacketFormatter::parsePacket(const uint8_t* packet, const JsonObject result) {
+BulbId FUT020PacketFormatter::parsePacket(const uint8_t* packet, PacketDelta& result) {
   const auto command = static_cast<FUT020Command>(packet[FUT02X_COMMAND_INDEX] & 0x0F);
 
   BulbId bulbId(
@@ -58,31 +62,32 @@ BulbId FUT020PacketFormatter::parsePacket(const uint8_t* packet, const JsonObjec
 
   switch (command) {
     case FUT020Command::ON_OFF:
-      result[F("state")] = F("ON");
+      result.setState(ON);
       break;
 
     case FUT020Command::BRIGHTNESS_DOWN:
-      result[F("command")] = F("brightness_down");
+      result.setCommand(PacketCommand::BRIGHTNESS_DOWN);
       break;
 
     case FUT020Command::BRIGHTNESS_UP:
-      result[F("command")] = F("brightness_up");
+      result.setCommand(PacketCommand::BRIGHTNESS_UP);
       break;
 
     case FUT020Command::MODE_SWITCH:
-      result[F("command")] = F("next_mode");
+      result.setCommand(PacketCommand::NEXT_MODE);
       break;
 
     case FUT020Command::COLOR_WHITE_TOGGLE:
-      result[F("command")] = F("color_white_toggle");
+      result.setCommand(PacketCommand::COLOR_WHITE_TOGGLE);
       break;
 
     case FUT020Command::COLOR:
-      uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[FUT02X_ARGUMENT_INDEX], 360.0, 255.0);
+      uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[FUT02X_ARGUMENT_INDEX], 360, 255);
       remappedColor = (remappedColor + 113) % 360;
-      result[GroupStateFieldNames::HUE] = remappedColor;
+      result.setHue(remappedColor);
       break;
   }
 
+  result.bulbId = bulbId;
   return bulbId;
 }
@@ -23,8 +23,9 @@ public:
   void updateColorWhite() override;
   void nextMode() override;
   void updateBrightness(uint8_t value) override;
+  uint8_t getIncrementSteps(GroupStateField field) const override;
   void increaseBrightness() override;
   void decreaseBrightness() override;
 
-  BulbId parsePacket(const uint8_t* packet, JsonObject result) override;
+  BulbId parsePacket(const uint8_t* packet, PacketDelta& result) override;
 };
@@ -30,15 +30,11 @@ void FUT02xPacketFormatter::command(uint8_t command, const uint8_t arg) {
 }
 
 void FUT02xPacketFormatter::pair() {
-  for (size_t i = 0; i < 5; i++) {
-    command(FUT02X_PAIR_COMMAND, 0);
-  }
+  repeatCommand(FUT02X_PAIR_COMMAND, 0, 5);
 }
 
 void FUT02xPacketFormatter::unpair() {
-  for (size_t i = 0; i < 5; i++) {
-    command(FUT02X_PAIR_COMMAND, 0);
-  }
+  repeatCommand(FUT02X_PAIR_COMMAND, 0, 5);
 }
 
 void FUT02xPacketFormatter::format(uint8_t const* packet, char* buffer) {
@@ -38,5 +38,5 @@ public:
   void modeSpeedUp() override;
   void updateMode(uint8_t mode) override;
 
-  BulbId parsePacket(const uint8_t* packet, JsonObject result) override;
+  BulbId parseDecodedPacket(const uint8_t* packet, PacketDelta& result) override;
 };
@@ -18,5 +18,5 @@ public:
   void updateTemperature(uint8_t value) override;
   void enableNightMode() override;
 
-  BulbId parsePacket(const uint8_t* packet, JsonObject result) override;
+  BulbId parseDecodedPacket(const uint8_t* packet, PacketDelta& result) override;
 };
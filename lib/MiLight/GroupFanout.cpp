@@ -0,0 +1,70 @@
+#include <GroupFanout.h>
+#include <MiLightRemoteConfig.h>
+#include <algorithm>
+
+namespace {
+  struct Device {
+    uint16_t deviceId;
+    MiLightRemoteType type;
+    // Bit n is set if group n was targeted
+    uint32_t groups;
+    size_t numTargets;
+    // False if a group was targeted that group 0 doesn't reach
+    bool coverable;
+    bool emitted;
+
+    bool covered() const {
+      const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(type);
+
+      if (! coverable || config == nullptr || config->numGroups == 0) {
+        return false;
+      }
+
+      const uint32_t allGroups = ((1UL << config->numGroups) - 1) << 1;
+      return (groups & 1) != 0 || (groups & allGroups) == allGroups;
+    }
+  };
+}
+
+std::vector<GroupFanout::Target> GroupFanout::plan(const std::vector<BulbId>& targets) {
+  std::vector<Device> devices;
+
+  for (const BulbId& bulbId : targets) {
+    auto device = std::find_if(devices.begin(), devices.end(), [&bulbId](const Device& d) {
+      return d.deviceId == bulbId.deviceId && d.type == bulbId.deviceType;
+    });
+
+    if (device == devices.end()) {
+      devices.push_back({bulbId.deviceId, bulbId.deviceType, 0, 0, true, false});
+      device = devices.end() - 1;
+    }
+
+    const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(bulbId.deviceType);
+
+    if (config == nullptr || bulbId.groupId > config->numGroups || bulbId.groupId >= 32) {
+      device->coverable = false;
+    } else {
+      device->groups |= 1UL << bulbId.groupId;
+    }
+
+    device->numTargets++;
+  }
+
+  std::vector<Target> result;
+  result.reserve(targets.size());
+
+  for (const BulbId& bulbId : targets) {
+    Device& device = *std::find_if(devices.begin(), devices.end(), [&bulbId](const Device& d) {
+      return d.deviceId == bulbId.deviceId && d.type == bulbId.deviceType;
+    });
+
+    if (! device.covered()) {
+      result.push_back({bulbId, 1});
+    } else if (! device.emitted) {
+      result.push_back({BulbId(device.deviceId, 0, device.type), device.numTargets});
+      device.emitted = true;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <BulbId.h>
+#include <vector>
+
+struct GroupFanoutStats {
+  // Group 0 commands sent in place of commands to each group
+  size_t group0Commands;
+  // Per-group commands that weren't sent because of them
+  size_t commandsSaved;
+  // Radio packets those would have taken, not counting repeats
+  size_t packetsSaved;
+};
+
+/*
+ * Plans the fewest commands needed to send the same update to a list of bulbs.  Targets are
+ * grouped by device ID and remote type.  When a device's targets cover every one of its
+ * groups (or include group 0), they're replaced by a single group 0 command.  The state store
+ * fans group 0 state out to the individual groups when the packet is sent, so state ends up
+ * the same either way.
+ *
+ * Targets for devices that aren't fully covered are passed through unchanged, in the order
+ * they were given.
+ */
+class GroupFanout {
+public:
+  struct Target {
+    BulbId bulbId;
+    // Number of requested targets this one stands in for
+    size_t numTargets;
+  };
+
+  static std::vector<Target> plan(const std::vector<BulbId>& targets);
+};
@@ -4,63 +4,13 @@
 #include <TokenIterator.h>
 #include <ParsedColor.h>
 #include <MiLightCommands.h>
+#include <IntParsing.h>
+#include <ModePlanner.h>
 #include <functional>
+#include <algorithm>
 
 using namespace std::placeholders;
 
-static constexpr uint8_t STATUS_UNDEFINED = 255;
-
-const char* MiLightClient::FIELD_ORDERINGS[] = {
-  // These are handled manually
-  // GroupStateFieldNames::STATE,
-  // GroupStateFieldNames::STATUS,
-  GroupStateFieldNames::HUE,
-  GroupStateFieldNames::SATURATION,
-  GroupStateFieldNames::KELVIN,
-  GroupStateFieldNames::TEMPERATURE,
-  GroupStateFieldNames::COLOR_TEMP,
-  GroupStateFieldNames::MODE,
-  GroupStateFieldNames::EFFECT,
-  GroupStateFieldNames::COLOR,
-  // Level/Brightness must be processed last because they're specific to a particular bulb mode.
-  // So make sure bulb mode is set before applying level/brightness.
-  GroupStateFieldNames::LEVEL,
-  GroupStateFieldNames::BRIGHTNESS,
-  GroupStateFieldNames::COMMAND,
-  GroupStateFieldNames::COMMANDS
-};
-
-const std::map<const char*, std::function<void(MiLightClient*, JsonVariant)>, MiLightClient::cmp_str> MiLightClient::FIELD_SETTERS = {
-  {
-    GroupStateFieldNames::STATUS,
-    [](const MiLightClient* client, const JsonVariant val) {
-      client->updateStatus(parseMilightStatus(val));
-    }
-  },
-  {GroupStateFieldNames::LEVEL, &MiLightClient::updateBrightness},
-  {
-    GroupStateFieldNames::BRIGHTNESS,
-    [](const MiLightClient* client, const uint16_t arg) {
-      client->updateBrightness(Units::rescale<uint16_t, uint16_t>(arg, 100, 255));
-    }
-  },
-  {GroupStateFieldNames::HUE, &MiLightClient::updateHue},
-  {GroupStateFieldNames::SATURATION, &MiLightClient::updateSaturation},
-  {GroupStateFieldNames::KELVIN, &MiLightClient::updateTemperature},
-  {GroupStateFieldNames::TEMPERATURE, &MiLightClient::updateTemperature},
-  {
-    GroupStateFieldNames::COLOR_TEMP,
-    [](const MiLightClient* client, const uint16_t arg) {
-      client->updateTemperature(Units::miredsToWhiteVal(arg, 100));
-    }
-  },
-  {GroupStateFieldNames::MODE, &MiLightClient::updateMode},
-  {GroupStateFieldNames::COLOR, &MiLightClient::updateColor},
-  {GroupStateFieldNames::EFFECT, &MiLightClient::handleEffect},
-  {GroupStateFieldNames::COMMAND, &MiLightClient::handleCommand},
-  {GroupStateFieldNames::COMMANDS, &MiLightClient::handleCommands}
-};
-
 MiLightClient::MiLightClient(
   RadioSwitchboard& radioSwitchboard,
   PacketSender& packetSender,
@@ -75,7 +25,60 @@ MiLightClient::MiLightClient(
     , currentState(nullptr), settings(settings)
     , packetSender(packetSender)
     , transitions(transitions)
-    , repeatsOverride(0) {
+    , redundantCommands(settings)
+    , fanoutStats({0, 0, 0})
+    , packetCapture(nullptr)
+    , captureStream(nullptr)
+    , commandDebouncer(settings, [this](const BulbId& bulbId, const GroupStateField field, const uint16_t value) {
+        updateField(bulbId, field, value);
+      })
+    , commandSource(CommandSource::INTERNAL)
+    , repeatsOverride(0)
+    , transactionId(PacketSender::NO_TRANSACTION)
+    , flushTransactionId(PacketSender::NO_TRANSACTION)
+    , packetOutput(*this) {
+}
+
+MiLightClient::QueueOutput::QueueOutput(MiLightClient& client)
+  : client(client)
+{ }
+
+uint8_t* MiLightClient::QueueOutput::allocate(const size_t packetLength) {
+  if (client.captureStream != nullptr) {
+    return client.captureStream->allocate(packetLength);
+  }
+
+  uint32_t transaction = client.transactionId;
+  if (transaction == PacketSender::NO_TRANSACTION) {
+    if (client.flushTransactionId == PacketSender::NO_TRANSACTION) {
+      client.flushTransactionId = client.packetSender.beginTransaction();
+    }
+    transaction = client.flushTransactionId;
+  }
+
+  uint8_t* packet = client.packetSender.reserve(client.currentRemote, client.repeatsOverride, transaction);
+
+  // A dropped packet won't be sent, so it isn't waited for
+  if (packet != nullptr && client.redundantCommands.isEnabled()) {
+    client.redundantCommands.queued(client.currentRemote->packetFormatter->currentBulbId());
+  }
+
+  return packet;
+}
+
+bool MiLightClient::QueueOutput::repeatLast(const size_t count) {
+  // Captured packets are stored, so each copy is built
+  if (client.captureStream != nullptr || ! client.packetSender.repeatLast(count)) {
+    return false;
+  }
+
+  if (client.redundantCommands.isEnabled()) {
+    for (size_t i = 0; i < count; ++i) {
+      client.redundantCommands.queued(client.currentRemote->packetFormatter->currentBulbId());
+    }
+  }
+
+  return true;
 }
 
 void MiLightClient::setHeld(const bool held) const {
@@ -88,7 +91,7 @@ void MiLightClient::prepare(
   const uint8_t groupId
 ) {
   this->currentRemote = remoteConfig;
-  currentRemote->packetFormatter->prepare(deviceId, groupId);
+  currentRemote->packetFormatter->prepare(deviceId, groupId, &packetOutput);
   this->currentState = stateStore->get(deviceId, groupId, remoteConfig->type);
 }
 
@@ -283,11 +286,19 @@ void MiLightClient::updateColor(const JsonVariant json) const {
     return;
   }
 
+  updateColor(color);
+}
+
+bool MiLightClient::isWhite(const ParsedColor& color) {
   // We consider an RGB color "white" if all color intensities are roughly the
   // same value.  An unscientific value of 10 (~4%) is chosen.
-  if ( abs(color.r - color.g) < RGB_WHITE_THRESHOLD
+  return abs(color.r - color.g) < RGB_WHITE_THRESHOLD
     && abs(color.g - color.b) < RGB_WHITE_THRESHOLD
-    && abs(color.r - color.b) < RGB_WHITE_THRESHOLD) {
+    && abs(color.r - color.b) < RGB_WHITE_THRESHOLD;
+}
+
+void MiLightClient::updateColor(const ParsedColor& color) const {
+  if (isWhite(color)) {
       this->updateColorWhite();
   } else {
     this->updateHue(color.hue);
@@ -296,33 +307,48 @@ void MiLightClient::updateColor(const JsonVariant json) const {
 }
 
 void MiLightClient::update(const JsonObject object) {
+  update(planUpdate(object));
+}
+
+CommandPlan MiLightClient::planUpdate(const JsonObject object) const {
+  return CommandPlan(object, transitions.getDefaultPolicy());
+}
+
+void MiLightClient::update(const CommandPlan& plan) {
   if (this->updateBeginHandler) {
     this->updateBeginHandler();
   }
 
-  const JsonVariant status = this->extractStatus(object);
-  const uint8_t parsedStatus = this->parseStatus(status);
-  const JsonVariant jsonTransition = object[RequestKeys::TRANSITION];
-  float transition = 0;
+  // Everything sent for this update is one command as far as side effects of sent packets go
+  transactionId = packetSender.beginTransaction();
 
-  if (!jsonTransition.isNull()) {
-    if (jsonTransition.is<float>()) {
-      transition = jsonTransition.as<float>();
-    } else if (jsonTransition.is<size_t>()) {
-      transition = jsonTransition.as<size_t>();
-    } else {
-      Serial.println(F("MiLightClient - WARN: unsupported transition type.  Must be float or int."));
-    }
+  const float transition = plan.transitionDuration;
+  const TransitionPolicy policy = plan.transitionPolicy;
+  const EasingCurve easing = plan.transitionEasing;
+  const BulbId bulbId = currentRemote->packetFormatter->currentBulbId();
+  const CommandPlan::FieldOp* brightness = plan.findBrightnessField();
+  // Fields the bulb is already known to be in can be skipped, if that's enabled
+  const bool filterRedundant = redundantCommands.isEnabled() && ! plan.force && currentState != nullptr;
+  if (filterRedundant && ! packetSender.isSending()) {
+    redundantCommands.clearPending();
   }
-
-  const JsonVariant brightness = object[GroupStateFieldNames::BRIGHTNESS];
-  const JsonVariant level = object[GroupStateFieldNames::LEVEL];
-  const bool isBrightnessDefined = !brightness.isNull() || !level.isNull();
+  // Brightness depends on the bulb mode, so it can only be skipped if nothing before it
+  // (which might change the mode) was sent
+  bool sentField = false;
 
   // Always turn on first
-  if (parsedStatus == ON) {
+  if (plan.status == ON) {
     if (transition == 0) {
-      this->updateStatus(ON);
+      if (packetCapture == nullptr) {
+        transitions.cancelTransitions(bulbId, GroupStateField::STATUS);
+      }
+
+      if (! filterRedundant
+        || ! RedundantCommandFilter::isStatusSatisfied(*currentState, ON)
+        || ! skipRedundant(bulbId)) {
+        this->updateStatus(ON);
+        sentField = true;
+      }
     }
     // Don't do an "On" transition if the bulb is already on.  The reasons for this are:
     //   * Ambiguous what the behavior should be.  Should it ramp to full brightness?
@@ -336,55 +362,394 @@ void MiLightClient::update(const JsonObject object) {
       // If brightness is defined, we'll want to transition to that.  Status
       // transitions only ramp up/down to the max/min. Otherwise, turn the bulb on
       // and let field transitions handle the rest.
-      if (!isBrightnessDefined) {
-        handleTransition(GroupStateField::STATUS, status, transition, 0);
+      if (brightness == nullptr) {
+        handleTransition(GroupStateField::STATUS, plan.rawStatus, transition, policy, easing, 0);
       } else {
         this->updateStatus(ON);
-
-        if (! brightness.isNull()) {
-          handleTransition(GroupStateField::BRIGHTNESS, brightness, transition, 0);
-        } else if (! level.isNull()) {
-          handleTransition(GroupStateField::LEVEL, level, transition, 0);
-        }
+        handleTransition(brightness->field, brightness->rawValue, transition, policy, easing, 0);
       }
     }
   }
 
-  for (const char* fieldName : FIELD_ORDERINGS) {
-    if (object.containsKey(fieldName)) {
-      auto handler = FIELD_SETTERS.find(fieldName);
-      const JsonVariant value = object[fieldName];
-
-      if (handler != FIELD_SETTERS.end()) {
-        // No transition -- set the field directly
-        if (transition == 0) {
-          handler->second(this, value);
-        } else {
-          const GroupStateField field = GroupStateFieldHelpers::getFieldByName(fieldName);
-
-          if (   !GroupStateFieldHelpers::isBrightnessField(field)  // If the field isn't brightness
-               || parsedStatus == STATUS_UNDEFINED                  // or if there was not a status field
-               || currentState->isOn()                              // or if the bulb was already on
-          ) {
-            handleTransition(field, value, transition);
-          }
+  const auto sendField = [&](const CommandPlan::FieldOp& op) {
+    // No transition -- set the field directly
+    if (transition == 0) {
+      if (packetCapture == nullptr) {
+        transitions.cancelTransitions(bulbId, op.field);
+      }
+
+      const bool redundant = filterRedundant
+        && ! (sentField && GroupStateFieldHelpers::isBrightnessField(op.field))
+        && RedundantCommandFilter::isFieldSatisfied(*currentState, plan, op)
+        && skipRedundant(bulbId, countFieldPackets(plan, op));
+
+      if (redundant) {
+        // The bulb is already where this asks, so an older held value mustn't move it
+        if (packetCapture == nullptr) {
+          commandDebouncer.cancel(bulbId, op.field);
         }
+      } else if (debounceField(bulbId, op.field, op.value)) {
+        applyField(plan, op);
+        sentField = true;
+      }
+    } else {
+      // A held value would undo the transition once it's sent
+      if (packetCapture == nullptr) {
+        commandDebouncer.cancel(bulbId, op.field);
+      }
+
+      if (   !GroupStateFieldHelpers::isBrightnessField(op.field)  // If the field isn't brightness
+          || plan.status == CommandPlan::STATUS_UNDEFINED          // or if there was not a status field
+          || currentState->isOn()                                  // or if the bulb was already on
+      ) {
+        handleTransition(op.field, op.rawValue, transition, policy, easing);
       }
     }
+  };
+
+  if (transition == 0 && currentState != nullptr && ModePlanner::appliesTo(currentRemote->type)) {
+    // Send fields in the order that switches the bulb's mode the fewest times
+    PacketFormatter* formatter = currentRemote->packetFormatter;
+    const ModePlanner modes(currentRemote->type, plan, currentState->getBulbMode(), settings.enableAutomaticModeSwitching);
+    bool finishedModes = false;
+
+    // Brightness is per mode, so the bulb has to be in its final mode before it's sent
+    const auto finishModes = [&]() {
+      if (! finishedModes) {
+        finishedModes = true;
+
+        if (formatter->getPlannedMode() != modes.getFinalMode()) {
+          this->switchToMode(modes.getFinalMode());
+          sentField = true;
+        }
+        formatter->endModePlan();
+      }
+    };
+
+    formatter->beginModePlan(currentState->getBulbMode());
+
+    for (const CommandPlan::FieldOp* op : modes.getFields()) {
+      if (GroupStateFieldHelpers::isBrightnessField(op->field)) {
+        finishModes();
+      } else if (ModePlanner::isWhiteSwitch(plan, *op)
+        && formatter->hasEnteredPlannedMode()
+        && formatter->getPlannedMode() == BULB_MODE_WHITE) {
+        continue;
+      }
+
+      sendField(*op);
+    }
+
+    finishModes();
+  } else {
+    for (const CommandPlan::FieldOp& op : plan.fields) {
+      sendField(op);
+    }
+  }
+
+  // Commands can't be transitioned, so they're always sent right away
+  if (! plan.command.isNull()) {
+    this->handleCommand(plan.command);
   }
+  this->handleCommands(plan.commands);
 
   // Raw packet command/args
-  if (object.containsKey("button_id") && object.containsKey("argument")) {
-    this->command(object["button_id"], object["argument"]);
+  if (plan.hasRawCommand) {
+    this->command(plan.buttonId, plan.argument);
   }
 
   // Always turn off last
-  if (parsedStatus == OFF) {
+  if (plan.status == OFF) {
+    // Held values would turn the bulb back on
+    if (packetCapture == nullptr) {
+      commandDebouncer.cancel(bulbId);
+    }
+
     if (transition == 0) {
-      this->updateStatus(OFF);
+      // Anything still fading would turn the bulb back on
+      if (packetCapture == nullptr) {
+        transitions.cancelTransitions(bulbId, Transition::FIELD_BIT_ALL);
+      }
+
+      if (! filterRedundant
+        || ! RedundantCommandFilter::isStatusSatisfied(*currentState, OFF)
+        || ! skipRedundant(bulbId)) {
+        this->updateStatus(OFF);
+      }
+    } else {
+      handleTransition(GroupStateField::STATUS, plan.rawStatus, transition, policy, easing);
+    }
+  }
+
+  transactionId = PacketSender::NO_TRANSACTION;
+
+  if (this->updateEndHandler) {
+    this->updateEndHandler();
+  }
+}
+
+void MiLightClient::updateMany(const std::vector<BulbId>& targets, const CommandPlan& plan) {
+  std::vector<GroupFanout::Target> planned;
+
+  if (canSendToGroup0(plan)) {
+    planned = GroupFanout::plan(targets);
+  } else {
+    planned.reserve(targets.size());
+    for (const BulbId& bulbId : targets) {
+      planned.push_back({bulbId, 1});
+    }
+  }
+
+  for (const GroupFanout::Target& target : planned) {
+    const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(target.bulbId.deviceType);
+
+    if (config == nullptr) {
+      Serial.printf_P(PSTR("MiLightClient::updateMany: unknown device type %d\n"), static_cast<uint8_t>(target.bulbId.deviceType));
+      continue;
+    }
+
+    if (target.numTargets > 1) {
+      // Transitions are tracked for each group, and would undo the group 0 command
+      for (uint8_t groupId = 1; groupId <= config->numGroups; ++groupId) {
+        transitions.cancelTransitions(BulbId(target.bulbId.deviceId, groupId, target.bulbId.deviceType), Transition::FIELD_BIT_ALL);
+      }
+    }
+
+    const size_t queuedBefore = packetSender.enqueuedPackets();
+
+    prepare(config, target.bulbId.deviceId, target.bulbId.groupId);
+    update(plan);
+
+    if (target.numTargets > 1) {
+      fanoutStats.group0Commands++;
+      fanoutStats.commandsSaved += target.numTargets - 1;
+      fanoutStats.packetsSaved += (packetSender.enqueuedPackets() - queuedBefore) * (target.numTargets - 1);
+    }
+  }
+}
+
+void MiLightClient::capture(const BulbId& bulbId, const CommandPlan& plan, const PacketCaptureHandler& handler) {
+  const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(bulbId.deviceType);
+
+  if (config == nullptr) {
+    Serial.printf_P(PSTR("MiLightClient::capture: unknown device type %d\n"), static_cast<uint8_t>(bulbId.deviceType));
+    return;
+  }
+
+  uint8_t buffer[PACKET_FORMATTER_BUFFER_SIZE];
+  PacketStream stream(buffer, sizeof(buffer));
+
+  packetCapture = &handler;
+  captureStream = &stream;
+  config->packetFormatter->setStateIndependent(true);
+
+  prepare(config, bulbId.deviceId, bulbId.groupId);
+  currentState = nullptr;
+  update(plan);
+
+  config->packetFormatter->setStateIndependent(false);
+  captureStream = nullptr;
+  packetCapture = nullptr;
+}
+
+bool MiLightClient::canSendToGroup0(const CommandPlan& plan) const {
+  // Transitions start from each group's own state.  Commands and raw packets may not mean the
+  // same thing for group 0 (e.g. pair/unpair).  And skipping redundant fields depends on the
+  // state of each group.
+  return ! plan.hasTransition()
+    && plan.command.isNull()
+    && plan.commands.isNull()
+    && ! plan.hasRawCommand
+    && (! redundantCommands.isEnabled() || plan.force);
+}
+
+bool MiLightClient::skipRedundant(const BulbId& bulbId, const size_t numPackets) {
+  const size_t repeats = repeatsOverride == PacketSender::DEFAULT_PACKET_SENDS_VALUE
+    ? settings.packetRepeats
+    : repeatsOverride;
+
+  return redundantCommands.suppress(bulbId, numPackets * repeats);
+}
+
+size_t MiLightClient::countFieldPackets(const CommandPlan& plan, const CommandPlan::FieldOp& op) const {
+  const PacketFormatter* formatter = currentRemote->packetFormatter;
+
+  switch (op.field) {
+    case GroupStateField::LEVEL:
+    case GroupStateField::BRIGHTNESS:
+    case GroupStateField::KELVIN:
+      return formatter->getFieldPacketCount(op.field, op.value);
+    case GroupStateField::COLOR_TEMP:
+      return formatter->getFieldPacketCount(GroupStateField::KELVIN, Units::miredsToWhiteVal(op.value, 100));
+    case GroupStateField::COLOR:
+      // Hue and saturation are sent separately
+      return isWhite(plan.color) ? 1 : 2;
+    default:
+      return 1;
+  }
+}
+
+bool MiLightClient::debounceField(const BulbId& bulbId, const GroupStateField field, const uint16_t value) {
+  if (packetCapture != nullptr) {
+    return true;
+  }
+
+  // Colors set hue and saturation, or white mode, so anything held for those is older
+  if (field == GroupStateField::COLOR) {
+    commandDebouncer.cancel(bulbId, GroupStateField::HUE);
+    commandDebouncer.cancel(bulbId, GroupStateField::SATURATION);
+    commandDebouncer.cancel(bulbId, GroupStateField::KELVIN);
+  }
+
+  // Plans hold brightness as a level already
+  const uint16_t slotValue = field == GroupStateField::COLOR_TEMP
+    ? Units::miredsToWhiteVal(value, 100)
+    : value;
+
+  return commandDebouncer.submit(commandSource, bulbId, CommandDebouncer::slotFor(field), slotValue);
+}
+
+bool MiLightClient::debounce(const GroupStateField field, const uint16_t value) {
+  return debounceField(currentRemote->packetFormatter->currentBulbId(), field, value);
+}
+
+void MiLightClient::applyField(const CommandPlan& plan, const CommandPlan::FieldOp& op) const {
+  switch (op.field) {
+    case GroupStateField::LEVEL:
+    case GroupStateField::BRIGHTNESS:
+      // Brightness was rescaled to a level when the plan was built
+      this->updateBrightness(op.value);
+      break;
+    case GroupStateField::HUE:
+      this->updateHue(op.value);
+      break;
+    case GroupStateField::SATURATION:
+      this->updateSaturation(op.value);
+      break;
+    case GroupStateField::KELVIN:
+      this->updateTemperature(op.value);
+      break;
+    case GroupStateField::COLOR_TEMP:
+      this->updateTemperature(Units::miredsToWhiteVal(op.value, 100));
+      break;
+    case GroupStateField::MODE:
+      this->updateMode(op.value);
+      break;
+    case GroupStateField::COLOR:
+      this->updateColor(plan.color);
+      break;
+    case GroupStateField::EFFECT:
+      if (op.value == CommandPlan::EFFECT_NIGHT_MODE) {
+        this->enableNightMode();
+      } else if (op.value == CommandPlan::EFFECT_WHITE_MODE) {
+        this->updateColorWhite();
+      } else {
+        this->updateMode(op.value);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void MiLightClient::switchToMode(const BulbMode mode) const {
+  switch (mode) {
+    case BULB_MODE_COLOR:
+      this->updateHue(currentState->getHue());
+      break;
+    case BULB_MODE_WHITE:
+      this->updateColorWhite();
+      break;
+    case BULB_MODE_SCENE:
+      this->updateMode(currentState->getMode());
+      break;
+    case BULB_MODE_NIGHT:
+      this->enableNightMode();
+      break;
+  }
+}
+
+bool MiLightClient::beginTypedUpdate(const BulbId& bulbId, const char* caller) {
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(bulbId.deviceType);
+
+  if (remoteConfig == nullptr) {
+    Serial.printf_P(PSTR("MiLightClient::%s: unknown device type %d\n"), caller, bulbId.deviceType);
+    return false;
+  }
+
+  this->currentRemote = remoteConfig;
+  this->currentState = nullptr;
+  currentRemote->packetFormatter->prepare(bulbId.deviceId, bulbId.groupId, &packetOutput);
+
+  if (this->updateBeginHandler) {
+    this->updateBeginHandler();
+  }
+
+  return true;
+}
+
+void MiLightClient::updateField(const BulbId& bulbId, const GroupStateField field, const uint16_t value) {
+  if (! beginTypedUpdate(bulbId, "updateField")) {
+    return;
+  }
+
+  switch (field) {
+    case GroupStateField::STATE:
+    case GroupStateField::STATUS:
+      this->updateStatus(static_cast<MiLightStatus>(value));
+      break;
+    case GroupStateField::LEVEL:
+      this->updateBrightness(value);
+      break;
+    case GroupStateField::BRIGHTNESS:
+      this->updateBrightness(Units::rescale<uint16_t, uint16_t>(value, 100, 255));
+      break;
+    case GroupStateField::HUE:
+      this->updateHue(value);
+      break;
+    case GroupStateField::SATURATION:
+      this->updateSaturation(value);
+      break;
+    case GroupStateField::KELVIN:
+      this->updateTemperature(value);
+      break;
+    case GroupStateField::COLOR_TEMP:
+      this->updateTemperature(Units::miredsToWhiteVal(value, 100));
+      break;
+    case GroupStateField::MODE:
+      this->updateMode(value);
+      break;
+    default:
+      Serial.printf_P(PSTR("MiLightClient::updateField: unsupported field %s\n"), GroupStateFieldHelpers::getFieldName(field));
+      break;
+  }
+
+  if (this->updateEndHandler) {
+    this->updateEndHandler();
+  }
+}
+
+void MiLightClient::updateIncrement(const BulbId& bulbId, const GroupStateField field, const IncrementDirection direction) {
+  if (! beginTypedUpdate(bulbId, "updateIncrement")) {
+    return;
+  }
+
+  const bool increase = direction == IncrementDirection::INCREASE;
+
+  if (GroupStateFieldHelpers::isBrightnessField(field)) {
+    if (increase) {
+      this->increaseBrightness();
+    } else {
+      this->decreaseBrightness();
+    }
+  } else if (field == GroupStateField::KELVIN || field == GroupStateField::COLOR_TEMP) {
+    if (increase) {
+      this->increaseTemperature();
     } else {
-      handleTransition(GroupStateField::STATUS, status, transition);
+      this->decreaseTemperature();
     }
+  } else {
+    Serial.printf_P(PSTR("MiLightClient::updateIncrement: unsupported field %s\n"), GroupStateFieldHelpers::getFieldName(field));
   }
 
   if (this->updateEndHandler) {
@@ -448,7 +813,7 @@ void MiLightClient::handleCommand(const JsonVariant command) const {
   }
 }
 
-void MiLightClient::handleTransition(const GroupStateField field, const JsonVariant value, const float duration, const int16_t startValue) const {
+void MiLightClient::handleTransition(const GroupStateField field, const JsonVariant value, const float duration, const TransitionPolicy policy, const EasingCurve easing, const int16_t startValue) const {
   const BulbId bulbId = currentRemote->packetFormatter->currentBulbId();
   std::shared_ptr<Transition::Builder> transitionBuilder = nullptr;
 
@@ -457,15 +822,23 @@ void MiLightClient::handleTransition(const GroupStateField field, const JsonVari
     return;
   }
 
-  if (!currentState->isSetField(field)) {
+  const uint8_t numIncrements = currentRemote->packetFormatter->getIncrementSteps(field);
+
+  // Increment-only fields can be planned without knowing where they start
+  if (numIncrements == 0 && !currentState->isSetField(field)) {
     Serial.println(F("Error planning transition: current state for field could not be determined"));
     return;
   }
 
-  if (field == GroupStateField::COLOR) {
-    const ParsedColor currentColor = currentState->getColor();
+  if (numIncrements > 0) {
+    // The bulb picks up from wherever it physically is, so always start from the state
+    transitionBuilder = buildIncrementTransition(bulbId, field, FETCH_VALUE_FROM_STATE, value, numIncrements, policy);
+  } else if (field == GroupStateField::COLOR) {
+    ParsedColor currentColor = currentState->getColor();
     const ParsedColor endColor = ParsedColor::fromJson(value);
 
+    transitions.getStartColor(bulbId, policy, currentColor);
+
     transitionBuilder = transitions.buildColorTransition(
       bulbId,
       currentColor,
@@ -481,6 +854,10 @@ void MiLightClient::handleTransition(const GroupStateField field, const JsonVari
       startLevel = startValue;
     }
 
+    if (uint16_t level; transitions.getStartValue(bulbId, GroupStateField::LEVEL, policy, level)) {
+      startLevel = level;
+    }
+
     transitionBuilder = transitions.buildStatusTransition(bulbId, status, startLevel);
   } else {
     uint16_t currentValue;
@@ -492,6 +869,8 @@ void MiLightClient::handleTransition(const GroupStateField field, const JsonVari
       currentValue = startValue;
     }
 
+    transitions.getStartValue(bulbId, field, policy, currentValue);
+
     transitionBuilder = transitions.buildFieldTransition(
       bulbId,
       field,
@@ -506,7 +885,58 @@ void MiLightClient::handleTransition(const GroupStateField field, const JsonVari
   }
 
   transitionBuilder->setDuration(duration);
-  transitions.addTransition(transitionBuilder->build());
+  transitionBuilder->setEasing(easing);
+  transitions.addTransition(transitionBuilder->build(), policy);
+}
+
+std::shared_ptr<Transition::Builder> MiLightClient::buildIncrementTransition(
+  const BulbId& bulbId,
+  const GroupStateField field,
+  const int16_t startValue,
+  const uint16_t endValue,
+  const uint8_t numIncrements,
+  const TransitionPolicy policy
+) const {
+  const bool isBrightness = GroupStateFieldHelpers::isBrightnessField(field);
+  // Up/down commands move level or kelvin, both of which are in [0, 100]
+  const GroupStateField stepField = isBrightness ? GroupStateField::LEVEL : GroupStateField::KELVIN;
+  const GroupStateField scratchField = isBrightness ? GroupStateField::BRIGHTNESS : GroupStateField::KELVIN;
+
+  const auto toStep = [field, stepField, numIncrements](const uint16_t value) {
+    uint16_t stepValue = 0;
+    Transition::convertFieldValue(field, value, stepField, stepValue);
+    return static_cast<int8_t>((std::min<uint16_t>(stepValue, 100) * numIncrements) / 100);
+  };
+
+  int8_t startStep = IncrementTransition::UNKNOWN_STEP;
+  uint8_t numResets = numIncrements;
+
+  if (startValue != FETCH_VALUE_FROM_STATE) {
+    startStep = toStep(startValue);
+  } else if (currentState->isSetField(field)) {
+    startStep = toStep(currentState->getParsedFieldValue(field));
+  } else if (currentState->isSetScratchField(scratchField)) {
+    // Already part way through driving the field down.  The state becomes known when the
+    // scratch value reaches 0.
+    numResets = currentState->getScratchFieldValue(scratchField);
+  }
+
+  if (uint16_t value; transitions.getStartValue(bulbId, field, policy, value)) {
+    startStep = toStep(value);
+  }
+
+  std::shared_ptr<Transition::Builder> builder = transitions.buildIncrementTransition(
+    bulbId,
+    stepField,
+    startStep,
+    toStep(endValue),
+    numIncrements,
+    numResets
+  );
+  // Every step is exactly one packet
+  builder->setMinPeriod(packetSender.estimateAirtime(1));
+
+  return builder;
 }
 
 bool MiLightClient::handleTransition(const JsonObject args, JsonDocument& responseObj) const {
@@ -521,6 +951,10 @@ bool MiLightClient::handleTransition(const JsonObject args, JsonDocument& respon
   const JsonVariant startValue = args[FPSTR(TransitionParams::START_VALUE)];
   const JsonVariant endValue = args[FPSTR(TransitionParams::END_VALUE)];
   const GroupStateField field = GroupStateFieldHelpers::getFieldByName(fieldName);
+  const TransitionPolicy policy = TransitionController::parsePolicy(
+    args[FPSTR(TransitionParams::POLICY)].as<const char*>(),
+    transitions.getDefaultPolicy()
+  );
   std::shared_ptr<Transition::Builder> transitionBuilder = nullptr;
 
   if (field == GroupStateField::UNKNOWN) {
@@ -537,17 +971,36 @@ bool MiLightClient::handleTransition(const JsonObject args, JsonDocument& respon
     case GroupStateField::BRIGHTNESS:
     case GroupStateField::LEVEL:
     case GroupStateField::KELVIN:
-    case GroupStateField::COLOR_TEMP:
+    case GroupStateField::COLOR_TEMP: {
+      if (const uint8_t numIncrements = currentRemote->packetFormatter->getIncrementSteps(field); numIncrements > 0) {
+        transitionBuilder = buildIncrementTransition(
+          bulbId,
+          field,
+          startValue.isNull() ? FETCH_VALUE_FROM_STATE : startValue.as<int16_t>(),
+          endValue,
+          numIncrements,
+          policy
+        );
+        break;
+      }
+
+      uint16_t _startValue;
+
+      if (startValue.isNull()) {
+        _startValue = currentState->getParsedFieldValue(field);
+        transitions.getStartValue(bulbId, field, policy, _startValue);
+      } else {
+        _startValue = startValue.as<uint16_t>();
+      }
 
       transitionBuilder = transitions.buildFieldTransition(
         bulbId,
         field,
-        startValue.isNull()
-          ? currentState->getParsedFieldValue(field)
-          : startValue.as<uint16_t>(),
+        _startValue,
         endValue
       );
       break;
+    }
 
     default:
       break;
@@ -555,7 +1008,7 @@ bool MiLightClient::handleTransition(const JsonObject args, JsonDocument& respon
 
   // Color can be decomposed into hue/saturation, and these can be transitioned separately
   if (field == GroupStateField::COLOR) {
-    const ParsedColor _startValue = startValue.isNull()
+    ParsedColor _startValue = startValue.isNull()
       ? currentState->getColor()
       : ParsedColor::fromJson(startValue);
     const ParsedColor endColor = ParsedColor::fromJson(endValue);
@@ -564,6 +1017,9 @@ bool MiLightClient::handleTransition(const JsonObject args, JsonDocument& respon
       responseObj[F("error")] = F("Transition - error parsing start color");
       return false;
     }
+    if (startValue.isNull()) {
+      transitions.getStartColor(bulbId, policy, _startValue);
+    }
     if (! endColor.success) {
       responseObj[F("error")] = F("Transition - error parsing end color");
       return false;
@@ -588,6 +1044,10 @@ bool MiLightClient::handleTransition(const JsonObject args, JsonDocument& respon
       startLevel = 100;
     }
 
+    if (uint16_t level; transitions.getStartValue(bulbId, GroupStateField::LEVEL, policy, level)) {
+      startLevel = level;
+    }
+
     transitionBuilder = transitions.buildStatusTransition(bulbId, toStatus, startLevel);
   }
 
@@ -604,6 +1064,114 @@ bool MiLightClient::handleTransition(const JsonObject args, JsonDocument& respon
   if (args.containsKey(FPSTR(TransitionParams::PERIOD))) {
     transitionBuilder->setPeriod(args[FPSTR(TransitionParams::PERIOD)]);
   }
+  transitionBuilder->setEasing(Easing::parse(args[FPSTR(TransitionParams::EASING)].as<const char*>(), EasingCurve::LINEAR));
+
+  transitions.addTransition(transitionBuilder->build(), policy);
+  return true;
+}
+
+bool MiLightClient::handleSceneTransition(const JsonObject args, JsonDocument& responseObj) const {
+  // Fields that can be moved in lockstep.  Color is split into hue and saturation.
+  static const GroupStateField SCENE_FIELDS[] = {
+    GroupStateField::LEVEL,
+    GroupStateField::BRIGHTNESS,
+    GroupStateField::KELVIN,
+    GroupStateField::COLOR_TEMP,
+    GroupStateField::HUE,
+    GroupStateField::SATURATION
+  };
+
+  const JsonArray bulbs = args[FPSTR(TransitionParams::BULBS)];
+
+  if (bulbs.isNull() || bulbs.size() == 0) {
+    responseObj[F("error")] = F("Scene transition must specify at least one bulb");
+    return false;
+  }
+
+  std::vector<SceneTransition::Member> members;
+  char errorMsg[80];
+
+  for (const JsonObject bulb : bulbs) {
+    const char* typeName = bulb.containsKey(GroupStateFieldNames::DEVICE_TYPE)
+      ? bulb[GroupStateFieldNames::DEVICE_TYPE].as<const char*>()
+      : bulb[F("remote_type")].as<const char*>();
+    const MiLightRemoteConfig* remoteConfig = typeName == nullptr ? nullptr : MiLightRemoteConfig::fromType(typeName);
+
+    if (remoteConfig == nullptr
+      || ! bulb.containsKey(GroupStateFieldNames::DEVICE_ID)
+      || ! bulb.containsKey(GroupStateFieldNames::GROUP_ID)) {
+      responseObj[F("error")] = F("Each bulb must specify device_id, group_id and a known device_type");
+      return false;
+    }
+
+    const String deviceId = bulb[GroupStateFieldNames::DEVICE_ID];
+    const BulbId bulbId(parseInt<uint16_t>(deviceId), bulb[GroupStateFieldNames::GROUP_ID].as<uint8_t>(), remoteConfig->type);
+    const GroupState* state = stateStore->get(bulbId);
+    StaticJsonDocument<64> colorTargets;
+
+    if (bulb.containsKey(GroupStateFieldNames::COLOR)) {
+      const ParsedColor color = ParsedColor::fromJson(bulb[GroupStateFieldNames::COLOR]);
+
+      if (! color.success) {
+        responseObj[F("error")] = F("Scene transition - error parsing color");
+        return false;
+      }
+
+      colorTargets[GroupStateFieldNames::HUE] = color.hue;
+      colorTargets[GroupStateFieldNames::SATURATION] = color.saturation;
+    }
+
+    for (const GroupStateField field : SCENE_FIELDS) {
+      const char* fieldName = GroupStateFieldHelpers::getFieldName(field);
+      JsonVariant target = bulb[fieldName];
+
+      if (target.isNull()) {
+        target = colorTargets[fieldName];
+      }
+      if (target.isNull()) {
+        continue;
+      }
+
+      // Up/down commands can't be sent in lockstep with everything else
+      if (remoteConfig->packetFormatter->getIncrementSteps(field) > 0) {
+        sprintf_P(errorMsg, PSTR("Scene transition - %s can't be transitioned on %s bulbs"), fieldName, remoteConfig->name.c_str());
+        responseObj[F("error")] = errorMsg;
+        return false;
+      }
+
+      uint16_t startValue = 0;
+      bool knownStart = state != nullptr && state->isSetField(field);
+
+      if (knownStart) {
+        startValue = state->getParsedFieldValue(field);
+      }
+      // Pick up from wherever a running transition has gotten the field to
+      knownStart = transitions.getStartValue(bulbId, field, TransitionPolicy::MERGE, startValue) || knownStart;
+
+      if (! knownStart) {
+        sprintf_P(errorMsg, PSTR("Scene transition - current %s of a bulb could not be determined"), fieldName);
+        responseObj[F("error")] = errorMsg;
+        return false;
+      }
+
+      members.push_back({ bulbId, field, startValue, target.as<uint16_t>() });
+    }
+  }
+
+  if (members.empty()) {
+    responseObj[F("error")] = F("Scene transition doesn't change any fields");
+    return false;
+  }
+
+  std::shared_ptr<Transition::Builder> transitionBuilder = transitions.buildSceneTransition(members);
+
+  if (args.containsKey(FPSTR(TransitionParams::DURATION))) {
+    transitionBuilder->setDuration(args[FPSTR(TransitionParams::DURATION)]);
+  }
+  if (args.containsKey(FPSTR(TransitionParams::PERIOD))) {
+    transitionBuilder->setPeriod(args[FPSTR(TransitionParams::PERIOD)]);
+  }
+  transitionBuilder->setEasing(Easing::parse(args[FPSTR(TransitionParams::EASING)].as<const char*>(), EasingCurve::LINEAR));
 
   transitions.addTransition(transitionBuilder->build());
   return true;
@@ -628,7 +1196,7 @@ JsonVariant MiLightClient::extractStatus(const JsonObject object) {
 
 uint8_t MiLightClient::parseStatus(const JsonVariant object) {
   if (object.isNull()) {
-    return STATUS_UNDEFINED;
+    return CommandPlan::STATUS_UNDEFINED;
   }
 
   return parseMilightStatus(object);
@@ -642,16 +1210,42 @@ void MiLightClient::clearRepeatsOverride() {
   this->repeatsOverride = PacketSender::DEFAULT_PACKET_SENDS_VALUE;
 }
 
+void MiLightClient::setCommandSource(const CommandSource source) {
+  this->commandSource = source;
+}
+
+void MiLightClient::clearCommandSource() {
+  this->commandSource = CommandSource::INTERNAL;
+}
+
 void MiLightClient::flushPacket() const {
-  PacketStream& stream = currentRemote->packetFormatter->buildPackets();
+  // Packets were built in place as the formatter went, so there's nothing left to queue
+  currentRemote->packetFormatter->endPackets();
+  flushTransactionId = PacketSender::NO_TRANSACTION;
 
-  while (stream.hasNext()) {
-    packetSender.enqueue(stream.next(), currentRemote, repeatsOverride);
+  if (captureStream != nullptr) {
+    while (captureStream->hasNext()) {
+      (*packetCapture)(captureStream->next(), *currentRemote);
+    }
+
+    captureStream->clear();
   }
 
   currentRemote->packetFormatter->reset();
 }
 
+RedundantCommandFilter& MiLightClient::getRedundantCommandFilter() {
+  return redundantCommands;
+}
+
+const GroupFanoutStats& MiLightClient::getFanoutStats() const {
+  return fanoutStats;
+}
+
+CommandDebouncer& MiLightClient::getCommandDebouncer() {
+  return commandDebouncer;
+}
+
 void MiLightClient::onUpdateBegin(const EventHandler &handler) {
   this->updateBeginHandler = handler;
 }
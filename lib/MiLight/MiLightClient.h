@@ -9,14 +9,19 @@
 #include <GroupStateStore.h>
 #include <PacketSender.h>
 #include <TransitionController.h>
-#include <cstring>
-#include <map>
+#include <CommandPlan.h>
+#include <RedundantCommandFilter.h>
+#include <GroupFanout.h>
+#include <CommandDebouncer.h>
 
 //#define DEBUG_PRINTF
 //#define DEBUG_CLIENT_COMMANDS // enable to show each change command (like hue, brightness, etc.)
 
 namespace RequestKeys {
   static constexpr char TRANSITION[] = "transition";
+  static constexpr char TRANSITION_POLICY[] = "transition_policy";
+  static constexpr char TRANSITION_EASING[] = "transition_easing";
+  static constexpr char FORCE[] = "force";
 };
 
 namespace TransitionParams {
@@ -25,6 +30,9 @@ namespace TransitionParams {
   static constexpr char END_VALUE[] PROGMEM = "end_value";
   static constexpr char DURATION[] PROGMEM = "duration";
   static constexpr char PERIOD[] PROGMEM = "period";
+  static constexpr char POLICY[] PROGMEM = "policy";
+  static constexpr char BULBS[] PROGMEM = "bulbs";
+  static constexpr char EASING[] PROGMEM = "easing";
 }
 
 // Used to determine RGB colors that are approximately white
@@ -46,6 +54,7 @@ public:
   ~MiLightClient() { }
 
   typedef std::function<void(void)> EventHandler;
+  typedef std::function<void(const uint8_t* packet, const MiLightRemoteConfig& config)> PacketCaptureHandler;
 
   void prepare(const MiLightRemoteConfig* remoteConfig, uint16_t deviceId = -1, uint8_t groupId = -1);
   void prepare(MiLightRemoteType type, uint16_t deviceId = -1, uint8_t groupId = -1);
@@ -77,6 +86,7 @@ public:
   void updateColorRaw(uint8_t color) const;
   void enableNightMode() const;
   void updateColor(JsonVariant json) const;
+  void updateColor(const ParsedColor& color) const;
 
   // CCT methods
   void updateTemperature(uint8_t colorTemperature) const;
@@ -88,10 +98,35 @@ public:
   void updateSaturation(uint8_t saturation) const;
 
   void update(JsonObject object);
+  // Sends a parsed update to the bulb selected with prepare().  Build the plan once with
+  // planUpdate() to send the same update to many bulbs.
+  void update(const CommandPlan& plan);
+  CommandPlan planUpdate(JsonObject object) const;
+  // Sends the same update to each of the targets.  Where the targets cover every group of a
+  // device, a single group 0 command is sent instead (see GroupFanout).
+  void updateMany(const std::vector<BulbId>& targets, const CommandPlan& plan);
+  // Builds the packets for an update without sending them, and passes each to the handler.
+  // The bulb's state isn't used, so the packets can be stored and sent later.  Transitions
+  // aren't started or cancelled.
+  void capture(const BulbId& bulbId, const CommandPlan& plan, const PacketCaptureHandler& handler);
+
+  /*
+   * Sets a single field on a bulb without going through JSON.  Used for transition steps,
+   * which send one field at a time.  Doesn't cancel transitions, and doesn't look up the
+   * bulb's state (currentState is cleared until the next call to prepare()).
+   */
+  void updateField(const BulbId& bulbId, GroupStateField field, uint16_t value);
+
+  // Sends a single up/down command for a field.  Used by increment transitions.
+  void updateIncrement(const BulbId& bulbId, GroupStateField field, IncrementDirection direction);
+
   void handleCommand(JsonVariant command) const;
   void handleCommands(JsonArray commands) const;
   bool handleTransition(JsonObject args, JsonDocument& responseObj) const;
-  void handleTransition(GroupStateField field, JsonVariant value, float duration, int16_t startValue = FETCH_VALUE_FROM_STATE) const;
+  void handleTransition(GroupStateField field, JsonVariant value, float duration, TransitionPolicy policy, EasingCurve easing, int16_t startValue = FETCH_VALUE_FROM_STATE) const;
+  // Moves the bulbs listed in args["bulbs"] to their target states together.  See
+  // SceneTransition.
+  bool handleSceneTransition(JsonObject args, JsonDocument& responseObj) const;
   void handleEffect(const String& effect) const;
 
   void onUpdateBegin(const EventHandler &handler);
@@ -108,18 +143,26 @@ public:
   // Remove the repeat count override.
   void clearRepeatsOverride();
 
+  // Sets where the commands that follow came from, which decides how they're debounced.
+  // Reset with clearCommandSource.
+  void setCommandSource(CommandSource source);
+  void clearCommandSource();
+
+  // For callers that use the typed update methods directly.  Returns true if the field
+  // should be sent to the bulb selected with prepare() now, or false if it's been held by
+  // the debouncer, which will send it later.
+  bool debounce(GroupStateField field, uint16_t value);
+
   static uint8_t parseStatus(JsonVariant object);
   static JsonVariant extractStatus(JsonObject object);
+  // RGB colors close enough to white are sent as white mode
+  static bool isWhite(const ParsedColor& color);
 
-protected:
-  struct cmp_str {
-    bool operator()(char const *a, char const *b) const {
-        return std::strcmp(a, b) < 0;
-    }
-  };
-  static const std::map<const char*, std::function<void(MiLightClient*, JsonVariant)>, cmp_str> FIELD_SETTERS;
-  static const char* FIELD_ORDERINGS[];
+  RedundantCommandFilter& getRedundantCommandFilter();
+  const GroupFanoutStats& getFanoutStats() const;
+  CommandDebouncer& getCommandDebouncer();
 
+protected:
   RadioSwitchboard& radioSwitchboard;
   std::vector<std::shared_ptr<MiLightRadio>> radios;
   std::shared_ptr<MiLightRadio> currentRadio;
@@ -133,9 +176,64 @@ protected:
   Settings& settings;
   PacketSender& packetSender;
   TransitionController& transitions;
+  // Mutable so that flushPacket() can record queued packets
+  mutable RedundantCommandFilter redundantCommands;
+  GroupFanoutStats fanoutStats;
+  // Set while capturing.  Packets go here instead of being queued.
+  const PacketCaptureHandler* packetCapture;
+  // Set while capturing.  Packets are built here, then passed to packetCapture.
+  PacketStream* captureStream;
+  CommandDebouncer commandDebouncer;
+  CommandSource commandSource;
 
   // If set, override the number of packet repeats used.
   size_t repeatsOverride;
+  // Set while update() runs, so that every packet it sends is part of one transaction.
+  // Otherwise each flushPacket() starts its own.
+  uint32_t transactionId;
+  // Transaction for the packets built since the last flushPacket(), when transactionId isn't
+  // set.  Started when the first of them is queued.
+  mutable uint32_t flushTransactionId;
+
+  // Where formatters build packets for this client: straight into a send queue slot, or
+  // into captureStream while capturing.  Saves building each command in a buffer of its
+  // own and copying it into the queue afterwards.
+  class QueueOutput : public PacketOutput {
+  public:
+    explicit QueueOutput(MiLightClient& client);
+    uint8_t* allocate(size_t packetLength) override;
+    bool repeatLast(size_t count) override;
+
+  private:
+    MiLightClient& client;
+  };
+  QueueOutput packetOutput;
 
   void flushPacket() const;
+  void applyField(const CommandPlan& plan, const CommandPlan::FieldOp& op) const;
+  // Switches the current bulb to a mode, using the hue or scene in its known state
+  void switchToMode(BulbMode mode) const;
+  // Call for a field the bulb is already in, which would take numPackets packets to send.
+  // True if it should be skipped instead of sent.
+  bool skipRedundant(const BulbId& bulbId, size_t numPackets = 1);
+  // Number of packets applyField would send for op
+  size_t countFieldPackets(const CommandPlan& plan, const CommandPlan::FieldOp& op) const;
+  // Passes a field to the debouncer.  True if it should be sent now.
+  bool debounceField(const BulbId& bulbId, GroupStateField field, uint16_t value);
+  // True if the plan does the same thing when sent to group 0 as when sent to each group
+  bool canSendToGroup0(const CommandPlan& plan) const;
+
+  // Sets up for one of the typed updates.  Returns false if the device type is unknown.
+  bool beginTypedUpdate(const BulbId& bulbId, const char* caller);
+
+  // Plans a transition for a field the current remote can only change with up/down commands.
+  // The builder keeps a reference to bulbId.
+  std::shared_ptr<Transition::Builder> buildIncrementTransition(
+    const BulbId& bulbId,
+    GroupStateField field,
+    int16_t startValue,
+    uint16_t endValue,
+    uint8_t numIncrements,
+    TransitionPolicy policy
+  ) const;
 };
@@ -8,6 +8,7 @@
 #include<RgbCctPacketFormatter.h>
 #include<RgbPacketFormatter.h>
 #include<RgbwPacketFormatter.h>
+#include <V2RFEncoding.h>
 
 /**
  * IMPORTANT NOTE: These should be in the same order as MiLightRemoteType.
@@ -38,25 +39,74 @@ const MiLightRemoteConfig* MiLightRemoteConfig::fromType(const MiLightRemoteType
   return ALL_REMOTES[type];
 }
 
+// Remotes on each radio config, indexed the same as MiLightRadioConfig::ALL_CONFIGS.  The V2
+// remotes share one, and are told apart by the protocol ID in the decoded packet instead.
+static const MiLightRemoteConfig* const REMOTES_BY_RADIO_CONFIG[] = {
+  &FUT096Config,
+  &FUT007Config,
+  nullptr,
+  &FUT098Config,
+  &FUT020Config
+};
+static constexpr size_t V2_RADIO_CONFIG_INDEX = 2;
+
+// V2 remotes, indexed by protocol ID, starting from V2_FIRST_PROTOCOL_ID
+static constexpr uint8_t V2_FIRST_PROTOCOL_ID = 0x20;
+static const MiLightRemoteConfig* const REMOTES_BY_V2_PROTOCOL_ID[] = {
+  &FUT092Config, // 0x20
+  &FUT091Config, // 0x21
+  nullptr,
+  nullptr,
+  nullptr,
+  &FUT089Config  // 0x25
+};
+
+static_assert(
+  std::size(REMOTES_BY_RADIO_CONFIG) == MiLightRadioConfig::NUM_CONFIGS,
+  "Every radio config should have an entry"
+);
+
 const MiLightRemoteConfig* MiLightRemoteConfig::fromReceivedPacket(
   const MiLightRadioConfig& radioConfig,
   const uint8_t* packet,
-  const size_t len
+  const size_t len,
+  uint8_t* decoded
 ) {
-  for (size_t i = 0; i < NUM_REMOTES; i++) {
-    const MiLightRemoteConfig* config = ALL_REMOTES[i];
-    if (&config->radioConfig == &radioConfig
-      && config->packetFormatter->canHandle(packet, len)) {
-      return config;
+  uint8_t scratch[MILIGHT_MAX_PACKET_LENGTH];
+  const size_t radioIx = &radioConfig - MiLightRadioConfig::ALL_CONFIGS;
+  const MiLightRemoteConfig* config = nullptr;
+
+  if (decoded == nullptr) {
+    decoded = scratch;
+  }
+
+  if (radioIx < MiLightRadioConfig::NUM_CONFIGS && len <= MILIGHT_MAX_PACKET_LENGTH) {
+    memcpy(decoded, packet, len);
+
+    if (radioIx == V2_RADIO_CONFIG_INDEX) {
+      // Decode once here, rather than once for each V2 remote to check its protocol ID
+      if (len == V2_PACKET_LEN) {
+        V2RFEncoding::decodeV2Packet(decoded);
+
+        const size_t protocolIx = static_cast<uint8_t>(decoded[V2_PROTOCOL_ID_INDEX] - V2_FIRST_PROTOCOL_ID);
+        if (protocolIx < std::size(REMOTES_BY_V2_PROTOCOL_ID)) {
+          config = REMOTES_BY_V2_PROTOCOL_ID[protocolIx];
+        }
+      }
+    } else if (REMOTES_BY_RADIO_CONFIG[radioIx]->packetFormatter->canHandle(decoded, len)) {
+      // Other protocols aren't encoded, so the copy is already decoded
+      config = REMOTES_BY_RADIO_CONFIG[radioIx];
     }
   }
 
   // This can happen under normal circumstances, so not an error condition
 #ifdef DEBUG_PRINTF
-  Serial.println(F("MiLightRemoteConfig::fromReceivedPacket: ERROR - tried to fetch remote config for unknown packet"));
+  if (config == nullptr) {
+    Serial.println(F("MiLightRemoteConfig::fromReceivedPacket: ERROR - tried to fetch remote config for unknown packet"));
+  }
 #endif
 
-  return nullptr;
+  return config;
 }
 
 const MiLightRemoteConfig FUT096Config( //rgbw
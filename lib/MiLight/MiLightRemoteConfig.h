@@ -26,7 +26,15 @@ public:
 
   static const MiLightRemoteConfig* fromType(MiLightRemoteType type);
   static const MiLightRemoteConfig* fromType(const String& type);
-  static const MiLightRemoteConfig* fromReceivedPacket(const MiLightRadioConfig& radioConfig, const uint8_t* packet, size_t len);
+  // Finds the remote a packet heard on radioConfig came from, or nullptr if none match.  If
+  // decoded is given, the packet is written to it with its over-the-air encoding undone, for
+  // PacketFormatter::parseDecodedPacket.  It must hold MILIGHT_MAX_PACKET_LENGTH bytes.
+  static const MiLightRemoteConfig* fromReceivedPacket(
+    const MiLightRadioConfig& radioConfig,
+    const uint8_t* packet,
+    size_t len,
+    uint8_t* decoded = nullptr
+  );
 
   static const size_t NUM_REMOTES;
   static const MiLightRemoteConfig* ALL_REMOTES[];
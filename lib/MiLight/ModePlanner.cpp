@@ -0,0 +1,113 @@
+#include <ModePlanner.h>
+#include <MiLightClient.h>
+#include <algorithm>
+
+ModePlanner::ModePlanner(
+  const MiLightRemoteType type,
+  const CommandPlan& plan,
+  const BulbMode currentMode,
+  const bool automaticModeSwitching
+) : type(type)
+  , plan(plan)
+  , currentMode(currentMode)
+  , automaticModeSwitching(automaticModeSwitching)
+  , finalMode(currentMode)
+{
+  fields.reserve(plan.fields.size());
+
+  for (const CommandPlan::FieldOp& op : plan.fields) {
+    fields.push_back(&op);
+
+    if (! GroupStateFieldHelpers::isBrightnessField(op.field) && ! restoresMode(op)) {
+      finalMode = modeFor(op);
+    }
+  }
+
+  std::stable_sort(fields.begin(), fields.end(), [this](const CommandPlan::FieldOp* a, const CommandPlan::FieldOp* b) {
+    return rankOf(*a) < rankOf(*b);
+  });
+}
+
+const std::vector<const CommandPlan::FieldOp*>& ModePlanner::getFields() const {
+  return fields;
+}
+
+BulbMode ModePlanner::getFinalMode() const {
+  return finalMode;
+}
+
+bool ModePlanner::appliesTo(const MiLightRemoteType type) {
+  return type == REMOTE_TYPE_RGB_CCT || type == REMOTE_TYPE_FUT089;
+}
+
+bool ModePlanner::isWhiteSwitch(const CommandPlan& plan, const CommandPlan::FieldOp& op) {
+  return (op.field == GroupStateField::EFFECT && op.value == CommandPlan::EFFECT_WHITE_MODE)
+    || (op.field == GroupStateField::COLOR && MiLightClient::isWhite(plan.color));
+}
+
+BulbMode ModePlanner::modeFor(const CommandPlan::FieldOp& op) const {
+  switch (op.field) {
+    case GroupStateField::HUE:
+    case GroupStateField::SATURATION:
+      return BULB_MODE_COLOR;
+    case GroupStateField::COLOR:
+      return MiLightClient::isWhite(plan.color) ? BULB_MODE_WHITE : BULB_MODE_COLOR;
+    case GroupStateField::KELVIN:
+    case GroupStateField::COLOR_TEMP:
+      return BULB_MODE_WHITE;
+    case GroupStateField::MODE:
+      return BULB_MODE_SCENE;
+    case GroupStateField::EFFECT:
+      if (op.value == CommandPlan::EFFECT_NIGHT_MODE) {
+        return BULB_MODE_NIGHT;
+      } else if (op.value == CommandPlan::EFFECT_WHITE_MODE) {
+        return BULB_MODE_WHITE;
+      }
+      return BULB_MODE_SCENE;
+    default:
+      return currentMode;
+  }
+}
+
+bool ModePlanner::entersMode(const CommandPlan::FieldOp& op) const {
+  switch (op.field) {
+    case GroupStateField::SATURATION:
+      return false;
+    // RGB+CCT bulbs switch to white when they get a temperature.  FUT089 bulbs need to be
+    // switched first.
+    case GroupStateField::KELVIN:
+    case GroupStateField::COLOR_TEMP:
+      return type == REMOTE_TYPE_RGB_CCT;
+    default:
+      return true;
+  }
+}
+
+bool ModePlanner::restoresMode(const CommandPlan::FieldOp& op) const {
+  switch (op.field) {
+    // Never switches by itself without automatic switching, so never sets the mode
+    case GroupStateField::SATURATION:
+      return true;
+    case GroupStateField::KELVIN:
+    case GroupStateField::COLOR_TEMP:
+      return automaticModeSwitching;
+    default:
+      return false;
+  }
+}
+
+uint8_t ModePlanner::rankOf(const CommandPlan::FieldOp& op) const {
+  uint8_t rank;
+
+  if (GroupStateFieldHelpers::isBrightnessField(op.field)) {
+    rank = RANK_BRIGHTNESS;
+  } else if (const BulbMode mode = modeFor(op); mode == finalMode) {
+    rank = RANK_FINAL_MODE;
+  } else if (mode == currentMode) {
+    rank = RANK_START_MODE;
+  } else {
+    rank = RANK_OTHER_MODE + mode;
+  }
+
+  return (rank << 1) | (entersMode(op) ? 0 : 1);
+}
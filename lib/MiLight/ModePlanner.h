@@ -0,0 +1,64 @@
+#pragma once
+
+#include <CommandPlan.h>
+#include <GroupState.h>
+#include <MiLightRemoteType.h>
+#include <vector>
+
+/*
+ * Orders the fields of an update for bulbs where some fields only work in one mode.  RGB+CCT
+ * and FUT089 bulbs only take saturation in color mode, and FUT089 bulbs only take temperature
+ * in white mode.  Their formatters switch to the mode a field needs and, with automatic mode
+ * switching on, switch back afterwards.  Sent in CommandPlan's fixed order, an update with a
+ * color, a temperature and a brightness can bounce the bulb between modes several times.
+ *
+ * Instead, the planner works out the mode the update should leave the bulb in.  Fields for
+ * other modes are sent first, grouped by mode, then the fields for the final mode, then
+ * brightness, which is kept per mode.  Within a mode, fields that switch to it go before the
+ * ones that only work in it.  The formatter is put in a mode plan while they're sent (see
+ * PacketFormatter::beginModePlan), so it only switches when it has to and never switches back.
+ *
+ * The final mode is the one the last mode-setting field asks for.  With automatic mode
+ * switching, saturation and temperature don't set the mode by themselves, so an update with
+ * only those leaves the bulb in the mode it was in.  The client switches back to it before
+ * brightness is sent if one of them had to leave it.
+ */
+class ModePlanner {
+public:
+  ModePlanner(MiLightRemoteType type, const CommandPlan& plan, BulbMode currentMode, bool automaticModeSwitching);
+
+  // Fields in the order to send them
+  const std::vector<const CommandPlan::FieldOp*>& getFields() const;
+  BulbMode getFinalMode() const;
+
+  // Remote types whose fields are planned.  Fields for others are sent in the plan's order.
+  static bool appliesTo(MiLightRemoteType type);
+  // True if the field does nothing but switch to white mode.  It can be skipped once another
+  // field of the update has done that (on RGB+CCT, it'd also undo a temperature sent earlier).
+  static bool isWhiteSwitch(const CommandPlan& plan, const CommandPlan::FieldOp& op);
+
+private:
+  enum Rank : uint8_t {
+    // Earlier fields leave the bulb in a mode that isn't the final one.  Modes are ordered
+    // with the one the bulb starts in first.
+    RANK_START_MODE,
+    RANK_OTHER_MODE,
+    RANK_FINAL_MODE = RANK_OTHER_MODE + BULB_MODE_NIGHT + 1,
+    RANK_BRIGHTNESS
+  };
+
+  const MiLightRemoteType type;
+  const CommandPlan& plan;
+  const BulbMode currentMode;
+  const bool automaticModeSwitching;
+  BulbMode finalMode;
+  std::vector<const CommandPlan::FieldOp*> fields;
+
+  // The mode a field sends the bulb to, or needs it to be in
+  BulbMode modeFor(const CommandPlan::FieldOp& op) const;
+  // Whether a field switches the bulb to its mode, rather than needing it to be there already
+  bool entersMode(const CommandPlan::FieldOp& op) const;
+  // Whether a field leaves the bulb in the mode it was in when automatic switching is on
+  bool restoresMode(const CommandPlan::FieldOp& op) const;
+  uint8_t rankOf(const CommandPlan::FieldOp& op) const;
+};
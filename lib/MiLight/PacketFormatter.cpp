@@ -1,14 +1,26 @@
 #include <PacketFormatter.h>
 
-static auto PACKET_BUFFER = new uint8_t[PACKET_FORMATTER_BUFFER_SIZE];
+bool PacketOutput::repeatLast(size_t) {
+  return false;
+}
 
-PacketStream::PacketStream()
-    : packetStream(PACKET_BUFFER),
+PacketStream::PacketStream(uint8_t* buffer, const size_t capacity)
+    : packetStream(buffer),
+      capacity(capacity),
       numPackets(0),
       packetLength(0),
       currentPacket(0)
 { }
 
+uint8_t* PacketStream::allocate(const size_t packetLength) {
+  if ((numPackets + 1) * packetLength > capacity) {
+    return nullptr;
+  }
+
+  this->packetLength = packetLength;
+  return packetStream + (numPackets++ * packetLength);
+}
+
 bool PacketStream::hasNext() const {
   return currentPacket < numPackets;
 }
@@ -19,6 +31,11 @@ uint8_t* PacketStream::next() {
   return packet;
 }
 
+void PacketStream::clear() {
+  numPackets = 0;
+  currentPacket = 0;
+}
+
 PacketFormatter::PacketFormatter(const MiLightRemoteType deviceType, const size_t packetLength, const size_t maxPackets)
   : deviceType(deviceType),
     packetLength(packetLength),
@@ -27,10 +44,13 @@ PacketFormatter::PacketFormatter(const MiLightRemoteType deviceType, const size_
     held(false),
     deviceId(0),
     groupId(0),
-    sequenceNum(0)
-{
-  packetStream.packetLength = packetLength;
-}
+    sequenceNum(0),
+    stateIndependent(false),
+    planningModes(false),
+    enteredPlannedMode(false),
+    plannedMode(BULB_MODE_WHITE),
+    output(nullptr)
+{ }
 
 void PacketFormatter::initialize(GroupStateStore* stateStore, const Settings* settings) {
   this->stateStore = stateStore;
@@ -48,7 +68,7 @@ void PacketFormatter::updateStatus(const MiLightStatus status) {
 }
 
 void PacketFormatter::toggleStatus() {
-  const GroupState* state = stateStore->get(deviceId, groupId, deviceType);
+  const GroupState* state = getKnownState();
 
   if (state && state->isSetState() && state->getState() == ON) {
     updateStatus(OFF);
@@ -83,13 +103,31 @@ void PacketFormatter::enableNightMode() { }
 void PacketFormatter::updateTemperature(uint8_t value) { }
 void PacketFormatter::updateSaturation(uint8_t value) { }
 
-BulbId PacketFormatter::parsePacket(const uint8_t *packet, JsonObject result) {
+BulbId PacketFormatter::parsePacket(const uint8_t *packet, PacketDelta& result) {
+  result.bulbId = DEFAULT_BULB_ID;
   return DEFAULT_BULB_ID;
 }
 
+BulbId PacketFormatter::parseDecodedPacket(const uint8_t* packet, PacketDelta& result) {
+  // Nothing to undo for packets that aren't encoded
+  return parsePacket(packet, result);
+}
+
+BulbId PacketFormatter::parsePacket(const uint8_t* packet, const JsonObject result) {
+  PacketDelta delta;
+  const BulbId bulbId = parsePacket(packet, delta);
+
+  delta.toJson(result);
+  return bulbId;
+}
+
 void PacketFormatter::pair() {
-  for (size_t i = 0; i < 5; i++) {
-    updateStatus(ON);
+  updateStatus(ON);
+
+  if (! repeatPacket(4)) {
+    for (size_t i = 1; i < 5; i++) {
+      updateStatus(ON);
+    }
   }
 }
 
@@ -97,15 +135,12 @@ void PacketFormatter::unpair() {
   pair();
 }
 
-PacketStream& PacketFormatter::buildPackets() {
+void PacketFormatter::endPackets() {
   if (numPackets > 0) {
     finalizePacket(currentPacket);
   }
 
-  packetStream.numPackets = numPackets;
-  packetStream.currentPacket = 0;
-
-  return packetStream;
+  numPackets = 0;
 }
 
 void PacketFormatter::valueByStepFunction(const StepFunction increase, const StepFunction decrease, const uint8_t numSteps, const uint8_t targetValue, const int8_t knownValue) {
@@ -115,9 +150,7 @@ void PacketFormatter::valueByStepFunction(const StepFunction increase, const Ste
   // If the current value is not known, drive down to the minimum value. Then we can assume that we
   // know the state (it'll be 0).
   if (knownValue == -1) {
-    for (size_t i = 0; i < numSteps; i++) {
-      (this->*decrease)();
-    }
+    repeatStep(decrease, numSteps);
 
     fn = increase;
     numCommands = targetValue;
@@ -132,20 +165,52 @@ void PacketFormatter::valueByStepFunction(const StepFunction increase, const Ste
   }
 
   // Get to the desired value
-  for (size_t i = 0; i < numCommands; i++) {
-    (this->*fn)();
+  repeatStep(fn, numCommands);
+}
+
+bool PacketFormatter::repeatPacket(const size_t count) {
+  return count == 0 || (numPackets > 0 && output != nullptr && output->repeatLast(count));
+}
+
+void PacketFormatter::repeatCommand(const uint8_t command, const uint8_t arg, const size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  this->command(command, arg);
+
+  if (! repeatPacket(count - 1)) {
+    for (size_t i = 1; i < count; i++) {
+      this->command(command, arg);
+    }
   }
 }
 
-void PacketFormatter::prepare(const uint16_t deviceId, const uint8_t groupId) {
+void PacketFormatter::repeatStep(const StepFunction step, const size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  (this->*step)();
+
+  if (! repeatPacket(count - 1)) {
+    for (size_t i = 1; i < count; i++) {
+      (this->*step)();
+    }
+  }
+}
+
+void PacketFormatter::prepare(const uint16_t deviceId, const uint8_t groupId, PacketOutput* output) {
   this->deviceId = deviceId;
   this->groupId = groupId;
+  this->output = output;
+  this->planningModes = false;
   reset();
 }
 
 void PacketFormatter::reset() {
   this->numPackets = 0;
-  this->currentPacket = PACKET_BUFFER;
+  this->currentPacket = overflowPacket;
   this->held = false;
 }
 
@@ -154,13 +219,18 @@ void PacketFormatter::pushPacket() {
     finalizePacket(currentPacket);
   }
 
-  // Make sure there are enough buffers to add another packet.
-  if ((currentPacket + packetLength) >= PACKET_BUFFER + PACKET_FORMATTER_BUFFER_SIZE) {
-    Serial.println(F("ERROR: packet buffer full!  Cannot buffer a new packet.  THIS IS A BUG!"));
+  uint8_t* packet = output != nullptr ? output->allocate(packetLength) : nullptr;
+
+  // A full output drops the packet.  The queue counts these drops, so there's
+  // nothing to log here -- a fade or scene can fill it many times a second.
+  if (packet == nullptr) {
+    currentPacket = overflowPacket;
+    numPackets = 0;
+    initializePacket(currentPacket);
     return;
   }
 
-  currentPacket = PACKET_BUFFER + (numPackets * packetLength);
+  currentPacket = packet;
   numPackets++;
   initializePacket(currentPacket);
 }
@@ -186,6 +256,99 @@ size_t PacketFormatter::getPacketLength() const {
   return packetLength;
 }
 
+size_t PacketFormatter::getStepPacketCount(const BulbId& bulbId, const GroupStateField field) const {
+  const uint8_t numIncrements = getIncrementSteps(field);
+
+  if (numIncrements == 0) {
+    return 1;
+  }
+
+  const GroupState* state = stateStore != nullptr ? stateStore->get(bulbId) : nullptr;
+
+  // A known value moves one increment per step.  Otherwise it's driven down to the minimum
+  // first, then back up, which is as many as numIncrements commands each way.
+  return state != nullptr && state->isSetField(field) ? 1 : 2 * numIncrements;
+}
+
+size_t PacketFormatter::getFieldPacketCount(const GroupStateField field, const uint8_t value) const {
+  const uint8_t numIncrements = getIncrementSteps(field);
+
+  if (numIncrements == 0) {
+    return 1;
+  }
+
+  const GroupState* state = getKnownState();
+  const bool isBrightness = GroupStateFieldHelpers::isBrightnessField(field);
+  const int target = value * numIncrements / 100;
+
+  // Steps are counted the way valueByStepFunction sends them
+  if (state == nullptr || ! (isBrightness ? state->isSetBrightness() : state->isSetKelvin())) {
+    return numIncrements + target;
+  }
+
+  const int known = (isBrightness ? state->getBrightness() : state->getKelvin()) * numIncrements / 100;
+  return abs(target - known);
+}
+
+uint8_t PacketFormatter::getIncrementSteps(GroupStateField) const {
+  return 0;
+}
+
+void PacketFormatter::restampPacket(uint8_t* packet) {
+  // The sequence number is the last byte for formats without a checksum
+  packet[packetLength - 1] = sequenceNum++;
+  finalizePacket(packet);
+}
+
+void PacketFormatter::setStateIndependent(const bool stateIndependent) {
+  this->stateIndependent = stateIndependent;
+}
+
+const GroupState* PacketFormatter::getKnownState() const {
+  if (stateIndependent || stateStore == nullptr) {
+    return nullptr;
+  }
+
+  return stateStore->get(deviceId, groupId, deviceType);
+}
+
+void PacketFormatter::beginModePlan(const BulbMode mode) {
+  planningModes = true;
+  enteredPlannedMode = false;
+  plannedMode = mode;
+}
+
+void PacketFormatter::endModePlan() {
+  planningModes = false;
+}
+
+bool PacketFormatter::isPlanningModes() const {
+  return planningModes;
+}
+
+BulbMode PacketFormatter::getPlannedMode() const {
+  return plannedMode;
+}
+
+bool PacketFormatter::hasEnteredPlannedMode() const {
+  return planningModes && enteredPlannedMode;
+}
+
+BulbMode PacketFormatter::getBulbMode(const GroupState& state) const {
+  return planningModes ? plannedMode : state.getBulbMode();
+}
+
+void PacketFormatter::enterMode(const BulbMode mode) {
+  if (planningModes) {
+    plannedMode = mode;
+    enteredPlannedMode = true;
+  }
+}
+
+bool PacketFormatter::shouldRestoreMode() const {
+  return settings->enableAutomaticModeSwitching && ! planningModes;
+}
+
 BulbId PacketFormatter::currentBulbId() const {
   return BulbId(deviceId, groupId, deviceType);
 }
@@ -7,19 +7,43 @@
 #include <GroupState.h>
 #include <GroupStateStore.h>
 #include <Settings.h>
+#include <MiLightRadioConfig.h>
 
 // Most packets sent are for CCT bulbs, which always includes 10 down commands
 // and can include up to 10 up commands.  CCT packets are 7 bytes.
 //   (10 * 7) + (10 * 7) = 140
+// Enough for a PacketStream to hold any single command.
 #define PACKET_FORMATTER_BUFFER_SIZE 140
 
-struct PacketStream {
-  PacketStream();
+/*
+ * Where a formatter writes the packets it builds.  Formatters don't own any packet storage.
+ * Whoever is building a command provides it, so builds don't share a buffer, and packets can
+ * be built in the place they'll be used (e.g. a slot in the send queue) instead of copied
+ * there afterwards.
+ */
+class PacketOutput {
+public:
+  virtual ~PacketOutput() = default;
+
+  // Storage for one more packet of packetLength bytes, or nullptr if there's no room
+  virtual uint8_t* allocate(size_t packetLength) = 0;
+  // Sends the last packet allocated count more times, each with a fresh sequence number.
+  // Returns false if this output can't, in which case the copies must be built.
+  virtual bool repeatLast(size_t count);
+};
+
+// Packets built into a caller-provided buffer, read back in the order they were built
+struct PacketStream : public PacketOutput {
+  PacketStream(uint8_t* buffer, size_t capacity);
 
+  uint8_t* allocate(size_t packetLength) override;
   uint8_t* next();
   bool hasNext() const;
+  // Drops the packets built so far, so the buffer can be built into again
+  void clear();
 
   uint8_t* packetStream;
+  size_t capacity;
   size_t numPackets;
   size_t packetLength;
   size_t currentPacket;
@@ -78,17 +102,61 @@ public:
 
   virtual void reset();
 
-  virtual PacketStream& buildPackets();
-  virtual void prepare(uint16_t deviceId, uint8_t groupId);
+  // Finishes the last packet built.  Call once a command has been built, before its packets
+  // are read or sent.
+  void endPackets();
+  // Starts building for a bulb.  Packets are written to output until the next call.  Leave
+  // it out if only parsing.
+  virtual void prepare(uint16_t deviceId, uint8_t groupId, PacketOutput* output = nullptr);
   virtual void format(uint8_t const* packet, char* buffer);
 
-  virtual BulbId parsePacket(const uint8_t* packet, JsonObject result);
+  // Decodes the fields a packet changes.  Also sets result.bulbId.
+  virtual BulbId parsePacket(const uint8_t* packet, PacketDelta& result);
+  // Same, for a packet whose over-the-air encoding has already been undone.  Received
+  // packets are decoded once when they're classified, so this saves decoding them again.
+  virtual BulbId parseDecodedPacket(const uint8_t* packet, PacketDelta& result);
+  // Same, rendered as JSON.  Prefer the PacketDelta version where JSON isn't needed.
+  BulbId parsePacket(const uint8_t* packet, JsonObject result);
   virtual BulbId currentBulbId() const;
 
+  // Gives a packet built earlier the next sequence number, and redoes its checksum and
+  // encoding.  Bulbs ignore packets with a sequence number they just saw, so stored packets
+  // must be restamped each time they're sent.
+  virtual void restampPacket(uint8_t* packet);
+
+  // While set, packets are built as if nothing is known about the bulb's state, so they can
+  // be stored and sent later.  E.g. CCT brightness is driven down to the minimum and back up
+  // instead of stepped from its known value.
+  void setStateIndependent(bool stateIndependent);
+
+  // While set, packets are built as if the bulb is in the mode the commands built so far
+  // leave it in, instead of the mode in its known state, and a field that needs another mode
+  // doesn't switch back afterwards.  MiLightClient sets this while it sends fields in the
+  // order a ModePlanner chose.  Cleared by prepare().
+  void beginModePlan(BulbMode mode);
+  void endModePlan();
+  bool isPlanningModes() const;
+  // The mode the commands built since beginModePlan leave the bulb in
+  BulbMode getPlannedMode() const;
+  // True once a command built since beginModePlan has switched the bulb to a mode, even the
+  // one it was already in
+  bool hasEnteredPlannedMode() const;
+
   static void formatV1Packet(uint8_t const* packet, char* buffer);
 
   size_t getPacketLength() const;
 
+  // Number of packets the next update to a single field on the bulb will take.  Used to
+  // estimate how long a transition step will be on the air.
+  size_t getStepPacketCount(const BulbId& bulbId, GroupStateField field) const;
+  // Number of packets setting a field to value (0-100) takes, starting from the prepared
+  // bulb's known state.  Stepped fields take a packet per step; others take one.
+  size_t getFieldPacketCount(GroupStateField field, uint8_t value) const;
+
+  // For fields that can only be changed with up/down commands, the number of commands that
+  // cover the field's range.  0 if the field can be set directly.
+  virtual uint8_t getIncrementSteps(GroupStateField field) const;
+
 protected:
   const MiLightRemoteType deviceType;
   size_t packetLength;
@@ -98,11 +166,33 @@ protected:
   uint16_t deviceId;
   uint8_t groupId;
   uint8_t sequenceNum;
-  PacketStream packetStream;
+  bool stateIndependent;
+  bool planningModes;
+  bool enteredPlannedMode;
+  BulbMode plannedMode;
+  PacketOutput* output;
+  // Written to instead when output has no room, so a command can't write past its storage
+  uint8_t overflowPacket[MILIGHT_MAX_PACKET_LENGTH];
   GroupStateStore* stateStore = nullptr;
   const Settings* settings = nullptr;
 
   void pushPacket();
+  // Has the output send the packet just built count more times.  Returns false if it can't,
+  // in which case the caller must build the copies itself.
+  bool repeatPacket(size_t count);
+  // Builds count copies of a command, storing it once where the output allows
+  void repeatCommand(uint8_t command, uint8_t arg, size_t count);
+  // Same, for a step function.  Step functions build a single packet.
+  void repeatStep(StepFunction step, size_t count);
+
+  // The state of the bulb being built for, or nullptr if it's unknown or being ignored
+  const GroupState* getKnownState() const;
+  // The bulb's mode: the planned one while planning, otherwise the one in its known state
+  BulbMode getBulbMode(const GroupState& state) const;
+  // Call when a command is built that switches the bulb to a mode
+  void enterMode(BulbMode mode);
+  // Whether a field that had to switch modes should switch back to the one the bulb was in
+  bool shouldRestoreMode() const;
 
   // Get a field into a desired state using only increment/decrement commands.  Do this by:
   //   1. Driving it down to its minimum value
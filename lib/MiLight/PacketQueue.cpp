@@ -4,11 +4,36 @@ PacketQueue::PacketQueue()
   : droppedPackets(0)
 { }
 
-void PacketQueue::push(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride) {
+void PacketQueue::push(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride, const uint32_t transactionId, const bool restamp) {
+  if (uint8_t* slot = reserve(remoteConfig, repeatsOverride, transactionId, restamp); slot != nullptr) {
+    memcpy(slot, packet, remoteConfig->packetFormatter->getPacketLength());
+  }
+}
+
+uint8_t* PacketQueue::reserve(const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride, const uint32_t transactionId, const bool restamp) {
   const std::shared_ptr<QueuedPacket> qp = checkoutPacket();
-  memcpy(qp->packet, packet, remoteConfig->packetFormatter->getPacketLength());
+
+  if (qp == nullptr) {
+    return nullptr;
+  }
+
   qp->remoteConfig = remoteConfig;
   qp->repeatsOverride = repeatsOverride;
+  qp->transactionId = transactionId;
+  qp->copies = 1;
+  qp->restamp = restamp;
+  return qp->packet;
+}
+
+bool PacketQueue::repeatLast(const size_t count) {
+  const std::shared_ptr<QueuedPacket> last = queue.getLast();
+
+  if (last == nullptr) {
+    return false;
+  }
+
+  last->copies += count;
+  return true;
 }
 
 bool PacketQueue::isEmpty() const {
@@ -23,11 +48,18 @@ std::shared_ptr<QueuedPacket> PacketQueue::pop() {
   return queue.shift();
 }
 
+std::shared_ptr<QueuedPacket> PacketQueue::peek() const {
+  const auto* head = queue.getHead();
+  return head == nullptr ? nullptr : head->data;
+}
+
 std::shared_ptr<QueuedPacket> PacketQueue::checkoutPacket() {
+  // The last entry may be a packet that's still being built, so it can't be reused
   if (queue.size() == MILIGHT_MAX_QUEUED_PACKETS) {
     ++droppedPackets;
-    return queue.getLast();
+    return nullptr;
   }
+  // Packets are read on every send, so they stay in internal RAM even when there's PSRAM
   auto packet = std::make_shared<QueuedPacket>();
   queue.add(packet);
   return packet;
@@ -39,3 +71,28 @@ void PacketQueue::checkinPacket([[maybe_unused]] std::shared_ptr<QueuedPacket> p
 size_t PacketQueue::size() const {
   return queue.size();
 }
+
+bool PacketQueue::hasTransactionThrough(const uint32_t transactionId) const {
+  for (const auto* node = queue.getHead(); node != nullptr; node = node->next) {
+    if (isTransactionThrough(node->data->transactionId, transactionId)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool PacketQueue::isTransactionThrough(const uint32_t transactionId, const uint32_t lastTransactionId) {
+  // IDs wrap around, so compare the distance between them
+  return transactionId != 0 && static_cast<int32_t>(transactionId - lastTransactionId) <= 0;
+}
+
+size_t PacketQueue::packetCount() const {
+  size_t count = 0;
+
+  for (const auto* node = queue.getHead(); node != nullptr; node = node->next) {
+    count += node->data->copies;
+  }
+
+  return count;
+}
@@ -14,16 +14,39 @@ struct QueuedPacket {
   uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
   const MiLightRemoteConfig* remoteConfig;
   size_t repeatsOverride;
+  // Packets built for the same command share an ID.  0 if the packet stands alone.
+  uint32_t transactionId;
+  // Number of times the packet is sent, each with a fresh sequence number.  Commands that are
+  // repeated (CCT brightness steps, pairing) take one entry instead of one for each copy.
+  size_t copies;
+  // Stored packets (scenes) are given a fresh sequence number and checksum when they're sent
+  bool restamp;
 };
 
 class PacketQueue {
 public:
   PacketQueue();
 
-  void push(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, size_t repeatsOverride);
+  // Packets pushed or reserved while the queue is full are dropped, and counted in
+  // getDroppedPacketCount
+  void push(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, size_t repeatsOverride, uint32_t transactionId = 0, bool restamp = false);
+  // Queues a packet without copying one in, and returns its storage for the caller to
+  // build it in.  Returns nullptr if the queue is full.
+  uint8_t* reserve(const MiLightRemoteConfig* remoteConfig, size_t repeatsOverride, uint32_t transactionId = 0, bool restamp = false);
+  // Sends the last packet queued count more times.  False if the queue is empty.
+  bool repeatLast(size_t count);
   std::shared_ptr<QueuedPacket> pop();
+  // The packet pop() would return, or nullptr if the queue is empty
+  std::shared_ptr<QueuedPacket> peek() const;
   bool isEmpty() const;
   size_t size() const;
+  // Number of packets that will be sent, counting every copy
+  size_t packetCount() const;
+  // True if a packet of the transaction, or of one begun before it, is queued.  Packets that
+  // aren't part of a transaction are ignored.
+  bool hasTransactionThrough(uint32_t transactionId) const;
+  // True if transactionId was begun no later than lastTransactionId
+  static bool isTransactionThrough(uint32_t transactionId, uint32_t lastTransactionId);
   size_t getDroppedPacketCount() const;
 
 private:
@@ -7,9 +7,13 @@ PacketSender::PacketSender(
 ) : radioSwitchboard(radioSwitchboard),
     settings(settings),
     stateStore(nullptr),
+    numEnqueued(0),
     currentPacket(nullptr),
     packetRepeatsRemaining(0),
     packetSentHandler(packetSentHandler),
+    transactionEndHandler(nullptr),
+    lastTransactionId(NO_TRANSACTION),
+    repeatMicros(MILIGHT_PACKET_REPEAT_MICROS),
     lastSend(0),
     currentResendCount(settings.packetRepeats),
     throttleMultiplier(
@@ -19,7 +23,24 @@ PacketSender::PacketSender(
     )
 {}
 
-void PacketSender::enqueue(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride) {
+void PacketSender::enqueue(
+  const uint8_t* packet,
+  const MiLightRemoteConfig* remoteConfig,
+  const size_t repeatsOverride,
+  const uint32_t transactionId,
+  const bool restamp
+) {
+  if (uint8_t* slot = reserve(remoteConfig, repeatsOverride, transactionId, restamp); slot != nullptr) {
+    memcpy(slot, packet, remoteConfig->packetFormatter->getPacketLength());
+  }
+}
+
+uint8_t* PacketSender::reserve(
+  const MiLightRemoteConfig* remoteConfig,
+  const size_t repeatsOverride,
+  const uint32_t transactionId,
+  const bool restamp
+) {
 #ifdef DEBUG_PRINTF
   Serial.println("Enqueuing packet");
 #endif
@@ -27,7 +48,42 @@ void PacketSender::enqueue(const uint8_t* packet, const MiLightRemoteConfig* rem
     ? this->currentResendCount
     : repeatsOverride;
 
-  queue.push(packet, remoteConfig, repeats);
+  numEnqueued++;
+  return queue.reserve(remoteConfig, repeats, transactionId, restamp);
+}
+
+bool PacketSender::repeatLast(const size_t count) {
+  if (! queue.repeatLast(count)) {
+    return false;
+  }
+
+  numEnqueued += count;
+  return true;
+}
+
+uint32_t PacketSender::beginTransaction() {
+  if (++lastTransactionId == NO_TRANSACTION) {
+    ++lastTransactionId;
+  }
+
+  return lastTransactionId;
+}
+
+void PacketSender::onTransactionEnd(const TransactionEndHandler& handler) {
+  this->transactionEndHandler = handler;
+}
+
+uint32_t PacketSender::lastTransaction() const {
+  return lastTransactionId;
+}
+
+bool PacketSender::isTransactionSent(const uint32_t transactionId) const {
+  if (packetRepeatsRemaining > 0
+    && PacketQueue::isTransactionThrough(currentPacket->transactionId, transactionId)) {
+    return false;
+  }
+
+  return ! queue.hasTransactionThrough(transactionId);
 }
 
 void PacketSender::loop() {
@@ -52,6 +108,15 @@ void PacketSender::nextPacket() {
 #endif
   currentPacket = queue.pop();
 
+  // Bulbs ignore a sequence number they've seen recently, which a stored packet may carry
+  if (currentPacket->restamp) {
+    currentPacket->remoteConfig->packetFormatter->restampPacket(currentPacket->packet);
+  }
+
+  beginPacket();
+}
+
+void PacketSender::beginPacket() {
   if (currentPacket->repeatsOverride > 0) {
     packetRepeatsRemaining = currentPacket->repeatsOverride;
   } else {
@@ -70,10 +135,32 @@ void PacketSender::handleCurrentPacket() {
   sendRepeats(numToSend);
   packetRepeatsRemaining -= numToSend;
 
+  if (packetRepeatsRemaining > 0) {
+    return;
+  }
+
   // If we're done sending this packet, fire the transmitted packet callback
-  if (packetRepeatsRemaining == 0 && packetSentHandler != nullptr) {
+  if (packetSentHandler != nullptr) {
     packetSentHandler(currentPacket->packet, *currentPacket->remoteConfig);
   }
+
+  // Send the next copy of a repeated command.  Bulbs ignore a sequence number they just saw,
+  // so each one needs a new one.
+  if (currentPacket->copies > 1) {
+    currentPacket->copies--;
+    currentPacket->remoteConfig->packetFormatter->restampPacket(currentPacket->packet);
+    beginPacket();
+    return;
+  }
+
+  if (transactionEndHandler != nullptr) {
+    const uint32_t transactionId = currentPacket->transactionId;
+    const std::shared_ptr<QueuedPacket> next = queue.peek();
+
+    if (transactionId == NO_TRANSACTION || next == nullptr || next->transactionId != transactionId) {
+      transactionEndHandler();
+    }
+  }
 }
 
 size_t PacketSender::queueLength() const {
@@ -84,7 +171,23 @@ size_t PacketSender::droppedPackets() const {
   return queue.getDroppedPacketCount();
 }
 
-void PacketSender::sendRepeats(size_t num) const {
+size_t PacketSender::enqueuedPackets() const {
+  return numEnqueued;
+}
+
+unsigned long PacketSender::estimateAirtime(const size_t numPackets) const {
+  return (numPackets * currentResendCount * repeatMicros) / 1000;
+}
+
+unsigned long PacketSender::getBacklogMillis() const {
+  const size_t currentCopies = currentPacket != nullptr && packetRepeatsRemaining > 0
+    ? currentPacket->copies - 1
+    : 0;
+
+  return (((queue.packetCount() + currentCopies) * currentResendCount + packetRepeatsRemaining) * repeatMicros) / 1000;
+}
+
+void PacketSender::sendRepeats(const size_t num) {
   size_t len = currentPacket->remoteConfig->packetFormatter->getPacketLength();
 
 #ifdef DEBUG_PRINTF
@@ -96,10 +199,16 @@ void PacketSender::sendRepeats(size_t num) const {
   int iStart = millis();
 #endif
 
+  const unsigned long start = micros();
+
   for (size_t i = 0; i < num; ++i) {
     radioSwitchboard.write(currentPacket->packet, len);
   }
 
+  if (num > 0) {
+    repeatMicros = (7 * repeatMicros + (micros() - start) / num) / 8;
+  }
+
 #ifdef DEBUG_PRINTF
   int iElapsed = millis() - iStart;
   Serial.print("Elapsed: ");
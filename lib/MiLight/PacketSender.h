@@ -5,10 +5,19 @@
 #include <PacketQueue.h>
 #include <RadioSwitchboard.h>
 
+// Starting estimate for how long one repeat of a packet takes to send.  Replaced with a
+// measured average once packets have been sent.
+#ifndef MILIGHT_PACKET_REPEAT_MICROS
+#define MILIGHT_PACKET_REPEAT_MICROS 1000
+#endif
+
 class PacketSender {
 public:
   typedef std::function<void(uint8_t* packet, const MiLightRemoteConfig& config)> PacketSentHandler;
+  typedef std::function<void()> TransactionEndHandler;
   static constexpr size_t DEFAULT_PACKET_SENDS_VALUE = 0;
+  // Transaction ID for packets that stand alone
+  static constexpr uint32_t NO_TRANSACTION = 0;
 
   PacketSender(
     RadioSwitchboard& radioSwitchboard,
@@ -16,21 +25,64 @@ public:
     const PacketSentHandler &packetSentHandler
   );
 
-  void enqueue(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, size_t repeatsOverride = 0);
+  // Pass restamp for stored packets, so they get a fresh sequence number and checksum when
+  // they're sent rather than the ones they were recorded with
+  void enqueue(
+    const uint8_t* packet,
+    const MiLightRemoteConfig* remoteConfig,
+    size_t repeatsOverride = 0,
+    uint32_t transactionId = NO_TRANSACTION,
+    bool restamp = false
+  );
+  // Queues a packet and returns its storage, so that it can be built in place instead of
+  // copied in.  It must be complete before loop() is next called.  Returns nullptr if the
+  // queue is full, in which case the packet is dropped.
+  uint8_t* reserve(
+    const MiLightRemoteConfig* remoteConfig,
+    size_t repeatsOverride = 0,
+    uint32_t transactionId = NO_TRANSACTION,
+    bool restamp = false
+  );
+  // Sends the last packet queued count more times, as one queue entry.  Each copy gets a
+  // fresh sequence number when it's sent.  Returns false if nothing is queued.
+  bool repeatLast(size_t count);
   void loop();
 
+  // Returns a new ID to tag the packets of one command with.  The transaction end handler
+  // is called once after the last of them is sent, so that work which only depends on the
+  // final result (publishing state, for example) is done once per command instead of once
+  // per packet.
+  uint32_t beginTransaction();
+  // Called after the last packet of a transaction is sent, right after the packet sent
+  // handler.  Packets that aren't part of a transaction are each a transaction of their own.
+  void onTransactionEnd(const TransactionEndHandler& handler);
+  // The ID returned by the last call to beginTransaction
+  uint32_t lastTransaction() const;
+  // True once every packet of the transaction, and of the ones begun before it, has been
+  // sent.
+  bool isTransactionSent(uint32_t transactionId) const;
+
   // Return true if there are queued packets
   bool isSending() const;
 
   // Return the number of queued packets
   size_t queueLength() const;
   size_t droppedPackets() const;
+  // Number of packets enqueued since boot, including dropped ones
+  size_t enqueuedPackets() const;
+
+  // Estimated time in milliseconds to send the provided number of packets, with repeats
+  unsigned long estimateAirtime(size_t numPackets) const;
+
+  // Estimated time in milliseconds until everything currently queued has been sent
+  unsigned long getBacklogMillis() const;
 
 private:
   RadioSwitchboard& radioSwitchboard;
   Settings& settings;
   GroupStateStore* stateStore;
   PacketQueue queue;
+  size_t numEnqueued;
 
   // The current packet we're sending and the number of repeats left
   std::shared_ptr<QueuedPacket> currentPacket;
@@ -39,15 +91,22 @@ private:
   // Handler called after packets are sent.  Will not be called multiple times
   // per repeat.
   PacketSentHandler packetSentHandler;
+  TransactionEndHandler transactionEndHandler;
+  uint32_t lastTransactionId;
 
   // Send a batch of repeats for the current packet
   void handleCurrentPacket();
 
   // Switch to the next packet in the queue
   void nextPacket();
+  // Start sending the current packet, or the next copy of it
+  void beginPacket();
 
   // Send repeats of the current packet N times
-  void sendRepeats(size_t num) const;
+  void sendRepeats(size_t num);
+
+  // Moving average of how long a single repeat takes to send
+  unsigned long repeatMicros;
 
   // Used to track auto-repeat limiting
   unsigned long lastSend;
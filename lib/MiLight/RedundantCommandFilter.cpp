@@ -0,0 +1,156 @@
+#include <RedundantCommandFilter.h>
+#include <MiLightClient.h>
+#include <Units.h>
+
+RedundantCommandFilter::RedundantCommandFilter(const Settings& settings)
+  : settings(settings)
+  , numEntries(0)
+  , stats({0, 0, 0})
+{ }
+
+bool RedundantCommandFilter::isEnabled() const {
+  return settings.suppressRedundantCommands;
+}
+
+RedundantCommandFilter::Entry& RedundantCommandFilter::getEntry(const BulbId& bulbId) {
+  const unsigned long now = millis();
+  Entry* oldest = nullptr;
+
+  for (size_t i = 0; i < numEntries; ++i) {
+    if (entries[i].bulbId == bulbId) {
+      return entries[i];
+    }
+
+    if (oldest == nullptr || (now - entries[i].lastRefresh) > (now - oldest->lastRefresh)) {
+      oldest = &entries[i];
+    }
+  }
+
+  // Not tracked yet.  Take a free slot, or the one refreshed longest ago.  Forgetting a bulb
+  // is always safe: its commands are sent until it's refreshed again.
+  Entry* entry = numEntries < MILIGHT_REDUNDANT_FILTER_SIZE ? &entries[numEntries++] : oldest;
+  entry->bulbId = bulbId;
+  entry->lastRefresh = now;
+  entry->refreshed = false;
+  entry->pending = 0;
+
+  return *entry;
+}
+
+void RedundantCommandFilter::queued(const BulbId& bulbId) {
+  Entry& entry = getEntry(bulbId);
+
+  if (entry.pending < UINT8_MAX) {
+    entry.pending++;
+  }
+}
+
+void RedundantCommandFilter::touch(const BulbId& bulbId) {
+  Entry& entry = getEntry(bulbId);
+
+  entry.lastRefresh = millis();
+  entry.refreshed = true;
+
+  if (entry.pending > 0) {
+    entry.pending--;
+  }
+}
+
+void RedundantCommandFilter::invalidate(const BulbId& bulbId) {
+  for (size_t i = 0; i < numEntries; ++i) {
+    if (entries[i].bulbId == bulbId) {
+      entries[i].refreshed = false;
+      return;
+    }
+  }
+}
+
+void RedundantCommandFilter::clearPending() {
+  for (size_t i = 0; i < numEntries; ++i) {
+    entries[i].pending = 0;
+  }
+}
+
+const RedundantCommandFilter::Entry* RedundantCommandFilter::findEntry(const BulbId& bulbId) const {
+  for (size_t i = 0; i < numEntries; ++i) {
+    if (entries[i].bulbId == bulbId) {
+      return &entries[i];
+    }
+  }
+
+  return nullptr;
+}
+
+bool RedundantCommandFilter::suppress(const BulbId& bulbId, const size_t numPackets) {
+  const Entry* entry = findEntry(bulbId);
+
+  // Nothing sent yet, a remote was heard since, or the state doesn't reflect what's queued
+  if (entry == nullptr || ! entry->refreshed || entry->pending > 0) {
+    return false;
+  }
+
+  if ((millis() - entry->lastRefresh) >= settings.redundantCommandWindow) {
+    stats.stale++;
+    return false;
+  }
+
+  stats.suppressed++;
+  stats.packetsAvoided += numPackets;
+  return true;
+}
+
+const RedundantCommandStats& RedundantCommandFilter::getStats() const {
+  return stats;
+}
+
+bool RedundantCommandFilter::isInMode(const GroupState& state, const BulbMode mode) {
+  return state.isSetBulbMode() && state.getBulbMode() == mode;
+}
+
+bool RedundantCommandFilter::isStatusSatisfied(const GroupState& state, const MiLightStatus status) {
+  return state.isSetState() && state.getState() == status;
+}
+
+bool RedundantCommandFilter::isFieldSatisfied(const GroupState& state, const CommandPlan& plan, const CommandPlan::FieldOp& op) {
+  // Hue is stored with 8 bits, so compare it the way it will be stored
+  const auto storedHue = [](const uint16_t hue) {
+    return Units::rescale<uint16_t, uint16_t>(Units::rescale<uint16_t, uint16_t>(hue, 255, 360), 360, 255);
+  };
+
+  switch (op.field) {
+    case GroupStateField::LEVEL:
+    case GroupStateField::BRIGHTNESS:
+      // Brightness was rescaled to a level when the plan was built
+      return state.isSetBrightness() && state.getBrightness() == op.value;
+    case GroupStateField::HUE:
+      return isInMode(state, BULB_MODE_COLOR) && state.isSetHue() && state.getHue() == storedHue(op.value);
+    case GroupStateField::SATURATION:
+      return isInMode(state, BULB_MODE_COLOR) && state.isSetSaturation() && state.getSaturation() == op.value;
+    case GroupStateField::KELVIN:
+      return isInMode(state, BULB_MODE_WHITE) && state.isSetKelvin() && state.getKelvin() == op.value;
+    case GroupStateField::COLOR_TEMP:
+      return isInMode(state, BULB_MODE_WHITE)
+        && state.isSetKelvin()
+        && state.getKelvin() == Units::miredsToWhiteVal(op.value, 100);
+    case GroupStateField::MODE:
+      return isInMode(state, BULB_MODE_SCENE) && state.isSetMode() && state.getMode() == op.value;
+    case GroupStateField::COLOR:
+      if (MiLightClient::isWhite(plan.color)) {
+        return isInMode(state, BULB_MODE_WHITE);
+      }
+
+      return isInMode(state, BULB_MODE_COLOR)
+        && state.isSetHue() && state.getHue() == storedHue(plan.color.hue)
+        && state.isSetSaturation() && state.getSaturation() == plan.color.saturation;
+    case GroupStateField::EFFECT:
+      if (op.value == CommandPlan::EFFECT_NIGHT_MODE) {
+        return isInMode(state, BULB_MODE_NIGHT);
+      } else if (op.value == CommandPlan::EFFECT_WHITE_MODE) {
+        return isInMode(state, BULB_MODE_WHITE);
+      }
+
+      return isInMode(state, BULB_MODE_SCENE) && state.isSetMode() && state.getMode() == op.value;
+    default:
+      return false;
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <BulbId.h>
+#include <GroupState.h>
+#include <CommandPlan.h>
+#include <Settings.h>
+
+// Number of bulbs whose last refresh time is tracked.  Bulbs that aren't tracked are never
+// considered fresh, so their commands are always sent.
+#ifndef MILIGHT_REDUNDANT_FILTER_SIZE
+#define MILIGHT_REDUNDANT_FILTER_SIZE 16
+#endif
+
+struct RedundantCommandStats {
+  // Fields skipped because the bulb was already in the requested state
+  size_t suppressed;
+  // Radio packets those would have taken, counting repeats
+  size_t packetsAvoided;
+  // Fields that matched the known state, but were sent anyway because it was too old
+  size_t stale;
+};
+
+/*
+ * Skips commands for fields a bulb is already known to be in, so that clients which resend
+ * their whole state (Home Assistant, Node-RED) don't fill the air with packets that change
+ * nothing.  Off unless enabled in settings.
+ *
+ * State is only trusted for a window after a packet for the bulb was last sent.  After that,
+ * everything is sent again, in case the bulb was changed by something the hub didn't hear.
+ * It's also not trusted while packets for the bulb are still queued, since state is only
+ * updated once they're sent, or after a packet from a remote was heard, since the bulb may
+ * not have heard the same packets the hub did.
+ */
+class RedundantCommandFilter {
+public:
+  explicit RedundantCommandFilter(const Settings& settings);
+
+  bool isEnabled() const;
+
+  // Records that a packet for bulbId was queued to be sent
+  void queued(const BulbId& bulbId);
+  // Records that a packet queued for bulbId was just sent
+  void touch(const BulbId& bulbId);
+  // Records that a packet for bulbId was heard from a remote.  Its state isn't trusted until
+  // the hub sends it another packet.
+  void invalidate(const BulbId& bulbId);
+  // Call when nothing is queued, so nothing is pending for any bulb
+  void clearPending();
+
+  // Call for a field that's already satisfied.  Returns true if it should be skipped, and
+  // counts it as numPackets packets avoided.
+  bool suppress(const BulbId& bulbId, size_t numPackets);
+
+  const RedundantCommandStats& getStats() const;
+
+  static bool isStatusSatisfied(const GroupState& state, MiLightStatus status);
+  static bool isFieldSatisfied(const GroupState& state, const CommandPlan& plan, const CommandPlan::FieldOp& op);
+
+private:
+  struct Entry {
+    BulbId bulbId;
+    unsigned long lastRefresh;
+    // False until a packet for the bulb has been sent, and again once one is heard
+    bool refreshed;
+    // Packets queued but not sent yet
+    uint8_t pending;
+  };
+
+  const Settings& settings;
+  Entry entries[MILIGHT_REDUNDANT_FILTER_SIZE];
+  size_t numEntries;
+  RedundantCommandStats stats;
+
+  const Entry* findEntry(const BulbId& bulbId) const;
+  // Finds the entry for bulbId, replacing the one refreshed longest ago if it isn't tracked
+  Entry& getEntry(const BulbId& bulbId);
+  static bool isInMode(const GroupState& state, BulbMode mode);
+};
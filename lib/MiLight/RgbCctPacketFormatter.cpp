@@ -14,6 +14,7 @@ void RgbCctPacketFormatter::modeSpeedUp() {
 void RgbCctPacketFormatter::updateMode(const uint8_t mode) {
   lastMode = mode;
   command(RGB_CCT_MODE, mode);
+  enterMode(BULB_MODE_SCENE);
 }
 
 void RgbCctPacketFormatter::nextMode() {
@@ -36,6 +37,7 @@ void RgbCctPacketFormatter::updateHue(const uint16_t value) {
 
 void RgbCctPacketFormatter::updateColorRaw(const uint8_t value) {
   command(RGB_CCT_COLOR, RGB_CCT_COLOR_OFFSET + value);
+  enterMode(BULB_MODE_COLOR);
 }
 
 void RgbCctPacketFormatter::updateTemperature(const uint8_t value) {
@@ -47,19 +49,16 @@ void RgbCctPacketFormatter::updateTemperature(const uint8_t value) {
   // in white mode, that makes changing temperature annoying because the current hue/mode
   // is lost. Such a lookup our current bulb mode, and if needed, reset the hue/mode after
   // changing the temperature
-  const GroupState* ourState = this->stateStore->get(this->deviceId, this->groupId, REMOTE_TYPE_RGB_CCT);
+  const GroupState* ourState = getKnownState();
+  const BulbMode originalBulbMode = ourState == nullptr ? BULB_MODE_WHITE : getBulbMode(*ourState);
 
   // now make the temperature change
   command(RGB_CCT_KELVIN, cmdValue);
+  enterMode(BULB_MODE_WHITE);
 
   // and return to our original mode
-  if (ourState != nullptr) {
-    if (
-      const BulbMode originalBulbMode = ourState->getBulbMode(); settings->enableAutomaticModeSwitching &&
-      originalBulbMode != BULB_MODE_WHITE
-    ) {
-      switchMode(*ourState, originalBulbMode);
-    }
+  if (ourState != nullptr && shouldRestoreMode() && originalBulbMode != BULB_MODE_WHITE) {
+    switchMode(*ourState, originalBulbMode);
   }
 }
 
@@ -67,13 +66,13 @@ void RgbCctPacketFormatter::updateTemperature(const uint8_t value) {
 // make the change, and switch back again.
 void RgbCctPacketFormatter::updateSaturation(const uint8_t value) {
    // look up our current mode
-  const GroupState* ourState = this->stateStore->get(this->deviceId, this->groupId, REMOTE_TYPE_RGB_CCT);
+  const GroupState* ourState = getKnownState();
   BulbMode originalBulbMode = BULB_MODE_WHITE;
 
   if (ourState != nullptr) {
-    originalBulbMode = ourState->getBulbMode();
+    originalBulbMode = getBulbMode(*ourState);
 
-    // are we already in white?  If not, change to white
+    // are we already in color?  If not, change to color
     if ((settings->enableAutomaticModeSwitching) && (originalBulbMode != BULB_MODE_COLOR)) {
       updateHue(ourState->getHue());
     }
@@ -84,7 +83,7 @@ void RgbCctPacketFormatter::updateSaturation(const uint8_t value) {
   command(RGB_CCT_SATURATION, remapped);
 
   if (ourState != nullptr) {
-    if ((settings->enableAutomaticModeSwitching) && (originalBulbMode != BULB_MODE_COLOR)) {
+    if (shouldRestoreMode() && (originalBulbMode != BULB_MODE_COLOR)) {
       switchMode(*ourState, originalBulbMode);
     }
   }
@@ -93,7 +92,7 @@ void RgbCctPacketFormatter::updateSaturation(const uint8_t value) {
 void RgbCctPacketFormatter::updateColorWhite() {
   // there is no direct white command, so let's look up our prior temperature and set that, which
   // causes the bulb to go white
-  const GroupState* ourState = this->stateStore->get(this->deviceId, this->groupId, REMOTE_TYPE_RGB_CCT);
+  const GroupState* ourState = getKnownState();
   const uint8_t value =
     ourState == nullptr
       ? 0
@@ -101,60 +100,59 @@ void RgbCctPacketFormatter::updateColorWhite() {
 
   // issue command to set kelvin to prior value, which will drive to white
   command(RGB_CCT_KELVIN, value);
+  enterMode(BULB_MODE_WHITE);
 }
 
 void RgbCctPacketFormatter::enableNightMode() {
   const uint8_t arg = groupCommandArg(OFF, groupId);
   command(RGB_CCT_ON | 0x80, arg);
+  enterMode(BULB_MODE_NIGHT);
 }
 
-BulbId RgbCctPacketFormatter::parsePacket(const uint8_t *packet, const JsonObject result) {
-  uint8_t packetCopy[V2_PACKET_LEN];
-  memcpy(packetCopy, packet, V2_PACKET_LEN);
-  V2RFEncoding::decodeV2Packet(packetCopy);
-
+BulbId RgbCctPacketFormatter::parseDecodedPacket(const uint8_t* packet, PacketDelta& result) {
   BulbId bulbId(
-    (packetCopy[2] << 8) | packetCopy[3],
-    packetCopy[7],
+    (packet[2] << 8) | packet[3],
+    packet[7],
     REMOTE_TYPE_RGB_CCT
   );
 
-  const uint8_t command = (packetCopy[V2_COMMAND_INDEX] & 0x7F);
-  const uint8_t arg = packetCopy[V2_ARGUMENT_INDEX];
+  const uint8_t command = (packet[V2_COMMAND_INDEX] & 0x7F);
+  const uint8_t arg = packet[V2_ARGUMENT_INDEX];
 
   if (command == RGB_CCT_ON) {
-    if ((packetCopy[V2_COMMAND_INDEX] & 0x80) == 0x80) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::NIGHT_MODE;
+    if ((packet[V2_COMMAND_INDEX] & 0x80) == 0x80) {
+      result.setCommand(PacketCommand::NIGHT_MODE);
     } else if (arg == RGB_CCT_MODE_SPEED_DOWN) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_DOWN;
+      result.setCommand(PacketCommand::MODE_SPEED_DOWN);
     } else if (arg == RGB_CCT_MODE_SPEED_UP) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_UP;
+      result.setCommand(PacketCommand::MODE_SPEED_UP);
     } else if (arg < 5) { // Group is not reliably encoded in group byte. Extract from arg byte
-      result[GroupStateFieldNames::STATE] = "ON";
+      result.setState(ON);
       bulbId.groupId = arg;
     } else {
-      result[GroupStateFieldNames::STATE] = "OFF";
+      result.setState(OFF);
       bulbId.groupId = arg-5;
     }
   } else if (command == RGB_CCT_COLOR) {
     const uint8_t rescaledColor = (arg - RGB_CCT_COLOR_OFFSET) % 0x100;
-    const uint16_t hue = Units::rescale<uint16_t, uint16_t>(rescaledColor, 360, 255.0);
-    result[GroupStateFieldNames::HUE] = hue;
+    const uint16_t hue = Units::rescale<uint16_t, uint16_t>(rescaledColor, 360, 255);
+    result.setHue(hue);
   } else if (command == RGB_CCT_KELVIN) {
     const uint8_t temperature = fromV2Scale(arg, RGB_CCT_KELVIN_REMOTE_END, 2);
-    result[GroupStateFieldNames::COLOR_TEMP] = Units::whiteValToMireds(temperature, 100);
+    result.setColorTemp(Units::whiteValToMireds(temperature, 100));
   // brightness == saturation
   } else if (command == RGB_CCT_BRIGHTNESS && arg >= (RGB_CCT_BRIGHTNESS_OFFSET - 15)) {
     const uint8_t level = constrain(arg - RGB_CCT_BRIGHTNESS_OFFSET, 0, 100);
-    result[GroupStateFieldNames::BRIGHTNESS] = Units::rescale<uint8_t, uint8_t>(level, 255, 100);
+    result.setBrightness(Units::rescale<uint8_t, uint8_t>(level, 255, 100));
   } else if (command == RGB_CCT_SATURATION) {
-    result[GroupStateFieldNames::SATURATION] = constrain(arg - RGB_CCT_SATURATION_OFFSET, 0, 100);
+    result.setSaturation(constrain(arg - RGB_CCT_SATURATION_OFFSET, 0, 100));
   } else if (command == RGB_CCT_MODE) {
-    result[GroupStateFieldNames::MODE] = arg;
+    result.setMode(arg);
   } else {
-    result["button_id"] = command;
-    result["argument"] = arg;
+    result.setButtonId(command);
+    result.setArgument(arg);
   }
 
+  result.bulbId = bulbId;
   return bulbId;
 }
@@ -49,7 +49,7 @@ public:
   void nextMode() override;
   void previousMode() override;
 
-  BulbId parsePacket(const uint8_t* packet, JsonObject result) override;
+  BulbId parseDecodedPacket(const uint8_t* packet, PacketDelta& result) override;
 
 protected:
 
@@ -14,15 +14,11 @@ void RgbPacketFormatter::initializePacket(uint8_t *packet) {
 }
 
 void RgbPacketFormatter::pair() {
-  for (size_t i = 0; i < 5; i++) {
-    command(RGB_SPEED_UP, 0);
-  }
+  repeatCommand(RGB_SPEED_UP, 0, 5);
 }
 
 void RgbPacketFormatter::unpair() {
-  for (size_t i = 0; i < 5; i++) {
-    command(RGB_SPEED_UP | 0x10, 0);
-  }
+  repeatCommand(RGB_SPEED_UP | 0x10, 0, 5);
 }
 
 void RgbPacketFormatter::updateStatus(const MiLightStatus status, uint8_t groupId) {
@@ -48,7 +44,7 @@ void RgbPacketFormatter::updateColorRaw(const uint8_t value) {
 }
 
 void RgbPacketFormatter::updateBrightness(const uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, REMOTE_TYPE_RGB);
+  const GroupState* state = getKnownState();
   const int8_t knownValue = (state != nullptr && state->isSetBrightness()) ? state->getBrightness() / RGB_INTERVALS : -1;
 
   valueByStepFunction(
@@ -60,6 +56,10 @@ void RgbPacketFormatter::updateBrightness(const uint8_t value) {
   );
 }
 
+uint8_t RgbPacketFormatter::getIncrementSteps(const GroupStateField field) const {
+  return GroupStateFieldHelpers::isBrightnessField(field) ? RGB_INTERVALS : 0;
+}
+
 void RgbPacketFormatter::increaseBrightness() {
   command(RGB_BRIGHTNESS_UP, 0);
 }
@@ -84,7 +84,7 @@ void RgbPacketFormatter::previousMode() {
   command(RGB_MODE_DOWN, 0);
 }
 
-BulbId RgbPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject result) {
+BulbId RgbPacketFormatter::parsePacket(const uint8_t* packet, PacketDelta& result) {
   const uint8_t command = packet[RGB_COMMAND_INDEX] & 0x7F;
 
   BulbId bulbId(
@@ -94,29 +94,30 @@ BulbId RgbPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject r
   );
 
   if (command == RGB_ON) {
-    result[GroupStateFieldNames::STATE] = "ON";
+    result.setState(ON);
   } else if (command == RGB_OFF) {
-    result[GroupStateFieldNames::STATE] = "OFF";
+    result.setState(OFF);
   } else if (command == 0) {
-    uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[RGB_COLOR_INDEX], 360.0, 255.0);
+    uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[RGB_COLOR_INDEX], 360, 255);
     remappedColor = (remappedColor + 320) % 360;
-    result[GroupStateFieldNames::HUE] = remappedColor;
+    result.setHue(remappedColor);
   } else if (command == RGB_MODE_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::PREVIOUS_MODE;
+    result.setCommand(PacketCommand::PREVIOUS_MODE);
   } else if (command == RGB_MODE_UP) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::NEXT_MODE;
+    result.setCommand(PacketCommand::NEXT_MODE);
   } else if (command == RGB_SPEED_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_DOWN;
+    result.setCommand(PacketCommand::MODE_SPEED_DOWN);
   } else if (command == RGB_SPEED_UP) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_UP;
+    result.setCommand(PacketCommand::MODE_SPEED_UP);
   } else if (command == RGB_BRIGHTNESS_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_down";
+    result.setCommand(PacketCommand::BRIGHTNESS_DOWN);
   } else if (command == RGB_BRIGHTNESS_UP) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_up";
+    result.setCommand(PacketCommand::BRIGHTNESS_UP);
   } else {
-    result["button_id"] = command;
+    result.setButtonId(command);
   }
 
+  result.bulbId = bulbId;
   return bulbId;
 }
 
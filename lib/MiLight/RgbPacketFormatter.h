@@ -26,6 +26,7 @@ public:
 
   void updateStatus(MiLightStatus status, uint8_t groupId) override;
   void updateBrightness(uint8_t value) override;
+  uint8_t getIncrementSteps(GroupStateField field) const override;
   void increaseBrightness() override;
   void decreaseBrightness() override;
   void command(uint8_t command, uint8_t arg) override;
@@ -38,7 +39,7 @@ public:
   void modeSpeedUp() override;
   void nextMode() override;
   void previousMode() override;
-  BulbId parsePacket(const uint8_t* packet, JsonObject result) override;
+  BulbId parsePacket(const uint8_t* packet, PacketDelta& result) override;
 
   void initializePacket(uint8_t* packet) override;
 };
@@ -44,7 +44,7 @@ void RgbwPacketFormatter::previousMode() {
 }
 
 uint8_t RgbwPacketFormatter::currentMode() const {
-  const GroupState* state = stateStore->get(deviceId, groupId, REMOTE_TYPE_RGBW);
+  const GroupState* state = getKnownState();
   return state != nullptr ? state->getMode() : 0;
 }
 
@@ -100,7 +100,7 @@ void RgbwPacketFormatter::enableNightMode() {
   // Bulbs must be OFF for night mode to work in RGBW.
   // Turn it off if it isn't already off.
   if (
-    const GroupState* state = stateStore->get(deviceId, groupId, REMOTE_TYPE_RGBW); state == nullptr ||
+    const GroupState* state = getKnownState(); state == nullptr ||
     state->getState() == ON
   ) {
     command(button, 0);
@@ -110,7 +110,7 @@ void RgbwPacketFormatter::enableNightMode() {
   command(button | 0x10, 0);
 }
 
-BulbId RgbwPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject result) {
+BulbId RgbwPacketFormatter::parsePacket(const uint8_t* packet, PacketDelta& result) {
   const uint8_t command = packet[RGBW_COMMAND_INDEX] & 0x7F;
 
   BulbId bulbId(
@@ -120,7 +120,7 @@ BulbId RgbwPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject
   );
 
   if (command >= RGBW_ALL_ON && command <= RGBW_GROUP_4_OFF) {
-    result[GroupStateFieldNames::STATE] = (STATUS_FOR_COMMAND(command) == ON) ? "ON" : "OFF";
+    result.setState(STATUS_FOR_COMMAND(command));
 
     // Determine group ID from button ID for on/off. The remote's state is from
     // the last packet sent, not the current one, and that can be wrong for
@@ -128,9 +128,9 @@ BulbId RgbwPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject
     bulbId.groupId = GROUP_FOR_STATUS_COMMAND(command);
   } else if (command & 0x10) {
     if ((command % 2) == 0) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::NIGHT_MODE;
+      result.setCommand(PacketCommand::NIGHT_MODE);
     } else {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::SET_WHITE;
+      result.setCommand(PacketCommand::SET_WHITE);
     }
     bulbId.groupId = GROUP_FOR_STATUS_COMMAND(command & 0xF);
   } else if (command == RGBW_BRIGHTNESS) {
@@ -138,21 +138,22 @@ BulbId RgbwPacketFormatter::parsePacket(const uint8_t* packet, const JsonObject
     brightness -= packet[RGBW_BRIGHTNESS_GROUP_INDEX] >> 3;
     brightness += 17;
     brightness %= 32;
-    result[GroupStateFieldNames::BRIGHTNESS] = Units::rescale<uint8_t, uint8_t>(brightness, 255, 25);
+    result.setBrightness(Units::rescale<uint8_t, uint8_t>(brightness, 255, 25));
   } else if (command == RGBW_COLOR) {
-    uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[RGBW_COLOR_INDEX], 360.0, 255.0);
+    uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[RGBW_COLOR_INDEX], 360, 255);
     remappedColor = (remappedColor + 320) % 360;
-    result[GroupStateFieldNames::HUE] = remappedColor;
+    result.setHue(remappedColor);
   } else if (command == RGBW_SPEED_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_DOWN;
+    result.setCommand(PacketCommand::MODE_SPEED_DOWN);
   } else if (command == RGBW_SPEED_UP) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_UP;
+    result.setCommand(PacketCommand::MODE_SPEED_UP);
   } else if (command == RGBW_DISCO_MODE) {
-    result[GroupStateFieldNames::MODE] = packet[0] & ~RGBW_PROTOCOL_ID_BYTE;
+    result.setMode(packet[0] & ~RGBW_PROTOCOL_ID_BYTE);
   } else {
-    result["button_id"] = command;
+    result.setButtonId(command);
   }
 
+  result.bulbId = bulbId;
   return bulbId;
 }
 
@@ -69,7 +69,7 @@ public:
   void previousMode() override;
   void updateMode(uint8_t mode) override;
   void enableNightMode() override;
-  BulbId parsePacket(const uint8_t* packet, JsonObject result) override;
+  BulbId parsePacket(const uint8_t* packet, PacketDelta& result) override;
 
   void initializePacket(uint8_t* packet) override;
 
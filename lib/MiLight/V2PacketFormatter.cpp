@@ -21,6 +21,18 @@ bool V2PacketFormatter::canHandle(const uint8_t *packet, const size_t packetLen)
   return packetCopy[V2_PROTOCOL_ID_INDEX] == protocolId;
 }
 
+BulbId V2PacketFormatter::parsePacket(const uint8_t* packet, PacketDelta& result) {
+  uint8_t packetCopy[V2_PACKET_LEN];
+  memcpy(packetCopy, packet, V2_PACKET_LEN);
+  V2RFEncoding::decodeV2Packet(packetCopy);
+
+  return parseDecodedPacket(packetCopy, result);
+}
+
+uint8_t V2PacketFormatter::getProtocolId() const {
+  return protocolId;
+}
+
 void V2PacketFormatter::initializePacket(uint8_t* packet) {
   size_t packetPtr = 0;
 
@@ -51,15 +63,20 @@ void V2PacketFormatter::updateStatus(const MiLightStatus status, const uint8_t g
 }
 
 void V2PacketFormatter::unpair() {
-  for (size_t i = 0; i < 5; i++) {
-    updateStatus(ON, 0);
-  }
+  repeatCommand(0x01, groupCommandArg(ON, 0), 5);
 }
 
 void V2PacketFormatter::finalizePacket(uint8_t* packet) {
   V2RFEncoding::encodeV2Packet(packet);
 }
 
+void V2PacketFormatter::restampPacket(uint8_t* packet) {
+  // The sequence number is scrambled with the rest of the packet, so decode it first
+  V2RFEncoding::decodeV2Packet(packet);
+  packet[V2_SEQUENCE_INDEX] = sequenceNum++;
+  finalizePacket(packet);
+}
+
 void V2PacketFormatter::format(uint8_t const* packet, char* buffer) {
   buffer += sprintf_P(buffer, PSTR("Raw packet: "));
   for (size_t i = 0; i < packetLength; i++) {
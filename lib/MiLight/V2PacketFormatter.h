@@ -7,6 +7,7 @@
 #define V2_PROTOCOL_ID_INDEX 1
 #define V2_COMMAND_INDEX 4
 #define V2_ARGUMENT_INDEX 5
+#define V2_SEQUENCE_INDEX 6
 
 // Default number of values to allow before and after strictly defined range for V2 scales
 #define V2_DEFAULT_RANGE_BUFFER 0x13
@@ -16,6 +17,8 @@ public:
   V2PacketFormatter(MiLightRemoteType deviceType, uint8_t protocolId, uint8_t numGroups);
 
   bool canHandle(const uint8_t* packet, size_t packetLen) override;
+  // Decodes a copy and passes it to parseDecodedPacket
+  BulbId parsePacket(const uint8_t* packet, PacketDelta& result) override;
   void initializePacket(uint8_t* packet) override;
 
   void updateStatus(MiLightStatus status, uint8_t group) override;
@@ -24,8 +27,10 @@ public:
   void unpair() override;
 
   void finalizePacket(uint8_t* packet) override;
+  void restampPacket(uint8_t* packet) override;
 
   uint8_t groupCommandArg(MiLightStatus status, uint8_t groupId) const;
+  uint8_t getProtocolId() const;
 
   /*
    * Some protocols have scales which have the following characteristics:
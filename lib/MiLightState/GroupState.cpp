@@ -1,7 +1,7 @@
 #include <GroupState.h>
 #include <Units.h>
 #include <MiLightRemoteConfig.h>
-#include <RGBConverter.h>
+#include <ColorMath.h>
 #include <BulbId.h>
 #include <MiLightCommands.h>
 
@@ -32,6 +32,86 @@ static constexpr GroupStateField ALL_SCRATCH_FIELDS[] = {
 // Number of units each increment command counts for
 static constexpr uint8_t INCREMENT_COMMAND_VALUE = 10;
 
+struct GroupState::StateMasks {
+  // Fields that are copied verbatim by patch().  Brightness is handled separately because
+  // which bits it lives in depends on bulb mode.
+  FieldMask patchFields[6];
+  // Fields that clearNonMatchingFields() can clear just by dropping the is-set bit
+  FieldMask clearFields[5];
+
+  FieldMask status;
+  FieldMask nightMode;
+  FieldMask bulbModeNight;
+  // Bits ignored by isEqualIgnoreDirty()
+  uint32_t dirty[DATA_LONGS];
+
+  // Derive masks from the bitfield layout rather than hard-coding offsets, so that
+  // reordering StateData can't silently break them.  Decrementing an unsigned bitfield
+  // from 0 sets all of its bits.
+  template<typename ValueSetter, typename IsSetSetter>
+  static FieldMask fieldMask(ValueSetter setValue, IsSetSetter setIsSet) {
+    StateData value = {};
+    StateData isSet = {};
+    setValue(value.fields);
+    setIsSet(isSet.fields);
+
+    FieldMask mask = {};
+    for (size_t i = 0; i < DATA_LONGS; ++i) {
+      mask.value[i] = value.rawData[i];
+      mask.isSet[i] = isSet.rawData[i];
+    }
+    return mask;
+  }
+
+  static StateMasks build() {
+    using F = StateData::Fields;
+    StateMasks masks = {};
+
+    const FieldMask state = fieldMask([](F& f) { --f._state; }, [](F& f) { --f._isSetState; });
+    const FieldMask hue = fieldMask([](F& f) { --f._hue; }, [](F& f) { --f._isSetHue; });
+    const FieldMask saturation = fieldMask([](F& f) { --f._saturation; }, [](F& f) { --f._isSetSaturation; });
+    const FieldMask mode = fieldMask([](F& f) { --f._mode; }, [](F& f) { --f._isSetMode; });
+    const FieldMask kelvin = fieldMask([](F& f) { --f._kelvin; }, [](F& f) { --f._isSetKelvin; });
+    const FieldMask bulbMode = fieldMask([](F& f) { --f._bulbMode; }, [](F& f) { --f._isSetBulbMode; });
+
+    // Same order as ALL_PHYSICAL_FIELDS, minus brightness
+    masks.patchFields[0] = bulbMode;
+    masks.patchFields[1] = hue;
+    masks.patchFields[2] = kelvin;
+    masks.patchFields[3] = mode;
+    masks.patchFields[4] = saturation;
+    masks.patchFields[5] = state;
+
+    masks.clearFields[0] = hue;
+    masks.clearFields[1] = kelvin;
+    masks.clearFields[2] = mode;
+    masks.clearFields[3] = saturation;
+    masks.clearFields[4] = state;
+
+    masks.status = state;
+    masks.nightMode = fieldMask([](F& f) { --f._isNightMode; }, [](F& f) { --f._isSetNightMode; });
+    masks.bulbModeNight = fieldMask([](F& f) { f._bulbMode = BULB_MODE_NIGHT; }, [](F&) { });
+
+    const FieldMask dirty = fieldMask([](F& f) { --f._dirty; }, [](F& f) { --f._mqttDirty; });
+    for (size_t i = 0; i < DATA_LONGS; ++i) {
+      masks.dirty[i] = dirty.value[i] | dirty.isSet[i];
+    }
+
+    return masks;
+  }
+};
+
+static inline bool matchesAny(const uint32_t* data, const uint32_t* mask) {
+  return ((data[0] & mask[0]) | (data[1] & mask[1])) != 0;
+}
+
+static inline bool matchesAll(const uint32_t* data, const uint32_t* mask, const uint32_t* expected) {
+  return (data[0] & mask[0]) == expected[0] && (data[1] & mask[1]) == expected[1];
+}
+
+// Must be initialized before the default states below
+const GroupState::StateMasks GroupState::MASKS = GroupState::StateMasks::build();
+
 static const GroupState DEFAULT_STATE = GroupState();
 static const GroupState DEFAULT_RGB_ONLY_STATE = GroupState::initDefaultRgbState();
 static const GroupState DEFAULT_WHITE_ONLY_STATE = GroupState::initDefaultWhiteState();
@@ -114,6 +194,10 @@ GroupState::GroupState(const GroupState& other) :
   }
 
 GroupState::GroupState(const GroupState* previousState, const JsonObject jsonState)
+  : GroupState(previousState, PacketDelta::fromJson(jsonState))
+{ }
+
+GroupState::GroupState(const GroupState* previousState, const PacketDelta& delta)
   : previousState(previousState)
 {
   initFields();
@@ -122,7 +206,7 @@ GroupState::GroupState(const GroupState* previousState, const JsonObject jsonSta
     this->scratchpad = previousState->scratchpad;
   }
 
-  patch(jsonState);
+  patch(delta);
 }
 
 bool GroupState::operator==(const GroupState& other) const {
@@ -130,15 +214,13 @@ bool GroupState::operator==(const GroupState& other) const {
 }
 
 bool GroupState::isEqualIgnoreDirty(const GroupState& other) const {
-  GroupState meCopy = *this;
-  GroupState otherCopy = other;
-
-  meCopy.clearDirty();
-  meCopy.clearMqttDirty();
-  otherCopy.clearDirty();
-  otherCopy.clearMqttDirty();
+  for (size_t i = 0; i < DATA_LONGS; ++i) {
+    if ((state.rawData[i] ^ other.state.rawData[i]) & ~MASKS.dirty[i]) {
+      return false;
+    }
+  }
 
-  return meCopy == otherCopy;
+  return true;
 }
 
 void GroupState::print(Stream& stream) const {
@@ -576,6 +658,10 @@ bool GroupState::setBulbMode(const BulbMode bulbMode) {
   return true;
 }
 
+const char* GroupState::getBulbModeName() const {
+  return BULB_MODE_NAMES[getBulbMode()];
+}
+
 bool GroupState::isSetNightMode() const { return state.fields._isSetNightMode; }
 bool GroupState::isNightMode() const { return state.fields._isNightMode; }
 bool GroupState::setNightMode(const bool nightMode) {
@@ -679,16 +765,38 @@ bool GroupState::clearNonMatchingFields(const GroupState& other) {
 
   bool clearedAny = false;
 
-  for (size_t i = 0; i < std::size(ALL_PHYSICAL_FIELDS); ++i) {
-    const GroupStateField field = ALL_PHYSICAL_FIELDS[i];
+  // Clearing bulb mode also clears brightness, so it has to go first
+  if (other.isSetBulbMode() && isSetBulbMode() && getBulbMode() != other.getBulbMode()) {
+    clearedAny = clearField(GroupStateField::BULB_MODE);
+  }
+
+  // For the remaining simple fields: drop the is-set bit if both are set and values differ
+  uint32_t bothSet[DATA_LONGS];
+  uint32_t differing[DATA_LONGS];
+  uint32_t cleared[DATA_LONGS] = {};
 
-    if (other.isSetField(field) && isSetField(field) && getFieldValue(field) != other.getFieldValue(field)) {
-      if (clearField(field)) {
-        clearedAny = true;
+  for (size_t i = 0; i < DATA_LONGS; ++i) {
+    bothSet[i] = state.rawData[i] & other.state.rawData[i];
+    differing[i] = state.rawData[i] ^ other.state.rawData[i];
+  }
+
+  for (const FieldMask& mask : MASKS.clearFields) {
+    if (matchesAny(bothSet, mask.isSet) && matchesAny(differing, mask.value)) {
+      for (size_t i = 0; i < DATA_LONGS; ++i) {
+        cleared[i] |= mask.isSet[i];
       }
     }
   }
 
+  for (size_t i = 0; i < DATA_LONGS; ++i) {
+    state.rawData[i] &= ~cleared[i];
+    clearedAny = clearedAny || cleared[i] != 0;
+  }
+
+  if (other.isSetBrightness() && isSetBrightness() && getBrightness() != other.getBrightness()) {
+    clearedAny = clearBrightness() || clearedAny;
+  }
+
 #ifdef STATE_DEBUG
   this->debugState("Result");
 #endif
@@ -702,6 +810,62 @@ void GroupState::patch(const GroupState& other) {
   Serial.println();
 #endif
 
+  // Night mode and off bulbs change which fields get applied part way through.  Also bail
+  // on a raw night bulb mode, which setBulbMode() would turn into night mode.
+  const bool needsFieldPatch = !isOn()
+    || matchesAny(other.state.rawData, MASKS.nightMode.value)
+    || matchesAll(other.state.rawData, MASKS.patchFields[0].value, MASKS.bulbModeNight.value);
+
+  if (needsFieldPatch) {
+    patchFields(other);
+  } else {
+    // Copy value and is-set bits for every field that's set in the other state
+    uint32_t copied[DATA_LONGS] = {};
+    for (const FieldMask& mask : MASKS.patchFields) {
+      if (matchesAny(other.state.rawData, mask.isSet)) {
+        for (size_t i = 0; i < DATA_LONGS; ++i) {
+          copied[i] |= mask.value[i] | mask.isSet[i];
+        }
+      }
+    }
+
+    bool changed = false;
+    bool statusChanged = false;
+
+    for (size_t i = 0; i < DATA_LONGS; ++i) {
+      const uint32_t changedBits = (state.rawData[i] ^ other.state.rawData[i]) & copied[i];
+
+      changed = changed || changedBits != 0;
+      statusChanged = statusChanged || (changedBits & (MASKS.status.value[i] | MASKS.status.isSet[i])) != 0;
+      state.rawData[i] = (state.rawData[i] & ~copied[i]) | (other.state.rawData[i] & copied[i]);
+    }
+
+    if (changed) {
+      setDirty();
+    }
+
+    // Mirror setState(), which marks night mode as explicitly off when status changes
+    if (statusChanged) {
+      for (size_t i = 0; i < DATA_LONGS; ++i) {
+        state.rawData[i] |= MASKS.nightMode.isSet[i];
+      }
+    }
+
+    // Brightness is applied last, and depends on the (possibly just patched) bulb mode and status
+    if (other.isSetBrightness() && isOn()) {
+      setBrightness(other.getBrightness());
+    }
+  }
+
+  for (size_t i = 0; i < std::size(ALL_SCRATCH_FIELDS); ++i) {
+    // All scratch field updates require that the bulb is on.
+    if (const GroupStateField field = ALL_SCRATCH_FIELDS[i]; isOn() && other.isSetScratchField(field)) {
+      setScratchFieldValue(field, other.getScratchFieldValue(field));
+    }
+  }
+}
+
+void GroupState::patchFields(const GroupState& other) {
   for (size_t i = 0; i < std::size(ALL_PHYSICAL_FIELDS); ++i) {
     // Handle night mode separately.  Should always set this field.
     if (
@@ -718,13 +882,16 @@ void GroupState::patch(const GroupState& other) {
       setFieldValue(field, other.getFieldValue(field));
     }
   }
+}
 
-  for (size_t i = 0; i < std::size(ALL_SCRATCH_FIELDS); ++i) {
-    // All scratch field updates require that the bulb is on.
-    if (const GroupStateField field = ALL_SCRATCH_FIELDS[i]; isOn() && other.isSetScratchField(field)) {
-      setScratchFieldValue(field, other.getScratchFieldValue(field));
-    }
-  }
+bool GroupState::patch(const JsonObject state) {
+#ifdef STATE_DEBUG
+  Serial.print(F("Patching existing state with: "));
+  serializeJson(state, Serial);
+  Serial.println();
+#endif
+
+  return patch(PacketDelta::fromJson(state));
 }
 
 /*
@@ -735,62 +902,66 @@ void GroupState::patch(const GroupState& other) {
 
   Returns true if the packet changes affects a state change
 */
-bool GroupState::patch(JsonObject state) {
+bool GroupState::patch(const PacketDelta& delta) {
   bool changes = false;
 
-#ifdef STATE_DEBUG
-  Serial.print(F("Patching existing state with: "));
-  serializeJson(state, Serial);
-  Serial.println();
-#endif
-
-  if (state.containsKey(GroupStateFieldNames::STATE)) {
-    const bool stateChange = setState(state[GroupStateFieldNames::STATE] == "ON" ? ON : OFF);
-    changes |= stateChange;
+  if (delta.has(PacketDelta::STATE)) {
+    changes |= setState(delta.state);
   }
 
   // Devices do not support changing their state while off, so don't apply state
   // changes to devices we know are off.
 
-  if (isOn() && state.containsKey(GroupStateFieldNames::BRIGHTNESS)) {
-    const bool stateChange = setBrightness(Units::rescale(
-      state[GroupStateFieldNames::BRIGHTNESS].as<uint8_t>(), 100, 255
-    ));
-    changes |= stateChange;
+  if (isOn() && delta.has(PacketDelta::BRIGHTNESS)) {
+    changes |= setBrightness(Units::rescale(delta.brightness, 100, 255));
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::HUE)) {
-    changes |= setHue(state[GroupStateFieldNames::HUE]);
+  if (isOn() && delta.has(PacketDelta::HUE)) {
+    changes |= setHue(delta.hue);
     changes |= setBulbMode(BULB_MODE_COLOR);
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::SATURATION)) {
-    changes |= setSaturation(state[GroupStateFieldNames::SATURATION]);
+  if (isOn() && delta.has(PacketDelta::SATURATION)) {
+    changes |= setSaturation(delta.saturation);
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::MODE)) {
-    changes |= setMode(state[GroupStateFieldNames::MODE]);
+  if (isOn() && delta.has(PacketDelta::MODE)) {
+    changes |= setMode(delta.mode);
     changes |= setBulbMode(BULB_MODE_SCENE);
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::COLOR_TEMP)) {
-    changes |= setMireds(state[GroupStateFieldNames::COLOR_TEMP]);
+  if (isOn() && delta.has(PacketDelta::COLOR_TEMP)) {
+    changes |= setMireds(delta.colorTemp);
     changes |= setBulbMode(BULB_MODE_WHITE);
   }
 
-  if (state.containsKey(GroupStateFieldNames::COMMAND)) {
-    const String& command = state[GroupStateFieldNames::COMMAND];
-
-    if (isOn() && command == MiLightCommandNames::SET_WHITE) {
-      changes |= setBulbMode(BULB_MODE_WHITE);
-    } else if (command == MiLightCommandNames::NIGHT_MODE) {
-      changes |= setBulbMode(BULB_MODE_NIGHT);
-    } else if (isOn() && command == "brightness_up") {
-      changes |= applyIncrementCommand(GroupStateField::BRIGHTNESS, IncrementDirection::INCREASE);
-    } else if (isOn() && command == "brightness_down") {
-      changes |= applyIncrementCommand(GroupStateField::BRIGHTNESS, IncrementDirection::DECREASE);
-    } else if (isOn() && command == MiLightCommandNames::TEMPERATURE_UP) {
-      changes |= applyIncrementCommand(GroupStateField::KELVIN, IncrementDirection::INCREASE);
-      changes |= setBulbMode(BULB_MODE_WHITE);
-    } else if (isOn() && command == MiLightCommandNames::TEMPERATURE_DOWN) {
-      changes |= applyIncrementCommand(GroupStateField::KELVIN, IncrementDirection::DECREASE);
-      changes |= setBulbMode(BULB_MODE_WHITE);
+  if (delta.has(PacketDelta::COMMAND)) {
+    switch (delta.command) {
+      case PacketCommand::SET_WHITE:
+        if (isOn()) {
+          changes |= setBulbMode(BULB_MODE_WHITE);
+        }
+        break;
+      case PacketCommand::NIGHT_MODE:
+        changes |= setBulbMode(BULB_MODE_NIGHT);
+        break;
+      case PacketCommand::BRIGHTNESS_UP:
+      case PacketCommand::BRIGHTNESS_DOWN:
+        if (isOn()) {
+          changes |= applyIncrementCommand(
+            GroupStateField::BRIGHTNESS,
+            delta.command == PacketCommand::BRIGHTNESS_UP ? IncrementDirection::INCREASE : IncrementDirection::DECREASE
+          );
+        }
+        break;
+      case PacketCommand::TEMPERATURE_UP:
+      case PacketCommand::TEMPERATURE_DOWN:
+        if (isOn()) {
+          changes |= applyIncrementCommand(
+            GroupStateField::KELVIN,
+            delta.command == PacketCommand::TEMPERATURE_UP ? IncrementDirection::INCREASE : IncrementDirection::DECREASE
+          );
+          changes |= setBulbMode(BULB_MODE_WHITE);
+        }
+        break;
+      default:
+        break;
     }
   }
 
@@ -852,7 +1023,7 @@ void GroupState::applyField(const JsonObject partialState, const BulbId& bulbId,
         break;
 
       case GroupStateField::BULB_MODE:
-        partialState[GroupStateFieldNames::BULB_MODE] = BULB_MODE_NAMES[getBulbMode()];
+        partialState[GroupStateFieldNames::BULB_MODE] = getBulbModeName();
         break;
 
       // For HomeAssistant. Should report:
@@ -1007,17 +1178,11 @@ bool GroupState::isSetColor() const {
 
 ParsedColor GroupState::getColor() const {
   uint8_t rgb[3];
-  RGBConverter converter;
   const uint16_t hue = getHue();
+  // Default to fully saturated
   const uint8_t sat = isSetSaturation() ? getSaturation() : 100;
 
-  converter.hsvToRgb(
-    hue / 360.0,
-    // Default to fully saturated
-    sat / 100.0,
-    1,
-    rgb
-  );
+  ColorMath::hsvToRgb(hue, sat, rgb);
 
   return {
     .success = true,
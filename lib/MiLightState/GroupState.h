@@ -6,6 +6,7 @@
 #include <GroupStateField.h>
 #include <ArduinoJson.h>
 #include <BulbId.h>
+#include <PacketDelta.h>
 #include <ParsedColor.h>
 #include <vector>
 
@@ -35,6 +36,8 @@ public:
   // Convenience constructor that patches transient state from a previous GroupState,
   // and defaults with JSON state
   GroupState(const GroupState* previousState, JsonObject jsonState);
+  // Same, from a decoded packet
+  GroupState(const GroupState* previousState, const PacketDelta& delta);
 
   void initFields();
 
@@ -92,6 +95,7 @@ public:
   bool isSetBulbMode() const;
   BulbMode getBulbMode() const;
   bool setBulbMode(BulbMode mode);
+  const char* getBulbModeName() const;
 
   // 1 bit
   bool isSetNightMode() const;
@@ -116,6 +120,8 @@ public:
   // Patches this state with the fields defined in the JSON state. Returns
   // true if there were any changes.
   bool patch(JsonObject state);
+  // Same, from a decoded packet
+  bool patch(const PacketDelta& delta);
 
   // It's a little weird to need to pass in a BulbId here. The purpose is to
   // support fields like DEVICE_ID, which aren't otherwise available to the
@@ -201,6 +207,15 @@ private:
     } fields;
   };
 
+  // Precomputed masks over StateData words.  Used to patch and compare states a word at
+  // a time rather than going field by field.
+  struct FieldMask {
+    uint32_t value[DATA_LONGS];
+    uint32_t isSet[DATA_LONGS];
+  };
+  struct StateMasks;
+  static const StateMasks MASKS;
+
   StateData state;
   TransientData scratchpad;
 
@@ -210,6 +225,10 @@ private:
   // it here.
   const GroupState* previousState;
 
+  // Field-by-field versions of patch/clearNonMatchingFields.  Used when night mode or an off
+  // bulb means the order fields are applied in matters.
+  void patchFields(const GroupState& other);
+
   static void applyColor(JsonObject state, uint8_t r, uint8_t g, uint8_t b);
   void applyColor(JsonObject state) const;
   // Apply OpenHAB-style color, e.g., {"color":"0,0,0"}
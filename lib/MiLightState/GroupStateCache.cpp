@@ -1,46 +1,70 @@
 #include <GroupStateCache.h>
+#include <algorithm>
+
+// Share of free PSRAM (1/N) the state cache is allowed to claim
+#ifndef MILIGHT_EXT_STATE_CACHE_FRACTION
+#define MILIGHT_EXT_STATE_CACHE_FRACTION 4
+#endif
 
 GroupStateCache::GroupStateCache(const size_t maxSize)
   : maxSize(maxSize)
-{ }
+  , lookups(0)
+  , hits(0)
+  , lookupMicros(0)
+{
+  index.reserve(maxSize);
+}
 
 GroupStateCache::~GroupStateCache() {
-  const ListNode<GroupCacheNode*>* cur = cache.getHead();
+  const Node* cur = cache.getHead();
 
   while (cur != nullptr) {
-    delete cur->data;
+    ExtMemory::destroy(cur->data);
     cur = cur->next;
   }
 }
 
 GroupState* GroupStateCache::get(const BulbId& id) {
-  return getInternal(id);
+  GroupCacheNode* node = getInternal(id);
+  return node == nullptr ? nullptr : &node->state;
 }
 
 GroupState* GroupStateCache::set(const BulbId& id, const GroupState& state) {
+  return &setNode(id, state, 0)->state;
+}
+
+GroupCacheNode* GroupStateCache::getNode(const BulbId& id) {
+  return getInternal(id);
+}
+
+GroupCacheNode* GroupStateCache::setNode(const BulbId& id, const GroupState& state, const uint32_t version) {
   GroupCacheNode* pushedNode = nullptr;
   if (cache.size() >= maxSize) {
     pushedNode = cache.pop();
+    index.erase(keyOf(pushedNode->id));
   }
 
-  GroupState* cachedState = getInternal(id);
+  GroupCacheNode* cachedNode = getInternal(id);
 
-  if (cachedState == nullptr) {
+  if (cachedNode == nullptr) {
     if (pushedNode == nullptr) {
-      const auto newNode = new GroupCacheNode(id, state);
-      cachedState = &newNode->state;
-      cache.unshift(newNode);
+      cachedNode = ExtMemory::create<GroupCacheNode>(id, state, version);
+      cache.unshift(cachedNode);
     } else {
       pushedNode->id = id;
       pushedNode->state = state;
-      cachedState = &pushedNode->state;
+      pushedNode->version = version;
+      cachedNode = pushedNode;
       cache.unshift(pushedNode);
     }
+
+    index[keyOf(id)] = cache.getHead();
   } else {
-    *cachedState = state;
+    cachedNode->state = state;
+    cachedNode->version = version;
   }
 
-  return cachedState;
+  return cachedNode;
 }
 
 BulbId GroupStateCache::getLru() const {
@@ -48,25 +72,61 @@ BulbId GroupStateCache::getLru() const {
   return node->id;
 }
 
+uint32_t GroupStateCache::getLruVersion() const {
+  const GroupCacheNode* node = cache.getLast();
+  return node->version;
+}
+
 bool GroupStateCache::isFull() const {
   return cache.size() >= maxSize;
 }
 
-ListNode<GroupCacheNode*>* GroupStateCache::getHead() {
+GroupStateCache::Node* GroupStateCache::getHead() {
   return cache.getHead();
 }
 
-GroupState* GroupStateCache::getInternal(const BulbId& id) {
-  ListNode<GroupCacheNode*>* cur = cache.getHead();
+GroupStateCacheStats GroupStateCache::getStats() const {
+  return {
+    cache.size(),
+    maxSize,
+    ExtMemory::isAvailable(),
+    lookups,
+    hits,
+    lookupMicros
+  };
+}
 
-  while (cur != nullptr) {
-    if (cur->data->id == id) {
-      GroupState* result = &cur->data->state;
-      cache.spliceToFront(cur);
-      return result;
-    }
-    cur = cur->next;
+size_t GroupStateCache::sizeForAvailableMemory(const size_t defaultSize, const size_t maxExternalSize) {
+  if (! ExtMemory::isAvailable()) {
+    return defaultSize;
+  }
+
+  // The index costs about a bucket and a hash node per entry
+  const size_t indexSize = sizeof(NodeIndex::value_type) + 3 * sizeof(void*);
+  const size_t nodeSize = sizeof(GroupCacheNode) + sizeof(Node) + indexSize;
+  const size_t fits = ExtMemory::getFree() / MILIGHT_EXT_STATE_CACHE_FRACTION / nodeSize;
+
+  return std::max(defaultSize, std::min(fits, maxExternalSize));
+}
+
+GroupCacheNode* GroupStateCache::getInternal(const BulbId& id) {
+  const unsigned long start = micros();
+  GroupCacheNode* result = nullptr;
+
+  if (const auto it = index.find(keyOf(id)); it != index.end()) {
+    result = it->second->data;
+    cache.spliceToFront(it->second);
+  }
+
+  ++lookups;
+  lookupMicros += micros() - start;
+  if (result != nullptr) {
+    ++hits;
   }
 
-  return nullptr;
+  return result;
+}
+
+uint32_t GroupStateCache::keyOf(const BulbId& id) {
+  return (static_cast<uint32_t>(id.deviceId) << 16) | (static_cast<uint32_t>(id.deviceType) << 8) | id.groupId;
 }
@@ -2,30 +2,76 @@
 
 #include <GroupState.h>
 #include <LinkedList.h>
+#include <ExtMemory.h>
+#include <unordered_map>
 
 struct GroupCacheNode {
-  GroupCacheNode() {}
-  GroupCacheNode(const BulbId& id, const GroupState& state)
-    : id(id), state(state) { }
+  GroupCacheNode() : version(0) {}
+  GroupCacheNode(const BulbId& id, const GroupState& state, const uint32_t version = 0)
+    : id(id), state(state), version(version) { }
 
   BulbId id;
   GroupState state;
+
+  // Value of the store's change sequence when this state last changed
+  uint32_t version;
+};
+
+struct GroupStateCacheStats {
+  size_t size;
+  size_t maxSize;
+  bool externalMemory;
+  uint32_t lookups;
+  uint32_t hits;
+  // Total time spent searching the cache.  Divide by lookups for the average access latency.
+  uint32_t lookupMicros;
 };
 
 class GroupStateCache {
 public:
+  typedef ListNode<GroupCacheNode*> Node;
+  typedef LinkedList<GroupCacheNode*, ExtMemory::Allocator<Node>> NodeList;
+  // Finds a state's list node without walking the list, which can be 1000 nodes in PSRAM
+  typedef std::unordered_map<
+    uint32_t,
+    Node*,
+    std::hash<uint32_t>,
+    std::equal_to<uint32_t>,
+    ExtMemory::Allocator<std::pair<const uint32_t, Node*>>
+  > NodeIndex;
+
   explicit GroupStateCache(size_t maxSize);
   ~GroupStateCache();
 
   GroupState* get(const BulbId& id);
   GroupState* set(const BulbId& id, const GroupState& state);
+
+  // Same as get/set, but expose the cache node (and with it the state version)
+  GroupCacheNode* getNode(const BulbId& id);
+  GroupCacheNode* setNode(const BulbId& id, const GroupState& state, uint32_t version);
+
   BulbId getLru() const;
+  uint32_t getLruVersion() const;
   bool isFull() const;
-  ListNode<GroupCacheNode*>* getHead();
+  Node* getHead();
+
+  GroupStateCacheStats getStats() const;
+
+  /*
+   * Picks a cache size for the memory on this board.  Without external memory (PSRAM) this is
+   * just the default.  With it, the cache may use a share of free PSRAM, up to maxExternalSize.
+   */
+  static size_t sizeForAvailableMemory(size_t defaultSize, size_t maxExternalSize);
 
 private:
-  LinkedList<GroupCacheNode*> cache;
+  NodeList cache;
+  NodeIndex index;
   const size_t maxSize;
+  uint32_t lookups;
+  uint32_t hits;
+  uint32_t lookupMicros;
 
-  GroupState* getInternal(const BulbId& id);
+  GroupCacheNode* getInternal(const BulbId& id);
+  // Unlike BulbId::getCompactId, keeps every bit of the device ID
+  static uint32_t keyOf(const BulbId& id);
 };
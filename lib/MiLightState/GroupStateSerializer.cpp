@@ -0,0 +1,341 @@
+#include <GroupStateSerializer.h>
+#include <MiLightRemoteConfig.h>
+#include <MiLightCommands.h>
+#include <Units.h>
+#include <cstring>
+
+// Discards output, only counting bytes
+class CountingPrint : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, const size_t size) override { return size; }
+};
+
+// Writes to a fixed buffer, dropping anything that doesn't fit
+class BufferPrint : public Print {
+public:
+  BufferPrint(char* buffer, const size_t size)
+    : buffer(buffer)
+    , size(size)
+    , length(0)
+    , overflowed(false)
+  { }
+
+  size_t write(const uint8_t c) override {
+    if (length + 1 >= size) {
+      overflowed = true;
+      return 0;
+    }
+    buffer[length++] = c;
+    return 1;
+  }
+
+  char* buffer;
+  const size_t size;
+  size_t length;
+  bool overflowed;
+};
+
+static size_t writeString(Print& out, const char* value) {
+  return out.print('"') + out.print(value) + out.print('"');
+}
+
+static size_t writeRgb(Print& out, const uint8_t r, const uint8_t g, const uint8_t b) {
+  return out.print(F("{\"r\":")) + out.print(r)
+    + out.print(F(",\"g\":")) + out.print(g)
+    + out.print(F(",\"b\":")) + out.print(b)
+    + out.print('}');
+}
+
+static bool isColorMode(const GroupState& state, const BulbId&) {
+  return state.getBulbMode() == BULB_MODE_COLOR;
+}
+
+static bool isWhiteMode(const GroupState& state) {
+  return state.isSetBulbMode() && state.getBulbMode() == BULB_MODE_WHITE;
+}
+
+static bool always(const GroupState&, const BulbId&) {
+  return true;
+}
+
+GroupStateSerializer::GroupStateSerializer(const std::vector<GroupStateField>& fields) {
+  compile(fields);
+}
+
+void GroupStateSerializer::compile(const std::vector<GroupStateField>& fields) {
+  plan.clear();
+
+  for (const GroupStateField field : fields) {
+    FieldWriter writer = {};
+
+    if (! getWriter(field, writer)) {
+      Serial.printf_P(PSTR("Tried to apply unknown field: %d\n"), static_cast<uint8_t>(field));
+      continue;
+    }
+
+    const char* key = getKey(field);
+    bool found = false;
+
+    for (KeyWriter& keyWriter : plan) {
+      if (strcmp(keyWriter.key, key) == 0) {
+        keyWriter.writers.push_back(writer);
+        found = true;
+        break;
+      }
+    }
+
+    if (! found) {
+      plan.push_back({ key, { writer } });
+    }
+  }
+}
+
+size_t GroupStateSerializer::write(Print& out, const GroupState& state, const BulbId& bulbId) const {
+  size_t written = out.print('{');
+  bool first = true;
+
+  for (const KeyWriter& keyWriter : plan) {
+    for (auto it = keyWriter.writers.rbegin(); it != keyWriter.writers.rend(); ++it) {
+      if (it->hasValue(state, bulbId)) {
+        if (! first) {
+          written += out.print(',');
+        }
+        written += writeString(out, keyWriter.key);
+        written += out.print(':');
+        written += it->writeValue(out, state, bulbId);
+
+        first = false;
+        break;
+      }
+    }
+  }
+
+  return written + out.print('}');
+}
+
+size_t GroupStateSerializer::write(char* buffer, const size_t size, const GroupState& state, const BulbId& bulbId) const {
+  BufferPrint out(buffer, size);
+  write(out, state, bulbId);
+
+  if (out.overflowed) {
+    return 0;
+  }
+
+  buffer[out.length] = 0;
+  return out.length;
+}
+
+size_t GroupStateSerializer::measure(const GroupState& state, const BulbId& bulbId) const {
+  CountingPrint out;
+  return write(out, state, bulbId);
+}
+
+std::unique_ptr<char[]> GroupStateSerializer::serialize(const GroupState& state, const BulbId& bulbId, size_t& length) const {
+  const size_t size = measure(state, bulbId) + 1;
+  std::unique_ptr<char[]> buffer(new char[size]);
+  length = write(buffer.get(), size, state, bulbId);
+  return buffer;
+}
+
+const char* GroupStateSerializer::getKey(const GroupStateField field) {
+  switch (field) {
+    // All of these are rendered under the same key
+    case GroupStateField::COLOR:
+    case GroupStateField::OH_COLOR:
+    case GroupStateField::HEX_COLOR:
+    case GroupStateField::COMPUTED_COLOR:
+      return GroupStateFieldNames::COLOR;
+
+    default:
+      return GroupStateFieldHelpers::getFieldName(field);
+  }
+}
+
+// Mirrors GroupState::applyField
+bool GroupStateSerializer::getWriter(const GroupStateField field, FieldWriter& writer) {
+  switch (field) {
+    case GroupStateField::STATE:
+    case GroupStateField::STATUS:
+      writer.hasValue = [](const GroupState& state, const BulbId&) { return state.isSetState(); };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return writeString(out, state.getState() == ON ? "ON" : "OFF");
+      };
+      return true;
+
+    case GroupStateField::BRIGHTNESS:
+      writer.hasValue = [](const GroupState& state, const BulbId&) { return state.isSetBrightness(); };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return out.print(Units::rescale(state.getBrightness(), 255, 100));
+      };
+      return true;
+
+    case GroupStateField::LEVEL:
+      writer.hasValue = [](const GroupState& state, const BulbId&) { return state.isSetBrightness(); };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return out.print(state.getBrightness());
+      };
+      return true;
+
+    case GroupStateField::BULB_MODE:
+      writer.hasValue = [](const GroupState& state, const BulbId&) { return state.isSetBulbMode(); };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return writeString(out, state.getBulbModeName());
+      };
+      return true;
+
+    // For HomeAssistant.  See GroupState::applyField.
+    case GroupStateField::COLOR_MODE:
+      writer.hasValue = [](const GroupState& state, const BulbId&) { return state.isSetBulbMode(); };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId& bulbId) {
+        const BulbMode bulbMode = state.getBulbMode();
+
+        if (MiLightRemoteTypeHelpers::supportsRgb(bulbId.deviceType) && bulbMode == BULB_MODE_COLOR) {
+          return writeString(out, "rgb");
+        } else if (MiLightRemoteTypeHelpers::supportsColorTemp(bulbId.deviceType) && bulbMode == BULB_MODE_WHITE) {
+          return writeString(out, "color_temp");
+        } else if (bulbMode == BULB_MODE_NIGHT) {
+          return writeString(out, "onoff");
+        } else {
+          return writeString(out, "brightness");
+        }
+      };
+      return true;
+
+    case GroupStateField::COLOR:
+      writer.hasValue = [](const GroupState& state, const BulbId& bulbId) {
+        return state.isSetHue() && isColorMode(state, bulbId);
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        const ParsedColor color = state.getColor();
+        return writeRgb(out, color.r, color.g, color.b);
+      };
+      return true;
+
+    case GroupStateField::OH_COLOR:
+      writer.hasValue = [](const GroupState& state, const BulbId& bulbId) {
+        return state.isSetHue() && isColorMode(state, bulbId);
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        const ParsedColor color = state.getColor();
+        char ohColorStr[13];
+        snprintf_P(ohColorStr, sizeof(ohColorStr), PSTR("%d,%d,%d"), color.r, color.g, color.b);
+        return writeString(out, ohColorStr);
+      };
+      return true;
+
+    case GroupStateField::HEX_COLOR:
+      writer.hasValue = [](const GroupState& state, const BulbId& bulbId) {
+        return state.isSetHue() && isColorMode(state, bulbId);
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        const ParsedColor color = state.getColor();
+        char hexColor[8];
+        snprintf_P(hexColor, sizeof(hexColor), PSTR("#%02X%02X%02X"), color.r, color.g, color.b);
+        return writeString(out, hexColor);
+      };
+      return true;
+
+    case GroupStateField::COMPUTED_COLOR:
+      writer.hasValue = always;
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        if (state.getBulbMode() == BULB_MODE_COLOR) {
+          const ParsedColor color = state.getColor();
+          return writeRgb(out, color.r, color.g, color.b);
+        } else {
+          return writeRgb(out, 255, 255, 255);
+        }
+      };
+      return true;
+
+    case GroupStateField::HUE:
+      writer.hasValue = [](const GroupState& state, const BulbId& bulbId) {
+        return state.isSetHue() && isColorMode(state, bulbId);
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return out.print(state.getHue());
+      };
+      return true;
+
+    case GroupStateField::SATURATION:
+      writer.hasValue = [](const GroupState& state, const BulbId& bulbId) {
+        return state.isSetSaturation() && isColorMode(state, bulbId);
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return out.print(state.getSaturation());
+      };
+      return true;
+
+    case GroupStateField::MODE:
+      writer.hasValue = [](const GroupState& state, const BulbId&) {
+        return state.isSetMode() && state.getBulbMode() == BULB_MODE_SCENE;
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return out.print(state.getMode());
+      };
+      return true;
+
+    case GroupStateField::EFFECT:
+      writer.hasValue = [](const GroupState& state, const BulbId&) {
+        return state.isSetEffect() && (
+          state.getBulbMode() == BULB_MODE_SCENE
+            || state.getBulbMode() == BULB_MODE_NIGHT
+            || isWhiteMode(state)
+        );
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        if (state.getBulbMode() == BULB_MODE_SCENE) {
+          return out.print('"') + out.print(state.getMode()) + out.print('"');
+        } else if (isWhiteMode(state)) {
+          return writeString(out, "white_mode");
+        } else {
+          return writeString(out, MiLightCommandNames::NIGHT_MODE);
+        }
+      };
+      return true;
+
+    case GroupStateField::COLOR_TEMP:
+      writer.hasValue = [](const GroupState& state, const BulbId&) {
+        return state.isSetKelvin() && isWhiteMode(state);
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return out.print(state.getMireds());
+      };
+      return true;
+
+    case GroupStateField::KELVIN:
+      writer.hasValue = [](const GroupState& state, const BulbId&) {
+        return state.isSetKelvin() && isWhiteMode(state);
+      };
+      writer.writeValue = [](Print& out, const GroupState& state, const BulbId&) {
+        return out.print(state.getKelvin());
+      };
+      return true;
+
+    case GroupStateField::DEVICE_ID:
+      writer.hasValue = always;
+      writer.writeValue = [](Print& out, const GroupState&, const BulbId& bulbId) {
+        return out.print(bulbId.deviceId);
+      };
+      return true;
+
+    case GroupStateField::GROUP_ID:
+      writer.hasValue = always;
+      writer.writeValue = [](Print& out, const GroupState&, const BulbId& bulbId) {
+        return out.print(bulbId.groupId);
+      };
+      return true;
+
+    case GroupStateField::DEVICE_TYPE:
+      writer.hasValue = [](const GroupState&, const BulbId& bulbId) {
+        return MiLightRemoteConfig::fromType(bulbId.deviceType) != nullptr;
+      };
+      writer.writeValue = [](Print& out, const GroupState&, const BulbId& bulbId) {
+        return writeString(out, MiLightRemoteConfig::fromType(bulbId.deviceType)->name.c_str());
+      };
+      return true;
+
+    default:
+      return false;
+  }
+}
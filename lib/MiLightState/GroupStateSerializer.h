@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GroupState.h>
+#include <Print.h>
+#include <vector>
+#include <memory>
+
+/*
+ * Writes the JSON for a fixed set of GroupState fields directly to a Print, skipping the
+ * JsonDocument that GroupState::applyState needs.  The field list is compiled once into a
+ * list of writers, so serializing doesn't have to go through the per-field switch.
+ *
+ * Output matches serializing the result of applyState, except that when several fields share
+ * a key (e.g., "color" and "oh_color"), the key is always placed where the first of them is
+ * listed.
+ */
+class GroupStateSerializer {
+public:
+  GroupStateSerializer() = default;
+  explicit GroupStateSerializer(const std::vector<GroupStateField>& fields);
+
+  void compile(const std::vector<GroupStateField>& fields);
+
+  size_t write(Print& out, const GroupState& state, const BulbId& bulbId) const;
+
+  // Writes a null-terminated string to the buffer.  Returns the length written, or 0 if the
+  // buffer was too small.
+  size_t write(char* buffer, size_t size, const GroupState& state, const BulbId& bulbId) const;
+
+  // Number of bytes write() will produce
+  size_t measure(const GroupState& state, const BulbId& bulbId) const;
+
+  // Writes to a null-terminated buffer sized with measure(), for JSON that has to be held
+  // until something else is serialized (e.g. as a serialized() value in a JsonDocument).
+  // Sets length to the length written.
+  std::unique_ptr<char[]> serialize(const GroupState& state, const BulbId& bulbId, size_t& length) const;
+
+private:
+  typedef bool (*HasValueFn)(const GroupState& state, const BulbId& bulbId);
+  typedef size_t (*WriteValueFn)(Print& out, const GroupState& state, const BulbId& bulbId);
+
+  struct FieldWriter {
+    HasValueFn hasValue;
+    WriteValueFn writeValue;
+  };
+
+  // All writers for one JSON key, in the order their fields were listed.  The last one with a
+  // value wins, same as repeatedly assigning the key in a JsonObject.
+  struct KeyWriter {
+    const char* key;
+    std::vector<FieldWriter> writers;
+  };
+
+  std::vector<KeyWriter> plan;
+
+  static const char* getKey(GroupStateField field);
+  static bool getWriter(GroupStateField field, FieldWriter& writer);
+};
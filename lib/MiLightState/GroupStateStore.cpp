@@ -1,16 +1,31 @@
 #include <GroupStateStore.h>
 #include <MiLightRemoteConfig.h>
 
+#ifdef ESP32
+  #include <esp_system.h>
+  #define STATE_EPOCH_SEED esp_random()
+#else
+  #define STATE_EPOCH_SEED RANDOM_REG32
+#endif
+
 GroupStateStore::GroupStateStore(const size_t maxSize, const size_t flushRate)
   : cache(GroupStateCache(maxSize)),
     flushRate(flushRate),
-    lastFlush(0)
+    lastFlush(0),
+    epoch(STATE_EPOCH_SEED),
+    changeSequence(0),
+    evictedVersion(0)
 { }
 
 GroupState* GroupStateStore::get(const BulbId& id) {
-  GroupState* state = cache.get(id);
+  GroupCacheNode* node = getNode(id);
+  return node == nullptr ? nullptr : &node->state;
+}
+
+GroupCacheNode* GroupStateStore::getNode(const BulbId& id) {
+  GroupCacheNode* node = cache.getNode(id);
 
-  if (state == nullptr) {
+  if (node == nullptr) {
 #if STATE_DEBUG
     printf(
       "Couldn't fetch state for 0x%04X / %d / %s in the cache, getting it from persistence\n",
@@ -29,10 +44,13 @@ GroupState* GroupStateStore::get(const BulbId& id) {
     }
 
     GroupStatePersistence::get(id, loadedState);
-    state = cache.set(id, loadedState);
+
+    // Loading from flash isn't a change.  The current sequence is still a safe
+    // version: any earlier change to this state has a version <= the sequence.
+    node = cache.setNode(id, loadedState, changeSequence);
   }
 
-  return state;
+  return node;
 }
 
 GroupState* GroupStateStore::get(const uint16_t deviceId, const uint8_t groupId, const MiLightRemoteType deviceType) {
@@ -52,8 +70,14 @@ GroupState* GroupStateStore::get(const uint16_t deviceId, const uint8_t groupId,
 //
 GroupState* GroupStateStore::set(const BulbId &id, const GroupState& state) {
   BulbId otherId(id);
-  GroupState* storedState = get(id);
-  storedState->patch(state);
+  GroupCacheNode* storedNode = getNode(id);
+
+  if (storedNode == nullptr) {
+    return nullptr;
+  }
+
+  GroupState* storedState = &storedNode->state;
+  patchNode(storedNode, state);
 
   if (id.groupId == 0) {
     const MiLightRemoteConfig* remote = MiLightRemoteConfig::fromType(id.deviceType);
@@ -66,14 +90,15 @@ GroupState* GroupStateStore::set(const BulbId &id, const GroupState& state) {
     for (size_t i = 1; i <= remote->numGroups; i++) {
       otherId.groupId = i;
 
-      GroupState* individualState = get(otherId);
-      individualState->patch(state);
+      patchNode(getNode(otherId), state);
     }
   } else {
     otherId.groupId = 0;
-    GroupState* group0State = get(otherId);
+    GroupCacheNode* group0Node = getNode(otherId);
 
-    group0State->clearNonMatchingFields(state);
+    if (group0Node->state.clearNonMatchingFields(state)) {
+      group0Node->version = ++changeSequence;
+    }
   }
 
   return storedState;
@@ -85,18 +110,59 @@ GroupState* GroupStateStore::set(const uint16_t deviceId, const uint8_t groupId,
 }
 
 void GroupStateStore::clear(const BulbId& bulbId) {
-  GroupState* state = get(bulbId);
+  GroupCacheNode* node = getNode(bulbId);
 
-  if (state != nullptr) {
-    state->initFields();
-    state->patch(GroupState::defaultState(bulbId.deviceType));
+  if (node != nullptr) {
+    node->state.initFields();
+    node->state.patch(GroupState::defaultState(bulbId.deviceType));
+    node->version = ++changeSequence;
   }
 }
 
+void GroupStateStore::patchNode(GroupCacheNode* node, const GroupState& state) {
+  const GroupState previous = node->state;
+  node->state.patch(state);
+
+  if (! node->state.isEqualIgnoreDirty(previous)) {
+    node->version = ++changeSequence;
+  }
+}
+
+uint32_t GroupStateStore::getChangeSequence() const {
+  return changeSequence;
+}
+
+uint32_t GroupStateStore::getEpoch() const {
+  return epoch;
+}
+
+uint32_t GroupStateStore::getVersion(const BulbId& id) {
+  const GroupCacheNode* node = getNode(id);
+  return node == nullptr ? 0 : node->version;
+}
+
+bool GroupStateStore::forEachChangedSince(const uint32_t epoch, const uint32_t sequence, const GroupStateVisitor& visitor) {
+  // A sequence from before a restart says nothing about what changed since
+  const bool sameEpoch = epoch == this->epoch;
+  const uint32_t since = sameEpoch ? sequence : 0;
+
+  for (const ListNode<GroupCacheNode*>* curr = cache.getHead(); curr != nullptr; curr = curr->next) {
+    if (curr->data->version > since) {
+      visitor(curr->data->id, curr->data->state, curr->data->version);
+    }
+  }
+
+  return sameEpoch && sequence >= evictedVersion && sequence <= changeSequence;
+}
+
 void GroupStateStore::trackEviction() {
   if (cache.isFull()) {
     evictedIds.add(cache.getLru());
 
+    if (const uint32_t lruVersion = cache.getLruVersion(); lruVersion > evictedVersion) {
+      evictedVersion = lruVersion;
+    }
+
 #ifdef STATE_DEBUG
     BulbId bulbId = evictedIds.getLast();
     printf(
@@ -148,3 +214,7 @@ void GroupStateStore::limitedFlush() {
     }
   }
 }
+
+GroupStateCacheStats GroupStateStore::getCacheStats() const {
+  return cache.getStats();
+}
@@ -3,6 +3,9 @@
 #include <GroupState.h>
 #include <GroupStateCache.h>
 #include <GroupStatePersistence.h>
+#include <functional>
+
+typedef std::function<void(const BulbId& id, const GroupState& state, uint32_t version)> GroupStateVisitor;
 
 class GroupStateStore {
 public:
@@ -39,12 +42,39 @@ public:
    */
   void limitedFlush();
 
+  /*
+   * Every change to a stored state bumps a global change sequence, and the
+   * state's version is set to the new sequence value.  Versions are only
+   * meaningful within an epoch, which is picked at random when the store is
+   * created (i.e., on boot or when settings are reloaded).
+   */
+  uint32_t getChangeSequence() const;
+  uint32_t getEpoch() const;
+  uint32_t getVersion(const BulbId& id);
+
+  /*
+   * Calls the visitor for every cached state that changed after the provided
+   * sequence number, which was read in the provided epoch.  Returns false if
+   * changes may have been missed because states were evicted from the cache,
+   * in which case the caller should re-fetch everything.  If the sequence is
+   * from a different epoch, every cached state is visited and false is
+   * returned.
+   */
+  bool forEachChangedSince(uint32_t epoch, uint32_t sequence, const GroupStateVisitor& visitor);
+
+  GroupStateCacheStats getCacheStats() const;
+
 private:
   GroupStateCache cache;
   GroupStatePersistence persistence;
   LinkedList<BulbId> evictedIds;
   const size_t flushRate;
   unsigned long lastFlush;
+  const uint32_t epoch;
+  uint32_t changeSequence;
+  uint32_t evictedVersion;
 
+  GroupCacheNode* getNode(const BulbId& id);
+  void patchNode(GroupCacheNode* node, const GroupState& state);
   void trackEviction();
 };
@@ -0,0 +1,351 @@
+#include <SceneManager.h>
+#include <IntParsing.h>
+#include <algorithm>
+
+// A scene's program size is stored in two bytes
+static_assert(
+  SceneProgram::HEADER_SIZE
+    + MILIGHT_MAX_SCENE_BULBS * SceneProgram::BULB_SIZE
+    + MILIGHT_MAX_SCENE_PACKETS * (2 + MILIGHT_MAX_PACKET_LENGTH) <= UINT16_MAX,
+  "MILIGHT_MAX_SCENE_PACKETS is too large to store"
+);
+
+SceneManager::SceneManager(
+  Settings& settings,
+  MiLightClient*& milightClient,
+  PacketSender*& packetSender,
+  TransitionController& transitions
+) : settings(settings)
+  , milightClient(milightClient)
+  , packetSender(packetSender)
+  , transitions(transitions)
+  , recallOffset(0)
+  , recallTransaction(PacketSender::NO_TRANSACTION)
+  , recalling(false)
+  , stats({0, 0})
+{ }
+
+bool SceneManager::isValidId(const char* id) {
+  const size_t length = id == nullptr ? 0 : strlen(id);
+
+  if (length == 0 || length > MILIGHT_MAX_SCENE_ID_LENGTH) {
+    return false;
+  }
+
+  for (size_t i = 0; i < length; ++i) {
+    if (! isalnum(id[i]) && id[i] != '_' && id[i] != '-') {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool SceneManager::parseBulb(const JsonObject bulb, BulbId& bulbId) const {
+  if (const char* alias = bulb[F("alias")]; alias != nullptr) {
+    const auto it = settings.groupIdAliases.find(alias);
+
+    if (it == settings.groupIdAliases.end()) {
+      return false;
+    }
+
+    bulbId = it->second.bulbId;
+    return true;
+  }
+
+  const char* typeName = bulb[GroupStateFieldNames::DEVICE_TYPE];
+  const MiLightRemoteConfig* remoteConfig = typeName == nullptr ? nullptr : MiLightRemoteConfig::fromType(typeName);
+
+  if (remoteConfig == nullptr
+    || ! bulb.containsKey(GroupStateFieldNames::DEVICE_ID)
+    || ! bulb.containsKey(GroupStateFieldNames::GROUP_ID)) {
+    return false;
+  }
+
+  const String deviceId = bulb[GroupStateFieldNames::DEVICE_ID];
+  bulbId = BulbId(parseInt<uint16_t>(deviceId), bulb[GroupStateFieldNames::GROUP_ID].as<uint8_t>(), remoteConfig->type);
+
+  return true;
+}
+
+bool SceneManager::compile(const JsonArray bulbs, SceneProgram& program, JsonDocument& response) const {
+  program.clear();
+
+  if (bulbs.isNull() || bulbs.size() == 0) {
+    response[F("error")] = F("Scene must specify at least one bulb");
+    return false;
+  }
+
+  for (const JsonObject bulb : bulbs) {
+    BulbId bulbId;
+
+    if (! parseBulb(bulb, bulbId)) {
+      response[F("error")] = F("Each bulb must specify a known alias, or device_id, group_id and a known device_type");
+      return false;
+    }
+
+    const JsonObject state = bulb[F("state")];
+
+    if (state.isNull()) {
+      response[F("error")] = F("Each bulb must specify a state");
+      return false;
+    }
+
+    const CommandPlan plan = milightClient->planUpdate(state);
+
+    if (plan.hasTransition() || ! plan.command.isNull() || ! plan.commands.isNull() || plan.hasRawCommand) {
+      response[F("error")] = F("Scene states can't include transitions or commands");
+      return false;
+    }
+
+    const uint8_t repeats = bulb[F("repeats")] | 0;
+    bool full = ! program.addBulb(bulbId);
+
+    milightClient->capture(bulbId, plan, [&program, &full, repeats](const uint8_t* packet, const MiLightRemoteConfig& config) {
+      if (program.getNumPackets() >= MILIGHT_MAX_SCENE_PACKETS) {
+        full = true;
+      } else {
+        program.addPacket(config, packet, repeats);
+      }
+    });
+
+    if (full) {
+      response[F("error")] = F("Scene takes too many packets");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void SceneManager::scan(File& file, const std::function<bool(const char* id, size_t size)>& visitor) {
+  char id[MILIGHT_MAX_SCENE_ID_LENGTH + 1];
+
+  while (file.available()) {
+    const int idLength = file.read();
+    uint8_t size[2];
+
+    if (idLength <= 0
+      || idLength > MILIGHT_MAX_SCENE_ID_LENGTH
+      || file.readBytes(id, idLength) != static_cast<size_t>(idLength)
+      || file.readBytes(size, 2) != 2) {
+      Serial.println(F("SceneManager - ERROR: scenes file is corrupt"));
+      return;
+    }
+    id[idLength] = 0;
+
+    const size_t programSize = size[0] | (size[1] << 8);
+    const size_t programStart = file.position();
+
+    if (! visitor(id, programSize)) {
+      return;
+    }
+
+    file.seek(programStart + programSize);
+  }
+}
+
+void SceneManager::copyScenes(File& out, const char* skipId) {
+  File in = ProjectFS.open(SCENES_FILE, "r");
+
+  if (! in) {
+    return;
+  }
+
+  scan(in, [&in, &out, skipId](const char* id, size_t size) {
+    if (strcmp(id, skipId) == 0) {
+      return true;
+    }
+
+    const uint8_t idLength = strlen(id);
+    const uint8_t header[2] = { static_cast<uint8_t>(size & 0xFF), static_cast<uint8_t>(size >> 8) };
+    out.write(idLength);
+    out.write(reinterpret_cast<const uint8_t*>(id), idLength);
+    out.write(header, 2);
+
+    uint8_t buffer[64];
+    while (size > 0) {
+      const size_t read = in.readBytes(buffer, std::min(size, sizeof(buffer)));
+
+      if (read == 0) {
+        break;
+      }
+
+      out.write(buffer, read);
+      size -= read;
+    }
+
+    return true;
+  });
+
+  in.close();
+}
+
+bool SceneManager::commitScenes() {
+  // Atomic where the filesystem replaces an existing file on rename (LittleFS).  SPIFFS
+  // refuses, so the old file has to go first; recoverScenes covers a reset in between.
+  if (ProjectFS.rename(SCENES_TEMP_FILE, SCENES_FILE)) {
+    return true;
+  }
+
+  ProjectFS.remove(SCENES_FILE);
+  return ProjectFS.rename(SCENES_TEMP_FILE, SCENES_FILE);
+}
+
+void SceneManager::recoverScenes() {
+  if (! ProjectFS.exists(SCENES_FILE) && ProjectFS.exists(SCENES_TEMP_FILE)) {
+    Serial.println(F("SceneManager - recovering scenes from temp file"));
+    ProjectFS.rename(SCENES_TEMP_FILE, SCENES_FILE);
+  }
+}
+
+bool SceneManager::save(const char* id, const SceneProgram& program) const {
+  const size_t size = program.getSize();
+
+  if (! isValidId(id) || size > UINT16_MAX) {
+    return false;
+  }
+
+  recoverScenes();
+
+  File out = ProjectFS.open(SCENES_TEMP_FILE, "w");
+
+  if (! out) {
+    Serial.println(F("SceneManager - ERROR: could not open scenes file for writing"));
+    return false;
+  }
+
+  copyScenes(out, id);
+
+  const uint8_t idLength = strlen(id);
+  const uint8_t header[2] = { static_cast<uint8_t>(size & 0xFF), static_cast<uint8_t>(size >> 8) };
+  out.write(idLength);
+  out.write(reinterpret_cast<const uint8_t*>(id), idLength);
+  out.write(header, 2);
+  program.dump(out);
+  out.close();
+
+  return commitScenes();
+}
+
+bool SceneManager::load(const char* id, SceneProgram& program) const {
+  recoverScenes();
+
+  File file = ProjectFS.open(SCENES_FILE, "r");
+  bool found = false;
+
+  if (! file) {
+    return false;
+  }
+
+  scan(file, [&file, &program, &found, id](const char* sceneId, const size_t size) {
+    if (strcmp(sceneId, id) != 0) {
+      return true;
+    }
+
+    found = program.load(file, size);
+    return false;
+  });
+
+  file.close();
+  return found;
+}
+
+bool SceneManager::remove(const char* id) const {
+  SceneProgram program;
+
+  if (! load(id, program)) {
+    return false;
+  }
+
+  File out = ProjectFS.open(SCENES_TEMP_FILE, "w");
+
+  if (! out) {
+    return false;
+  }
+
+  copyScenes(out, id);
+  out.close();
+
+  return commitScenes();
+}
+
+void SceneManager::forEach(const SceneVisitor& visitor) const {
+  recoverScenes();
+
+  File file = ProjectFS.open(SCENES_FILE, "r");
+  SceneProgram program;
+
+  if (! file) {
+    return;
+  }
+
+  scan(file, [&file, &program, &visitor](const char* id, const size_t size) {
+    if (program.load(file, size)) {
+      visitor(id, program);
+    }
+    return true;
+  });
+
+  file.close();
+}
+
+bool SceneManager::recall(const char* id) {
+  if (! load(id, recallProgram)) {
+    return false;
+  }
+
+  RedundantCommandFilter* redundantCommands = milightClient == nullptr ? nullptr : &milightClient->getRedundantCommandFilter();
+
+  for (const BulbId& bulbId : recallProgram.getBulbs()) {
+    // The scene sets these bulbs directly, so anything fading on them is stale
+    transitions.cancelTransitions(bulbId, Transition::FIELD_BIT_ALL);
+
+    // Known state for these bulbs can't be trusted until their packets are sent
+    if (redundantCommands != nullptr && redundantCommands->isEnabled()) {
+      redundantCommands->queued(bulbId);
+    }
+  }
+
+  recallOffset = 0;
+  recallTransaction = PacketSender::NO_TRANSACTION;
+  recalling = true;
+  stats.recalls++;
+
+  loop();
+  return true;
+}
+
+void SceneManager::loop() {
+  if (! recalling || packetSender == nullptr) {
+    return;
+  }
+
+  SceneProgram::Packet packet;
+
+  while (packetSender->queueLength() + MILIGHT_SCENE_QUEUE_RESERVE < MILIGHT_MAX_QUEUED_PACKETS) {
+    if (! recallProgram.nextPacket(recallOffset, packet)) {
+      recalling = false;
+      recallProgram.clear();
+      return;
+    }
+
+    // A command begun since the scene's packets were last queued would otherwise wait for
+    // every scene packet queued after it, so later ones get a transaction of their own
+    if (recallTransaction == PacketSender::NO_TRANSACTION || packetSender->lastTransaction() != recallTransaction) {
+      recallTransaction = packetSender->beginTransaction();
+    }
+
+    // Restamped as they're sent, since they carry the sequence number they were compiled with
+    packetSender->enqueue(packet.packet, packet.remoteConfig, packet.repeats, recallTransaction, true);
+    stats.packetsSent++;
+  }
+}
+
+bool SceneManager::isRecalling() const {
+  return recalling;
+}
+
+const SceneStats& SceneManager::getStats() const {
+  return stats;
+}
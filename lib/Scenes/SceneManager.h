@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <MiLightClient.h>
+#include <PacketSender.h>
+#include <Settings.h>
+#include <TransitionController.h>
+#include <SceneProgram.h>
+#include <ProjectFS.h>
+#include <functional>
+
+#define SCENES_FILE "/scenes.bin"
+#define SCENES_TEMP_FILE "/scenes.tmp"
+
+#ifndef MILIGHT_MAX_SCENE_ID_LENGTH
+#define MILIGHT_MAX_SCENE_ID_LENGTH 24
+#endif
+
+// Packets it takes to set one bulb, at most.  CCT bulbs take the most: up to 21 each for
+// brightness and temperature, since they're driven down to the minimum and back up, plus one
+// to switch them on.  Other types set each field with one packet.
+#define MILIGHT_SCENE_PACKETS_PER_FIELD 21
+#define MILIGHT_SCENE_PACKETS_PER_BULB (2 * MILIGHT_SCENE_PACKETS_PER_FIELD + 1)
+
+// Bulbs a scene can always hold, even if every one is a CCT bulb.  Scenes of other types can
+// hold more, up to MILIGHT_MAX_SCENE_PACKETS in all.
+#ifndef MILIGHT_MAX_SCENE_BULBS
+#define MILIGHT_MAX_SCENE_BULBS 12
+#endif
+
+#ifndef MILIGHT_MAX_SCENE_PACKETS
+#define MILIGHT_MAX_SCENE_PACKETS (MILIGHT_MAX_SCENE_BULBS * MILIGHT_SCENE_PACKETS_PER_BULB)
+#endif
+
+// Queue slots left free while a scene is being recalled, so commands sent meanwhile aren't
+// dropped
+#ifndef MILIGHT_SCENE_QUEUE_RESERVE
+#define MILIGHT_SCENE_QUEUE_RESERVE 4
+#endif
+
+struct SceneStats {
+  size_t recalls;
+  size_t packetsSent;
+};
+
+/*
+ * Stored scenes.  A scene is a state for each of a set of bulbs, compiled once into the
+ * packets that set it (see SceneProgram).  Recalling it streams those packets into the
+ * PacketSender as the queue has room, without parsing JSON or building packets again.
+ *
+ * Packets are compiled without looking at the bulbs' state, so they set every field from
+ * scratch.  Scene states can't include transitions or commands.
+ */
+class SceneManager {
+public:
+  typedef std::function<void(const char* id, const SceneProgram& program)> SceneVisitor;
+
+  SceneManager(
+    Settings& settings,
+    MiLightClient*& milightClient,
+    PacketSender*& packetSender,
+    TransitionController& transitions
+  );
+
+  // Compiles a list of bulbs, each with an alias (or device_id, group_id and device_type) and
+  // a state.  Sets "error" in response and returns false if the scene isn't valid.
+  bool compile(JsonArray bulbs, SceneProgram& program, JsonDocument& response) const;
+
+  bool save(const char* id, const SceneProgram& program) const;
+  bool load(const char* id, SceneProgram& program) const;
+  bool remove(const char* id) const;
+  void forEach(const SceneVisitor& visitor) const;
+
+  // Starts sending the scene's packets.  Replaces a scene that's still being sent.
+  bool recall(const char* id);
+  void loop();
+  bool isRecalling() const;
+
+  const SceneStats& getStats() const;
+
+  static bool isValidId(const char* id);
+
+private:
+  Settings& settings;
+  MiLightClient*& milightClient;
+  PacketSender*& packetSender;
+  TransitionController& transitions;
+
+  SceneProgram recallProgram;
+  size_t recallOffset;
+  // Shared by the scene's packets, so what they change is published once instead of once per
+  // packet
+  uint32_t recallTransaction;
+  bool recalling;
+  SceneStats stats;
+
+  bool parseBulb(JsonObject bulb, BulbId& bulbId) const;
+
+  // Calls visitor with the ID and size of each stored scene.  The file is positioned at the
+  // start of the scene's program.  Stops early if the visitor returns false.
+  static void scan(File& file, const std::function<bool(const char* id, size_t size)>& visitor);
+  // Copies every stored scene except the one with the given ID
+  static void copyScenes(File& out, const char* skipId);
+  // Replaces the scenes file with the temp file just written
+  static bool commitScenes();
+  // Finishes a replace that was cut off by a reset, between removing the scenes file and
+  // renaming the temp file over it
+  static void recoverScenes();
+};
@@ -0,0 +1,137 @@
+#include <SceneProgram.h>
+
+SceneProgram::SceneProgram()
+  : numPackets(0)
+{ }
+
+void SceneProgram::clear() {
+  bulbs.clear();
+  packets.clear();
+  numPackets = 0;
+}
+
+bool SceneProgram::addBulb(const BulbId& bulbId) {
+  if (bulbs.size() >= UINT8_MAX) {
+    return false;
+  }
+
+  bulbs.push_back(bulbId);
+  return true;
+}
+
+bool SceneProgram::addPacket(const MiLightRemoteConfig& remoteConfig, const uint8_t* packet, const uint8_t repeats) {
+  if (numPackets >= UINT16_MAX) {
+    return false;
+  }
+
+  packets.push_back(static_cast<uint8_t>(remoteConfig.type));
+  packets.push_back(repeats);
+  packets.insert(packets.end(), packet, packet + remoteConfig.packetFormatter->getPacketLength());
+  numPackets++;
+
+  return true;
+}
+
+const std::vector<BulbId>& SceneProgram::getBulbs() const {
+  return bulbs;
+}
+
+size_t SceneProgram::getNumPackets() const {
+  return numPackets;
+}
+
+bool SceneProgram::nextPacket(size_t& offset, Packet& packet) const {
+  if (offset + 2 > packets.size()) {
+    return false;
+  }
+
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(static_cast<MiLightRemoteType>(packets[offset]));
+
+  if (remoteConfig == nullptr) {
+    return false;
+  }
+
+  const size_t packetLength = remoteConfig->packetFormatter->getPacketLength();
+
+  if (offset + 2 + packetLength > packets.size()) {
+    return false;
+  }
+
+  packet.remoteConfig = remoteConfig;
+  packet.repeats = packets[offset + 1];
+  packet.packet = &packets[offset + 2];
+  offset += 2 + packetLength;
+
+  return true;
+}
+
+size_t SceneProgram::getSize() const {
+  return HEADER_SIZE + bulbs.size() * BULB_SIZE + packets.size();
+}
+
+void SceneProgram::dump(Print& out) const {
+  const uint8_t header[HEADER_SIZE] = {
+    VERSION,
+    static_cast<uint8_t>(bulbs.size()),
+    static_cast<uint8_t>(numPackets & 0xFF),
+    static_cast<uint8_t>(numPackets >> 8)
+  };
+  out.write(header, HEADER_SIZE);
+
+  for (const BulbId& bulbId : bulbs) {
+    const uint8_t bulb[BULB_SIZE] = {
+      static_cast<uint8_t>(bulbId.deviceId & 0xFF),
+      static_cast<uint8_t>(bulbId.deviceId >> 8),
+      bulbId.groupId,
+      static_cast<uint8_t>(bulbId.deviceType)
+    };
+    out.write(bulb, BULB_SIZE);
+  }
+
+  out.write(packets.data(), packets.size());
+}
+
+bool SceneProgram::load(Stream& in, const size_t size) {
+  clear();
+
+  uint8_t header[HEADER_SIZE];
+  if (size < HEADER_SIZE || in.readBytes(header, HEADER_SIZE) != HEADER_SIZE || header[0] != VERSION) {
+    return false;
+  }
+
+  const size_t numBulbs = header[1];
+
+  if (size < HEADER_SIZE + numBulbs * BULB_SIZE) {
+    return false;
+  }
+
+  for (size_t i = 0; i < numBulbs; ++i) {
+    uint8_t bulb[BULB_SIZE];
+
+    if (in.readBytes(bulb, BULB_SIZE) != BULB_SIZE) {
+      return false;
+    }
+
+    bulbs.emplace_back(bulb[0] | (bulb[1] << 8), bulb[2], static_cast<MiLightRemoteType>(bulb[3]));
+  }
+
+  const size_t packetsSize = size - HEADER_SIZE - numBulbs * BULB_SIZE;
+  packets.resize(packetsSize);
+  if (in.readBytes(packets.data(), packetsSize) != packetsSize) {
+    clear();
+    return false;
+  }
+  numPackets = header[2] | (header[3] << 8);
+
+  // Make sure every packet can be read
+  size_t offset = 0;
+  Packet packet;
+  for (size_t i = 0; i < numPackets; ++i) {
+    if (! nextPacket(offset, packet)) {
+      clear();
+      return false;
+    }
+  }
+
+  return offset == packets.size();
+}
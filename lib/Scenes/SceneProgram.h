@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <BulbId.h>
+#include <MiLightRemoteConfig.h>
+#include <vector>
+
+/*
+ * A scene compiled to the packets that recall it.  Written to flash as:
+ *
+ *   version (1) | number of bulbs (1) | number of packets (2)
+ *   for each bulb:   device ID (2) | group ID (1) | remote type (1)
+ *   for each packet: remote type (1) | repeats (1, 0 for the default) | packet
+ *
+ * Packet length depends on the remote type.  Packets are kept as they were built, and get a
+ * new sequence number and checksum from PacketFormatter::restampPacket() each time they're
+ * sent.
+ */
+class SceneProgram {
+public:
+  static constexpr uint8_t VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 4;
+  static constexpr size_t BULB_SIZE = 4;
+
+  struct Packet {
+    const MiLightRemoteConfig* remoteConfig;
+    uint8_t repeats;
+    const uint8_t* packet;
+  };
+
+  SceneProgram();
+
+  void clear();
+  // Returns false if the program is full
+  bool addBulb(const BulbId& bulbId);
+  bool addPacket(const MiLightRemoteConfig& remoteConfig, const uint8_t* packet, uint8_t repeats);
+
+  const std::vector<BulbId>& getBulbs() const;
+  size_t getNumPackets() const;
+
+  // Reads the packet at offset, and moves offset to the one after it.  Start with offset 0.
+  bool nextPacket(size_t& offset, Packet& packet) const;
+
+  // Size in bytes, as written by dump()
+  size_t getSize() const;
+  void dump(Print& out) const;
+  // Reads a program of the given size written by dump().  Returns false if it isn't valid.
+  bool load(Stream& in, size_t size);
+
+private:
+  std::vector<BulbId> bulbs;
+  std::vector<uint8_t> packets;
+  uint16_t numPackets;
+};
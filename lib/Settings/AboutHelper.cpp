@@ -1,6 +1,7 @@
 #include <AboutHelper.h>
 #include <ArduinoJson.h>
 #include <Settings.h>
+#include <ExtMemory.h>
 
 #ifdef ESP8266
 #include <ESP8266WiFi.h>
@@ -46,6 +47,9 @@ void AboutHelper::generateAboutObject(JsonDocument &obj, bool abbreviated) {
   if (!abbreviated) {
     obj[FPSTR("variant")] = QUOTE(FIRMWARE_VARIANT);
     obj[FPSTR("free_heap")] = ESP.getFreeHeap();
+    if (ExtMemory::isAvailable()) {
+      obj[FPSTR("free_psram")] = ExtMemory::getFree();
+    }
 #ifdef ESP8266
     obj[FPSTR("arduino_version")] = ESP.getCoreVersion();
     obj[FPSTR("free_stack")] = cont_get_free_stack(g_pcont);
@@ -88,6 +88,8 @@ void Settings::patch(const JsonObject parsedSettings) {
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::MQTT_UPDATE_TOPIC_PATTERN), mqttUpdateTopicPattern);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::MQTT_STATE_TOPIC_PATTERN), mqttStateTopicPattern);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::MQTT_CLIENT_STATUS_TOPIC), mqttClientStatusTopic);
+  this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::MQTT_TRANSITION_TOPIC), mqttTransitionTopic);
+  this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::MQTT_SCENE_TOPIC), mqttSceneTopic);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::SIMPLE_MQTT_CLIENT_STATUS), simpleMqttClientStatus);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::DISCOVERY_PORT), discoveryPort);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::LISTEN_REPEATS), listenRepeats);
@@ -99,6 +101,11 @@ void Settings::patch(const JsonObject parsedSettings) {
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::PACKET_REPEAT_THROTTLE_SENSITIVITY), packetRepeatThrottleSensitivity);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::PACKET_REPEAT_MINIMUM), packetRepeatMinimum);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::ENABLE_AUTOMATIC_MODE_SWITCHING), enableAutomaticModeSwitching);
+  this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::SUPPRESS_REDUNDANT_COMMANDS), suppressRedundantCommands);
+  this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::REDUNDANT_COMMAND_WINDOW), redundantCommandWindow);
+  this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::HTTP_COMMAND_DEBOUNCE), httpCommandDebounce);
+  this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::MQTT_COMMAND_DEBOUNCE), mqttCommandDebounce);
+  this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::UDP_COMMAND_DEBOUNCE), udpCommandDebounce);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::LED_MODE_PACKET_COUNT), ledModePacketCount);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::HOSTNAME), hostname);
   this->setIfPresent(parsedSettings, FPSTR(SettingsKeys::WIFI_STATIC_IP), wifiStaticIP);
@@ -165,7 +172,7 @@ void Settings::patch(const JsonObject parsedSettings) {
   }
 }
 
-std::map<String, GroupAlias>::const_iterator Settings::findAlias(const MiLightRemoteType deviceType, const uint16_t deviceId, const uint8_t groupId) {
+GroupAliasMap::const_iterator Settings::findAlias(const MiLightRemoteType deviceType, const uint16_t deviceId, const uint8_t groupId) {
   const BulbId searchId{ deviceId, groupId, deviceType };
 
   for (auto it = groupIdAliases.begin(); it != groupIdAliases.end(); ++it) {
@@ -323,6 +330,8 @@ void Settings::serialize(Print& stream, const bool prettyPrint) const {
   root[FPSTR(SettingsKeys::MQTT_UPDATE_TOPIC_PATTERN)] = this->mqttUpdateTopicPattern;
   root[FPSTR(SettingsKeys::MQTT_STATE_TOPIC_PATTERN)] = this->mqttStateTopicPattern;
   root[FPSTR(SettingsKeys::MQTT_CLIENT_STATUS_TOPIC)] = this->mqttClientStatusTopic;
+  root[FPSTR(SettingsKeys::MQTT_TRANSITION_TOPIC)] = this->mqttTransitionTopic;
+  root[FPSTR(SettingsKeys::MQTT_SCENE_TOPIC)] = this->mqttSceneTopic;
   root[FPSTR(SettingsKeys::SIMPLE_MQTT_CLIENT_STATUS)] = this->simpleMqttClientStatus;
   root[FPSTR(SettingsKeys::DISCOVERY_PORT)] = this->discoveryPort;
   root[FPSTR(SettingsKeys::LISTEN_REPEATS)] = this->listenRepeats;
@@ -334,6 +343,11 @@ void Settings::serialize(Print& stream, const bool prettyPrint) const {
   root[FPSTR(SettingsKeys::PACKET_REPEAT_THROTTLE_THRESHOLD)] = this->packetRepeatThrottleThreshold;
   root[FPSTR(SettingsKeys::PACKET_REPEAT_MINIMUM)] = this->packetRepeatMinimum;
   root[FPSTR(SettingsKeys::ENABLE_AUTOMATIC_MODE_SWITCHING)] = this->enableAutomaticModeSwitching;
+  root[FPSTR(SettingsKeys::SUPPRESS_REDUNDANT_COMMANDS)] = this->suppressRedundantCommands;
+  root[FPSTR(SettingsKeys::REDUNDANT_COMMAND_WINDOW)] = this->redundantCommandWindow;
+  root[FPSTR(SettingsKeys::HTTP_COMMAND_DEBOUNCE)] = this->httpCommandDebounce;
+  root[FPSTR(SettingsKeys::MQTT_COMMAND_DEBOUNCE)] = this->mqttCommandDebounce;
+  root[FPSTR(SettingsKeys::UDP_COMMAND_DEBOUNCE)] = this->udpCommandDebounce;
   root[FPSTR(SettingsKeys::LED_MODE_WIFI_CONFIG)] = LEDStatus::LEDModeToString(this->ledModeWifiConfig);
   root[FPSTR(SettingsKeys::LED_MODE_WIFI_FAILED)] = LEDStatus::LEDModeToString(this->ledModeWifiFailed);
   root[FPSTR(SettingsKeys::LED_MODE_OPERATING)] = LEDStatus::LEDModeToString(this->ledModeOperating);
@@ -448,7 +462,7 @@ bool Settings::deleteAlias(const size_t id) {
   return false;
 }
 
-std::map<String, GroupAlias>::const_iterator Settings::findAliasById(const size_t id) {
+GroupAliasMap::const_iterator Settings::findAliasById(const size_t id) {
   for (auto it = groupIdAliases.begin(); it != groupIdAliases.end(); ++it) {
     if (it->second.id == id) {
       return it;
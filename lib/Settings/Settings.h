@@ -44,6 +44,12 @@
 #define MILIGHT_MAX_STATE_ITEMS 100
 #endif
 
+// Upper bound on cached states for boards with PSRAM.  The actual cache size
+// is picked at boot based on how much PSRAM is free.
+#ifndef MILIGHT_MAX_EXT_STATE_ITEMS
+#define MILIGHT_MAX_EXT_STATE_ITEMS 1000
+#endif
+
 #ifndef MILIGHT_MAX_STALE_MQTT_GROUPS
 #define MILIGHT_MAX_STALE_MQTT_GROUPS 10
 #endif
@@ -107,6 +113,8 @@ namespace SettingsKeys {
   static constexpr char MQTT_UPDATE_TOPIC_PATTERN[] PROGMEM = "mqtt_update_topic_pattern";
   static constexpr char MQTT_STATE_TOPIC_PATTERN[] PROGMEM = "mqtt_state_topic_pattern";
   static constexpr char MQTT_CLIENT_STATUS_TOPIC[] PROGMEM = "mqtt_client_status_topic";
+  static constexpr char MQTT_TRANSITION_TOPIC[] PROGMEM = "mqtt_transition_topic";
+  static constexpr char MQTT_SCENE_TOPIC[] PROGMEM = "mqtt_scene_topic";
   static constexpr char SIMPLE_MQTT_CLIENT_STATUS[] PROGMEM = "simple_mqtt_client_status";
   static constexpr char DISCOVERY_PORT[] PROGMEM = "discovery_port";
   static constexpr char LISTEN_REPEATS[] PROGMEM = "listen_repeats";
@@ -118,6 +126,11 @@ namespace SettingsKeys {
   static constexpr char PACKET_REPEAT_THROTTLE_SENSITIVITY[] PROGMEM = "packet_repeat_throttle_sensitivity";
   static constexpr char PACKET_REPEAT_MINIMUM[] PROGMEM = "packet_repeat_minimum";
   static constexpr char ENABLE_AUTOMATIC_MODE_SWITCHING[] PROGMEM = "enable_automatic_mode_switching";
+  static constexpr char SUPPRESS_REDUNDANT_COMMANDS[] PROGMEM = "suppress_redundant_commands";
+  static constexpr char REDUNDANT_COMMAND_WINDOW[] PROGMEM = "redundant_command_window";
+  static constexpr char HTTP_COMMAND_DEBOUNCE[] PROGMEM = "http_command_debounce";
+  static constexpr char MQTT_COMMAND_DEBOUNCE[] PROGMEM = "mqtt_command_debounce";
+  static constexpr char UDP_COMMAND_DEBOUNCE[] PROGMEM = "udp_command_debounce";
   static constexpr char LED_MODE_PACKET_COUNT[] PROGMEM = "led_mode_packet_count";
   static constexpr char HOSTNAME[] PROGMEM = "hostname";
   static constexpr char WIFI_STATIC_IP[] PROGMEM = "wifi_static_ip";
@@ -160,6 +173,8 @@ public:
     mqttTopicPattern("milight/commands/:device_id/:device_type/:group_id"),
     mqttStateTopicPattern("milight/state/:device_id/:device_type/:group_id"),
     mqttClientStatusTopic("milight/client_status"),
+    mqttTransitionTopic("milight/transitions"),
+    mqttSceneTopic("milight/scenes"),
     simpleMqttClientStatus(true),
     stateFlushInterval(10000),
     mqttStateRateLimit(500),
@@ -169,6 +184,11 @@ public:
     packetRepeatThrottleSensitivity(0),
     packetRepeatMinimum(3),
     enableAutomaticModeSwitching(false),
+    suppressRedundantCommands(false),
+    redundantCommandWindow(60000),
+    httpCommandDebounce(0),
+    mqttCommandDebounce(0),
+    udpCommandDebounce(0),
     ledModeWifiConfig(LEDStatus::LEDMode::FastToggle),
     ledModeWifiFailed(LEDStatus::LEDMode::On),
     ledModeOperating(LEDStatus::LEDMode::SlowBlip),
@@ -210,8 +230,8 @@ public:
   void patch(JsonObject parsedSettings);
   String mqttServer();
   [[nodiscard]] uint16_t mqttPort() const;
-  std::map<String, GroupAlias>::const_iterator findAlias(MiLightRemoteType deviceType, uint16_t deviceId, uint8_t groupId);
-  std::map<String, GroupAlias>::const_iterator findAliasById(size_t id);
+  GroupAliasMap::const_iterator findAlias(MiLightRemoteType deviceType, uint16_t deviceId, uint8_t groupId);
+  GroupAliasMap::const_iterator findAliasById(size_t id);
   void addAlias(const char* alias, const BulbId& bulbId);
   bool deleteAlias(size_t id);
 
@@ -233,6 +253,8 @@ public:
   String mqttUpdateTopicPattern;
   String mqttStateTopicPattern;
   String mqttClientStatusTopic;
+  String mqttTransitionTopic;
+  String mqttSceneTopic;
   bool simpleMqttClientStatus;
   size_t stateFlushInterval;
   size_t mqttStateRateLimit;
@@ -242,6 +264,12 @@ public:
   size_t packetRepeatThrottleSensitivity;
   size_t packetRepeatMinimum;
   bool enableAutomaticModeSwitching;
+  bool suppressRedundantCommands;
+  size_t redundantCommandWindow;
+  // Minimum milliseconds between commands for the same field of a bulb, by source.  0 disables.
+  size_t httpCommandDebounce;
+  size_t mqttCommandDebounce;
+  size_t udpCommandDebounce;
   LEDStatus::LEDMode ledModeWifiConfig;
   LEDStatus::LEDMode ledModeWifiFailed;
   LEDStatus::LEDMode ledModeOperating;
@@ -258,7 +286,7 @@ public:
   String wifiStaticIPNetmask;
   String wifiStaticIPGateway;
   size_t packetRepeatsPerLoop;
-  std::map<String, GroupAlias> groupIdAliases;
+  GroupAliasMap groupIdAliases;
   std::map<uint32_t, BulbId> deletedGroupIdAliases;
   String homeAssistantDiscoveryPrefix;
   WifiMode wifiMode;
@@ -16,6 +16,7 @@ ChangeFieldOnFinishTransition::Builder::Builder(
 std::shared_ptr<Transition> ChangeFieldOnFinishTransition::Builder::_build() const {
   delegate->setDurationRaw(this->getOrComputeDuration());
   delegate->setPeriod(this->getOrComputePeriod());
+  delegate->setEasing(this->getEasing());
 
   return std::make_shared<ChangeFieldOnFinishTransition>(
     delegate->build(),
@@ -41,6 +42,19 @@ bool ChangeFieldOnFinishTransition::isFinished() {
   return delegate->isFinished() && changeSent;
 }
 
+uint8_t ChangeFieldOnFinishTransition::getFieldBits() const {
+  return delegate->getFieldBits() | Transition::getFieldBits(field);
+}
+
+bool ChangeFieldOnFinishTransition::getFieldValue(const GroupStateField field, const bool atEnd, uint16_t& value) const {
+  if (atEnd && Transition::getFieldBits(field) == Transition::getFieldBits(this->field)) {
+    value = arg;
+    return true;
+  }
+
+  return delegate->getFieldValue(field, atEnd, value);
+}
+
 void ChangeFieldOnFinishTransition::step() {
   if (! delegate->isFinished()) {
     delegate->step();
@@ -50,6 +64,10 @@ void ChangeFieldOnFinishTransition::step() {
   }
 }
 
+bool ChangeFieldOnFinishTransition::skipStep() {
+  return ! delegate->isFinished() && delegate->skipStep();
+}
+
 void ChangeFieldOnFinishTransition::childSerialize(JsonObject& json) {
   json[F("type")] = F("change_on_finish");
   json[F("field")] = GroupStateFieldHelpers::getFieldName(field);
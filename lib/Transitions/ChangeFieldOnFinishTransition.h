@@ -25,6 +25,8 @@ public:
   );
 
   virtual bool isFinished() override;
+  uint8_t getFieldBits() const override;
+  bool getFieldValue(GroupStateField field, bool atEnd, uint16_t& value) const override;
 
 private:
   std::shared_ptr<Transition> delegate;
@@ -33,5 +35,6 @@ private:
   bool changeSent;
 
   virtual void step() override;
+  bool skipStep() override;
   virtual void childSerialize(JsonObject& json) override;
 };
@@ -26,7 +26,8 @@ std::shared_ptr<Transition> ColorTransition::Builder::_build() const {
     duration,
     period,
     numPeriods,
-    callback
+    callback,
+    getEasing()
   );
 }
 
@@ -60,19 +61,41 @@ ColorTransition::ColorTransition(
   const size_t duration,
   const size_t period,
   size_t numPeriods,
-  TransitionFn callback
+  TransitionFn callback,
+  const EasingCurve easing
 ) : Transition(id, bulbId, period, std::move(callback))
+  , startColor(startColor)
   , endColor(endColor)
-  , currentColor(startColor)
   , stepSizes(
       calculateStepSizePart(endColor.r - startColor.r, duration, period),
       calculateStepSizePart(endColor.g - startColor.g, duration, period),
       calculateStepSizePart(endColor.b - startColor.b, duration, period))
+  , easing(easing)
+  , numSteps(calculateNumSteps(startColor, endColor, stepSizes))
+  , currentStep(0)
+  , lastColor(startColor)
   , lastHue(400) // use impossible values to force a packet send
   , lastSaturation(200)
   , sentFinalColor(false)
 { }
 
+size_t ColorTransition::calculateNumSteps(const RgbColor& start, const RgbColor& end, const RgbColor& stepSizes) {
+  return std::max(
+    std::max(
+      calculateNumStepsPart(end.r - start.r, stepSizes.r),
+      calculateNumStepsPart(end.g - start.g, stepSizes.g)
+    ),
+    calculateNumStepsPart(end.b - start.b, stepSizes.b)
+  );
+}
+
+size_t ColorTransition::calculateNumStepsPart(const int16_t distance, const int16_t stepSize) {
+  if (distance == 0 || stepSize == 0) {
+    return 0;
+  }
+  return std::ceil(std::abs(distance / static_cast<float>(stepSize)));
+}
+
 size_t ColorTransition::calculateMaxDistance(const RgbColor& start, const RgbColor& end) {
   // return max distance between any of R/G/B
   return std::max(
@@ -99,8 +122,30 @@ int16_t ColorTransition::calculateStepSizePart(const int16_t distance, const siz
   return rounded;
 }
 
+ColorTransition::RgbColor ColorTransition::colorAt(const size_t step) const {
+  return {
+    partAt(startColor.r, endColor.r, stepSizes.r, step),
+    partAt(startColor.g, endColor.g, stepSizes.g, step),
+    partAt(startColor.b, endColor.b, stepSizes.b, step)
+  };
+}
+
+int16_t ColorTransition::partAt(const int16_t start, const int16_t end, const int16_t stepSize, const size_t step) const {
+  if (step >= numSteps) {
+    return end;
+  }
+  if (easing != EasingCurve::LINEAR) {
+    return start + Easing::interpolate(easing, end - start, step, numSteps);
+  }
+
+  // Each part moves at its own rate, and stops once it gets to the end
+  const int32_t moved = static_cast<int32_t>(step) * stepSize;
+  return std::abs(moved) >= std::abs(end - start) ? end : start + moved;
+}
+
 void ColorTransition::step() {
-  const ParsedColor parsedColor = ParsedColor::fromRgb(currentColor.r, currentColor.g, currentColor.b);
+  lastColor = colorAt(currentStep);
+  const ParsedColor parsedColor = ParsedColor::fromRgb(lastColor.r, lastColor.g, lastColor.b);
 
   if (parsedColor.hue != lastHue) {
     callback(bulbId, GroupStateField::HUE, parsedColor.hue);
@@ -112,22 +157,58 @@ void ColorTransition::step() {
     lastSaturation = parsedColor.saturation;
   }
 
-  if (!isFinished()) {
-    stepValue(currentColor.r, endColor.r, stepSizes.r);
-    stepValue(currentColor.g, endColor.g, stepSizes.g);
-    stepValue(currentColor.b, endColor.b, stepSizes.b);
+  if (currentStep < numSteps) {
+    ++currentStep;
   } else {
     this->sentFinalColor = true;
   }
 }
 
+bool ColorTransition::skipStep() {
+  if (currentStep >= numSteps) {
+    return false;
+  }
+
+  ++currentStep;
+  return true;
+}
+
 bool ColorTransition::isFinished() {
   return this->sentFinalColor;
 }
 
+uint8_t ColorTransition::getFieldBits() const {
+  return Transition::getFieldBits(GroupStateField::COLOR);
+}
+
+bool ColorTransition::getFieldValue(const GroupStateField field, const bool atEnd, uint16_t& value) const {
+  ParsedColor color;
+  getColorValue(atEnd, color);
+
+  if (field == GroupStateField::HUE) {
+    value = color.hue;
+    return true;
+  } else if (field == GroupStateField::SATURATION) {
+    value = color.saturation;
+    return true;
+  }
+
+  return false;
+}
+
+bool ColorTransition::getColorValue(const bool atEnd, ParsedColor& color) const {
+  // Close enough to the last color sent.  Within a step of it, at worst.
+  const RgbColor& rgb = atEnd ? endColor : lastColor;
+  color = ParsedColor::fromRgb(rgb.r, rgb.g, rgb.b);
+  return true;
+}
+
 void ColorTransition::childSerialize(JsonObject& json) {
   json[F("type")] = F("color");
 
+  json[F("easing")] = Easing::getName(easing);
+
+  const RgbColor currentColor = colorAt(currentStep);
   const JsonArray currentColorArr = json.createNestedArray(F("current_color"));
   currentColorArr.add(currentColor.r);
   currentColorArr.add(currentColor.g);
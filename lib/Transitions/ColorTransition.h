@@ -33,18 +33,28 @@ public:
     size_t duration,
     size_t period,
     size_t numPeriods,
-    TransitionFn callback
+    TransitionFn callback,
+    EasingCurve easing = EasingCurve::LINEAR
   );
 
   static size_t calculateColorPeriod(ColorTransition* t, const RgbColor& start, const RgbColor& end, size_t stepSize, size_t duration);
   inline static size_t calculateMaxDistance(const RgbColor& start, const RgbColor& end);
   inline static int16_t calculateStepSizePart(int16_t distance, size_t duration, size_t period);
   bool isFinished() override;
+  uint8_t getFieldBits() const override;
+  bool getFieldValue(GroupStateField field, bool atEnd, uint16_t& value) const override;
+  bool getColorValue(bool atEnd, ParsedColor& color) const override;
 
 protected:
+  const RgbColor startColor;
   const RgbColor endColor;
-  RgbColor currentColor;
-  RgbColor stepSizes;
+  const RgbColor stepSizes;
+  const EasingCurve easing;
+  // Steps after the first one.  The last step lands on endColor.
+  const size_t numSteps;
+  // Next step to send
+  size_t currentStep;
+  RgbColor lastColor;
 
   // Store these to avoid wasted packets
   uint16_t lastHue;
@@ -52,6 +62,10 @@ protected:
   bool sentFinalColor;
 
   void step() override;
+  bool skipStep() override;
   void childSerialize(JsonObject& json) override;
-  static inline void stepPart(uint16_t& current, uint16_t end, int16_t step);
+  RgbColor colorAt(size_t step) const;
+  int16_t partAt(int16_t start, int16_t end, int16_t stepSize, size_t step) const;
+  static size_t calculateNumSteps(const RgbColor& start, const RgbColor& end, const RgbColor& stepSizes);
+  static size_t calculateNumStepsPart(int16_t distance, int16_t stepSize);
 };
@@ -0,0 +1,109 @@
+#include <Easing.h>
+#include <Arduino.h>
+#include <cstring>
+
+// Curves sampled at 33 evenly spaced points, scaled so that 1.0 is 0xFFFF.  Values between
+// samples are interpolated linearly.
+static constexpr size_t CURVE_SEGMENT_BITS = 11;
+static constexpr uint16_t CURVE_SEGMENT_MASK = (1 << CURVE_SEGMENT_BITS) - 1;
+
+// t^2
+static const uint16_t EASE_IN_CURVE[] PROGMEM = {
+      0,    64,   256,   576,  1024,  1600,  2304,  3136,  4096,  5184,  6400,
+   7744,  9216, 10816, 12544, 14400, 16384, 18496, 20736, 23104, 25600, 28224,
+  30976, 33855, 36863, 39999, 43263, 46655, 50175, 53823, 57599, 61503, 65535
+};
+
+// 1 - (1-t)^2
+static const uint16_t EASE_OUT_CURVE[] PROGMEM = {
+      0,  4032,  7936, 11712, 15360, 18880, 22272, 25536, 28672, 31680, 34559,
+  37311, 39935, 42431, 44799, 47039, 49151, 51135, 52991, 54719, 56319, 57791,
+  59135, 60351, 61439, 62399, 63231, 63935, 64511, 64959, 65279, 65471, 65535
+};
+
+// 3t^2 - 2t^3
+static const uint16_t EASE_IN_OUT_CURVE[] PROGMEM = {
+      0,   188,   736,  1620,  2816,  4300,  6048,  8036, 10240, 12636, 15200,
+  17908, 20736, 23660, 26656, 29700, 32768, 35835, 38879, 41875, 44799, 47627,
+  50335, 52899, 55295, 57499, 59487, 61235, 62719, 63915, 64799, 65347, 65535
+};
+
+// t^2.2
+static const uint16_t GAMMA_CURVE[] PROGMEM = {
+      0,    32,   147,   359,   676,  1104,  1648,  2314,  3104,  4022,  5072,
+   6255,  7574,  9033, 10632, 12375, 14263, 16298, 18482, 20816, 23303, 25943,
+  28739, 31692, 34802, 38072, 41503, 45097, 48853, 52774, 56860, 61114, 65535
+};
+
+uint16_t Easing::apply(const EasingCurve curve, const uint16_t progress) {
+  const uint16_t* table;
+
+  switch (curve) {
+    case EasingCurve::EASE_IN:
+      table = EASE_IN_CURVE;
+      break;
+    case EasingCurve::EASE_OUT:
+      table = EASE_OUT_CURVE;
+      break;
+    case EasingCurve::EASE_IN_OUT:
+      table = EASE_IN_OUT_CURVE;
+      break;
+    case EasingCurve::GAMMA:
+      table = GAMMA_CURVE;
+      break;
+    default:
+      return progress;
+  }
+
+  const size_t ix = progress >> CURVE_SEGMENT_BITS;
+  const uint32_t frac = progress & CURVE_SEGMENT_MASK;
+  const int32_t from = pgm_read_word(&table[ix]);
+  const int32_t to = pgm_read_word(&table[ix + 1]);
+
+  return from + (((to - from) * static_cast<int32_t>(frac)) >> CURVE_SEGMENT_BITS);
+}
+
+int32_t Easing::interpolate(const EasingCurve curve, const int32_t distance, const size_t step, const size_t numSteps) {
+  if (numSteps == 0 || step >= numSteps) {
+    return distance;
+  }
+
+  const uint16_t progress = (static_cast<uint32_t>(step) * ONE) / numSteps;
+  const int32_t scaled = distance * apply(curve, progress);
+
+  // Round to nearest rather than toward zero
+  return (scaled + (scaled < 0 ? -(ONE / 2) : (ONE / 2))) / ONE;
+}
+
+EasingCurve Easing::parse(const char* name, const EasingCurve defaultValue) {
+  if (name == nullptr) {
+    return defaultValue;
+  } else if (strcmp(name, EasingCurveNames::LINEAR) == 0) {
+    return EasingCurve::LINEAR;
+  } else if (strcmp(name, EasingCurveNames::EASE_IN) == 0) {
+    return EasingCurve::EASE_IN;
+  } else if (strcmp(name, EasingCurveNames::EASE_OUT) == 0) {
+    return EasingCurve::EASE_OUT;
+  } else if (strcmp(name, EasingCurveNames::EASE_IN_OUT) == 0) {
+    return EasingCurve::EASE_IN_OUT;
+  } else if (strcmp(name, EasingCurveNames::GAMMA) == 0) {
+    return EasingCurve::GAMMA;
+  }
+
+  return defaultValue;
+}
+
+const char* Easing::getName(const EasingCurve curve) {
+  switch (curve) {
+    case EasingCurve::EASE_IN:
+      return EasingCurveNames::EASE_IN;
+    case EasingCurve::EASE_OUT:
+      return EasingCurveNames::EASE_OUT;
+    case EasingCurve::EASE_IN_OUT:
+      return EasingCurveNames::EASE_IN_OUT;
+    case EasingCurve::GAMMA:
+      return EasingCurveNames::GAMMA;
+    default:
+      return EasingCurveNames::LINEAR;
+  }
+}
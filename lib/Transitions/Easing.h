@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// How a transition's progress maps onto its value
+enum class EasingCurve {
+  LINEAR,
+  // Slow start, fast finish
+  EASE_IN,
+  // Fast start, slow finish
+  EASE_OUT,
+  // Slow start and finish
+  EASE_IN_OUT,
+  // Follows perceived brightness.  A linear brightness fade does most of its visible
+  // changing at the low end.  This spreads the change out evenly.
+  GAMMA
+};
+
+namespace EasingCurveNames {
+  static constexpr char LINEAR[] = "linear";
+  static constexpr char EASE_IN[] = "ease_in";
+  static constexpr char EASE_OUT[] = "ease_out";
+  static constexpr char EASE_IN_OUT[] = "ease_in_out";
+  static constexpr char GAMMA[] = "gamma";
+}
+
+/*
+ * Curves are precomputed as fixed-point lookup tables, so stepping a transition doesn't
+ * need any floating point math.  Progress and results are fractions scaled to [0, 0xFFFF].
+ */
+class Easing {
+public:
+  static constexpr uint16_t ONE = 0xFFFF;
+
+  static uint16_t apply(EasingCurve curve, uint16_t progress);
+
+  // Offset from the start value after step steps out of numSteps
+  static int32_t interpolate(EasingCurve curve, int32_t distance, size_t step, size_t numSteps);
+
+  static EasingCurve parse(const char* name, EasingCurve defaultValue);
+  static const char* getName(EasingCurve curve);
+};
@@ -41,7 +41,8 @@ std::shared_ptr<Transition> FieldTransition::Builder::_build() const {
     end,
     stepSize,
     period,
-    callback
+    callback,
+    getEasing()
   );
 }
 
@@ -53,33 +54,73 @@ FieldTransition::FieldTransition(
   uint16_t endValue,
   int16_t stepSize,
   size_t period,
-  TransitionFn callback
+  TransitionFn callback,
+  EasingCurve easing
 ) : Transition(id, bulbId, period, callback)
   , field(field)
-  , currentValue(startValue)
+  , startValue(startValue)
   , endValue(endValue)
   , stepSize(stepSize)
+  , easing(easing)
+  , numSteps(std::ceil(std::abs((endValue - startValue) / static_cast<float>(stepSize))))
+  , currentStep(0)
+  , lastValue(startValue)
   , finished(false)
 { }
 
+int16_t FieldTransition::valueAt(const size_t step) const {
+  if (step >= numSteps) {
+    return endValue;
+  }
+  if (easing == EasingCurve::LINEAR) {
+    return startValue + static_cast<int16_t>(step) * stepSize;
+  }
+
+  return startValue + Easing::interpolate(easing, endValue - startValue, step, numSteps);
+}
+
 void FieldTransition::step() {
-  callback(bulbId, field, currentValue);
+  const int16_t value = valueAt(currentStep);
+
+  // Curves flatten out at the ends, and can land on the same value more than once
+  if (currentStep == 0 || value != lastValue) {
+    callback(bulbId, field, value);
+  }
+  lastValue = value;
 
-  if (currentValue != endValue) {
-    Transition::stepValue(currentValue, endValue, stepSize);
+  if (currentStep < numSteps) {
+    ++currentStep;
   } else {
     finished = true;
   }
 }
 
+bool FieldTransition::skipStep() {
+  if (currentStep >= numSteps) {
+    return false;
+  }
+
+  ++currentStep;
+  return true;
+}
+
 bool FieldTransition::isFinished() {
   return finished;
 }
 
+uint8_t FieldTransition::getFieldBits() const {
+  return Transition::getFieldBits(field);
+}
+
+bool FieldTransition::getFieldValue(const GroupStateField field, const bool atEnd, uint16_t& value) const {
+  return convertFieldValue(this->field, atEnd ? endValue : lastValue, field, value);
+}
+
 void FieldTransition::childSerialize(JsonObject& json) {
   json[F("type")] = F("field");
   json[F("field")] = GroupStateFieldHelpers::getFieldName(field);
-  json[F("current_value")] = currentValue;
+  json[F("current_value")] = valueAt(currentStep);
   json[F("end_value")] = endValue;
   json[F("step_size")] = stepSize;
+  json[F("easing")] = Easing::getName(easing);
 }
\ No newline at end of file
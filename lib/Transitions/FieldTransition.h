@@ -28,18 +28,30 @@ public:
     uint16_t endValue,
     int16_t stepSize,
     size_t period,
-    TransitionFn callback
+    TransitionFn callback,
+    EasingCurve easing = EasingCurve::LINEAR
   );
 
   bool isFinished() override;
+  uint8_t getFieldBits() const override;
+  bool getFieldValue(GroupStateField field, bool atEnd, uint16_t& value) const override;
 
 private:
   const GroupStateField field;
-  int16_t currentValue;
+  const int16_t startValue;
   const int16_t endValue;
   const int16_t stepSize;
+  const EasingCurve easing;
+  // Steps after the first one.  The last step lands on endValue.
+  const size_t numSteps;
+  // Next step to send
+  size_t currentStep;
+  // Last value sent
+  int16_t lastValue;
   bool finished;
 
   void step() override;
+  bool skipStep() override;
   void childSerialize(JsonObject& json) override;
+  int16_t valueAt(size_t step) const;
 };
@@ -0,0 +1,122 @@
+#include <IncrementTransition.h>
+#include <Arduino.h>
+
+IncrementTransition::Builder::Builder(
+  const size_t id,
+  const uint16_t defaultPeriod,
+  const BulbId& bulbId,
+  const TransitionFn& callback,
+  const IncrementFn& incrementCallback,
+  const GroupStateField field,
+  const int8_t startStep,
+  const uint8_t endStep,
+  const uint8_t numIncrements,
+  const uint8_t numResets
+)
+  : Transition::Builder(
+      id,
+      defaultPeriod,
+      bulbId,
+      callback,
+      max(static_cast<size_t>(1), countCommands(startStep, endStep, numResets))
+  )
+  , incrementCallback(incrementCallback)
+  , field(field)
+  , startStep(startStep)
+  , endStep(endStep)
+  , numIncrements(numIncrements)
+  , numResets(numResets)
+{ }
+
+std::shared_ptr<Transition> IncrementTransition::Builder::_build() const {
+  const size_t period = max(getMinPeriod(), getOrComputeDuration() / getMaxSteps());
+
+  return std::make_shared<IncrementTransition>(
+    id,
+    bulbId,
+    field,
+    startStep,
+    endStep,
+    numIncrements,
+    numResets,
+    period,
+    callback,
+    incrementCallback
+  );
+}
+
+IncrementTransition::IncrementTransition(
+  const size_t id,
+  const BulbId& bulbId,
+  const GroupStateField field,
+  const int8_t startStep,
+  const uint8_t endStep,
+  const uint8_t numIncrements,
+  const uint8_t numResets,
+  const size_t period,
+  TransitionFn callback,
+  IncrementFn incrementCallback
+) : Transition(id, bulbId, period, std::move(callback))
+  , incrementCallback(std::move(incrementCallback))
+  , field(field)
+  , endStep(endStep)
+  , numIncrements(numIncrements)
+  , resetsRemaining(startStep == UNKNOWN_STEP ? numResets : 0)
+  , currentStep(startStep == UNKNOWN_STEP ? 0 : startStep)
+  , finished(false)
+{ }
+
+size_t IncrementTransition::countCommands(const int8_t startStep, const uint8_t endStep, const uint8_t numResets) {
+  if (startStep == UNKNOWN_STEP) {
+    return numResets + endStep;
+  }
+  return std::abs(static_cast<int16_t>(endStep) - startStep);
+}
+
+void IncrementTransition::step() {
+  if (resetsRemaining > 0) {
+    incrementCallback(bulbId, field, IncrementDirection::DECREASE);
+    --resetsRemaining;
+  } else if (currentStep < endStep) {
+    incrementCallback(bulbId, field, IncrementDirection::INCREASE);
+    ++currentStep;
+  } else if (currentStep > endStep) {
+    incrementCallback(bulbId, field, IncrementDirection::DECREASE);
+    --currentStep;
+  }
+
+  finished = resetsRemaining == 0 && currentStep == endStep;
+}
+
+bool IncrementTransition::isFinished() {
+  return finished;
+}
+
+uint8_t IncrementTransition::getFieldBits() const {
+  return Transition::getFieldBits(field);
+}
+
+bool IncrementTransition::getFieldValue(const GroupStateField field, const bool atEnd, uint16_t& value) const {
+  if (atEnd) {
+    return convertFieldValue(this->field, stepToValue(endStep), field, value);
+  }
+
+  // Still driving down to a known value, so there's no telling where the bulb is
+  if (resetsRemaining > 0) {
+    return false;
+  }
+
+  return convertFieldValue(this->field, stepToValue(currentStep), field, value);
+}
+
+uint16_t IncrementTransition::stepToValue(const uint8_t step) const {
+  return (step * 100) / numIncrements;
+}
+
+void IncrementTransition::childSerialize(JsonObject& json) {
+  json[F("type")] = F("increment");
+  json[F("field")] = GroupStateFieldHelpers::getFieldName(field);
+  json[F("current_step")] = currentStep;
+  json[F("end_step")] = endStep;
+  json[F("resets_remaining")] = resetsRemaining;
+}
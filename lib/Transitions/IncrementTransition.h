@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Transition.h>
+#include <GroupState.h>
+
+/*
+ * Transition for fields that can only be changed with up/down commands (e.g., CCT brightness
+ * and temperature).  Instead of setting a value each step, which can take a burst of
+ * commands when the bulb's state isn't known, it plans the fade as a series of single
+ * commands and sends exactly one per step.
+ *
+ * If the starting value isn't known, the plan starts by driving the field down to its
+ * minimum.  GroupState::applyIncrementCommand() tracks this in its scratch state, and marks
+ * the field as known once the minimum is reached.
+ */
+class IncrementTransition final : public Transition {
+public:
+  using IncrementFn = std::function<void(const BulbId& bulbId, GroupStateField field, IncrementDirection direction)>;
+
+  static constexpr int8_t UNKNOWN_STEP = -1;
+
+  class Builder final : public Transition::Builder {
+  public:
+    // Steps are positions in [0, numIncrements].  field should be LEVEL or KELVIN.
+    Builder(
+      size_t id,
+      uint16_t defaultPeriod,
+      const BulbId& bulbId,
+      const TransitionFn& callback,
+      const IncrementFn& incrementCallback,
+      GroupStateField field,
+      int8_t startStep,
+      uint8_t endStep,
+      uint8_t numIncrements,
+      uint8_t numResets
+    );
+
+    // The number of commands is fixed by the plan, so they're spread evenly over the
+    // duration.  A requested period is ignored.
+    std::shared_ptr<Transition> _build() const override;
+
+  private:
+    const IncrementFn incrementCallback;
+    const GroupStateField field;
+    const int8_t startStep;
+    const uint8_t endStep;
+    const uint8_t numIncrements;
+    const uint8_t numResets;
+  };
+
+  IncrementTransition(
+    size_t id,
+    const BulbId& bulbId,
+    GroupStateField field,
+    int8_t startStep,
+    uint8_t endStep,
+    uint8_t numIncrements,
+    uint8_t numResets,
+    size_t period,
+    TransitionFn callback,
+    IncrementFn incrementCallback
+  );
+
+  // Number of commands needed to get from startStep to endStep.  When startStep is unknown,
+  // includes numResets down commands first.
+  static size_t countCommands(int8_t startStep, uint8_t endStep, uint8_t numResets);
+
+  bool isFinished() override;
+  uint8_t getFieldBits() const override;
+  bool getFieldValue(GroupStateField field, bool atEnd, uint16_t& value) const override;
+
+private:
+  const IncrementFn incrementCallback;
+  const GroupStateField field;
+  const uint8_t endStep;
+  const uint8_t numIncrements;
+  uint8_t resetsRemaining;
+  // Position after the last command sent.  Only meaningful once resets are done.
+  int8_t currentStep;
+  bool finished;
+
+  void step() override;
+  void childSerialize(JsonObject& json) override;
+  uint16_t stepToValue(uint8_t step) const;
+};
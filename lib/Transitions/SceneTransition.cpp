@@ -0,0 +1,128 @@
+#include <SceneTransition.h>
+#include <Arduino.h>
+#include <cstdlib>
+
+SceneTransition::Builder::Builder(const size_t id, const uint16_t defaultPeriod, TransitionFn callback, const std::vector<Member>& members)
+  : Transition::Builder(
+      id,
+      defaultPeriod,
+      members.front().bulbId,
+      callback,
+      max(static_cast<size_t>(1), getMaxDistance(members))
+  )
+  , members(members)
+{ }
+
+size_t SceneTransition::Builder::getMaxDistance(const std::vector<Member>& members) {
+  size_t distance = 0;
+
+  for (const Member& member : members) {
+    distance = max(distance, static_cast<size_t>(std::abs(static_cast<int32_t>(member.end) - member.start)));
+  }
+
+  return distance;
+}
+
+std::shared_ptr<Transition> SceneTransition::Builder::_build() const {
+  // No point in taking more steps than the member that moves furthest has values
+  const size_t numSteps = max(static_cast<size_t>(1), min(getOrComputeNumPeriods(), getMaxSteps()));
+
+  return std::make_shared<SceneTransition>(
+    id,
+    members,
+    numSteps,
+    getOrComputePeriod(),
+    callback,
+    getEasing()
+  );
+}
+
+SceneTransition::SceneTransition(
+  const size_t id,
+  std::vector<Member> members,
+  const size_t numSteps,
+  const size_t period,
+  TransitionFn callback,
+  const EasingCurve easing
+) : Transition(id, members.front().bulbId, period, std::move(callback))
+  , members(std::move(members))
+  , numSteps(numSteps)
+  , easing(easing)
+  , currentStep(0)
+{ }
+
+void SceneTransition::step() {
+  ++currentStep;
+
+  for (const Member& member : members) {
+    callback(member.bulbId, member.field, valueAt(member, currentStep));
+  }
+}
+
+bool SceneTransition::skipStep() {
+  // The last step is where everything lands, so it's always sent
+  if (currentStep + 1 >= numSteps) {
+    return false;
+  }
+
+  ++currentStep;
+  return true;
+}
+
+bool SceneTransition::isFinished() {
+  return currentStep >= numSteps;
+}
+
+uint16_t SceneTransition::valueAt(const Member& member, const size_t step) const {
+  const int32_t distance = static_cast<int32_t>(member.end) - member.start;
+  return member.start + Easing::interpolate(easing, distance, step, numSteps);
+}
+
+uint8_t SceneTransition::getFieldBits() const {
+  uint8_t bits = 0;
+
+  for (const Member& member : members) {
+    bits |= Transition::getFieldBits(member.field);
+  }
+
+  return bits;
+}
+
+uint8_t SceneTransition::getFieldBitsFor(const BulbId& bulbId) const {
+  uint8_t bits = 0;
+
+  for (const Member& member : members) {
+    if (isSameTarget(member.bulbId, bulbId)) {
+      bits |= Transition::getFieldBits(member.field);
+    }
+  }
+
+  return bits;
+}
+
+size_t SceneTransition::getNumBulbs() const {
+  return members.size();
+}
+
+const BulbId& SceneTransition::getBulb(const size_t ix) const {
+  return members[ix].bulbId;
+}
+
+void SceneTransition::childSerialize(JsonObject& json) {
+  json[F("type")] = F("scene");
+  json[F("current_step")] = currentStep;
+  json[F("num_steps")] = numSteps;
+  json[F("easing")] = Easing::getName(easing);
+
+  JsonArray jsonMembers = json.createNestedArray(F("members"));
+
+  for (const Member& member : members) {
+    JsonObject jsonMember = jsonMembers.createNestedObject();
+    JsonObject bulb = jsonMember.createNestedObject(F("bulb"));
+
+    member.bulbId.serialize(bulb);
+    jsonMember[F("field")] = GroupStateFieldHelpers::getFieldName(member.field);
+    jsonMember[F("current_value")] = valueAt(member, currentStep);
+    jsonMember[F("end_value")] = member.end;
+  }
+}
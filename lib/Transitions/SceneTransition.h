@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Transition.h>
+#include <GroupStateField.h>
+#include <vector>
+
+/*
+ * Moves several bulbs to a target state together.  Each member is one field on one bulb.
+ * All members share a step counter, so every tick sends one update per member (in the order
+ * they were given), and every member reaches its end value on the same tick.
+ *
+ * The transition's bulbId is the first member's.  Conflicts are checked against every
+ * member, so setting a field directly on any of the bulbs stops the whole scene.
+ */
+class SceneTransition final : public Transition {
+public:
+  struct Member {
+    BulbId bulbId;
+    GroupStateField field;
+    uint16_t start;
+    uint16_t end;
+  };
+
+  class Builder final : public Transition::Builder {
+  public:
+    // members must not be empty, and must outlive the builder
+    Builder(size_t id, uint16_t defaultPeriod, TransitionFn callback, const std::vector<Member>& members);
+
+    std::shared_ptr<Transition> _build() const override;
+
+  private:
+    const std::vector<Member>& members;
+
+    static size_t getMaxDistance(const std::vector<Member>& members);
+  };
+
+  SceneTransition(
+    size_t id,
+    std::vector<Member> members,
+    size_t numSteps,
+    size_t period,
+    TransitionFn callback,
+    EasingCurve easing = EasingCurve::LINEAR
+  );
+
+  bool isFinished() override;
+  uint8_t getFieldBits() const override;
+  uint8_t getFieldBitsFor(const BulbId& bulbId) const override;
+  size_t getNumBulbs() const override;
+  const BulbId& getBulb(size_t ix) const override;
+
+private:
+  const std::vector<Member> members;
+  const size_t numSteps;
+  const EasingCurve easing;
+  // Number of steps taken so far, sent or skipped
+  size_t currentStep;
+
+  void step() override;
+  bool skipStep() override;
+  void childSerialize(JsonObject& json) override;
+  uint16_t valueAt(const Member& member, size_t step) const;
+};
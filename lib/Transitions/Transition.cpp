@@ -1,5 +1,6 @@
 #include <Transition.h>
 #include <Arduino.h>
+#include <Units.h>
 #include <cmath>
 
 // transition commands are in seconds, convert to ms.
@@ -22,6 +23,8 @@ Transition::Builder::Builder(const size_t id,
   , period(0)
   , numPeriods(0)
   , maxSteps(maxSteps)
+  , minPeriod(0)
+  , easing(EasingCurve::LINEAR)
 { }
 
 Transition::Builder& Transition::Builder::setDuration(const float duration) {
@@ -38,6 +41,11 @@ Transition::Builder& Transition::Builder::setPeriod(const size_t period) {
   return *this;
 }
 
+Transition::Builder& Transition::Builder::setNumPeriods(const size_t numPeriods) {
+  this->numPeriods = numPeriods;
+  return *this;
+}
+
 Transition::Builder& Transition::Builder::setDurationAwarePeriod(const size_t period, const size_t duration, const size_t maxSteps) {
   if ((period * maxSteps) < duration) {
     setPeriod(std::ceil(duration / static_cast<float>(maxSteps)));
@@ -47,6 +55,16 @@ Transition::Builder& Transition::Builder::setDurationAwarePeriod(const size_t pe
   return *this;
 }
 
+Transition::Builder& Transition::Builder::setMinPeriod(const size_t minPeriod) {
+  this->minPeriod = minPeriod;
+  return *this;
+}
+
+Transition::Builder& Transition::Builder::setEasing(const EasingCurve easing) {
+  this->easing = easing;
+  return *this;
+}
+
 size_t Transition::Builder::getNumPeriods() const {
   return this->numPeriods;
 }
@@ -63,6 +81,14 @@ size_t Transition::Builder::getMaxSteps() const {
   return this->maxSteps;
 }
 
+size_t Transition::Builder::getMinPeriod() const {
+  return this->minPeriod;
+}
+
+EasingCurve Transition::Builder::getEasing() const {
+  return this->easing;
+}
+
 bool Transition::Builder::isSetDuration() const {
   return this->duration > 0;
 }
@@ -134,6 +160,21 @@ std::shared_ptr<Transition> Transition::Builder::build() {
     }
   }
 
+  // Don't step faster than the radio can keep up with.  Fewer steps are taken instead, so
+  // the transition still takes as long as asked.
+  const size_t totalDuration = getOrComputeDuration();
+  const bool hasPeriod = isSetPeriod() || (isSetNumPeriods() && totalDuration > 0);
+  const size_t currentPeriod = isSetPeriod() ? period : (hasPeriod ? totalDuration / numPeriods : 0);
+
+  if (hasPeriod && currentPeriod < minPeriod) {
+    setPeriod(minPeriod);
+
+    if (isSetNumPeriods()) {
+      setDurationRaw(totalDuration);
+      setNumPeriods(max(static_cast<size_t>(1), totalDuration / minPeriod));
+    }
+  }
+
   return _build();
 }
 
@@ -147,16 +188,76 @@ Transition::Transition(
   , callback(callback)
   , period(period)
   , lastSent(0)
+  , nextTick(0)
+  , started(false)
 { }
 
 void Transition::tick() {
-  if (
-    const unsigned long now = millis(); (lastSent + period) <= now &&
-    ((!isFinished() || lastSent == 0))
-  ) { // always send at least once
+  tick(millis());
+}
+
+void Transition::tick(const unsigned long now) {
+  advance(now, false);
+}
+
+bool Transition::skip(const unsigned long now) {
+  return advance(now, true);
+}
+
+bool Transition::advance(const unsigned long now, const bool skip) {
+  if (started && isBefore(now, nextTick)) {
+    return false;
+  }
+
+  // always send at least once
+  if (started && isFinished()) {
+    return false;
+  }
+
+  const bool isFirstStep = ! started;
+
+  if (isFirstStep) {
+    nextTick = now;
+    started = true;
+  }
+
+  // Always send the first step so the change starts right away
+  const bool skipped = skip && ! isFirstStep && skipStep();
+
+  if (! skipped) {
     step();
     lastSent = now;
   }
+
+  // If we fell behind by more than a period, skip the missed deadlines instead of
+  // bursting to catch up.
+  const unsigned long interval = max(period, static_cast<size_t>(1));
+  const unsigned long missed = (now - nextTick) / interval;
+  nextTick += (missed + 1) * interval;
+
+  return skipped;
+}
+
+unsigned long Transition::getNextTick() const {
+  return nextTick;
+}
+
+size_t Transition::getPeriod() const {
+  return period;
+}
+
+bool Transition::skipStep() {
+  return false;
+}
+
+void Transition::scheduleFirstTick(const unsigned long at) {
+  if (! started) {
+    nextTick = at;
+  }
+}
+
+bool Transition::isBefore(const unsigned long a, const unsigned long b) {
+  return static_cast<long>(a - b) < 0;
 }
 
 size_t Transition::calculatePeriod(const int16_t distance, const size_t stepSize, const size_t duration) {
@@ -176,10 +277,97 @@ void Transition::stepValue(int16_t& current, const int16_t end, const int16_t st
   }
 }
 
+uint8_t Transition::getFieldBits(const GroupStateField field) {
+  switch (field) {
+    case GroupStateField::STATE:
+    case GroupStateField::STATUS:
+      return FIELD_BIT_STATUS;
+    case GroupStateField::BRIGHTNESS:
+    case GroupStateField::LEVEL:
+      return FIELD_BIT_BRIGHTNESS;
+    case GroupStateField::HUE:
+      return FIELD_BIT_HUE;
+    case GroupStateField::SATURATION:
+      return FIELD_BIT_SATURATION;
+    case GroupStateField::COLOR:
+      return FIELD_BIT_HUE | FIELD_BIT_SATURATION;
+    case GroupStateField::KELVIN:
+    case GroupStateField::COLOR_TEMP:
+      return FIELD_BIT_KELVIN;
+    default:
+      return 0;
+  }
+}
+
+uint8_t Transition::getFieldBitsFor(const BulbId& bulbId) const {
+  return isSameTarget(this->bulbId, bulbId) ? getFieldBits() : 0;
+}
+
+size_t Transition::getNumBulbs() const {
+  return 1;
+}
+
+const BulbId& Transition::getBulb(size_t) const {
+  return bulbId;
+}
+
+bool Transition::isSameTarget(const BulbId& a, const BulbId& b) {
+  return a.deviceId == b.deviceId
+    && a.deviceType == b.deviceType
+    && (a.groupId == b.groupId || a.groupId == 0 || b.groupId == 0);
+}
+
+bool Transition::getFieldValue(GroupStateField, bool, uint16_t&) const {
+  return false;
+}
+
+bool Transition::getColorValue(bool, ParsedColor&) const {
+  return false;
+}
+
+bool Transition::convertFieldValue(const GroupStateField from, const uint16_t value, const GroupStateField to, uint16_t& result) {
+  if (from == to) {
+    result = value;
+    return true;
+  }
+
+  switch (from) {
+    case GroupStateField::LEVEL:
+      if (to == GroupStateField::BRIGHTNESS) {
+        result = Units::rescale(value, 255, 100);
+        return true;
+      }
+      break;
+    case GroupStateField::BRIGHTNESS:
+      if (to == GroupStateField::LEVEL) {
+        result = Units::rescale(value, 100, 255);
+        return true;
+      }
+      break;
+    case GroupStateField::KELVIN:
+      if (to == GroupStateField::COLOR_TEMP) {
+        result = Units::whiteValToMireds(value, 100);
+        return true;
+      }
+      break;
+    case GroupStateField::COLOR_TEMP:
+      if (to == GroupStateField::KELVIN) {
+        result = Units::miredsToWhiteVal(value, 100);
+        return true;
+      }
+      break;
+    default:
+      break;
+  }
+
+  return false;
+}
+
 void Transition::serialize(JsonObject& json) {
   json[F("id")] = id;
   json[F("period")] = period;
   json[F("last_sent")] = lastSent;
+  json[F("next_tick")] = nextTick;
 
   const JsonObject bulbParams = json.createNestedObject("bulb");
   bulbId.serialize(bulbParams);
@@ -3,6 +3,8 @@
 #include <BulbId.h>
 #include <ArduinoJson.h>
 #include <GroupStateField.h>
+#include <ParsedColor.h>
+#include <Easing.h>
 #include <stdint.h>
 #include <functional>
 #include <memory>
@@ -26,6 +28,16 @@ public:
 
     Builder& setDuration(float duration);
     Builder& setPeriod(size_t period);
+    Builder& setNumPeriods(size_t numPeriods);
+
+    // Shortest period the transition can use, usually how long one step takes to send.  If
+    // the period would be shorter, it's stretched and the number of steps reduced so that the
+    // transition still takes the same amount of time, even if the number of steps was set.
+    Builder& setMinPeriod(size_t minPeriod);
+
+    // Curve values follow between the start and end.  Transitions which can't follow a curve
+    // ignore this.
+    Builder& setEasing(EasingCurve easing);
 
     /**
      * Users are typically defining transitions using:
@@ -54,6 +66,8 @@ public:
     size_t getPeriod() const;
     size_t getNumPeriods() const;
     size_t getMaxSteps() const;
+    size_t getMinPeriod() const;
+    EasingCurve getEasing() const;
 
     std::shared_ptr<Transition> build();
 
@@ -67,6 +81,8 @@ public:
     size_t period;
     size_t numPeriods;
     size_t maxSteps;
+    size_t minPeriod;
+    EasingCurve easing;
 
     virtual std::shared_ptr<Transition> _build() const = 0;
     size_t numSetParams() const;
@@ -84,16 +100,77 @@ public:
   );
 
   void tick();
+  void tick(unsigned long now);
+
+  // Like tick(), but moves on to the next value without sending anything.  Used when the
+  // radio is falling behind.  The last step is always sent.  Returns false if the step was
+  // sent anyway.
+  bool skip(unsigned long now);
+
   virtual bool isFinished() = 0;
   void serialize(JsonObject& json);
   virtual void step() = 0;
+
+  // Advances to the next value without sending it.  Returns false if this is the last step,
+  // or if the transition can't skip steps.
+  virtual bool skipStep();
   virtual void childSerialize(JsonObject& doc) = 0;
 
   static size_t calculatePeriod(int16_t distance, size_t stepSize, size_t duration);
 
+  // Time the next step is due.  Steps are scheduled from the previous deadline
+  // rather than from when they were actually sent, so a late loop() doesn't
+  // make the transition drift.
+  unsigned long getNextTick() const;
+  size_t getPeriod() const;
+  void scheduleFirstTick(unsigned long at);
+
+  // Wraparound-safe comparison of millis() timestamps
+  static bool isBefore(unsigned long a, unsigned long b);
+
+  // Physical fields a transition changes, as a bitmask.  Fields that are different views of
+  // the same value (e.g., brightness and level) share a bit.  Transitions that change the same
+  // bits on the same bulb conflict with each other.
+  enum FieldBits : uint8_t {
+    FIELD_BIT_STATUS     = 1 << 0,
+    FIELD_BIT_BRIGHTNESS = 1 << 1,
+    FIELD_BIT_HUE        = 1 << 2,
+    FIELD_BIT_SATURATION = 1 << 3,
+    FIELD_BIT_KELVIN     = 1 << 4,
+    FIELD_BIT_ALL        = 0xFF
+  };
+  static uint8_t getFieldBits(GroupStateField field);
+  virtual uint8_t getFieldBits() const = 0;
+
+  // Bits of the fields the transition changes on the provided bulb, or 0 if it doesn't
+  // change that bulb.
+  virtual uint8_t getFieldBitsFor(const BulbId& bulbId) const;
+
+  // Bulbs the transition changes.  Most transitions only change bulbId.
+  virtual size_t getNumBulbs() const;
+  virtual const BulbId& getBulb(size_t ix) const;
+
+  // Whether updates to one bulb affect the other.  Group 0 overlaps with all other groups.
+  static bool isSameTarget(const BulbId& a, const BulbId& b);
+
+  // Value of the provided field as of the last step sent (or at the end of the transition if
+  // atEnd is true), in the units the field uses.  Returns false if the transition doesn't
+  // change the field.
+  virtual bool getFieldValue(GroupStateField field, bool atEnd, uint16_t& value) const;
+  virtual bool getColorValue(bool atEnd, ParsedColor& color) const;
+
+  // Converts between fields which are different views of the same value (e.g., level and
+  // brightness).  Returns false if the fields aren't related.
+  static bool convertFieldValue(GroupStateField from, uint16_t value, GroupStateField to, uint16_t& result);
+
 protected:
   const size_t period;
   unsigned long lastSent;
+  unsigned long nextTick;
+  bool started;
 
   static void stepValue(int16_t& current, int16_t end, int16_t stepSize);
+
+private:
+  bool advance(unsigned long now, bool skip);
 };
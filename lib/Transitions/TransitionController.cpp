@@ -2,35 +2,64 @@
 #include <FieldTransition.h>
 #include <ColorTransition.h>
 #include <ChangeFieldOnFinishTransition.h>
+#include <IncrementTransition.h>
+#include <SceneTransition.h>
 #include <GroupStateField.h>
 #include <MiLightStatus.h>
 
 #include <TransitionController.h>
 #include <LinkedList.h>
+#include <algorithm>
+#include <cstring>
 #include <functional>
 
 using namespace std::placeholders;
 
 TransitionController::TransitionController()
   : callback(std::bind(&TransitionController::transitionCallback, this, _1, _2, _3))
+  , incrementCallback(std::bind(&TransitionController::incrementTransitionCallback, this, _1, _2, _3))
   , currentId(0)
   , defaultPeriod(500)
+  , defaultPolicy(TransitionPolicy::MERGE)
+  , stats()
+  , inTransitionCallback(false)
 { }
 
 void TransitionController::setDefaultPeriod(const uint16_t defaultPeriod) {
   this->defaultPeriod = defaultPeriod;
 }
 
+void TransitionController::setDefaultPolicy(const TransitionPolicy policy) {
+  this->defaultPolicy = policy;
+}
+
+TransitionPolicy TransitionController::getDefaultPolicy() const {
+  return defaultPolicy;
+}
+
+void TransitionController::setAirtimeEstimator(AirtimeFn estimator) {
+  this->airtimeEstimator = std::move(estimator);
+}
+
+void TransitionController::setBacklogSource(BacklogFn backlog) {
+  this->backlogSource = std::move(backlog);
+}
+
 void TransitionController::clearListeners() {
   observers.clear();
+  incrementObservers.clear();
 }
 
 void TransitionController::addListener(Transition::TransitionFn fn) {
   observers.push_back(fn);
 }
 
+void TransitionController::addIncrementListener(IncrementTransition::IncrementFn fn) {
+  incrementObservers.push_back(fn);
+}
+
 std::shared_ptr<Transition::Builder> TransitionController::buildColorTransition(const BulbId& bulbId, const ParsedColor& start, const ParsedColor& end) {
-  return std::make_shared<ColorTransition::Builder>(
+  std::shared_ptr<Transition::Builder> builder = std::make_shared<ColorTransition::Builder>(
     currentId++,
     defaultPeriod,
     bulbId,
@@ -38,10 +67,13 @@ std::shared_ptr<Transition::Builder> TransitionController::buildColorTransition(
     start,
     end
   );
+  builder->setMinPeriod(estimateStepAirtime(bulbId, GroupStateField::COLOR));
+
+  return builder;
 }
 
 std::shared_ptr<Transition::Builder> TransitionController::buildFieldTransition(const BulbId& bulbId, GroupStateField field, uint16_t start, uint16_t end) {
-  return std::make_shared<FieldTransition::Builder>(
+  std::shared_ptr<Transition::Builder> builder = std::make_shared<FieldTransition::Builder>(
     currentId++,
     defaultPeriod,
     bulbId,
@@ -50,6 +82,9 @@ std::shared_ptr<Transition::Builder> TransitionController::buildFieldTransition(
     start,
     end
   );
+  builder->setMinPeriod(estimateStepAirtime(bulbId, field));
+
+  return builder;
 }
 
 std::shared_ptr<Transition::Builder> TransitionController::buildStatusTransition(const BulbId& bulbId, const MiLightStatus status, const uint8_t startLevel) {
@@ -72,37 +107,403 @@ std::shared_ptr<Transition::Builder> TransitionController::buildStatusTransition
   return transition;
 }
 
+std::shared_ptr<Transition::Builder> TransitionController::buildIncrementTransition(
+  const BulbId& bulbId,
+  const GroupStateField field,
+  const int8_t startStep,
+  const uint8_t endStep,
+  const uint8_t numIncrements,
+  const uint8_t numResets
+) {
+  return std::make_shared<IncrementTransition::Builder>(
+    currentId++,
+    defaultPeriod,
+    bulbId,
+    callback,
+    incrementCallback,
+    field,
+    startStep,
+    endStep,
+    numIncrements,
+    numResets
+  );
+}
+
+std::shared_ptr<Transition::Builder> TransitionController::buildSceneTransition(const std::vector<SceneTransition::Member>& members) {
+  std::shared_ptr<Transition::Builder> builder = std::make_shared<SceneTransition::Builder>(
+    currentId++,
+    defaultPeriod,
+    callback,
+    members
+  );
+
+  // Every member is sent each step, so a step takes as long as all of them combined
+  size_t airtime = 0;
+  for (const SceneTransition::Member& member : members) {
+    airtime += estimateStepAirtime(member.bulbId, member.field);
+  }
+  builder->setMinPeriod(airtime);
+
+  return builder;
+}
+
+bool TransitionController::getStartValue(const BulbId& bulbId, const GroupStateField field, const TransitionPolicy policy, uint16_t& value) const {
+  const Transition* conflict = findConflict(bulbId, Transition::getFieldBits(field), policy);
+  return conflict != nullptr && conflict->getFieldValue(field, policy == TransitionPolicy::QUEUE, value);
+}
+
+bool TransitionController::getStartColor(const BulbId& bulbId, const TransitionPolicy policy, ParsedColor& color) const {
+  const Transition* conflict = findConflict(bulbId, Transition::getFieldBits(GroupStateField::COLOR), policy);
+  return conflict != nullptr && conflict->getColorValue(policy == TransitionPolicy::QUEUE, color);
+}
+
 void TransitionController::addTransition(std::shared_ptr<Transition> transition) {
+  addTransition(transition, defaultPolicy, millis());
+}
+
+void TransitionController::addTransition(std::shared_ptr<Transition> transition, const unsigned long now) {
+  addTransition(transition, defaultPolicy, now);
+}
+
+void TransitionController::addTransition(std::shared_ptr<Transition> transition, const TransitionPolicy policy) {
+  addTransition(transition, policy, millis());
+}
+
+void TransitionController::addTransition(std::shared_ptr<Transition> transition, const TransitionPolicy policy, const unsigned long now) {
+  // Transitions over several bulbs can't wait on, or keep the cadence of, any one running
+  // transition.  They supersede whatever is running on each of their bulbs instead.
+  if (transition->getNumBulbs() > 1) {
+    for (size_t i = 0; i < transition->getNumBulbs(); ++i) {
+      const BulbId& bulbId = transition->getBulb(i);
+      stats.superseded += removeConflicts(bulbId, transition->getFieldBitsFor(bulbId), now);
+    }
+
+    activeTransitions.add(transition);
+    indexTransition(transition, false);
+    scheduleTransition(transition, now);
+    return;
+  }
+
+  const uint8_t fieldBits = transition->getFieldBits();
+  unsigned long firstTick = now;
+
+  if (policy == TransitionPolicy::QUEUE) {
+    if (const Transition* last = findConflict(transition->bulbId, fieldBits, policy); last != nullptr) {
+      activeTransitions.add(transition);
+      indexTransition(transition, true);
+      queuedTransitions.push_back({ transition, last });
+      ++stats.queued;
+      return;
+    }
+  } else {
+    if (policy == TransitionPolicy::MERGE) {
+      // Pick up where the running transition left off, keeping its cadence
+      if (const Transition* running = findConflict(transition->bulbId, fieldBits, policy); running != nullptr) {
+        firstTick = running->getNextTick();
+        ++stats.merged;
+      }
+    }
+
+    stats.superseded += removeConflicts(transition->bulbId, fieldBits, now);
+  }
+
   activeTransitions.add(transition);
+  indexTransition(transition, false);
+  scheduleTransition(transition, firstTick);
+}
+
+void TransitionController::scheduleTransition(const std::shared_ptr<Transition>& transition, const unsigned long at) {
+  transition->scheduleFirstTick(at);
+  schedule.push_back(transition);
+  std::push_heap(schedule.begin(), schedule.end(), isScheduledAfter);
+}
+
+void TransitionController::cancelTransitions(const BulbId& bulbId, const GroupStateField field) {
+  cancelTransitions(bulbId, Transition::getFieldBits(field));
+}
+
+void TransitionController::cancelTransitions(const BulbId& bulbId, const uint8_t fieldBits) {
+  // Transitions set fields directly too.  Those updates shouldn't cancel anything.
+  if (inTransitionCallback || fieldBits == 0 || activeTransitions.size() == 0) {
+    return;
+  }
+
+  stats.cancelled += removeConflicts(bulbId, fieldBits, millis());
+}
+
+const TransitionStats& TransitionController::getStats() const {
+  return stats;
+}
+
+TransitionPolicy TransitionController::parsePolicy(const char* name, const TransitionPolicy defaultValue) {
+  if (name == nullptr) {
+    return defaultValue;
+  } else if (strcmp(name, TransitionPolicyNames::REPLACE) == 0) {
+    return TransitionPolicy::REPLACE;
+  } else if (strcmp(name, TransitionPolicyNames::QUEUE) == 0) {
+    return TransitionPolicy::QUEUE;
+  } else if (strcmp(name, TransitionPolicyNames::MERGE) == 0) {
+    return TransitionPolicy::MERGE;
+  }
+
+  return defaultValue;
+}
+
+const char* TransitionController::getPolicyName(const TransitionPolicy policy) {
+  switch (policy) {
+    case TransitionPolicy::REPLACE:
+      return TransitionPolicyNames::REPLACE;
+    case TransitionPolicy::QUEUE:
+      return TransitionPolicyNames::QUEUE;
+    default:
+      return TransitionPolicyNames::MERGE;
+  }
 }
 
 void TransitionController::transitionCallback(const BulbId& bulbId, const GroupStateField field, const uint16_t arg) {
+  const bool wasInCallback = inTransitionCallback;
+  inTransitionCallback = true;
+
   for (auto it = observers.begin(); it != observers.end(); ++it) {
     (*it)(bulbId, field, arg);
   }
+
+  inTransitionCallback = wasInCallback;
+}
+
+void TransitionController::incrementTransitionCallback(const BulbId& bulbId, const GroupStateField field, const IncrementDirection direction) {
+  const bool wasInCallback = inTransitionCallback;
+  inTransitionCallback = true;
+
+  for (auto it = incrementObservers.begin(); it != incrementObservers.end(); ++it) {
+    (*it)(bulbId, field, direction);
+  }
+
+  inTransitionCallback = wasInCallback;
 }
 
 void TransitionController::clear() {
   activeTransitions.clear();
+  schedule.clear();
+  queuedTransitions.clear();
+  transitionIndex.clear();
 }
 
 void TransitionController::loop() {
-  auto current = activeTransitions.getHead();
+  loop(millis());
+}
 
-  while (current != nullptr) {
-    const auto next = current->next;
+void TransitionController::loop(const unsigned long now) {
+  while (! schedule.empty() && ! Transition::isBefore(now, schedule.front()->getNextTick())) {
+    // Take the transition off the heap while it steps so that callbacks are free to add
+    // transitions of their own.
+    std::pop_heap(schedule.begin(), schedule.end(), isScheduledAfter);
+    const std::shared_ptr<Transition> transition = schedule.back();
+    schedule.pop_back();
+
+    step(*transition, now);
 
-    Transition& t = *current->data;
-    t.tick();
+    if (transition->isFinished()) {
+      removeTransition(transition.get(), now);
+    } else {
+      schedule.push_back(transition);
+      std::push_heap(schedule.begin(), schedule.end(), isScheduledAfter);
+    }
+  }
+}
+
+void TransitionController::step(Transition& transition, const unsigned long now) {
+  const unsigned long lateness = now - transition.getNextTick();
+
+  // If the radio won't have caught up by the time the next step is due, sending this one
+  // would only make things worse.
+  if (backlogSource && backlogSource() > transition.getPeriod()) {
+    if (transition.skip(now)) {
+      ++stats.skippedSteps;
+    }
+  } else {
+    transition.tick(now);
+  }
+
+  ++stats.steps;
+  stats.totalLateness += lateness;
+  stats.maxLateness = std::max(stats.maxLateness, static_cast<uint32_t>(lateness));
+}
 
-    if (t.isFinished()) {
+size_t TransitionController::estimateStepAirtime(const BulbId& bulbId, const GroupStateField field) const {
+  if (! airtimeEstimator) {
+    return 0;
+  }
+
+  // Color steps send hue and saturation separately
+  if (field == GroupStateField::COLOR) {
+    return airtimeEstimator(bulbId, GroupStateField::HUE) + airtimeEstimator(bulbId, GroupStateField::SATURATION);
+  }
+
+  return airtimeEstimator(bulbId, field);
+}
+
+size_t TransitionController::size() const {
+  return activeTransitions.size();
+}
+
+void TransitionController::removeTransition(const Transition* transition, const unsigned long now) {
+  unschedule(transition);
+  unindexTransition(transition);
+  removeActive(transition);
+
+  for (auto it = queuedTransitions.begin(); it != queuedTransitions.end();) {
+    if (it->transition.get() == transition) {
+      it = queuedTransitions.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Start anything that was waiting on this transition
+  std::vector<std::shared_ptr<Transition>> released;
+  for (auto it = queuedTransitions.begin(); it != queuedTransitions.end();) {
+    if (it->after == transition) {
+      released.push_back(it->transition);
+      it = queuedTransitions.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (const auto& next : released) {
+    setQueued(next.get(), false);
+    scheduleTransition(next, now);
+  }
+}
+
+size_t TransitionController::removeConflicts(const BulbId& bulbId, const uint8_t fieldBits, const unsigned long now) {
+  const auto bucket = transitionIndex.find(deviceKeyOf(bulbId));
+  if (bucket == transitionIndex.end()) {
+    return 0;
+  }
+
+  // Removing transitions changes the bucket, so collect them first
+  std::vector<std::shared_ptr<Transition>> conflicts;
+
+  for (const IndexedTransition& entry : bucket->second) {
+    if ((entry.fieldBits & fieldBits) != 0 && (entry.transition->getFieldBitsFor(bulbId) & fieldBits) != 0) {
+      conflicts.push_back(entry.transition);
+    }
+  }
+
+  for (const auto& transition : conflicts) {
+    removeTransition(transition.get(), now);
+  }
+
+  return conflicts.size();
+}
+
+Transition* TransitionController::findConflict(const BulbId& bulbId, const uint8_t fieldBits, const TransitionPolicy policy) const {
+  if (policy == TransitionPolicy::REPLACE || fieldBits == 0) {
+    return nullptr;
+  }
+
+  const auto bucket = transitionIndex.find(deviceKeyOf(bulbId));
+  if (bucket == transitionIndex.end()) {
+    return nullptr;
+  }
+
+  // Latest conflicting transition wins.  For merges, only consider ones that are running.
+  for (auto it = bucket->second.rbegin(); it != bucket->second.rend(); ++it) {
+    if ((it->fieldBits & fieldBits) != 0
+      && (policy == TransitionPolicy::QUEUE || ! it->queued)
+      && (it->transition->getFieldBitsFor(bulbId) & fieldBits) != 0) {
+      return it->transition.get();
+    }
+  }
+
+  return nullptr;
+}
+
+void TransitionController::indexTransition(const std::shared_ptr<Transition>& transition, const bool queued) {
+  for (size_t i = 0; i < transition->getNumBulbs(); ++i) {
+    const BulbId& bulbId = transition->getBulb(i);
+    std::vector<IndexedTransition>& bucket = transitionIndex[deviceKeyOf(bulbId)];
+    const uint8_t fieldBits = transition->getFieldBitsFor(bulbId);
+
+    // Scenes can move several groups on one device.  Those share an entry.
+    if (! bucket.empty() && bucket.back().transition == transition) {
+      bucket.back().fieldBits |= fieldBits;
+    } else {
+      bucket.push_back({ transition, fieldBits, queued });
+    }
+  }
+}
+
+void TransitionController::unindexTransition(const Transition* transition) {
+  for (size_t i = 0; i < transition->getNumBulbs(); ++i) {
+    const auto bucket = transitionIndex.find(deviceKeyOf(transition->getBulb(i)));
+    if (bucket == transitionIndex.end()) {
+      continue;
+    }
+
+    std::vector<IndexedTransition>& entries = bucket->second;
+    entries.erase(
+      std::remove_if(
+        entries.begin(),
+        entries.end(),
+        [transition](const IndexedTransition& entry) { return entry.transition.get() == transition; }
+      ),
+      entries.end()
+    );
+
+    if (entries.empty()) {
+      transitionIndex.erase(bucket);
+    }
+  }
+}
+
+void TransitionController::setQueued(const Transition* transition, const bool queued) {
+  for (size_t i = 0; i < transition->getNumBulbs(); ++i) {
+    const auto bucket = transitionIndex.find(deviceKeyOf(transition->getBulb(i)));
+    if (bucket == transitionIndex.end()) {
+      continue;
+    }
+
+    for (IndexedTransition& entry : bucket->second) {
+      if (entry.transition.get() == transition) {
+        entry.queued = queued;
+      }
+    }
+  }
+}
+
+uint32_t TransitionController::deviceKeyOf(const BulbId& bulbId) {
+  return (static_cast<uint32_t>(bulbId.deviceId) << 8) | static_cast<uint32_t>(bulbId.deviceType);
+}
+
+void TransitionController::removeActive(const Transition* transition) {
+  for (auto current = activeTransitions.getHead(); current != nullptr; current = current->next) {
+    if (current->data.get() == transition) {
       activeTransitions.remove(current);
+      return;
     }
+  }
+}
 
-    current = next;
+void TransitionController::unschedule(const Transition* transition) {
+  const auto it = std::find_if(
+    schedule.begin(),
+    schedule.end(),
+    [transition](const std::shared_ptr<Transition>& t) { return t.get() == transition; }
+  );
+
+  if (it != schedule.end()) {
+    schedule.erase(it);
+    std::make_heap(schedule.begin(), schedule.end(), isScheduledAfter);
   }
 }
 
+bool TransitionController::isScheduledAfter(const std::shared_ptr<Transition>& a, const std::shared_ptr<Transition>& b) {
+  return Transition::isBefore(b->getNextTick(), a->getNextTick());
+}
+
 ListNode<std::shared_ptr<Transition>>* TransitionController::getTransitions() {
   return activeTransitions.getHead();
 }
@@ -132,7 +533,8 @@ bool TransitionController::deleteTransition(const size_t id) {
   if (const auto node = findTransition(id); node == nullptr) {
     return false;
   } else {
-    activeTransitions.remove(node);
+    const std::shared_ptr<Transition> transition = node->data;
+    removeTransition(transition.get(), millis());
     return true;
   }
 }
@@ -1,27 +1,121 @@
 #pragma once
 
 #include <Transition.h>
+#include <IncrementTransition.h>
+#include <SceneTransition.h>
 #include <LinkedList.h>
 #include <ParsedColor.h>
 #include <GroupStateField.h>
+#include <functional>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
+// What to do when a new transition changes the same field on the same bulb as one that's
+// already running.
+enum class TransitionPolicy {
+  // Stop the running transition, and start the new one from its own start value
+  REPLACE,
+  // Start the new transition once the running one finishes, from its end value
+  QUEUE,
+  // Stop the running transition, and start the new one from the last value it sent
+  MERGE
+};
+
+namespace TransitionPolicyNames {
+  static constexpr char REPLACE[] = "replace";
+  static constexpr char QUEUE[] = "queue";
+  static constexpr char MERGE[] = "merge";
+}
+
+struct TransitionStats {
+  // Transitions stopped early because a new one replaced or merged with them
+  uint32_t superseded;
+  uint32_t merged;
+  uint32_t queued;
+  // Transitions stopped because the field was set directly
+  uint32_t cancelled;
+  // Steps run, and how many of those were skipped because the radio was behind
+  uint32_t steps;
+  uint32_t skippedSteps;
+  // How long after their deadline steps ran, in milliseconds
+  uint32_t totalLateness;
+  uint32_t maxLateness;
+};
+
 class TransitionController {
 public:
+  // Estimated time in milliseconds one step changing the field on the bulb takes to send
+  using AirtimeFn = std::function<size_t(const BulbId& bulbId, GroupStateField field)>;
+  // Estimated time in milliseconds until packets already queued have been sent
+  using BacklogFn = std::function<unsigned long()>;
+
   TransitionController();
 
   void clearListeners();
   void addListener(Transition::TransitionFn fn);
+  void addIncrementListener(IncrementTransition::IncrementFn fn);
   void setDefaultPeriod(uint16_t period);
+  void setDefaultPolicy(TransitionPolicy policy);
+  TransitionPolicy getDefaultPolicy() const;
+
+  /*
+   * Used to pace transitions to what the radio can send.  New transitions use periods at
+   * least as long as a step takes to send.  While the backlog is longer than a transition's
+   * period, its steps move on to the next value without sending anything, so that it still
+   * ends on time.
+   */
+  void setAirtimeEstimator(AirtimeFn estimator);
+  void setBacklogSource(BacklogFn backlog);
 
   std::shared_ptr<Transition::Builder> buildColorTransition(const BulbId& bulbId, const ParsedColor& start, const ParsedColor& end);
   std::shared_ptr<Transition::Builder> buildFieldTransition(const BulbId& bulbId, GroupStateField field, uint16_t start, uint16_t end);
   std::shared_ptr<Transition::Builder> buildStatusTransition(const BulbId& bulbId, MiLightStatus toStatus, uint8_t startLevel);
+  // See IncrementTransition for what the parameters mean
+  std::shared_ptr<Transition::Builder> buildIncrementTransition(
+    const BulbId& bulbId,
+    GroupStateField field,
+    int8_t startStep,
+    uint8_t endStep,
+    uint8_t numIncrements,
+    uint8_t numResets
+  );
+  // Moves several bulbs together.  members must not be empty, and must outlive the builder.
+  std::shared_ptr<Transition::Builder> buildSceneTransition(const std::vector<SceneTransition::Member>& members);
+
+  /*
+   * Adjusts the start value for a new transition to account for conflicting transitions
+   * already running on the bulb.  With MERGE, this is the last value the running transition
+   * sent.  With QUEUE, it's the value the last queued transition ends on.  Returns false and
+   * leaves the value alone if there's nothing to adjust for.
+   */
+  bool getStartValue(const BulbId& bulbId, GroupStateField field, TransitionPolicy policy, uint16_t& value) const;
+  bool getStartColor(const BulbId& bulbId, TransitionPolicy policy, ParsedColor& color) const;
 
   void addTransition(std::shared_ptr<Transition> transition);
+  void addTransition(std::shared_ptr<Transition> transition, unsigned long now);
+  void addTransition(std::shared_ptr<Transition> transition, TransitionPolicy policy);
+  void addTransition(std::shared_ptr<Transition> transition, TransitionPolicy policy, unsigned long now);
   void clear();
+
+  /*
+   * Stops running transitions on the bulb that change the provided field.  Called when a
+   * command sets the field directly.  Updates sent by transitions themselves are ignored.
+   */
+  void cancelTransitions(const BulbId& bulbId, GroupStateField field);
+  void cancelTransitions(const BulbId& bulbId, uint8_t fieldBits);
+
+  const TransitionStats& getStats() const;
+
+  static TransitionPolicy parsePolicy(const char* name, TransitionPolicy defaultValue);
+  static const char* getPolicyName(TransitionPolicy policy);
+
+  // Only does work for transitions that are due, so the cost of an idle loop doesn't grow
+  // with the number of active transitions.
   void loop();
+  void loop(unsigned long now);
+
+  size_t size() const;
 
   ListNode<std::shared_ptr<Transition>>* getTransitions();
   Transition* getTransition(size_t id);
@@ -29,11 +123,57 @@ public:
   bool deleteTransition(size_t id);
 
 private:
+  // Transition waiting for another one on the same field to finish
+  struct QueuedTransition {
+    std::shared_ptr<Transition> transition;
+    const Transition* after;
+  };
+
+  // Active transition touching a device.  fieldBits covers every group the transition
+  // changes on the device, so it only rules transitions out.
+  struct IndexedTransition {
+    std::shared_ptr<Transition> transition;
+    uint8_t fieldBits;
+    bool queued;
+  };
+
+  // Active transitions by device, in the order they were added.  Keyed without the group
+  // ID because group 0 addresses every group on the device.
+  typedef std::unordered_map<uint32_t, std::vector<IndexedTransition>> TransitionIndex;
+
   Transition::TransitionFn callback;
+  IncrementTransition::IncrementFn incrementCallback;
+  AirtimeFn airtimeEstimator;
+  BacklogFn backlogSource;
   LinkedList<std::shared_ptr<Transition>> activeTransitions;
+  // Min-heap of active transitions, ordered by when their next step is due
+  std::vector<std::shared_ptr<Transition>> schedule;
+  std::vector<QueuedTransition> queuedTransitions;
+  TransitionIndex transitionIndex;
   std::vector<Transition::TransitionFn> observers;
+  std::vector<IncrementTransition::IncrementFn> incrementObservers;
   size_t currentId;
   uint16_t defaultPeriod;
+  TransitionPolicy defaultPolicy;
+  TransitionStats stats;
+  bool inTransitionCallback;
 
   void transitionCallback(const BulbId& bulbId, GroupStateField field, uint16_t arg);
+  void incrementTransitionCallback(const BulbId& bulbId, GroupStateField field, IncrementDirection direction);
+  size_t estimateStepAirtime(const BulbId& bulbId, GroupStateField field) const;
+  void step(Transition& transition, unsigned long now);
+  void scheduleTransition(const std::shared_ptr<Transition>& transition, unsigned long at);
+  void unschedule(const Transition* transition);
+  void removeActive(const Transition* transition);
+  // Removes a transition entirely, and starts anything that was queued behind it
+  void removeTransition(const Transition* transition, unsigned long now);
+  size_t removeConflicts(const BulbId& bulbId, uint8_t fieldBits, unsigned long now);
+
+  void indexTransition(const std::shared_ptr<Transition>& transition, bool queued);
+  void unindexTransition(const Transition* transition);
+  void setQueued(const Transition* transition, bool queued);
+  Transition* findConflict(const BulbId& bulbId, uint8_t fieldBits, TransitionPolicy policy) const;
+
+  static uint32_t deviceKeyOf(const BulbId& bulbId);
+  static bool isScheduledAfter(const std::shared_ptr<Transition>& a, const std::shared_ptr<Transition>& b);
 };
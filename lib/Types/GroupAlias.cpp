@@ -33,7 +33,7 @@ void GroupAlias::dump(Stream &stream) const {
   bulbId.dump(stream);
 }
 
-void GroupAlias::loadAliases(Stream &stream, std::map<String, GroupAlias> &aliases) {
+void GroupAlias::loadAliases(Stream &stream, GroupAliasMap &aliases) {
   // Read number of aliases
   const uint16_t numAliases = stream.parseInt();
   // expect null terminator
@@ -49,7 +49,7 @@ void GroupAlias::loadAliases(Stream &stream, std::map<String, GroupAlias> &alias
   }
 }
 
-void GroupAlias::saveAliases(Stream &stream, const std::map<String, GroupAlias> &aliases) {
+void GroupAlias::saveAliases(Stream &stream, const GroupAliasMap &aliases) {
   // Write number of aliases
   stream.print(aliases.size());
   stream.write(static_cast<uint8_t>(0));
@@ -2,11 +2,17 @@
 
 #include <Stream.h>
 #include <BulbId.h>
+#include <ExtMemory.h>
 
 #include <map>
 
 #define MAX_ALIAS_LEN 32
 
+struct GroupAlias;
+
+// Kept in external memory when available, since installations can have hundreds of aliases
+typedef std::map<String, GroupAlias, std::less<String>, ExtMemory::Allocator<std::pair<const String, GroupAlias>>> GroupAliasMap;
+
 struct GroupAlias {
     size_t id{};
     char alias[MAX_ALIAS_LEN + 1]{};
@@ -26,6 +32,6 @@ struct GroupAlias {
     bool load(Stream& stream);
     void dump(Stream& stream) const;
 
-    static void loadAliases(Stream& stream, std::map<String, GroupAlias>& aliases);
-    static void saveAliases(Stream& stream, const std::map<String, GroupAlias>& aliases);
+    static void loadAliases(Stream& stream, GroupAliasMap& aliases);
+    static void saveAliases(Stream& stream, const GroupAliasMap& aliases);
 };
@@ -7,12 +7,15 @@ namespace MiLightCommandNames {
   static constexpr char NIGHT_MODE[] = "night_mode";
   static constexpr char LEVEL_UP[] = "level_up";
   static constexpr char LEVEL_DOWN[] = "level_down";
+  static constexpr char BRIGHTNESS_UP[] = "brightness_up";
+  static constexpr char BRIGHTNESS_DOWN[] = "brightness_down";
   static constexpr char TEMPERATURE_UP[] = "temperature_up";
   static constexpr char TEMPERATURE_DOWN[] = "temperature_down";
   static constexpr char NEXT_MODE[] = "next_mode";
   static constexpr char PREVIOUS_MODE[] = "previous_mode";
   static constexpr char MODE_SPEED_DOWN[] = "mode_speed_down";
   static constexpr char MODE_SPEED_UP[] = "mode_speed_up";
+  static constexpr char COLOR_WHITE_TOGGLE[] = "color_white_toggle";
   static constexpr char TOGGLE[] = "toggle";
   static constexpr char TRANSITION[] = "transition";
 }
@@ -0,0 +1,183 @@
+#include <PacketDelta.h>
+#include <GroupStateField.h>
+#include <MiLightCommands.h>
+#include <Size.h>
+#include <cstring>
+
+static constexpr char BUTTON_ID_KEY[] = "button_id";
+static constexpr char ARGUMENT_KEY[] = "argument";
+
+// Indexed by PacketCommand
+static const char* COMMAND_NAMES[] = {
+  nullptr,
+  MiLightCommandNames::NIGHT_MODE,
+  MiLightCommandNames::SET_WHITE,
+  MiLightCommandNames::BRIGHTNESS_UP,
+  MiLightCommandNames::BRIGHTNESS_DOWN,
+  MiLightCommandNames::TEMPERATURE_UP,
+  MiLightCommandNames::TEMPERATURE_DOWN,
+  MiLightCommandNames::NEXT_MODE,
+  MiLightCommandNames::PREVIOUS_MODE,
+  MiLightCommandNames::MODE_SPEED_UP,
+  MiLightCommandNames::MODE_SPEED_DOWN,
+  MiLightCommandNames::COLOR_WHITE_TOGGLE,
+};
+
+PacketDelta::PacketDelta()
+  : fields(0)
+  , state(OFF)
+  , brightness(0)
+  , hue(0)
+  , saturation(0)
+  , colorTemp(0)
+  , mode(0)
+  , command(PacketCommand::NONE)
+  , buttonId(0)
+  , argument(0)
+{ }
+
+void PacketDelta::clear() {
+  fields = 0;
+}
+
+void PacketDelta::setState(const MiLightStatus state) {
+  this->state = state;
+  fields |= STATE;
+}
+
+void PacketDelta::setBrightness(const uint8_t brightness) {
+  this->brightness = brightness;
+  fields |= BRIGHTNESS;
+}
+
+void PacketDelta::setHue(const uint16_t hue) {
+  this->hue = hue;
+  fields |= HUE;
+}
+
+void PacketDelta::setSaturation(const uint8_t saturation) {
+  this->saturation = saturation;
+  fields |= SATURATION;
+}
+
+void PacketDelta::setColorTemp(const uint16_t colorTemp) {
+  this->colorTemp = colorTemp;
+  fields |= COLOR_TEMP;
+}
+
+void PacketDelta::setMode(const uint8_t mode) {
+  this->mode = mode;
+  fields |= MODE;
+}
+
+void PacketDelta::setCommand(const PacketCommand command) {
+  this->command = command;
+  fields |= COMMAND;
+}
+
+void PacketDelta::setButtonId(const uint8_t buttonId) {
+  this->buttonId = buttonId;
+  fields |= BUTTON_ID;
+}
+
+void PacketDelta::setArgument(const uint8_t argument) {
+  this->argument = argument;
+  fields |= ARGUMENT;
+}
+
+void PacketDelta::merge(const PacketDelta& other) {
+  if (other.has(STATE)) setState(other.state);
+  if (other.has(BRIGHTNESS)) setBrightness(other.brightness);
+  if (other.has(HUE)) setHue(other.hue);
+  if (other.has(SATURATION)) setSaturation(other.saturation);
+  if (other.has(COLOR_TEMP)) setColorTemp(other.colorTemp);
+  if (other.has(MODE)) setMode(other.mode);
+  if (other.has(COMMAND)) setCommand(other.command);
+  if (other.has(BUTTON_ID)) setButtonId(other.buttonId);
+  if (other.has(ARGUMENT)) setArgument(other.argument);
+}
+
+void PacketDelta::toJson(JsonObject json) const {
+  if (has(STATE)) {
+    json[GroupStateFieldNames::STATE] = state == ON ? "ON" : "OFF";
+  }
+  if (has(BRIGHTNESS)) {
+    json[GroupStateFieldNames::BRIGHTNESS] = brightness;
+  }
+  if (has(HUE)) {
+    json[GroupStateFieldNames::HUE] = hue;
+  }
+  if (has(SATURATION)) {
+    json[GroupStateFieldNames::SATURATION] = saturation;
+  }
+  if (has(COLOR_TEMP)) {
+    json[GroupStateFieldNames::COLOR_TEMP] = colorTemp;
+  }
+  if (has(MODE)) {
+    json[GroupStateFieldNames::MODE] = mode;
+  }
+  if (has(COMMAND)) {
+    if (const char* name = getCommandName(command); name != nullptr) {
+      json[GroupStateFieldNames::COMMAND] = name;
+    }
+  }
+  if (has(BUTTON_ID)) {
+    json[BUTTON_ID_KEY] = buttonId;
+  }
+  if (has(ARGUMENT)) {
+    json[ARGUMENT_KEY] = argument;
+  }
+}
+
+PacketDelta PacketDelta::fromJson(const JsonObject json) {
+  PacketDelta delta;
+
+  if (json.containsKey(GroupStateFieldNames::STATE)) {
+    delta.setState(json[GroupStateFieldNames::STATE] == "ON" ? ON : OFF);
+  }
+  if (json.containsKey(GroupStateFieldNames::BRIGHTNESS)) {
+    delta.setBrightness(json[GroupStateFieldNames::BRIGHTNESS].as<uint8_t>());
+  }
+  if (json.containsKey(GroupStateFieldNames::HUE)) {
+    delta.setHue(json[GroupStateFieldNames::HUE].as<uint16_t>());
+  }
+  if (json.containsKey(GroupStateFieldNames::SATURATION)) {
+    delta.setSaturation(json[GroupStateFieldNames::SATURATION].as<uint8_t>());
+  }
+  if (json.containsKey(GroupStateFieldNames::COLOR_TEMP)) {
+    delta.setColorTemp(json[GroupStateFieldNames::COLOR_TEMP].as<uint16_t>());
+  }
+  if (json.containsKey(GroupStateFieldNames::MODE)) {
+    delta.setMode(json[GroupStateFieldNames::MODE].as<uint8_t>());
+  }
+  if (json.containsKey(GroupStateFieldNames::COMMAND)) {
+    delta.setCommand(getCommandByName(json[GroupStateFieldNames::COMMAND].as<const char*>()));
+  }
+  if (json.containsKey(BUTTON_ID_KEY)) {
+    delta.setButtonId(json[BUTTON_ID_KEY].as<uint8_t>());
+  }
+  if (json.containsKey(ARGUMENT_KEY)) {
+    delta.setArgument(json[ARGUMENT_KEY].as<uint8_t>());
+  }
+
+  return delta;
+}
+
+const char* PacketDelta::getCommandName(const PacketCommand command) {
+  const size_t index = static_cast<size_t>(command);
+  return index < size(COMMAND_NAMES) ? COMMAND_NAMES[index] : nullptr;
+}
+
+PacketCommand PacketDelta::getCommandByName(const char* name) {
+  if (name == nullptr) {
+    return PacketCommand::UNKNOWN;
+  }
+
+  for (size_t i = 1; i < size(COMMAND_NAMES); ++i) {
+    if (strcmp(name, COMMAND_NAMES[i]) == 0) {
+      return static_cast<PacketCommand>(i);
+    }
+  }
+
+  return PacketCommand::UNKNOWN;
+}
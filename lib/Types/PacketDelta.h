@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <ArduinoJson.h>
+#include <BulbId.h>
+#include <MiLightStatus.h>
+
+// Commands a decoded packet can carry, other than field values
+enum class PacketCommand : uint8_t {
+  NONE,
+  NIGHT_MODE,
+  SET_WHITE,
+  BRIGHTNESS_UP,
+  BRIGHTNESS_DOWN,
+  TEMPERATURE_UP,
+  TEMPERATURE_DOWN,
+  NEXT_MODE,
+  PREVIOUS_MODE,
+  MODE_SPEED_UP,
+  MODE_SPEED_DOWN,
+  COLOR_WHITE_TOGGLE,
+  // A command name that isn't one of the above.  Only comes from JSON.
+  UNKNOWN
+};
+
+/*
+ * What a single packet changes, as decoded by PacketFormatter::parsePacket.  Units are the
+ * same as in the JSON it replaces: brightness is [0, 255], hue is degrees, saturation is
+ * [0, 100] and color temperature is in mireds.
+ *
+ * Packets are decoded for every packet sent or heard, so this avoids building a JSON
+ * document for each one.  JSON is only rendered with toJson() when something (an MQTT update
+ * topic or a websocket client) wants it.
+ */
+struct PacketDelta {
+  enum Field : uint16_t {
+    STATE       = 1 << 0,
+    BRIGHTNESS  = 1 << 1,
+    HUE         = 1 << 2,
+    SATURATION  = 1 << 3,
+    COLOR_TEMP  = 1 << 4,
+    MODE        = 1 << 5,
+    COMMAND     = 1 << 6,
+    // Packets that weren't recognized
+    BUTTON_ID   = 1 << 7,
+    ARGUMENT    = 1 << 8
+  };
+
+  BulbId bulbId;
+  // Bitmask of Fields that are set
+  uint16_t fields;
+
+  MiLightStatus state;
+  uint8_t brightness;
+  uint16_t hue;
+  uint8_t saturation;
+  uint16_t colorTemp;
+  uint8_t mode;
+  PacketCommand command;
+  uint8_t buttonId;
+  uint8_t argument;
+
+  PacketDelta();
+
+  bool has(Field field) const { return (fields & field) != 0; }
+  bool isEmpty() const { return fields == 0; }
+  void clear();
+
+  void setState(MiLightStatus state);
+  void setBrightness(uint8_t brightness);
+  void setHue(uint16_t hue);
+  void setSaturation(uint8_t saturation);
+  void setColorTemp(uint16_t colorTemp);
+  void setMode(uint8_t mode);
+  void setCommand(PacketCommand command);
+  void setButtonId(uint8_t buttonId);
+  void setArgument(uint8_t argument);
+
+  // Copies the fields set in other over this one's
+  void merge(const PacketDelta& other);
+
+  // Renders the fields that are set, with the same keys and values parsePacket used to write
+  void toJson(JsonObject json) const;
+  // Reads the fields GroupState::patch understands from JSON.  bulbId isn't set.
+  static PacketDelta fromJson(JsonObject json);
+
+  static const char* getCommandName(PacketCommand command);
+  static PacketCommand getCommandByName(const char* name);
+};
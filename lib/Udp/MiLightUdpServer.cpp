@@ -40,7 +40,9 @@ void MiLightUdpServer::handleClient() {
     printf("\n");
 #endif
 
+    client->setCommandSource(CommandSource::UDP);
     handlePacket(packetBuffer, packetSize);
+    client->clearCommandSource();
   }
 }
 
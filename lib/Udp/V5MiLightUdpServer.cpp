@@ -1,4 +1,5 @@
 #include <V5MiLightUdpServer.h>
+#include <Units.h>
 
 void V5MiLightUdpServer::handlePacket(uint8_t* packet, const size_t packetSize) {
   if (packetSize == 2 || packetSize == 3) {
@@ -74,12 +75,15 @@ void V5MiLightUdpServer::handleCommand(const uint8_t command, const uint8_t comm
         pressButton(RGBW_SPEED_UP);
         break;
 
-      case UDP_RGBW_BRIGHTNESS:
+      case UDP_RGBW_BRIGHTNESS: {
         // map [2, 27] --> [0, 100]
-        client->updateBrightness(
-          round(((commandArg - 2) / 25.0)*100)
-        );
+        const uint8_t level = Units::rescale<int16_t, uint8_t>(commandArg - 2, 100, 25);
+
+        if (client->debounce(GroupStateField::LEVEL, level)) {
+          client->updateBrightness(level);
+        }
         break;
+      }
 
       default:
         handled = false;
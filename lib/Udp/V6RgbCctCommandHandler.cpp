@@ -68,15 +68,21 @@ bool V6RgbCctCommandHandler::handleCommand(
       break;
 
     case V2_KELVIN:
-      client->updateTemperature(100 - arg);
+      if (client->debounce(GroupStateField::KELVIN, 100 - arg)) {
+        client->updateTemperature(100 - arg);
+      }
       break;
 
     case V2_BRIGHTNESS:
-      client->updateBrightness(arg);
+      if (client->debounce(GroupStateField::LEVEL, arg)) {
+        client->updateBrightness(arg);
+      }
       break;
 
     case V2_SATURATION:
-      client->updateSaturation(100 - arg);
+      if (client->debounce(GroupStateField::SATURATION, 100 - arg)) {
+        client->updateSaturation(100 - arg);
+      }
       break;
 
     case V2_MODE:
@@ -65,7 +65,9 @@ bool V6RgbwCommandHandler::handleCommand(
     return true;
   }
   if (cmd == V2_RGBW_BRIGHTNESS_PREFIX) {
-    client->updateBrightness(arg);
+    if (client->debounce(GroupStateField::LEVEL, arg)) {
+      client->updateBrightness(arg);
+    }
     return true;
   }
   if (cmd == V2_RGBW_MODE_PREFIX) {
@@ -61,24 +61,26 @@ void MiLightHttpServer::begin() {
 
   server
     .buildHandler("/gateway_traffic")
-    .on(HTTP_GET, [this](auto && PH1) { handleListenGateway(std::forward<decltype(PH1)>(PH1)); });
+    .onSimple(HTTP_GET, [this](auto* bindings) { handleListenGateway(bindings); });
   server
     .buildHandler("/gateway_traffic/:type")
-    .on(HTTP_GET, [this](auto && PH1) { handleListenGateway(std::forward<decltype(PH1)>(PH1)); });
+    .onSimple(HTTP_GET, [this](auto* bindings) { handleListenGateway(bindings); });
 
+  // Handlers that can hold their response until packets are sent are simple handlers, so that
+  // RichHttp doesn't respond when they return
   server
     .buildHandler("/gateways/:device_id/:type/:group_id")
-    .on(HTTP_PUT, [this](auto && PH1) { handleUpdateGroup(std::forward<decltype(PH1)>(PH1)); })
-    .on(HTTP_POST, [this](auto && PH1) { handleUpdateGroup(std::forward<decltype(PH1)>(PH1)); })
+    .onSimple(HTTP_PUT, [this](auto* bindings) { handleUpdateGroup(bindings); })
+    .onSimple(HTTP_POST, [this](auto* bindings) { handleUpdateGroup(bindings); })
     .on(HTTP_DELETE, [this](auto && PH1) { handleDeleteGroup(std::forward<decltype(PH1)>(PH1)); })
-    .on(HTTP_GET, [this](auto && PH1) { handleGetGroup(std::forward<decltype(PH1)>(PH1)); });
+    .onSimple(HTTP_GET, [this](auto* bindings) { handleGetGroup(bindings); });
 
   server
     .buildHandler("/gateways/:device_alias")
-    .on(HTTP_PUT, [this](auto && PH1) { handleUpdateGroupAlias(std::forward<decltype(PH1)>(PH1)); })
-    .on(HTTP_POST, [this](auto && PH1) { handleUpdateGroupAlias(std::forward<decltype(PH1)>(PH1)); })
+    .onSimple(HTTP_PUT, [this](auto* bindings) { handleUpdateGroupAlias(bindings); })
+    .onSimple(HTTP_POST, [this](auto* bindings) { handleUpdateGroupAlias(bindings); })
     .on(HTTP_DELETE, [this](auto && PH1) { handleDeleteGroupAlias(std::forward<decltype(PH1)>(PH1)); })
-    .on(HTTP_GET, [this](auto && PH1) { handleGetGroupAlias(std::forward<decltype(PH1)>(PH1)); });
+    .onSimple(HTTP_GET, [this](auto* bindings) { handleGetGroupAlias(bindings); });
 
   server
     .buildHandler("/gateways")
@@ -95,9 +97,24 @@ void MiLightHttpServer::begin() {
     .on(HTTP_GET, [this](auto && PH1) { handleListTransitions(std::forward<decltype(PH1)>(PH1)); })
     .on(HTTP_POST, [this](auto && PH1) { handleCreateTransition(std::forward<decltype(PH1)>(PH1)); });
 
+  server
+    .buildHandler("/scenes/:id/recall")
+    .on(HTTP_POST, [this](auto && PH1) { handleRecallScene(std::forward<decltype(PH1)>(PH1)); });
+
+  server
+    .buildHandler("/scenes/:id")
+    .on(HTTP_GET, [this](auto && PH1) { handleGetScene(std::forward<decltype(PH1)>(PH1)); })
+    .on(HTTP_PUT, [this](auto && PH1) { handleSaveScene(std::forward<decltype(PH1)>(PH1)); })
+    .on(HTTP_POST, [this](auto && PH1) { handleSaveScene(std::forward<decltype(PH1)>(PH1)); })
+    .on(HTTP_DELETE, [this](auto && PH1) { handleDeleteScene(std::forward<decltype(PH1)>(PH1)); });
+
+  server
+    .buildHandler("/scenes")
+    .on(HTTP_GET, [this](auto && PH1) { handleListScenes(std::forward<decltype(PH1)>(PH1)); });
+
   server
     .buildHandler("/raw_commands/:type")
-    .on(HTTP_ANY, [this](auto && PH1) { handleSendRaw(std::forward<decltype(PH1)>(PH1)); });
+    .onSimple(HTTP_ANY, [this](auto* bindings) { handleSendRaw(bindings); });
 
   server
     .buildHandler("/about")
@@ -133,6 +150,10 @@ void MiLightHttpServer::begin() {
 
   server.clearBuilders();
 
+  // Needed for conditional GETs on device state
+  const char* collectedHeaders[] = { IF_NONE_MATCH_HEADER };
+  server.collectHeaders(collectedHeaders, std::size(collectedHeaders));
+
   // set up web socket server
   wsServer.onEvent(
     [this](const uint8_t num, const WStype_t type, uint8_t * payload, const size_t length) {
@@ -150,6 +171,9 @@ void MiLightHttpServer::onAbout(const AboutHandler &handler) {
 
 void MiLightHttpServer::handleClient() {
   server.handleClient();
+  handleGatewayListeners();
+  handleHeldResponses();
+  handleChangeListeners();
   wsServer.loop();
 }
 
@@ -228,6 +252,57 @@ void MiLightHttpServer::handleAbout(const RequestContext& request) const {
   const JsonObject queueStats = request.response.json.createNestedObject("queue_stats");
   queueStats[F("length")] = packetSender->queueLength();
   queueStats[F("dropped_packets")] = packetSender->droppedPackets();
+  queueStats[F("backlog_ms")] = packetSender->getBacklogMillis();
+
+  const TransitionStats& transitionStats = transitions.getStats();
+  const JsonObject transitionStatsObj = request.response.json.createNestedObject("transition_stats");
+  transitionStatsObj[F("active")] = transitions.size();
+  transitionStatsObj[F("superseded")] = transitionStats.superseded;
+  transitionStatsObj[F("merged")] = transitionStats.merged;
+  transitionStatsObj[F("queued")] = transitionStats.queued;
+  transitionStatsObj[F("cancelled")] = transitionStats.cancelled;
+  transitionStatsObj[F("steps")] = transitionStats.steps;
+  transitionStatsObj[F("skipped_steps")] = transitionStats.skippedSteps;
+  transitionStatsObj[F("max_lateness_ms")] = transitionStats.maxLateness;
+  transitionStatsObj[F("avg_lateness_ms")] = transitionStats.steps == 0
+    ? 0.0f
+    : transitionStats.totalLateness / static_cast<float>(transitionStats.steps);
+
+  if (milightClient != nullptr) {
+    const RedundantCommandStats& redundantStats = milightClient->getRedundantCommandFilter().getStats();
+    const JsonObject redundantStatsObj = request.response.json.createNestedObject("redundant_command_stats");
+    redundantStatsObj[F("suppressed")] = redundantStats.suppressed;
+    redundantStatsObj[F("packets_avoided")] = redundantStats.packetsAvoided;
+    redundantStatsObj[F("stale")] = redundantStats.stale;
+
+    const CommandDebounceStats& debounceStats = milightClient->getCommandDebouncer().getStats();
+    const JsonObject debounceStatsObj = request.response.json.createNestedObject("command_debounce_stats");
+    debounceStatsObj[F("deferred")] = debounceStats.deferred;
+    debounceStatsObj[F("collapsed")] = debounceStats.collapsed;
+    debounceStatsObj[F("trailing")] = debounceStats.trailing;
+
+    const GroupFanoutStats& fanoutStats = milightClient->getFanoutStats();
+    const JsonObject fanoutStatsObj = request.response.json.createNestedObject("fanout_stats");
+    fanoutStatsObj[F("group0_commands")] = fanoutStats.group0Commands;
+    fanoutStatsObj[F("commands_saved")] = fanoutStats.commandsSaved;
+    fanoutStatsObj[F("packets_saved")] = fanoutStats.packetsSaved;
+  }
+
+  const SceneStats& sceneStats = scenes.getStats();
+  const JsonObject sceneStatsObj = request.response.json.createNestedObject("scene_stats");
+  sceneStatsObj[F("recalls")] = sceneStats.recalls;
+  sceneStatsObj[F("packets_sent")] = sceneStats.packetsSent;
+
+  if (stateStore != nullptr) {
+    const GroupStateCacheStats stats = stateStore->getCacheStats();
+    const JsonObject cacheStats = request.response.json.createNestedObject("state_cache_stats");
+    cacheStats[F("size")] = stats.size;
+    cacheStats[F("max_size")] = stats.maxSize;
+    cacheStats[F("external_memory")] = stats.externalMemory;
+    cacheStats[F("lookups")] = stats.lookups;
+    cacheStats[F("hits")] = stats.hits;
+    cacheStats[F("avg_lookup_us")] = stats.lookups == 0 ? 0.0f : stats.lookupMicros / static_cast<float>(stats.lookups);
+  }
 }
 
 void MiLightHttpServer::handleGetRadioConfigs(const RequestContext& request) {
@@ -354,126 +429,287 @@ void MiLightHttpServer::handleFirmwareUpload() {
 }
 
 
-void MiLightHttpServer::handleListenGateway(const RequestContext& request) {
-  const bool listenAll = !request.pathVariables.hasBinding("type");
-  size_t configIx = 0;
-  std::shared_ptr<MiLightRadio> radio = nullptr;
+void MiLightHttpServer::handleListenGateway(const UrlTokenBindings* bindings) {
   const MiLightRemoteConfig* remoteConfig = nullptr;
-  const MiLightRemoteConfig* tmpRemoteConfig = nullptr;
 
-  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
+  if (bindings != nullptr && bindings->hasBinding("type")) {
+    const String strType(bindings->get("type"));
+    remoteConfig = MiLightRemoteConfig::fromType(strType);
 
-  if (!listenAll) {
-    const String strType(request.pathVariables.get("type"));
-    tmpRemoteConfig = MiLightRemoteConfig::fromType(strType);
-    milightClient->prepare(tmpRemoteConfig, 0, 0);
+    if (remoteConfig == nullptr) {
+      server.send_P(400, APPLICATION_JSON, PSTR("{\"error\":\"Unknown device type supplied\"}"));
+      return;
+    }
   }
 
-  if (tmpRemoteConfig == nullptr && !listenAll) {
-    request.response.setCode(400);
-    request.response.json["error"] = "Unknown device type supplied";
+  if (gatewayListeners.size() >= MILIGHT_MAX_GATEWAY_LISTENERS) {
+    server.send_P(503, APPLICATION_JSON, PSTR("{\"error\":\"Too many requests are already waiting for packets\"}"));
     return;
   }
 
-  if (tmpRemoteConfig != nullptr) {
-    radio = radios->switchRadio(tmpRemoteConfig);
+  // Nothing is sent here, so the web server leaves the connection alone when this returns.
+  // The main loop listens for packets while requests are waiting, and handlePacketHeard
+  // writes the whole response once one comes in.
+  gatewayListeners.push_back({server.client(), remoteConfig, millis()});
+}
+
+void MiLightHttpServer::handlePacketHeard(const uint8_t* packet, const MiLightRemoteConfig& config, const PacketDelta& delta) {
+  sniffer.handlePacket(packet, config, delta);
+
+  if (gatewayListeners.empty()) {
+    return;
   }
 
-  while (remoteConfig == nullptr) {
-    if (!server.client().connected()) {
-      return;
+  char responseBody[200];
+  char* responseBuffer = responseBody;
+
+  responseBuffer += sprintf_P(
+    responseBuffer,
+    PSTR("\n%s packet received (%d bytes):\n"),
+    config.name.c_str(),
+    config.packetFormatter->getPacketLength()
+  );
+  config.packetFormatter->format(packet, responseBuffer);
+
+  StaticJsonDocument<384> response;
+  response["packet_info"] = responseBody;
+
+  StringPrint body;
+  serializeJson(response, body);
+
+  for (auto it = gatewayListeners.begin(); it != gatewayListeners.end(); ) {
+    if (it->remoteConfig != nullptr && it->remoteConfig->type != config.type) {
+      ++it;
+      continue;
     }
 
-    if (listenAll) {
-      radio = radios->switchRadio(configIx++ % radios->getNumRadios());
+    sendRawResponse(it->client, 200, body.str());
+    it = gatewayListeners.erase(it);
+  }
+}
+
+void MiLightHttpServer::handleGatewayListeners() {
+  for (auto it = gatewayListeners.begin(); it != gatewayListeners.end(); ) {
+    if (! it->client.connected()) {
+      it = gatewayListeners.erase(it);
+    } else if (millis() - it->listenedAt >= MILIGHT_GATEWAY_TRAFFIC_TIMEOUT) {
+      sendRawResponse(it->client, 504, F("{\"error\":\"No packet was heard\"}"));
+      it = gatewayListeners.erase(it);
     } else {
-      radio->configure();
+      ++it;
     }
+  }
+}
 
-    if (radios->available()) {
-      const size_t packetLen = radios->read(packet);
-      remoteConfig = MiLightRemoteConfig::fromReceivedPacket(
-        radio->config(),
-        packet,
-        packetLen
-      );
+const __FlashStringHelper* MiLightHttpServer::reasonPhrase(const uint16_t code) {
+  switch (code) {
+    case 200: return F("OK");
+    case 204: return F("No Content");
+    case 304: return F("Not Modified");
+    case 400: return F("Bad Request");
+    case 404: return F("Not Found");
+    case 500: return F("Internal Server Error");
+    case 503: return F("Service Unavailable");
+    case 504: return F("Gateway Timeout");
+    default:  return F("");
+  }
+}
+
+void MiLightHttpServer::sendRawHeaders(WiFiClient& client, const uint16_t code, const int contentLength, const char* etag) {
+  client.printf_P(PSTR("HTTP/1.1 %u "), code);
+  client.print(reasonPhrase(code));
+  client.print(F("\r\n"));
+
+  // These can't have a body
+  if (code != 204 && code != 304) {
+    client.printf_P(PSTR("Content-Type: %s\r\n"), APPLICATION_JSON);
+
+    if (contentLength >= 0) {
+      client.printf_P(PSTR("Content-Length: %d\r\n"), contentLength);
     }
+  }
 
-    yield();
+  if (etag != nullptr) {
+    client.printf_P(PSTR("ETag: %s\r\n"), etag);
   }
 
-  char responseBody[200];
-  char* responseBuffer = responseBody;
+  client.print(F("Connection: close\r\n\r\n"));
+}
 
-  responseBuffer += sprintf_P(
-    responseBuffer,
-    PSTR("\n%s packet received (%d bytes):\n"),
-    remoteConfig->name.c_str(),
-    remoteConfig->packetFormatter->getPacketLength()
-  );
-  remoteConfig->packetFormatter->format(packet, responseBuffer);
+void MiLightHttpServer::sendRawResponse(WiFiClient& client, const uint16_t code, const String& body) {
+  if (! client.connected()) {
+    return;
+  }
 
-  request.response.json["packet_info"] = responseBody;
+  sendRawHeaders(client, code, body.length());
+  client.print(body);
+  client.stop();
+}
+
+bool MiLightHttpServer::isListening() const {
+  return sniffer.isActive() || ! gatewayListeners.empty();
 }
 
-void MiLightHttpServer::sendGroupState(const bool allowAsync, const BulbId& bulbId, RichHttp::Response& response) const {
+void MiLightHttpServer::formatEtag(char* etag, const BulbId& bulbId, const bool normalizedFormat) const {
+  // The representation only changes when the state version does (or when switching formats)
+  sprintf_P(
+    etag,
+    PSTR("\"%08x-%x%s\""),
+    stateStore->getEpoch(),
+    stateStore->getVersion(bulbId),
+    normalizedFormat ? "-n" : ""
+  );
+}
+
+void MiLightHttpServer::sendGroupState(const bool allowAsync, const BulbId& bulbId) {
   const bool blockOnQueue = server.arg("blockOnQueue").equalsIgnoreCase("true");
   const bool normalizedFormat = server.arg("fmt").equalsIgnoreCase("normalized");
 
-  // Wait for packet queue to flush out.  State will not have been updated before that.
-  // Bit hacky to call loop outside of main loop, but should be fine.
-  while (blockOnQueue && packetSender->isSending()) {
-    packetSender->loop();
+  // State isn't updated until queued packets are sent, so the response is held until they
+  // are.  handleHeldResponses writes it from the main loop, which keeps serving everything
+  // else meanwhile.
+  if (blockOnQueue) {
+    holdResponse(packetSender->lastTransaction(), true, bulbId, normalizedFormat);
+    return;
+  }
+
+  if (! allowAsync) {
+    server.send_P(200, APPLICATION_JSON, PSTR("{\"success\":true}"));
+    return;
   }
 
-  const JsonObject obj = response.json.to<JsonObject>();
   const GroupState* state = stateStore->get(bulbId);
 
-  if (blockOnQueue || allowAsync) {
-    if (state == nullptr) {
-      obj[F("error")] = F("not found");
-      response.setCode(404);
-    } else {
-      state->applyState(obj, bulbId, normalizedFormat ? NORMALIZED_GROUP_STATE_FIELDS : settings.groupStateFields);
+  if (state == nullptr) {
+    sendJsonError(404, F("not found"));
+    return;
+  }
+
+  char etag[32];
+  formatEtag(etag, bulbId, normalizedFormat);
+  server.sendHeader(F("ETag"), etag);
+
+  if (server.method() == HTTP_GET) {
+    if (const String ifNoneMatch = server.header(IF_NONE_MATCH_HEADER); ifNoneMatch.indexOf(etag) >= 0) {
+      server.send(304);
+      return;
     }
-  } else {
-    obj[F("success")] = true;
   }
+
+  // Written straight to the client, with its length measured up front
+  const GroupStateSerializer& serializer = normalizedFormat ? normalizedStateSerializer : stateSerializer;
+  server.setContentLength(serializer.measure(*state, bulbId));
+  server.send(200, APPLICATION_JSON);
+
+  WiFiClient client = server.client();
+  serializer.write(client, *state, bulbId);
 }
 
-void MiLightHttpServer::_handleGetGroup(const bool allowAsync, const BulbId &bulbId, const RequestContext& request) const {
-  sendGroupState(allowAsync, bulbId, request.response);
+void MiLightHttpServer::writeGroupState(WiFiClient& client, const BulbId& bulbId, const bool normalizedFormat) const {
+  const GroupState* state = stateStore->get(bulbId);
+
+  if (state == nullptr) {
+    sendRawResponse(client, 404, F("{\"error\":\"not found\"}"));
+    return;
+  }
+
+  char etag[32];
+  formatEtag(etag, bulbId, normalizedFormat);
+
+  const GroupStateSerializer& serializer = normalizedFormat ? normalizedStateSerializer : stateSerializer;
+  sendRawHeaders(client, 200, serializer.measure(*state, bulbId), etag);
+  serializer.write(client, *state, bulbId);
+  client.stop();
 }
 
-void MiLightHttpServer::handleGetGroupAlias(const RequestContext& request) const {
-  const String alias = request.pathVariables.get("device_alias");
+bool MiLightHttpServer::parseJsonBody(JsonDocument& body) {
+  if (deserializeJson(body, server.arg(F("plain"))) != DeserializationError::Ok) {
+    sendJsonError(400, F("Invalid JSON"));
+    return false;
+  }
+
+  return true;
+}
+
+void MiLightHttpServer::sendJsonError(const uint16_t code, const String& error) {
+  StaticJsonDocument<128> response;
+  response[F("error")] = error;
+
+  String body;
+  serializeJson(response, body);
+  server.send(code, APPLICATION_JSON, body);
+}
+
+bool MiLightHttpServer::checkHeldResponses() {
+  if (heldResponses.size() >= MILIGHT_MAX_HELD_RESPONSES) {
+    sendJsonError(503, F("Too many requests are already waiting for packets to be sent"));
+    return false;
+  }
+
+  return true;
+}
+
+void MiLightHttpServer::holdResponse(const uint32_t transactionId, const bool sendState, const BulbId& bulbId, const bool normalizedFormat) {
+  // Nothing is sent here, so the web server leaves the connection alone when this returns
+  heldResponses.push_back({server.client(), transactionId, sendState, bulbId, normalizedFormat, millis()});
+}
+
+void MiLightHttpServer::handleHeldResponses() {
+  for (auto it = heldResponses.begin(); it != heldResponses.end(); ) {
+    HeldResponse& held = *it;
+
+    if (! held.client.connected()) {
+      it = heldResponses.erase(it);
+    } else if (packetSender == nullptr || packetSender->isTransactionSent(held.transactionId)) {
+      if (held.sendState) {
+        writeGroupState(held.client, held.bulbId, held.normalizedFormat);
+      } else {
+        sendRawResponse(held.client, 200, F("{\"success\":true}"));
+      }
+      it = heldResponses.erase(it);
+    } else if (millis() - held.heldAt >= MILIGHT_HTTP_BLOCK_TIMEOUT) {
+      Serial.println(F("MiLightHttpServer: timed out waiting for packets to be sent"));
+      sendRawResponse(held.client, 504, F("{\"error\":\"Timed out waiting for packets to be sent\"}"));
+      it = heldResponses.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void MiLightHttpServer::handleGetGroupAlias(const UrlTokenBindings* bindings) {
+  const String alias = bindings->get("device_alias");
 
   const auto it = settings.groupIdAliases.find(alias);
 
   if (it == settings.groupIdAliases.end()) {
-    request.response.setCode(404);
-    request.response.json[F("error")] = F("Device alias not found");
+    sendJsonError(404, F("Device alias not found"));
+    return;
+  }
+
+  if (server.arg("blockOnQueue").equalsIgnoreCase("true") && ! checkHeldResponses()) {
     return;
   }
 
-  _handleGetGroup(true, it->second.bulbId, request);
+  sendGroupState(true, it->second.bulbId);
 }
 
-void MiLightHttpServer::handleGetGroup(const RequestContext& request) const {
-  const String _deviceId = request.pathVariables.get(GroupStateFieldNames::DEVICE_ID);
-  const uint8_t _groupId = atoi(request.pathVariables.get(GroupStateFieldNames::GROUP_ID));
-  const MiLightRemoteConfig* _remoteType = MiLightRemoteConfig::fromType(request.pathVariables.get("type"));
+void MiLightHttpServer::handleGetGroup(const UrlTokenBindings* bindings) {
+  const String _deviceId = bindings->get(GroupStateFieldNames::DEVICE_ID);
+  const uint8_t _groupId = atoi(bindings->get(GroupStateFieldNames::GROUP_ID));
+  const MiLightRemoteConfig* _remoteType = MiLightRemoteConfig::fromType(bindings->get("type"));
 
   if (_remoteType == nullptr) {
-    char buffer[40];
-    sprintf_P(buffer, PSTR("Unknown device type\n"));
-    request.response.setCode(400);
-    request.response.json["error"] = buffer;
+    sendJsonError(400, F("Unknown device type"));
+    return;
+  }
+
+  if (server.arg("blockOnQueue").equalsIgnoreCase("true") && ! checkHeldResponses()) {
     return;
   }
 
   const BulbId bulbId(parseInt<uint16_t>(_deviceId), _groupId, _remoteType->type);
-  _handleGetGroup(true, bulbId, request);
+  sendGroupState(true, bulbId);
 }
 
 void MiLightHttpServer::handleDeleteGroup(const RequestContext& request) const {
@@ -517,14 +753,13 @@ void MiLightHttpServer::_handleDeleteGroup(const BulbId &bulbId, const RequestCo
   request.response.json["success"] = true;
 }
 
-void MiLightHttpServer::handleUpdateGroupAlias(RequestContext& request) const {
-  const String alias = request.pathVariables.get("device_alias");
+void MiLightHttpServer::handleUpdateGroupAlias(const UrlTokenBindings* bindings) {
+  const String alias = bindings->get("device_alias");
 
   const auto it = settings.groupIdAliases.find(alias);
 
   if (it == settings.groupIdAliases.end()) {
-    request.response.setCode(404);
-    request.response.json[F("error")] = F("Device alias not found");
+    sendJsonError(404, F("Device alias not found"));
     return;
   }
 
@@ -534,22 +769,34 @@ void MiLightHttpServer::handleUpdateGroupAlias(RequestContext& request) const {
   if (config == nullptr) {
     char buffer[40];
     sprintf_P(buffer, PSTR("Unknown device type: %s"), bulbId.deviceType);
-    request.response.setCode(400);
-    request.response.json["error"] = buffer;
+    sendJsonError(400, buffer);
+    return;
+  }
+
+  DynamicJsonDocument requestBody(RICH_HTTP_REQUEST_BUFFER_SIZE);
+
+  // Checked before anything is sent, so a request that can't be held isn't applied
+  if (! parseJsonBody(requestBody)
+    || (server.arg("blockOnQueue").equalsIgnoreCase("true") && ! checkHeldResponses())) {
     return;
   }
 
-  milightClient->prepare(config, bulbId.deviceId, bulbId.groupId);
-  handleRequest(request.getJsonBody().as<JsonObject>());
-  sendGroupState(false, bulbId, request.response);
+  handleRequest({bulbId}, milightClient->planUpdate(requestBody.as<JsonObject>()));
+  sendGroupState(false, bulbId);
 }
 
-void MiLightHttpServer::handleUpdateGroup(RequestContext& request) const {
-  const JsonObject reqObj = request.getJsonBody().as<JsonObject>();
+void MiLightHttpServer::handleUpdateGroup(const UrlTokenBindings* bindings) {
+  DynamicJsonDocument requestBody(RICH_HTTP_REQUEST_BUFFER_SIZE);
 
-  const String _deviceIds = request.pathVariables.get(GroupStateFieldNames::DEVICE_ID);
-  const String _groupIds = request.pathVariables.get(GroupStateFieldNames::GROUP_ID);
-  const String _remoteTypes = request.pathVariables.get("type");
+  if (! parseJsonBody(requestBody)) {
+    return;
+  }
+
+  const JsonObject reqObj = requestBody.as<JsonObject>();
+
+  const String _deviceIds = bindings->get(GroupStateFieldNames::DEVICE_ID);
+  const String _groupIds = bindings->get(GroupStateFieldNames::GROUP_ID);
+  const String _remoteTypes = bindings->get("type");
   char deviceIds[_deviceIds.length()];
   char groupIds[_groupIds.length()];
   char remoteTypes[_remoteTypes.length()];
@@ -561,8 +808,9 @@ void MiLightHttpServer::handleUpdateGroup(RequestContext& request) const {
   TokenIterator groupIdItr(groupIds, _groupIds.length());
   TokenIterator remoteTypesItr(remoteTypes, _remoteTypes.length());
 
-  BulbId foundBulbId;
-  size_t groupCount = 0;
+  // Parsed once and sent to every matching group
+  const CommandPlan plan = milightClient->planUpdate(reqObj);
+  std::vector<BulbId> targets;
 
   while (remoteTypesItr.hasNext()) {
     const char* _remoteType = remoteTypesItr.nextToken();
@@ -571,8 +819,7 @@ void MiLightHttpServer::handleUpdateGroup(RequestContext& request) const {
     if (config == nullptr) {
       char buffer[40];
       sprintf_P(buffer, PSTR("Unknown device type: %s"), _remoteType);
-      request.response.setCode(400);
-      request.response.json["error"] = buffer;
+      sendJsonError(400, buffer);
       return;
     }
 
@@ -584,38 +831,50 @@ void MiLightHttpServer::handleUpdateGroup(RequestContext& request) const {
       while (groupIdItr.hasNext()) {
         const uint8_t groupId = atoi(groupIdItr.nextToken());
 
-        milightClient->prepare(config, deviceId, groupId);
-        handleRequest(reqObj);
-        foundBulbId = BulbId(deviceId, groupId, config->type);
-        groupCount++;
+        targets.emplace_back(deviceId, groupId, config->type);
       }
     }
   }
 
-  if (groupCount == 1) {
-    sendGroupState(false, foundBulbId, request.response);
+  // Only single groups send their state back, so only they can be held
+  if (targets.size() == 1
+    && server.arg("blockOnQueue").equalsIgnoreCase("true")
+    && ! checkHeldResponses()) {
+    return;
+  }
+
+  handleRequest(targets, plan);
+
+  if (targets.size() == 1) {
+    sendGroupState(false, targets.front());
   } else {
-    request.response.json["success"] = true;
+    server.send_P(200, APPLICATION_JSON, PSTR("{\"success\":true}"));
   }
 }
 
-void MiLightHttpServer::handleRequest(const JsonObject& request) const {
+void MiLightHttpServer::handleRequest(const std::vector<BulbId>& targets, const CommandPlan& plan) const {
   milightClient->setRepeatsOverride(
     settings.httpRepeatFactor * settings.packetRepeats
   );
-  milightClient->update(request);
+  milightClient->setCommandSource(CommandSource::HTTP);
+  milightClient->updateMany(targets, plan);
+  milightClient->clearCommandSource();
   milightClient->clearRepeatsOverride();
 }
 
-void MiLightHttpServer::handleSendRaw(RequestContext& request) const {
-  const JsonObject requestBody = request.getJsonBody().as<JsonObject>();
-  const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(request.pathVariables.get("type"));
+void MiLightHttpServer::handleSendRaw(const UrlTokenBindings* bindings) {
+  const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(bindings->get("type"));
 
   if (config == nullptr) {
     char buffer[50];
-    sprintf_P(buffer, PSTR("Unknown device type: %s"), request.pathVariables.get("type"));
-    request.response.setCode(400);
-    request.response.json["error"] = buffer;
+    sprintf_P(buffer, PSTR("Unknown device type: %s"), bindings->get("type"));
+    sendJsonError(400, buffer);
+    return;
+  }
+
+  DynamicJsonDocument requestBody(RICH_HTTP_REQUEST_BUFFER_SIZE);
+
+  if (! parseJsonBody(requestBody) || ! checkHeldResponses()) {
     return;
   }
 
@@ -628,14 +887,11 @@ void MiLightHttpServer::handleSendRaw(RequestContext& request) const {
     numRepeats = requestBody["num_repeats"];
   }
 
-  packetSender->enqueue(packet, config, numRepeats);
+  const uint32_t transactionId = packetSender->beginTransaction();
+  packetSender->enqueue(packet, config, numRepeats, transactionId);
 
-  // To make this response synchronous, wait for packet to be flushed
-  while (packetSender->isSending()) {
-    packetSender->loop();
-  }
-
-  request.response.json["success"] = true;
+  // To make this response synchronous, it's held until the packet has been sent
+  holdResponse(transactionId, false);
 }
 
 void MiLightHttpServer::handleWsEvent(uint8_t num, const WStype_t type, uint8_t *payload, size_t length) {
@@ -644,26 +900,32 @@ void MiLightHttpServer::handleWsEvent(uint8_t num, const WStype_t type, uint8_t
       if (numWsClients > 0) {
         numWsClients--;
       }
+      sniffer.handleDisconnect(num);
       break;
 
     case WStype_CONNECTED:
       numWsClients++;
       break;
 
+    case WStype_TEXT:
+      if (! sniffer.handleMessage(num, payload, length)) {
+        Serial.println(F("Unhandled websocket message"));
+      }
+      break;
+
     default:
       Serial.printf_P(PSTR("Unhandled websocket event: %d\n"), static_cast<uint8_t>(type));
       break;
   }
 }
 
-void MiLightHttpServer::handlePacketSent(const uint8_t *packet, const MiLightRemoteConfig& config, const BulbId& bulbId, const JsonObject& result) {
+void MiLightHttpServer::handlePacketSent(const uint8_t *packet, const MiLightRemoteConfig& config, const PacketDelta& delta) {
   if (numWsClients > 0) {
+    const BulbId& bulbId = delta.bulbId;
     DynamicJsonDocument output(1024);
 
     output[F("t")] = F("packet");
-    if (!output[F("u")].set(result)) {
-      Serial.println(F("Failed to set packet sent result"));
-    }
+    delta.toJson(output.createNestedObject(F("u")));
 
     const JsonObject device = output.createNestedObject(F("d"));
     device[F("di")] = bulbId.deviceId;
@@ -677,14 +939,19 @@ void MiLightHttpServer::handlePacketSent(const uint8_t *packet, const MiLightRem
       }
     }
 
+    // Held by pointer in the document, so it has to outlive serializing it
+    std::unique_ptr<char[]> serializedState;
+
     if (const GroupState* bulbState = this->stateStore->get(bulbId); bulbState != nullptr) {
-      const JsonObject state = output.createNestedObject(F("s"));
-      bulbState->applyState(state, bulbId, NORMALIZED_GROUP_STATE_FIELDS);
+      size_t stateLength;
+      serializedState = normalizedStateSerializer.serialize(*bulbState, bulbId, stateLength);
+      output[F("s")] = serialized(static_cast<const char*>(serializedState.get()), stateLength);
     }
 
-    char responseBuffer[300];
-    serializeJson(output, responseBuffer);
-    wsServer.broadcastTXT(reinterpret_cast<uint8_t*>(responseBuffer));
+    const size_t length = measureJson(output);
+    const std::unique_ptr<char[]> responseBuffer(new char[length + 1]);
+    serializeJson(output, responseBuffer.get(), length + 1);
+    wsServer.broadcastTXT(responseBuffer.get(), length);
   }
 }
 
@@ -749,9 +1016,95 @@ void MiLightHttpServer::handleListTransitions(const RequestContext& request) con
   }
 }
 
+void MiLightHttpServer::serializeScene(const JsonObject json, const char* id, const SceneProgram& program) {
+  json[F("id")] = id;
+  json[F("packets")] = program.getNumPackets();
+  json[F("size")] = program.getSize();
+
+  const JsonArray bulbs = json.createNestedArray(F("bulbs"));
+  for (const BulbId& bulbId : program.getBulbs()) {
+    bulbId.serialize(bulbs.createNestedObject());
+  }
+}
+
+void MiLightHttpServer::handleListScenes(const RequestContext& request) const {
+  const JsonArray list = request.response.json.to<JsonObject>().createNestedArray(F("scenes"));
+
+  scenes.forEach([&list](const char* id, const SceneProgram& program) {
+    serializeScene(list.createNestedObject(), id, program);
+  });
+}
+
+void MiLightHttpServer::handleGetScene(const RequestContext& request) const {
+  const char* id = request.pathVariables.get("id");
+  SceneProgram program;
+
+  if (! scenes.load(id, program)) {
+    request.response.setCode(404);
+    request.response.json[F("error")] = F("Scene not found");
+    return;
+  }
+
+  serializeScene(request.response.json.to<JsonObject>(), id, program);
+}
+
+void MiLightHttpServer::handleSaveScene(RequestContext& request) const {
+  const char* id = request.pathVariables.get("id");
+  SceneProgram program;
+
+  if (! SceneManager::isValidId(id)) {
+    request.response.setCode(400);
+    request.response.json[F("error")] = F("Scene IDs must be 1-24 letters, numbers, '_' or '-'");
+    return;
+  }
+
+  if (! scenes.compile(request.getJsonBody()[F("bulbs")].as<JsonArray>(), program, request.response.json)) {
+    request.response.setCode(400);
+    return;
+  }
+
+  if (! scenes.save(id, program)) {
+    request.response.setCode(500);
+    request.response.json[F("error")] = F("Could not save scene");
+    return;
+  }
+
+  request.response.json[F("success")] = true;
+  request.response.json[F("packets")] = program.getNumPackets();
+  request.response.json[F("size")] = program.getSize();
+}
+
+void MiLightHttpServer::handleDeleteScene(const RequestContext& request) const {
+  if (scenes.remove(request.pathVariables.get("id"))) {
+    request.response.json[F("success")] = true;
+  } else {
+    request.response.setCode(404);
+    request.response.json[F("error")] = F("Scene not found");
+  }
+}
+
+void MiLightHttpServer::handleRecallScene(const RequestContext& request) const {
+  if (scenes.recall(request.pathVariables.get("id"))) {
+    request.response.json[F("success")] = true;
+  } else {
+    request.response.setCode(404);
+    request.response.json[F("error")] = F("Scene not found");
+  }
+}
+
 void MiLightHttpServer::handleCreateTransition(RequestContext& request) const {
   const JsonObject body = request.getJsonBody().as<JsonObject>();
 
+  // Scene transitions list their own bulbs
+  if (body.containsKey(FPSTR(TransitionParams::BULBS))) {
+    if (milightClient->handleSceneTransition(body, request.response.json)) {
+      request.response.json[F("success")] = true;
+    } else {
+      request.response.setCode(400);
+    }
+    return;
+  }
+
   if (! body.containsKey(GroupStateFieldNames::DEVICE_ID)
     || ! body.containsKey(GroupStateFieldNames::GROUP_ID)
     || (!body.containsKey(F("remote_type")) && !body.containsKey(GroupStateFieldNames::DEVICE_TYPE))) {
@@ -1000,6 +1353,11 @@ void MiLightHttpServer::handleCreateBackup(const RequestContext &request) {
 
 
 void MiLightHttpServer::handleListGroups() {
+  if (server.hasArg(F("since"))) {
+    handleListChangedGroups();
+    return;
+  }
+
   this->stateStore->flush();
 
   server.setContentLength(CONTENT_LENGTH_UNKNOWN);
@@ -1024,10 +1382,15 @@ void MiLightHttpServer::handleListGroups() {
     device[F("device_type")] = MiLightRemoteTypeHelpers::remoteTypeToString(snd.bulbId.deviceType);
 
     const GroupState* state = this->stateStore->get(snd.bulbId);
-    const JsonObject outputState = stateBuffer.createNestedObject(F("state"));
+    // Held by pointer in the document, so it has to outlive serializing it
+    std::unique_ptr<char[]> serializedState;
+    size_t stateLength = 0;
 
     if (state != nullptr) {
-      state->applyState(outputState, snd.bulbId, NORMALIZED_GROUP_STATE_FIELDS);
+      serializedState = normalizedStateSerializer.serialize(*state, snd.bulbId, stateLength);
+      stateBuffer[F("state")] = serialized(static_cast<const char*>(serializedState.get()), stateLength);
+    } else {
+      stateBuffer.createNestedObject(F("state"));
     }
 
     client.printf("%zx\r\n", measureJson(stateBuffer)+(firstGroup ? 0 : 1));
@@ -1050,6 +1413,99 @@ void MiLightHttpServer::handleListGroups() {
   server.client().stop();
 }
 
+// Lists states that changed after the sequence number given in the `since` param, read in the
+// epoch given in the `epoch` param.  Unlike handleListGroups, this includes any known group
+// (not just aliases).  If nothing changed yet, the request is held like /gateway_traffic
+// requests are, and handleChangeListeners answers it once something does.
+void MiLightHttpServer::handleListChangedGroups() {
+  const uint32_t since = strtoul(server.arg(F("since")).c_str(), nullptr, 10);
+  // Without an epoch, the sequence can't be trusted, so the client is told to resync
+  const uint32_t epoch = server.hasArg(F("epoch"))
+    ? strtoul(server.arg(F("epoch")).c_str(), nullptr, 16)
+    : ~stateStore->getEpoch();
+
+  if (epoch == stateStore->getEpoch() && since == stateStore->getChangeSequence()) {
+    // Clients poll again after a 304, so that's the answer when too many are already waiting
+    if (changeListeners.size() >= MILIGHT_MAX_CHANGE_LISTENERS) {
+      server.send(304);
+    } else {
+      changeListeners.push_back({server.client(), since, millis()});
+    }
+    return;
+  }
+
+  WiFiClient client = server.client();
+  writeChangedGroups(client, epoch, since);
+}
+
+void MiLightHttpServer::writeChangedGroups(WiFiClient& client, const uint32_t epoch, const uint32_t since) const {
+  const uint32_t sequence = stateStore->getChangeSequence();
+  StaticJsonDocument<1024> stateBuffer;
+  bool firstGroup = true;
+
+  // The length isn't known up front, so the body runs until the client is closed
+  sendRawHeaders(client, 200);
+  client.print(F("{\"groups\":["));
+
+  const bool complete = stateStore->forEachChangedSince(
+    epoch,
+    since,
+    [&](const BulbId& bulbId, const GroupState& state, const uint32_t version) {
+      stateBuffer.clear();
+
+      const JsonObject device = stateBuffer.createNestedObject(F("device"));
+      device[F("device_id")] = bulbId.deviceId;
+      device[F("group_id")] = bulbId.groupId;
+      device[F("device_type")] = MiLightRemoteTypeHelpers::remoteTypeToString(bulbId.deviceType);
+
+      stateBuffer[F("version")] = version;
+
+      // Held by pointer in the document, so it has to outlive serializing it
+      size_t stateLength;
+      const std::unique_ptr<char[]> serializedState = normalizedStateSerializer.serialize(state, bulbId, stateLength);
+      stateBuffer[F("state")] = serialized(static_cast<const char*>(serializedState.get()), stateLength);
+
+      if (!firstGroup) {
+        client.print(',');
+      }
+      serializeJson(stateBuffer, client);
+
+      firstGroup = false;
+      yield();
+    }
+  );
+
+  // If states were evicted from the cache, or the hub restarted, the client has to start over
+  // with a full listing
+  char footer[64];
+  sprintf_P(
+    footer,
+    PSTR("],\"seq\":%u,\"epoch\":\"%08x\",\"resync\":%s}"),
+    sequence,
+    stateStore->getEpoch(),
+    complete ? "false" : "true"
+  );
+  client.print(footer);
+  client.stop();
+}
+
+void MiLightHttpServer::handleChangeListeners() {
+  for (auto it = changeListeners.begin(); it != changeListeners.end(); ) {
+    if (! it->client.connected()) {
+      it = changeListeners.erase(it);
+    } else if (stateStore->getChangeSequence() != it->since) {
+      writeChangedGroups(it->client, stateStore->getEpoch(), it->since);
+      it = changeListeners.erase(it);
+    } else if (millis() - it->listenedAt >= MILIGHT_CHANGE_LISTEN_TIMEOUT) {
+      sendRawHeaders(it->client, 304);
+      it->client.stop();
+      it = changeListeners.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 void MiLightHttpServer::handleBatchUpdateGroups(RequestContext& request) const {
   const JsonArray body = request.getJsonBody().as<JsonArray>();
 
@@ -1061,22 +1517,19 @@ void MiLightHttpServer::handleBatchUpdateGroups(RequestContext& request) const {
 
   for (auto update : body) {
     auto gateways = update[F("gateways")].as<JsonArray>();
-    auto stateUpdate = update[F("update")].as<JsonObject>();
+    const CommandPlan plan = milightClient->planUpdate(update[F("update")].as<JsonObject>());
+    std::vector<BulbId> targets;
+    targets.reserve(gateways.size());
 
     for (auto gateway : gateways) {
-      const BulbId bulbId(
+      targets.emplace_back(
         gateway[F("device_id")],
         gateway[F("group_id")],
         MiLightRemoteTypeHelpers::remoteTypeFromString(gateway[F("device_type")].as<const char*>())
       );
-
-      this->milightClient->prepare(
-        bulbId.deviceType,
-        bulbId.deviceId,
-        bulbId.groupId
-      );
-      handleRequest(stateUpdate);
     }
+
+    handleRequest(targets, plan);
   }
 
   request.response.json[F("success")] = true;
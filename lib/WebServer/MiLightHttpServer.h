@@ -8,9 +8,44 @@
 #include <RadioSwitchboard.h>
 #include <PacketSender.h>
 #include <TransitionController.h>
+#include <GroupStateSerializer.h>
+#include <SceneManager.h>
+#include <PacketSniffer.h>
 
 #define MAX_DOWNLOAD_ATTEMPTS 3
 
+// How long a synchronous response waits for its command's packets to be sent before it's
+// answered with a 504
+#ifndef MILIGHT_HTTP_BLOCK_TIMEOUT
+#define MILIGHT_HTTP_BLOCK_TIMEOUT 5000
+#endif
+
+// Synchronous responses that can be waiting for packets to be sent at once
+#ifndef MILIGHT_MAX_HELD_RESPONSES
+#define MILIGHT_MAX_HELD_RESPONSES 4
+#endif
+
+// /gateways?since= requests that can be waiting for a state to change at once
+#ifndef MILIGHT_MAX_CHANGE_LISTENERS
+#define MILIGHT_MAX_CHANGE_LISTENERS 4
+#endif
+
+// How long a /gateways?since= request waits for a state to change before it's answered with
+// a 304
+#ifndef MILIGHT_CHANGE_LISTEN_TIMEOUT
+#define MILIGHT_CHANGE_LISTEN_TIMEOUT 25000
+#endif
+
+// /gateway_traffic requests that can be waiting for a packet at once
+#ifndef MILIGHT_MAX_GATEWAY_LISTENERS
+#define MILIGHT_MAX_GATEWAY_LISTENERS 4
+#endif
+
+// How long a /gateway_traffic request waits for a packet before it's answered with a 504
+#ifndef MILIGHT_GATEWAY_TRAFFIC_TIMEOUT
+#define MILIGHT_GATEWAY_TRAFFIC_TIMEOUT 30000
+#endif
+
 typedef std::function<void()> SettingsSavedHandler;
 typedef std::function<void(const BulbId& id)> GroupDeletedHandler;
 typedef std::function<void()> THandlerFunction;
@@ -22,6 +57,7 @@ using RequestContext = RichHttpConfig::RequestContextType;
 constexpr char APPLICATION_OCTET_STREAM[] PROGMEM = "application/octet-stream";
 constexpr char TEXT_PLAIN[] PROGMEM = "text/plain";
 constexpr char APPLICATION_JSON[] = "application/json";
+constexpr char IF_NONE_MATCH_HEADER[] = "If-None-Match";
 const std::vector NORMALIZED_GROUP_STATE_FIELDS = {
     GroupStateField::STATE,
     GroupStateField::COLOR_MODE,
@@ -40,11 +76,14 @@ public:
     GroupStateStore*& stateStore,
     PacketSender*& packetSender,
     RadioSwitchboard*& radios,
-    TransitionController& transitions
+    TransitionController& transitions,
+    SceneManager& scenes,
+    const GroupStateSerializer& stateSerializer
   )
     : authProvider(settings)
     , server(80, authProvider)
     , wsServer(WebSocketsServer(8000))
+    , sniffer(wsServer)
     , numWsClients(0)
     , milightClient(milightClient)
     , settings(settings)
@@ -52,6 +91,9 @@ public:
     , packetSender(packetSender)
     , radios(radios)
     , transitions(transitions)
+    , scenes(scenes)
+    , stateSerializer(stateSerializer)
+    , normalizedStateSerializer(NORMALIZED_GROUP_STATE_FIELDS)
   { }
 
   void begin();
@@ -60,14 +102,24 @@ public:
   void onGroupDeleted(const GroupDeletedHandler &handler);
   void onAbout(const AboutHandler &handler);
   void on(const char* path, HTTPMethod method, const THandlerFunction &handler);
-  void handlePacketSent(const uint8_t* packet, const MiLightRemoteConfig& config, const BulbId& bulbId, const JsonObject& result);
+  // Broadcasts a sent or heard packet to websocket clients.  Does nothing if there are none.
+  void handlePacketSent(const uint8_t* packet, const MiLightRemoteConfig& config, const PacketDelta& delta);
+  // Passes a packet heard from a remote to sniffer sessions and waiting /gateway_traffic requests
+  void handlePacketHeard(const uint8_t* packet, const MiLightRemoteConfig& config, const PacketDelta& delta);
+  // True if something is waiting on packets from remotes, so they should be listened for
+  bool isListening() const;
   WiFiClient client();
 
 protected:
 
   bool serveFile(const char* file, const char* contentType = "text/html");
   void handleServe_P(const char* data, size_t length, const char* contentType);
-  void sendGroupState(bool allowAsync, const BulbId& bulbId, RichHttp::Response& response) const;
+  // Sends the bulb's state, or just success for an update (allowAsync false).  With
+  // blockOnQueue, the response is held until the request's packets are sent.
+  void sendGroupState(bool allowAsync, const BulbId& bulbId);
+  // Writes a complete response with the bulb's state to a held client
+  void writeGroupState(WiFiClient& client, const BulbId& bulbId, bool normalizedFormat) const;
+  void formatEtag(char* etag, const BulbId& bulbId, bool normalizedFormat) const;
 
   void serveSettings();
   void handleUpdateSettings(RequestContext& request) const;
@@ -80,16 +132,39 @@ protected:
   void handleSystemPost(RequestContext& request);
   void handleFirmwareUpload();
   void handleFirmwarePost();
-  void handleListenGateway(const RequestContext& request);
-  void handleSendRaw(RequestContext& request) const;
-
-  void handleUpdateGroup(RequestContext& request) const;
-  void handleUpdateGroupAlias(RequestContext& request) const;
+  // Registered as a simple handler, so that RichHttp doesn't respond when it returns
+  void handleListenGateway(const UrlTokenBindings* bindings);
+  // Drops /gateway_traffic requests whose client left, and answers the ones that timed out
+  void handleGatewayListeners();
+  // Writes the status line and headers of a response to a client kept from an earlier
+  // request.  Without a length, the body runs until the client is closed.
+  static void sendRawHeaders(WiFiClient& client, uint16_t code, int contentLength = -1, const char* etag = nullptr);
+  // Writes a complete response to a client kept from an earlier request, and closes it
+  static void sendRawResponse(WiFiClient& client, uint16_t code, const String& body);
+  static const __FlashStringHelper* reasonPhrase(uint16_t code);
+
+  // The handlers that can hold their response are registered as simple handlers too, and
+  // parse their own bodies.  Sends a 400 and returns false if the body isn't JSON.
+  bool parseJsonBody(JsonDocument& body);
+  void sendJsonError(uint16_t code, const String& error);
+  // True if another response can be held.  Sends a 503 if not.
+  bool checkHeldResponses();
+  void holdResponse(uint32_t transactionId, bool sendState, const BulbId& bulbId = DEFAULT_BULB_ID, bool normalizedFormat = false);
+  // Answers held responses whose packets were sent, or which timed out
+  void handleHeldResponses();
+  void handleSendRaw(const UrlTokenBindings* bindings);
+
+  void handleUpdateGroup(const UrlTokenBindings* bindings);
+  void handleUpdateGroupAlias(const UrlTokenBindings* bindings);
 
   void handleListGroups();
-  void handleGetGroup(const RequestContext& request) const;
-  void handleGetGroupAlias(const RequestContext& request) const;
-  void _handleGetGroup(bool allowAsync, const BulbId &bulbId, const RequestContext& request) const;
+  void handleListChangedGroups();
+  // Writes a complete response listing the states changed after since, and closes the client
+  void writeChangedGroups(WiFiClient& client, uint32_t epoch, uint32_t since) const;
+  // Answers /gateways?since= requests once a state changes, or with a 304 once they time out
+  void handleChangeListeners();
+  void handleGetGroup(const UrlTokenBindings* bindings);
+  void handleGetGroupAlias(const UrlTokenBindings* bindings);
   void handleBatchUpdateGroups(RequestContext& request) const;
 
   void handleDeleteGroup(const RequestContext& request) const;
@@ -101,6 +176,14 @@ protected:
   void handleCreateTransition(RequestContext& request) const;
   void handleListTransitions(const RequestContext& request) const;
 
+  // CRUD methods for /scenes
+  void handleListScenes(const RequestContext& request) const;
+  void handleGetScene(const RequestContext& request) const;
+  void handleSaveScene(RequestContext& request) const;
+  void handleDeleteScene(const RequestContext& request) const;
+  void handleRecallScene(const RequestContext& request) const;
+  static void serializeScene(JsonObject json, const char* id, const SceneProgram& program);
+
   // CRUD methods for /aliases
   void handleListAliases(const RequestContext& request) const;
   void handleCreateAlias(RequestContext& request) const;
@@ -112,7 +195,7 @@ protected:
   void handleCreateBackup(const RequestContext& request);
   void handleRestoreBackup(const RequestContext& request) const;
 
-  void handleRequest(const JsonObject& request) const;
+  void handleRequest(const std::vector<BulbId>& targets, const CommandPlan& plan) const;
   void handleWsEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length);
 
   void saveSettings() const;
@@ -122,6 +205,7 @@ protected:
   PassthroughAuthProvider<Settings> authProvider;
   RichHttpServer<RichHttp::Generics::Configs::EspressifBuiltin> server;
   WebSocketsServer wsServer;
+  PacketSniffer sniffer;
   size_t numWsClients;
   MiLightClient*& milightClient;
   Settings& settings;
@@ -132,5 +216,37 @@ protected:
   PacketSender*& packetSender;
   RadioSwitchboard*& radios;
   TransitionController& transitions;
+  SceneManager& scenes;
+  const GroupStateSerializer& stateSerializer;
+  const GroupStateSerializer normalizedStateSerializer;
   AboutHandler aboutHandler;
+
+  // A /gateway_traffic request waiting for a packet to be heard
+  struct GatewayListener {
+    WiFiClient client;
+    // Only packets from this remote answer it, or any packet if it's null
+    const MiLightRemoteConfig* remoteConfig;
+    unsigned long listenedAt;
+  };
+  std::vector<GatewayListener> gatewayListeners;
+
+  // A synchronous response, held until the packets of the request that made it are sent
+  struct HeldResponse {
+    WiFiClient client;
+    uint32_t transactionId;
+    // Answered with the bulb's state, or with success if this is false
+    bool sendState;
+    BulbId bulbId;
+    bool normalizedFormat;
+    unsigned long heldAt;
+  };
+  std::vector<HeldResponse> heldResponses;
+
+  // A /gateways?since= request waiting for a state to change
+  struct ChangeListener {
+    WiFiClient client;
+    uint32_t since;
+    unsigned long listenedAt;
+  };
+  std::vector<ChangeListener> changeListeners;
 };
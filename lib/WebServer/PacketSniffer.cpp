@@ -0,0 +1,184 @@
+#include <PacketSniffer.h>
+#include <ArduinoJson.h>
+#include <memory>
+
+static constexpr char MESSAGE_TYPE_KEY[] = "t";
+static constexpr char START_MESSAGE[] = "sniff";
+static constexpr char STOP_MESSAGE[] = "sniff_stop";
+static constexpr char REMOTE_TYPE_KEY[] = "rt";
+// Longest ,"dropped":N} added in place of the closing brace
+static constexpr size_t DROPPED_SUFFIX_LENGTH = sizeof(",\"dropped\":4294967295}");
+
+PacketSniffer::PacketSniffer(WebSocketsServer& wsServer)
+  : wsServer(wsServer)
+  , sessions()
+  , numActive(0)
+{ }
+
+bool PacketSniffer::handleMessage(const uint8_t num, const uint8_t* payload, const size_t length) {
+  StaticJsonDocument<128> message;
+
+  if (deserializeJson(message, payload, length) != DeserializationError::Ok) {
+    return false;
+  }
+
+  const char* type = message[MESSAGE_TYPE_KEY];
+
+  if (type == nullptr) {
+    return false;
+  }
+
+  if (strcmp(type, STOP_MESSAGE) == 0) {
+    stop(num);
+    return true;
+  }
+
+  if (strcmp(type, START_MESSAGE) != 0) {
+    return false;
+  }
+
+  if (const JsonVariant remoteType = message[REMOTE_TYPE_KEY]; remoteType.isNull()) {
+    start(num, REMOTE_TYPE_UNKNOWN);
+  } else if (const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(remoteType.as<String>()); config != nullptr) {
+    start(num, config->type);
+  } else {
+    sendError(num, F("Unknown device type supplied"));
+  }
+
+  return true;
+}
+
+void PacketSniffer::handleDisconnect(const uint8_t num) {
+  stop(num);
+}
+
+void PacketSniffer::handlePacket(const uint8_t* packet, const MiLightRemoteConfig& config, const PacketDelta& delta) {
+  if (numActive == 0) {
+    return;
+  }
+
+  const unsigned long now = millis();
+  // Rendered once, for the first session that takes it, and sized to fit
+  std::unique_ptr<char[]> buffer;
+  size_t length = 0;
+
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; ++num) {
+    if (! takePacket(num, config.type, now)) {
+      continue;
+    }
+
+    Session& session = sessions[num];
+
+    if (buffer == nullptr) {
+      StaticJsonDocument<384> output;
+      output[MESSAGE_TYPE_KEY] = F("sniffed_packet");
+      delta.toJson(output.createNestedObject(F("u")));
+
+      const JsonObject device = output.createNestedObject(F("d"));
+      device[F("di")] = delta.bulbId.deviceId;
+      device[F("gi")] = delta.bulbId.groupId;
+      device[F("rt")] = MiLightRemoteTypeHelpers::remoteTypeToString(config.type);
+
+      const JsonArray bytes = output.createNestedArray(F("p"));
+      for (size_t i = 0; i < config.packetFormatter->getPacketLength(); ++i) {
+        bytes.add(packet[i]);
+      }
+
+      length = measureJson(output);
+      buffer.reset(new char[length + 1]);
+      serializeJson(output, buffer.get(), length + 1);
+    }
+
+    if (session.dropped == 0) {
+      wsServer.sendTXT(num, buffer.get(), length);
+    } else {
+      // Tack the count on before the closing brace
+      const size_t capacity = length + DROPPED_SUFFIX_LENGTH;
+      const std::unique_ptr<char[]> withDropped(new char[capacity]);
+      const size_t withDroppedLength = snprintf_P(
+        withDropped.get(),
+        capacity,
+        PSTR("%.*s,\"dropped\":%u}"),
+        static_cast<int>(length - 1),
+        buffer.get(),
+        static_cast<unsigned>(session.dropped)
+      );
+
+      wsServer.sendTXT(num, withDropped.get(), std::min(withDroppedLength, capacity - 1));
+      session.dropped = 0;
+    }
+  }
+}
+
+bool PacketSniffer::isActive() const {
+  return numActive > 0;
+}
+
+bool PacketSniffer::takePacket(const uint8_t num, const MiLightRemoteType remoteType, const unsigned long now) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    return false;
+  }
+
+  Session& session = sessions[num];
+
+  if (! session.active
+    || (session.remoteType != REMOTE_TYPE_UNKNOWN && session.remoteType != remoteType)) {
+    return false;
+  }
+
+  return takeSlot(session, now);
+}
+
+size_t PacketSniffer::droppedPackets(const uint8_t num) const {
+  return num < WEBSOCKETS_SERVER_CLIENT_MAX ? sessions[num].dropped : 0;
+}
+
+void PacketSniffer::start(const uint8_t num, const MiLightRemoteType remoteType) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    return;
+  }
+
+  Session& session = sessions[num];
+
+  if (! session.active) {
+    numActive++;
+  }
+
+  session.active = true;
+  session.remoteType = remoteType;
+  session.windowStart = millis();
+  session.sentInWindow = 0;
+  session.dropped = 0;
+}
+
+void PacketSniffer::stop(const uint8_t num) {
+  if (num < WEBSOCKETS_SERVER_CLIENT_MAX && sessions[num].active) {
+    sessions[num].active = false;
+    numActive--;
+  }
+}
+
+void PacketSniffer::sendError(const uint8_t num, const __FlashStringHelper* error) {
+  StaticJsonDocument<96> output;
+  output[MESSAGE_TYPE_KEY] = F("error");
+  output[F("error")] = error;
+
+  char buffer[96];
+  const size_t length = serializeJson(output, buffer, sizeof(buffer));
+  wsServer.sendTXT(num, buffer, length);
+}
+
+bool PacketSniffer::takeSlot(Session& session, const unsigned long now) {
+  if (now - session.windowStart >= 1000) {
+    session.windowStart = now;
+    session.sentInWindow = 0;
+  }
+
+  if (session.sentInWindow >= MILIGHT_SNIFFER_MAX_RATE) {
+    session.dropped++;
+    return false;
+  }
+
+  session.sentInWindow++;
+  return true;
+}
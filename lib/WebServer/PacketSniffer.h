@@ -0,0 +1,63 @@
+#pragma once
+
+#include <WebSocketsServer.h>
+#include <MiLightRemoteConfig.h>
+#include <PacketDelta.h>
+
+// Packets sent to each sniffer client per second, at most.  Packets past that are dropped,
+// and the number dropped is reported with the next one sent.
+#ifndef MILIGHT_SNIFFER_MAX_RATE
+#define MILIGHT_SNIFFER_MAX_RATE 20
+#endif
+
+/*
+ * Streams packets heard from remotes to websocket clients that ask for them.  This replaces
+ * waiting on /gateway_traffic, which only returned one packet per request.
+ *
+ * A client starts a session by sending {"t":"sniff"}.  It can set "rt" to a remote type to
+ * only get packets from that type.  It ends the session with {"t":"sniff_stop"}.  Each packet
+ * heard is sent as {"t":"sniffed_packet","d":{...},"p":[...],"u":{...}}, with the same keys as
+ * the packet messages broadcast for every command.
+ *
+ * Each client gets at most MILIGHT_SNIFFER_MAX_RATE packets a second.  On a busy band, a
+ * slow client could otherwise leave frames queued on the heap faster than it reads them.
+ */
+class PacketSniffer {
+public:
+  explicit PacketSniffer(WebSocketsServer& wsServer);
+
+  // Handles a text message from a client.  Returns false if it isn't for the sniffer.
+  bool handleMessage(uint8_t num, const uint8_t* payload, size_t length);
+  void handleDisconnect(uint8_t num);
+  // Sends a packet heard from a remote to each session that wants it
+  void handlePacket(const uint8_t* packet, const MiLightRemoteConfig& config, const PacketDelta& delta);
+
+  // True if any client has a session
+  bool isActive() const;
+  // True if a packet from a remote of this type heard at now should be sent to the client.
+  // Counts it against the client's rate limit.
+  bool takePacket(uint8_t num, MiLightRemoteType remoteType, unsigned long now);
+  // Packets dropped for the client by the rate limit since the last one it was sent
+  size_t droppedPackets(uint8_t num) const;
+
+private:
+  struct Session {
+    bool active;
+    // Only packets from this type are sent, or from any type if it's REMOTE_TYPE_UNKNOWN
+    MiLightRemoteType remoteType;
+    unsigned long windowStart;
+    uint8_t sentInWindow;
+    // Packets dropped by the rate limit since the last one sent
+    size_t dropped;
+  };
+
+  WebSocketsServer& wsServer;
+  Session sessions[WEBSOCKETS_SERVER_CLIENT_MAX];
+  size_t numActive;
+
+  void start(uint8_t num, MiLightRemoteType remoteType);
+  void stop(uint8_t num);
+  void sendError(uint8_t num, const __FlashStringHelper* error);
+  // Counts a packet against the session's rate limit.  True if it can be sent.
+  static bool takeSlot(Session& session, unsigned long now);
+};
@@ -7,6 +7,7 @@
 #include <IntParsing.h>
 #include <LEDStatus.h>
 #include <GroupStateStore.h>
+#include <GroupStateSerializer.h>
 #include <MiLightRadioConfig.h>
 #include <MiLightRemoteConfig.h>
 #include <MiLightHttpServer.h>
@@ -20,6 +21,7 @@
 #include <PacketSender.h>
 #include <HomeAssistantDiscoveryClient.h>
 #include <TransitionController.h>
+#include <SceneManager.h>
 #include <ProjectWifi.h>
 
 #include <ESPId.h>
@@ -44,6 +46,7 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include "ProjectFS.h"
 
 WiFiManager* wifiManager;
@@ -69,10 +72,25 @@ uint8_t currentRadioType = 0;
 // For tracking and managing group state
 GroupStateStore* stateStore = nullptr;
 BulbStateUpdater* bulbStateUpdater = nullptr;
+// Serializes the state fields configured in settings.  Recompiled when settings change.
+GroupStateSerializer stateSerializer;
 TransitionController transitions;
+SceneManager scenes(settings, milightClient, packetSender, transitions);
 
 std::vector<std::shared_ptr<MiLightUdpServer>> udpServers;
 
+// Side effects of the packets handled since the end of the last command.  State is patched
+// for every packet, but MQTT updates and websocket broadcasts are sent once per command.
+struct PendingPacketEffects {
+  bool pending = false;
+  const MiLightRemoteConfig* remoteConfig = nullptr;
+  // The last packet of the command
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
+  // Fields decoded from every packet of the command, newest last
+  PacketDelta delta;
+};
+PendingPacketEffects packetEffects;
+
 /**
  * Set up UDP servers (both v5 and v6).  Clean up old ones if necessary.
  */
@@ -113,16 +131,42 @@ void initMilightUdpServers() {
 }
 
 /**
- * Milight RF packet handler.
- *
- * Called both when a packet is sent locally, and when an intercepted packet
- * is read.
+ * Publishes the state changed by the packets handled since the last call.  Called after
+ * the last packet of each command that's sent, and after every packet that's intercepted.
  */
-void onPacketSentHandler(const uint8_t* packet, const MiLightRemoteConfig& config) {
-  StaticJsonDocument<200> buffer;
-  const JsonObject result = buffer.to<JsonObject>();
+void flushPacketEffects() {
+  if (! packetEffects.pending) {
+    return;
+  }
+
+  packetEffects.pending = false;
+
+  const PacketDelta& delta = packetEffects.delta;
+  const MiLightRemoteConfig& remoteConfig = *packetEffects.remoteConfig;
+
+  // The delta is only rendered as JSON if there's an update topic or a websocket client
+  if (mqttClient) {
+    // Sends the state delta derived from the raw packets
+    mqttClient->sendUpdate(remoteConfig, delta);
+
+    // Sends the entire state
+    if (const GroupState* groupState = stateStore->get(delta.bulbId); groupState != nullptr) {
+      bulbStateUpdater->enqueueUpdate(delta.bulbId, *groupState);
+    }
+  }
+
+  httpServer->handlePacketSent(packetEffects.packet, remoteConfig, delta);
+}
 
-  const BulbId bulbId = config.packetFormatter->parsePacket(packet, result);
+/**
+ * Applies what a packet changed, once it's been decoded.
+ *
+ * Called both when a packet is sent locally (sent is true), and when an intercepted packet
+ * is read.  Updates state right away, since step packets (CCT, RGB) each move it.
+ * Everything else waits for flushPacketEffects().
+ */
+void handlePacketDelta(const uint8_t* packet, const MiLightRemoteConfig& config, const PacketDelta& result, const bool sent) {
+  const BulbId& bulbId = result.bulbId;
 
   // set LED mode for a packet movement
   ledStatus->oneshot(settings.ledModePacket, settings.ledModePacketCount);
@@ -132,35 +176,52 @@ void onPacketSentHandler(const uint8_t* packet, const MiLightRemoteConfig& confi
     return;
   }
 
+  // Commands only address one bulb, but don't mix up packets if that ever changes
+  if (packetEffects.pending && ! (packetEffects.delta.bulbId == bulbId)) {
+    flushPacketEffects();
+  }
+
+  // Our own packets leave the bulb in a known state.  One from a remote may not have
+  // reached it, so what's stored can't be trusted to skip commands.
+  if (milightClient) {
+    if (sent) {
+      milightClient->getRedundantCommandFilter().touch(bulbId);
+    } else {
+      milightClient->getRedundantCommandFilter().invalidate(bulbId);
+    }
+  }
+
   const MiLightRemoteConfig& remoteConfig =
     *MiLightRemoteConfig::fromType(bulbId.deviceType);
 
   // update state to reflect changes from this packet
-  GroupState* groupState = stateStore->get(bulbId);
+  if (const GroupState* groupState = stateStore->get(bulbId); groupState != nullptr) {
+    // pass in the previous scratch state as well
+    const GroupState stateUpdates(groupState, result);
 
-  // pass in the previous scratch state as well
-  const GroupState stateUpdates(groupState, result);
-
-  if (groupState != nullptr) {
-    groupState->patch(stateUpdates);
-
-    // Copy state before setting it to avoid group 0 re-initialization clobbering it
+    // Patching goes through the store so that it can track state versions
     stateStore->set(bulbId, stateUpdates);
   }
 
-  if (mqttClient) {
-    // Sends the state delta derived from the raw packet
-    char output[200];
-    serializeJson(result, output);
-    mqttClient->sendUpdate(remoteConfig, bulbId.deviceId, bulbId.groupId, output);
-
-    // Sends the entire state
-    if (groupState != nullptr) {
-      bulbStateUpdater->enqueueUpdate(bulbId, *groupState);
-    }
+  if (! packetEffects.pending) {
+    packetEffects.pending = true;
+    packetEffects.remoteConfig = &remoteConfig;
+    packetEffects.delta.clear();
+    packetEffects.delta.bulbId = bulbId;
   }
 
-  httpServer->handlePacketSent(packet, remoteConfig, bulbId, result);
+  packetEffects.delta.merge(result);
+  memcpy(packetEffects.packet, packet, config.packetFormatter->getPacketLength());
+}
+
+/**
+ * Milight RF packet handler, called when a packet is sent locally.
+ */
+void onPacketSentHandler(const uint8_t* packet, const MiLightRemoteConfig& config) {
+  PacketDelta result;
+  config.packetFormatter->parsePacket(packet, result);
+
+  handlePacketDelta(packet, config, result, true);
 }
 
 /**
@@ -170,21 +231,32 @@ void handleListen() {
   // Do not handle listens while there are packets enqueued to be sent
   // Doing so causes the radio module to need to be reinitialized inbetween
   // repeats, which slows things down.
-  if (! settings.listenRepeats || packetSender->isSending()) {
+  if (packetSender->isSending()) {
+    return;
+  }
+
+  // Sniffer sessions and /gateway_traffic requests need packets even if listening is off
+  const size_t listenRepeats = httpServer->isListening()
+    ? std::max<size_t>(settings.listenRepeats, 1)
+    : settings.listenRepeats;
+
+  if (listenRepeats == 0) {
     return;
   }
 
   const std::shared_ptr<MiLightRadio> radio = radios->switchRadio(currentRadioType++ % radios->getNumRadios());
 
-  for (size_t i = 0; i < settings.listenRepeats; i++) {
+  for (size_t i = 0; i < listenRepeats; i++) {
     if (radios->available()) {
       uint8_t readPacket[MILIGHT_MAX_PACKET_LENGTH];
+      uint8_t decodedPacket[MILIGHT_MAX_PACKET_LENGTH];
       const size_t packetLen = radios->read(readPacket);
 
       const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromReceivedPacket(
         radio->config(),
         readPacket,
-        packetLen
+        packetLen,
+        decodedPacket
       );
 
       if (remoteConfig == nullptr) {
@@ -195,8 +267,15 @@ void handleListen() {
         return;
       }
 
-      // update state to reflect this packet
-      onPacketSentHandler(readPacket, *remoteConfig);
+      // update state to reflect this packet.  It was decoded while finding its remote, so
+      // it isn't decoded again.  Intercepted packets aren't grouped into commands, so
+      // publish each one.
+      PacketDelta result;
+      remoteConfig->packetFormatter->parseDecodedPacket(decodedPacket, result);
+
+      handlePacketDelta(readPacket, *remoteConfig, result, false);
+      flushPacketEffects();
+      httpServer->handlePacketHeard(readPacket, *remoteConfig, result);
     }
   }
 }
@@ -240,6 +319,7 @@ void applySettings() {
   delete radios;
 
   transitions.setDefaultPeriod(settings.defaultTransitionPeriod);
+  stateSerializer.compile(settings.groupStateFields);
 
   radioFactory = MiLightRadioFactory::fromSettings(settings);
 
@@ -247,10 +327,14 @@ void applySettings() {
     Serial.println(F("ERROR: unable to construct radio factory"));
   }
 
-  stateStore = new GroupStateStore(MILIGHT_MAX_STATE_ITEMS, settings.stateFlushInterval);
+  stateStore = new GroupStateStore(
+    GroupStateCache::sizeForAvailableMemory(MILIGHT_MAX_STATE_ITEMS, MILIGHT_MAX_EXT_STATE_ITEMS),
+    settings.stateFlushInterval
+  );
 
   radios = new RadioSwitchboard(radioFactory, stateStore, settings);
   packetSender = new PacketSender(*radios, settings, onPacketSentHandler);
+  packetSender->onTransactionEnd(flushPacketEffects);
 
   milightClient = new MiLightClient(
     *radios,
@@ -263,7 +347,7 @@ void applySettings() {
   milightClient->onUpdateEnd(onUpdateEnd);
 
   if (settings.mqttServer().length() > 0) {
-    mqttClient = new MqttClient(settings, milightClient);
+    mqttClient = new MqttClient(settings, milightClient, scenes);
     mqttClient->begin();
     mqttClient->onConnect([]() {
       if (settings.homeAssistantDiscoveryPrefix.length() > 0) {
@@ -275,7 +359,7 @@ void applySettings() {
       }
     });
 
-    bulbStateUpdater = new BulbStateUpdater(settings, *mqttClient, *stateStore);
+    bulbStateUpdater = new BulbStateUpdater(settings, *mqttClient, *stateStore, stateSerializer);
   }
 
   initMilightUdpServers();
@@ -383,7 +467,7 @@ void postConnectSetup() {
   SSDP.setDeviceType("upnp:rootdevice");
   SSDP.begin();
 
-  httpServer = new MiLightHttpServer(settings, milightClient, stateStore, packetSender, radios, transitions);
+  httpServer = new MiLightHttpServer(settings, milightClient, stateStore, packetSender, radios, transitions, scenes, stateSerializer);
   httpServer->onSettingsSaved(applySettings);
   httpServer->onGroupDeleted(onGroupDeleted);
   httpServer->onAbout(aboutHandler);
@@ -392,13 +476,28 @@ void postConnectSetup() {
 
   transitions.addListener(
       [](const BulbId& bulbId, const GroupStateField field, const uint16_t value) {
-          StaticJsonDocument<100> buffer;
+          milightClient->updateField(bulbId, field, value);
+      }
+  );
+  transitions.addIncrementListener(
+      [](const BulbId& bulbId, const GroupStateField field, const IncrementDirection direction) {
+          milightClient->updateIncrement(bulbId, field, direction);
+      }
+  );
+  transitions.setAirtimeEstimator(
+      [](const BulbId& bulbId, const GroupStateField field) -> size_t {
+          const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(bulbId.deviceType);
 
-          const char* fieldName = GroupStateFieldHelpers::getFieldName(field);
-          buffer[fieldName] = value;
+          if (packetSender == nullptr || remoteConfig == nullptr) {
+            return 0;
+          }
 
-          milightClient->prepare(bulbId.deviceType, bulbId.deviceId, bulbId.groupId);
-          milightClient->update(buffer.as<JsonObject>());
+          return packetSender->estimateAirtime(remoteConfig->packetFormatter->getStepPacketCount(bulbId, field));
+      }
+  );
+  transitions.setBacklogSource(
+      []() -> unsigned long {
+          return packetSender == nullptr ? 0 : packetSender->getBacklogMillis();
       }
   );
 
@@ -550,6 +649,8 @@ void loop() {
     handleListen();
 
     stateStore->limitedFlush();
+    scenes.loop();
+    milightClient->getCommandDebouncer().loop();
     packetSender->loop();
 
     transitions.loop();
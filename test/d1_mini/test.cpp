@@ -7,10 +7,19 @@
 #include <GroupStateStore.h>
 #include <GroupStateCache.h>
 #include <GroupStatePersistence.h>
+#include <GroupStateSerializer.h>
 
 #include <RgbCctPacketFormatter.h>
 #include <FUT091PacketFormatter.h>
+#include <CctPacketFormatter.h>
+#include <V2RFEncoding.h>
 #include <Units.h>
+#include <ColorMath.h>
+#include <TransitionController.h>
+#include <MiLightClient.h>
+#include <PacketQueue.h>
+#include <SceneProgram.h>
+#include <PacketSniffer.h>
 
 #include "unity.h"
 
@@ -175,6 +184,57 @@ void test_cache() {
   storedState = cache.get(id1);
 
   TEST_ASSERT_NULL_MESSAGE(storedState, "Should evict old entry from cache");
+
+  // Lookups go through an index, which has to follow evictions and moves to the front
+  GroupStateCache lruCache(3);
+  const BulbId ids[] = {
+    BulbId(0x1234, 1, REMOTE_TYPE_RGB_CCT),
+    BulbId(0x1234, 2, REMOTE_TYPE_RGB_CCT),
+    BulbId(0x1234, 1, REMOTE_TYPE_CCT),
+    // Same low byte of the device ID as the others
+    BulbId(0x5634, 1, REMOTE_TYPE_RGB_CCT)
+  };
+
+  for (size_t i = 0; i < 3; ++i) {
+    GroupState state = color();
+    state.setHue(i * 10);
+    lruCache.set(ids[i], state);
+  }
+
+  TEST_ASSERT_NOT_NULL(lruCache.get(ids[0]));
+  lruCache.set(ids[3], color());
+
+  TEST_ASSERT_NULL_MESSAGE(lruCache.get(ids[1]), "Should evict the least recently used entry");
+  TEST_ASSERT_EQUAL(0, lruCache.get(ids[0])->getHue());
+  TEST_ASSERT_UINT16_WITHIN(2, 20, lruCache.get(ids[2])->getHue());
+  TEST_ASSERT_NOT_NULL(lruCache.get(ids[3]));
+  TEST_ASSERT_TRUE_MESSAGE(lruCache.getLru() == ids[0], "Lookups should move entries to the front");
+}
+
+void test_cache_stats() {
+  BulbId id1(1, 1, REMOTE_TYPE_FUT089);
+  BulbId id2(1, 2, REMOTE_TYPE_FUT089);
+
+  GroupStateCache cache(2);
+  cache.set(id1, color());
+  cache.get(id1);
+  cache.get(id2);
+
+  const GroupStateCacheStats stats = cache.getStats();
+
+  TEST_ASSERT_EQUAL_MESSAGE(1, stats.size, "Should count cached states");
+  TEST_ASSERT_EQUAL_MESSAGE(2, stats.maxSize, "Should report the max size");
+  // set() looks the id up too
+  TEST_ASSERT_EQUAL_MESSAGE(3, stats.lookups, "Should count lookups");
+  TEST_ASSERT_EQUAL_MESSAGE(1, stats.hits, "Should count hits");
+
+  if (! ExtMemory::isAvailable()) {
+    TEST_ASSERT_EQUAL_MESSAGE(
+      100,
+      GroupStateCache::sizeForAvailableMemory(100, 1000),
+      "Should use the default size without external memory"
+    );
+  }
 }
 
 void test_persistence() {
@@ -344,6 +404,1996 @@ void test_group_0() {
   TEST_ASSERT_TRUE_MESSAGE(storedState.isEqualIgnoreDirty(rgbState), "Should persist group 0 for device type with no groups");
 }
 
+void test_store_versions() {
+  BulbId id1(1, 1, REMOTE_TYPE_FUT089);
+  BulbId id2(1, 2, REMOTE_TYPE_FUT089);
+
+  GroupStateStore store(10, 0);
+  GroupStatePersistence persistence;
+
+  persistence.clear(id1);
+  persistence.clear(id2);
+
+  const uint32_t initialSequence = store.getChangeSequence();
+  const uint32_t initialVersion = store.getVersion(id1);
+
+  TEST_ASSERT_EQUAL_MESSAGE(initialSequence, store.getChangeSequence(), "Loading state should not bump the sequence");
+
+  store.set(id1, color());
+  const uint32_t changedVersion = store.getVersion(id1);
+  TEST_ASSERT_TRUE_MESSAGE(changedVersion > initialVersion, "Changing state should bump its version");
+
+  store.set(id1, color());
+  TEST_ASSERT_EQUAL_MESSAGE(changedVersion, store.getVersion(id1), "Patching with identical state should not bump version");
+
+  // group 0 may have changed as well, so start from the current sequence
+  const uint32_t sequence = store.getChangeSequence();
+  size_t numChanged = 0;
+  bool complete = store.forEachChangedSince(
+    store.getEpoch(),
+    sequence,
+    [&numChanged](const BulbId&, const GroupState&, uint32_t) { numChanged++; }
+  );
+  TEST_ASSERT_TRUE(complete);
+  TEST_ASSERT_EQUAL_MESSAGE(0, numChanged, "Should not list states that haven't changed");
+
+  store.set(id2, color());
+  store.forEachChangedSince(
+    store.getEpoch(),
+    sequence,
+    [&numChanged, &id2](const BulbId& id, const GroupState&, uint32_t) {
+      TEST_ASSERT_TRUE(id == id2);
+      numChanged++;
+    }
+  );
+  TEST_ASSERT_EQUAL_MESSAGE(1, numChanged, "Should list only states changed since the sequence");
+
+  // A restart picks a new epoch, and the sequence starts over.  Make the new store's sequence
+  // pass the old one, so that only the epoch tells them apart.
+  GroupStateStore restarted(10, 0);
+  TEST_ASSERT_NOT_EQUAL(store.getEpoch(), restarted.getEpoch());
+
+  while (restarted.getChangeSequence() <= sequence) {
+    GroupState changed = color();
+    changed.setHue(restarted.getChangeSequence() % 360);
+    restarted.set(id1, changed);
+  }
+
+  bool listedId1 = false;
+  complete = restarted.forEachChangedSince(
+    store.getEpoch(),
+    sequence,
+    [&listedId1, &id1](const BulbId& id, const GroupState&, uint32_t) { listedId1 |= id == id1; }
+  );
+  TEST_ASSERT_FALSE_MESSAGE(complete, "A sequence from another epoch should need a resync");
+  TEST_ASSERT_TRUE_MESSAGE(listedId1, "Every cached state should be listed for another epoch");
+
+  complete = restarted.forEachChangedSince(
+    restarted.getEpoch(),
+    restarted.getChangeSequence(),
+    [](const BulbId&, const GroupState&, uint32_t) { }
+  );
+  TEST_ASSERT_TRUE(complete);
+}
+
+// Field-by-field versions of GroupState operations, used as a reference for the
+// mask-based implementations.
+static const GroupStateField PHYSICAL_FIELDS[] = {
+  GroupStateField::BULB_MODE,
+  GroupStateField::HUE,
+  GroupStateField::KELVIN,
+  GroupStateField::MODE,
+  GroupStateField::SATURATION,
+  GroupStateField::STATE,
+  GroupStateField::BRIGHTNESS
+};
+
+void reference_patch(GroupState& state, const GroupState& other) {
+  for (const GroupStateField field : PHYSICAL_FIELDS) {
+    if (field == GroupStateField::BULB_MODE && other.isNightMode()) {
+      state.setFieldValue(field, other.getFieldValue(field));
+    } else if (other.isSetField(field) && (field == GroupStateField::STATE || state.isOn())) {
+      state.setFieldValue(field, other.getFieldValue(field));
+    }
+  }
+}
+
+bool reference_clear_non_matching(GroupState& state, const GroupState& other) {
+  bool clearedAny = false;
+
+  for (const GroupStateField field : PHYSICAL_FIELDS) {
+    if (other.isSetField(field) && state.isSetField(field) && state.getFieldValue(field) != other.getFieldValue(field)) {
+      clearedAny = state.clearField(field) || clearedAny;
+    }
+  }
+
+  return clearedAny;
+}
+
+GroupState random_state() {
+  GroupState s;
+
+  if (random(2)) s.setBulbMode(static_cast<BulbMode>(random(3)));
+  if (random(2)) s.setHue(random(360));
+  if (random(2)) s.setSaturation(random(101));
+  if (random(2)) s.setMode(random(9));
+  if (random(2)) s.setKelvin(random(101));
+  if (random(2)) s.setBrightness(random(101));
+  if (random(2)) s.setState(random(2) ? ON : OFF);
+  if (random(5) == 0) s.setBulbMode(BULB_MODE_NIGHT);
+  if (random(4) == 0) s.clearField(PHYSICAL_FIELDS[random(std::size(PHYSICAL_FIELDS))]);
+  if (random(2)) s.clearDirty();
+  if (random(2)) s.clearMqttDirty();
+
+  return s;
+}
+
+void test_state_mask_equivalence() {
+  randomSeed(42);
+
+  for (size_t i = 0; i < 2000; ++i) {
+    const GroupState a = random_state();
+    const GroupState b = random_state();
+
+    GroupState patched = a;
+    GroupState expectedPatched = a;
+    patched.patch(b);
+    reference_patch(expectedPatched, b);
+    TEST_ASSERT_TRUE_MESSAGE(patched == expectedPatched, "Mask patch should match field-by-field patch");
+
+    GroupState cleared = a;
+    GroupState expectedCleared = a;
+    const bool clearedAny = cleared.clearNonMatchingFields(b);
+    const bool expectedClearedAny = reference_clear_non_matching(expectedCleared, b);
+    TEST_ASSERT_TRUE_MESSAGE(cleared == expectedCleared, "Mask clear should match field-by-field clear");
+    TEST_ASSERT_EQUAL(expectedClearedAny, clearedAny);
+
+    GroupState aCopy = a;
+    GroupState bCopy = b;
+    aCopy.clearDirty();
+    aCopy.clearMqttDirty();
+    bCopy.clearDirty();
+    bCopy.clearMqttDirty();
+    TEST_ASSERT_EQUAL(aCopy == bCopy, a.isEqualIgnoreDirty(b));
+    TEST_ASSERT_TRUE(a.isEqualIgnoreDirty(aCopy));
+
+    yield();
+  }
+}
+
+void test_state_patch_benchmark() {
+  constexpr size_t NUM_STATES = 64;
+  constexpr size_t ITERATIONS = 20;
+  GroupState states[NUM_STATES];
+
+  randomSeed(7);
+  for (auto& state : states) {
+    state = random_state();
+  }
+
+  GroupState target;
+  unsigned long start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    for (const auto& state : states) {
+      reference_patch(target, state);
+    }
+  }
+  const unsigned long referenceTime = micros() - start;
+
+  target = GroupState();
+  start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    for (const auto& state : states) {
+      target.patch(state);
+    }
+  }
+  const unsigned long maskTime = micros() - start;
+
+  char message[100];
+  sprintf_P(
+    message,
+    PSTR("%u patches: field-by-field %luus, masks %luus"),
+    NUM_STATES * ITERATIONS,
+    referenceTime,
+    maskTime
+  );
+  TEST_MESSAGE(message);
+}
+
+// Every field, using only one of the fields rendered under "color"
+static const std::vector<GroupStateField> SERIALIZER_TEST_FIELDS = {
+  GroupStateField::STATE,
+  GroupStateField::STATUS,
+  GroupStateField::BRIGHTNESS,
+  GroupStateField::LEVEL,
+  GroupStateField::HUE,
+  GroupStateField::SATURATION,
+  GroupStateField::COMPUTED_COLOR,
+  GroupStateField::MODE,
+  GroupStateField::KELVIN,
+  GroupStateField::COLOR_TEMP,
+  GroupStateField::BULB_MODE,
+  GroupStateField::EFFECT,
+  GroupStateField::DEVICE_ID,
+  GroupStateField::GROUP_ID,
+  GroupStateField::DEVICE_TYPE,
+  GroupStateField::COLOR_MODE
+};
+
+void test_state_serializer() {
+  const BulbId bulbId(1234, 3, REMOTE_TYPE_RGB_CCT);
+  const GroupStateSerializer serializer(SERIALIZER_TEST_FIELDS);
+  StaticJsonDocument<1024> json;
+  char expected[400];
+  char actual[400];
+
+  randomSeed(42);
+
+  for (size_t i = 0; i < 500; ++i) {
+    const GroupState state = random_state();
+
+    json.clear();
+    state.applyState(json.to<JsonObject>(), bulbId, SERIALIZER_TEST_FIELDS);
+    const size_t expectedLength = serializeJson(json, expected);
+
+    const size_t length = serializer.write(actual, sizeof(actual), state, bulbId);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    TEST_ASSERT_EQUAL(expectedLength, length);
+    TEST_ASSERT_EQUAL(expectedLength, serializer.measure(state, bulbId));
+
+    // Sized to fit, however long the state is
+    size_t serializedLength;
+    const std::unique_ptr<char[]> serialized = serializer.serialize(state, bulbId, serializedLength);
+    TEST_ASSERT_EQUAL_STRING(expected, serialized.get());
+    TEST_ASSERT_EQUAL(expectedLength, serializedLength);
+
+    yield();
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(0, serializer.write(actual, 10, color(), bulbId), "Should fail if buffer is too small");
+}
+
+void test_state_serializer_benchmark() {
+  constexpr size_t ITERATIONS = 200;
+  const BulbId bulbId(1234, 3, REMOTE_TYPE_RGB_CCT);
+  const GroupStateSerializer serializer(SERIALIZER_TEST_FIELDS);
+  const GroupState state = color();
+  StaticJsonDocument<1024> json;
+  char buffer[400];
+  size_t bytes = 0;
+
+  unsigned long start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    json.clear();
+    state.applyState(json.to<JsonObject>(), bulbId, SERIALIZER_TEST_FIELDS);
+    bytes += serializeJson(json, buffer);
+  }
+  const unsigned long documentTime = micros() - start;
+
+  start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    serializer.write(buffer, sizeof(buffer), state, bulbId);
+  }
+  const unsigned long serializerTime = micros() - start;
+
+  char message[120];
+  sprintf_P(
+    message,
+    PSTR("%u bytes: JsonDocument %luus (%.2f B/us), serializer %luus (%.2f B/us)"),
+    bytes,
+    documentTime,
+    bytes / static_cast<float>(documentTime),
+    serializerTime,
+    bytes / static_cast<float>(serializerTime)
+  );
+  TEST_MESSAGE(message);
+}
+
+// Counts steps instead of sending anything
+class CountingTransition : public Transition {
+public:
+  CountingTransition(const size_t id, const size_t period, const size_t numSteps, size_t& stepCount)
+    : Transition(id, BulbId(), period, nullptr)
+    , stepsLeft(numSteps)
+    , stepCount(stepCount)
+  { }
+
+  bool isFinished() override { return stepsLeft == 0; }
+  void step() override { --stepsLeft; ++stepCount; }
+  void childSerialize(JsonObject&) override { }
+  uint8_t getFieldBits() const override { return 0; }
+
+private:
+  size_t stepsLeft;
+  size_t& stepCount;
+};
+
+void test_transition_schedule() {
+  TransitionController controller;
+  size_t steps = 0;
+  const auto transition = std::make_shared<CountingTransition>(0, 100, 1000, steps);
+
+  // Start close to millis() overflow
+  const unsigned long start = 0xFFFFFF00UL;
+  controller.addTransition(transition, start);
+
+  // Service every 7ms, so most steps run late
+  for (size_t i = 0; i < 715; ++i) {
+    controller.loop(start + i * 7);
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(50, steps, "Should step once per period");
+  TEST_ASSERT_EQUAL_MESSAGE(start + 100 * 50, transition->getNextTick(), "Should schedule from previous deadline");
+
+  // Skip missed steps rather than bursting
+  controller.loop(start + 100 * 53 + 1);
+  TEST_ASSERT_EQUAL(51, steps);
+  TEST_ASSERT_EQUAL(start + 100 * 54, transition->getNextTick());
+
+  TEST_ASSERT_TRUE(controller.deleteTransition(0));
+  controller.loop(start + 100 * 60);
+  TEST_ASSERT_EQUAL_MESSAGE(51, steps, "Should not step deleted transitions");
+  TEST_ASSERT_EQUAL(0, controller.size());
+}
+
+std::shared_ptr<Transition> build_level_transition(TransitionController& controller, const BulbId& bulbId, uint16_t start, uint16_t end) {
+  auto builder = controller.buildFieldTransition(bulbId, GroupStateField::LEVEL, start, end);
+  builder->setDuration(10);
+  builder->setPeriod(100);
+  return builder->build();
+}
+
+void test_transition_conflicts() {
+  const BulbId bulbId(1, 1, REMOTE_TYPE_FUT089);
+  TransitionController controller;
+  uint16_t lastLevel = 0;
+
+  controller.addListener([&](const BulbId& id, GroupStateField field, uint16_t value) {
+    lastLevel = value;
+    // Updates sent by transitions go through the same path as direct commands
+    controller.cancelTransitions(id, field);
+  });
+
+  controller.addTransition(build_level_transition(controller, bulbId, 0, 100), TransitionPolicy::MERGE, 0);
+  for (unsigned long now = 0; now <= 1000; now += 50) {
+    controller.loop(now);
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(10, lastLevel, "Transition shouldn't cancel itself");
+  TEST_ASSERT_EQUAL(1, controller.size());
+
+  // Merge picks up from the last value sent
+  uint16_t start = 50;
+  TEST_ASSERT_TRUE(controller.getStartValue(bulbId, GroupStateField::LEVEL, TransitionPolicy::MERGE, start));
+  TEST_ASSERT_EQUAL(10, start);
+  TEST_ASSERT_TRUE(controller.getStartValue(bulbId, GroupStateField::BRIGHTNESS, TransitionPolicy::MERGE, start));
+  TEST_ASSERT_EQUAL(26, start);
+
+  controller.addTransition(build_level_transition(controller, bulbId, 10, 0), TransitionPolicy::MERGE, 1050);
+  TEST_ASSERT_EQUAL_MESSAGE(1, controller.size(), "Merge should replace the running transition");
+  TEST_ASSERT_EQUAL(1, controller.getStats().superseded);
+  TEST_ASSERT_EQUAL(1, controller.getStats().merged);
+  TEST_ASSERT_EQUAL_MESSAGE(1100, controller.getTransitions()->data->getNextTick(), "Merge should keep cadence");
+
+  // Queued transitions start from where the previous one ends
+  TEST_ASSERT_TRUE(controller.getStartValue(bulbId, GroupStateField::LEVEL, TransitionPolicy::QUEUE, start));
+  TEST_ASSERT_EQUAL(0, start);
+  controller.addTransition(build_level_transition(controller, bulbId, 0, 100), TransitionPolicy::QUEUE, 1050);
+  TEST_ASSERT_EQUAL(2, controller.size());
+  TEST_ASSERT_EQUAL(1, controller.getStats().queued);
+
+  // Unrelated fields and bulbs don't conflict
+  const BulbId otherBulb(2, 1, REMOTE_TYPE_FUT089);
+  TEST_ASSERT_FALSE(controller.getStartValue(bulbId, GroupStateField::KELVIN, TransitionPolicy::MERGE, start));
+  TEST_ASSERT_FALSE(controller.getStartValue(otherBulb, GroupStateField::LEVEL, TransitionPolicy::MERGE, start));
+  controller.cancelTransitions(otherBulb, GroupStateField::LEVEL);
+  controller.cancelTransitions(bulbId, GroupStateField::HUE);
+  TEST_ASSERT_EQUAL(2, controller.size());
+
+  // Setting the field directly on group 0 cancels everything for the device
+  controller.cancelTransitions(BulbId(1, 0, REMOTE_TYPE_FUT089), GroupStateField::BRIGHTNESS);
+  TEST_ASSERT_EQUAL(0, controller.size());
+  TEST_ASSERT_EQUAL(2, controller.getStats().cancelled);
+
+  controller.addTransition(build_level_transition(controller, bulbId, 0, 100), TransitionPolicy::REPLACE, 2000);
+  controller.addTransition(build_level_transition(controller, bulbId, 0, 100), TransitionPolicy::REPLACE, 2000);
+  TEST_ASSERT_EQUAL(1, controller.size());
+  TEST_ASSERT_EQUAL(2, controller.getStats().superseded);
+
+  // Other groups on the same device are separate bulbs
+  const BulbId otherGroup(1, 2, REMOTE_TYPE_FUT089);
+  controller.addTransition(build_level_transition(controller, otherGroup, 0, 100), TransitionPolicy::REPLACE, 2000);
+  TEST_ASSERT_EQUAL(2, controller.size());
+  controller.cancelTransitions(bulbId, GroupStateField::LEVEL);
+  TEST_ASSERT_EQUAL(1, controller.size());
+  TEST_ASSERT_TRUE(controller.getStartValue(otherGroup, GroupStateField::LEVEL, TransitionPolicy::QUEUE, start));
+  TEST_ASSERT_FALSE(controller.getStartValue(bulbId, GroupStateField::LEVEL, TransitionPolicy::QUEUE, start));
+  controller.cancelTransitions(BulbId(1, 0, REMOTE_TYPE_FUT089), GroupStateField::LEVEL);
+  TEST_ASSERT_EQUAL(0, controller.size());
+}
+
+void test_transition_pacing() {
+  const BulbId bulbId(1, 1, REMOTE_TYPE_FUT089);
+  TransitionController controller;
+  unsigned long backlog = 0;
+  size_t packets = 0;
+  uint16_t lastLevel = 0;
+
+  controller.addListener([&](const BulbId&, GroupStateField, uint16_t value) {
+    ++packets;
+    lastLevel = value;
+  });
+  controller.setAirtimeEstimator([](const BulbId&, GroupStateField) -> size_t { return 250; });
+  controller.setBacklogSource([&backlog]() { return backlog; });
+
+  const std::shared_ptr<Transition> transition = build_level_transition(controller, bulbId, 0, 100);
+  TEST_ASSERT_EQUAL_MESSAGE(250, transition->getPeriod(), "Period should be stretched to fit a step's airtime");
+
+  controller.addTransition(transition, 0);
+  for (unsigned long now = 0; now <= 11000; now += 250) {
+    // Radio falls behind for a few steps
+    backlog = (now >= 250 && now <= 1000) ? 1000 : 0;
+    controller.loop(now + 10);
+  }
+
+  const TransitionStats& stats = controller.getStats();
+  TEST_ASSERT_EQUAL_MESSAGE(0, controller.size(), "Transition should finish on time");
+  TEST_ASSERT_EQUAL_MESSAGE(100, lastLevel, "Last step should always be sent");
+  TEST_ASSERT_EQUAL(35, stats.steps);
+  TEST_ASSERT_EQUAL(4, stats.skippedSteps);
+  TEST_ASSERT_EQUAL_MESSAGE(31, packets, "Skipped steps shouldn't send anything");
+  TEST_ASSERT_EQUAL(10, stats.maxLateness);
+}
+
+void test_transition_min_period() {
+  const BulbId bulbId(1, 1, REMOTE_TYPE_FUT089);
+  TransitionController controller;
+
+  auto builder = controller.buildFieldTransition(bulbId, GroupStateField::LEVEL, 0, 100);
+  builder->setDuration(2);
+  builder->setNumPeriods(100);
+  builder->setMinPeriod(500);
+  const std::shared_ptr<Transition> transition = builder->build();
+
+  TEST_ASSERT_EQUAL_MESSAGE(500, transition->getPeriod(), "Period should be stretched to the minimum");
+  TEST_ASSERT_EQUAL_MESSAGE(4, builder->getNumPeriods(), "Steps should be cut to keep the duration");
+  TEST_ASSERT_EQUAL(2000, builder->getOrComputeDuration());
+
+  // Periods that are already long enough are left alone
+  auto slowBuilder = controller.buildFieldTransition(bulbId, GroupStateField::LEVEL, 0, 100);
+  slowBuilder->setDuration(2);
+  slowBuilder->setNumPeriods(2);
+  slowBuilder->setMinPeriod(500);
+  slowBuilder->build();
+
+  TEST_ASSERT_EQUAL(2, slowBuilder->getNumPeriods());
+  TEST_ASSERT_EQUAL(2000, slowBuilder->getOrComputeDuration());
+}
+
+void test_scene_transition_lockstep() {
+  const std::vector<SceneTransition::Member> members = {
+    { BulbId(1, 1, REMOTE_TYPE_FUT089), GroupStateField::LEVEL, 0, 100 },
+    { BulbId(1, 2, REMOTE_TYPE_FUT089), GroupStateField::KELVIN, 100, 0 },
+    { BulbId(2, 1, REMOTE_TYPE_RGB_CCT), GroupStateField::HUE, 0, 50 }
+  };
+  TransitionController controller;
+  std::vector<uint8_t> tickOrder;
+  std::vector<uint16_t> lastValues(members.size());
+  std::vector<size_t> landedTick(members.size(), 0);
+  size_t tick = 0;
+
+  controller.addListener([&](const BulbId& bulbId, GroupStateField, uint16_t value) {
+    for (size_t i = 0; i < members.size(); ++i) {
+      if (members[i].bulbId == bulbId) {
+        tickOrder.push_back(i);
+        lastValues[i] = value;
+
+        if (value == members[i].end && landedTick[i] == 0) {
+          landedTick[i] = tick;
+        }
+      }
+    }
+  });
+  controller.setAirtimeEstimator([](const BulbId&, GroupStateField) -> size_t { return 100; });
+
+  // Running transition on one of the bulbs should be superseded
+  controller.addTransition(build_level_transition(controller, members[0].bulbId, 50, 0), 0);
+
+  auto builder = controller.buildSceneTransition(members);
+  builder->setDuration(3);
+  builder->setPeriod(100);
+  const std::shared_ptr<Transition> scene = builder->build();
+
+  TEST_ASSERT_EQUAL_MESSAGE(300, scene->getPeriod(), "Period should fit one step for every member");
+  controller.addTransition(scene, 0);
+  TEST_ASSERT_EQUAL(1, controller.getStats().superseded);
+  TEST_ASSERT_EQUAL(1, controller.size());
+
+  for (unsigned long now = 0; controller.size() > 0 && now <= 5000; now += 300) {
+    ++tick;
+    tickOrder.clear();
+    controller.loop(now);
+
+    if (! tickOrder.empty()) {
+      TEST_ASSERT_EQUAL_MESSAGE(members.size(), tickOrder.size(), "Should send one update per member per tick");
+      for (size_t i = 0; i < tickOrder.size(); ++i) {
+        TEST_ASSERT_EQUAL_MESSAGE(i, tickOrder[i], "Members should be sent in a fixed order");
+      }
+    }
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(0, controller.size(), "Scene should finish");
+  TEST_ASSERT_EQUAL_MESSAGE(10, tick, "3s at a 300ms period is 10 steps");
+  for (size_t i = 0; i < members.size(); ++i) {
+    TEST_ASSERT_EQUAL(members[i].end, lastValues[i]);
+    TEST_ASSERT_EQUAL_MESSAGE(tick, landedTick[i], "All members should land on the last tick");
+  }
+}
+
+std::vector<uint16_t> run_eased_fade(const EasingCurve easing) {
+  const BulbId bulbId(1, 1, REMOTE_TYPE_FUT089);
+  TransitionController controller;
+  std::vector<uint16_t> sent;
+
+  controller.addListener([&sent](const BulbId&, GroupStateField, uint16_t value) { sent.push_back(value); });
+
+  auto builder = controller.buildFieldTransition(bulbId, GroupStateField::LEVEL, 0, 100);
+  builder->setDuration(10);
+  builder->setPeriod(500);
+  builder->setEasing(easing);
+  controller.addTransition(builder->build(), 0);
+
+  for (unsigned long now = 0; controller.size() > 0 && now <= 20000; now += 500) {
+    controller.loop(now);
+  }
+
+  return sent;
+}
+
+void test_transition_easing() {
+  // Curves start at 0, end at 1, and never go backwards
+  for (const EasingCurve easing : { EasingCurve::LINEAR, EasingCurve::EASE_IN, EasingCurve::EASE_OUT, EasingCurve::EASE_IN_OUT, EasingCurve::GAMMA }) {
+    TEST_ASSERT_EQUAL(0, Easing::apply(easing, 0));
+    TEST_ASSERT_EQUAL(-40, Easing::interpolate(easing, -40, 7, 7));
+
+    uint16_t last = 0;
+    for (uint32_t progress = 0; progress <= Easing::ONE; progress += 97) {
+      const uint16_t value = Easing::apply(easing, progress);
+      TEST_ASSERT_TRUE(value >= last);
+      last = value;
+    }
+  }
+
+  TEST_ASSERT_EQUAL_STRING("gamma", Easing::getName(Easing::parse("gamma", EasingCurve::LINEAR)));
+  TEST_ASSERT_EQUAL(EasingCurve::LINEAR, Easing::parse("nope", EasingCurve::LINEAR));
+
+  const std::vector<uint16_t> linear = run_eased_fade(EasingCurve::LINEAR);
+  const std::vector<uint16_t> gamma = run_eased_fade(EasingCurve::GAMMA);
+
+  // 0-100 in steps of 5
+  TEST_ASSERT_EQUAL(21, linear.size());
+  TEST_ASSERT_EQUAL(5, linear[1]);
+
+  // Gamma moves slowly at the bottom.  Steps that round to the same level aren't sent.
+  const uint16_t expectedGamma[] = { 0, 1, 2, 3, 5, 7, 10, 13, 17, 22, 27, 33, 39, 46, 53, 61, 70, 79, 89, 100 };
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(expectedGamma) / sizeof(uint16_t), gamma.size(), "Repeated values should be dropped");
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(expectedGamma, gamma.data(), gamma.size());
+
+  // Color transitions land on the end color and finish
+  TransitionController controller;
+  size_t packets = 0;
+  controller.addListener([&packets](const BulbId&, GroupStateField, uint16_t) { ++packets; });
+
+  const BulbId bulbId(1, 1, REMOTE_TYPE_RGB_CCT);
+  auto builder = controller.buildColorTransition(bulbId, ParsedColor::fromRgb(255, 0, 0), ParsedColor::fromRgb(0, 0, 255));
+  builder->setDuration(2);
+  builder->setPeriod(200);
+  builder->setEasing(EasingCurve::EASE_IN_OUT);
+  const std::shared_ptr<Transition> color = builder->build();
+  controller.addTransition(color, 0);
+
+  for (unsigned long now = 0; controller.size() > 0 && now <= 10000; now += 200) {
+    controller.loop(now);
+  }
+
+  ParsedColor end;
+  TEST_ASSERT_EQUAL_MESSAGE(0, controller.size(), "Color transition should finish");
+  TEST_ASSERT_TRUE(color->getColorValue(false, end));
+  TEST_ASSERT_EQUAL(240, end.hue);
+}
+
+void test_transition_scheduler_benchmark() {
+  constexpr size_t STEPS = 10;
+  constexpr unsigned long SERVICE_INTERVAL = 5;
+  char message[120];
+
+  for (const size_t numTransitions : {1, 10, 100, 500}) {
+    // Each transition costs ~100 bytes between the object, list node and heap entry
+    if (ESP.getFreeHeap() < numTransitions * 150) {
+      sprintf_P(message, PSTR("%u transitions: skipped, not enough memory"), numTransitions);
+      TEST_MESSAGE(message);
+      continue;
+    }
+
+    TransitionController controller;
+    size_t steps = 0;
+    unsigned long now = 0;
+
+    for (size_t i = 0; i < numTransitions; ++i) {
+      controller.addTransition(std::make_shared<CountingTransition>(i, 100 + (i % 10) * 10, STEPS, steps), now);
+    }
+
+    unsigned long idleLoops = 0;
+    unsigned long idleTime = 0;
+    const unsigned long start = micros();
+
+    while (controller.size() > 0) {
+      const size_t before = steps;
+      const unsigned long loopStart = micros();
+
+      controller.loop(now);
+
+      if (steps == before) {
+        ++idleLoops;
+        idleTime += micros() - loopStart;
+      }
+      now += SERVICE_INTERVAL;
+      yield();
+    }
+    const unsigned long totalTime = micros() - start;
+
+    TEST_ASSERT_EQUAL(numTransitions * STEPS, steps);
+
+    sprintf_P(
+      message,
+      PSTR("%u transitions: %luus total, %.2fus/step, idle loop %.2fus"),
+      numTransitions,
+      totalTime,
+      totalTime / static_cast<float>(steps),
+      idleLoops == 0 ? 0.0f : idleTime / static_cast<float>(idleLoops)
+    );
+    TEST_MESSAGE(message);
+  }
+}
+
+// Accepts everything and sends nothing, so the client can run without a radio attached
+class NullRadio : public MiLightRadio {
+public:
+  explicit NullRadio(const MiLightRadioConfig& config) : radioConfig(config) { }
+
+  int begin() override { return 0; }
+  bool available() override { return false; }
+  int read(uint8_t[], size_t& frameLength) override { frameLength = 0; return 0; }
+  size_t write(uint8_t[], const size_t frameLength) override { return frameLength; }
+  int resend() override { return 0; }
+  int configure() override { return 0; }
+  const MiLightRadioConfig& config() override { return radioConfig; }
+
+private:
+  const MiLightRadioConfig& radioConfig;
+};
+
+class NullRadioFactory : public MiLightRadioFactory {
+public:
+  std::shared_ptr<MiLightRadio> create(const MiLightRadioConfig& config) override {
+    return std::make_shared<NullRadio>(config);
+  }
+};
+
+// Packet formatters keep a pointer to the store, so this is shared by tests that use the
+// client and lives for the whole run
+struct ClientFixture {
+  Settings settings;
+  GroupStateStore stateStore;
+  RadioSwitchboard switchboard;
+
+  ClientFixture()
+    : stateStore(10, 0)
+    , switchboard(std::make_shared<NullRadioFactory>(), &stateStore, settings)
+  {
+    settings.packetRepeats = 1;
+    settings.packetRepeatMinimum = 1;
+  }
+};
+
+ClientFixture& client_fixture() {
+  static ClientFixture fixture;
+  return fixture;
+}
+
+void test_transition_step_benchmark() {
+  constexpr size_t ITERATIONS = 500;
+  const BulbId bulbId(1234, 1, REMOTE_TYPE_RGB_CCT);
+
+  ClientFixture& fixture = client_fixture();
+  GroupStateStore& stateStore = fixture.stateStore;
+  PacketSender sender(fixture.switchboard, fixture.settings, nullptr);
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &stateStore, fixture.settings, transitions);
+
+  size_t packets = 0;
+  client.onUpdateEnd([&packets]() { ++packets; });
+
+  // What the transition listener used to do for each step
+  unsigned long start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    StaticJsonDocument<100> buffer;
+    buffer[GroupStateFieldNames::LEVEL] = i % 100;
+
+    client.prepare(bulbId.deviceType, bulbId.deviceId, bulbId.groupId);
+    client.update(buffer.as<JsonObject>());
+  }
+  const unsigned long jsonTime = micros() - start;
+
+  start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    client.updateField(bulbId, GroupStateField::LEVEL, i % 100);
+  }
+  const unsigned long typedTime = micros() - start;
+
+  TEST_ASSERT_EQUAL_MESSAGE(ITERATIONS * 2, packets, "Should send one update per step");
+
+  char message[120];
+  sprintf_P(
+    message,
+    PSTR("%u steps: JSON %luus (%.0f steps/s), typed %luus (%.0f steps/s)"),
+    ITERATIONS,
+    jsonTime,
+    ITERATIONS * 1000000.0f / jsonTime,
+    typedTime,
+    ITERATIONS * 1000000.0f / typedTime
+  );
+  TEST_MESSAGE(message);
+}
+
+void test_command_plan_benchmark() {
+  ClientFixture& fixture = client_fixture();
+  PacketSender sender(fixture.switchboard, fixture.settings, nullptr);
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  size_t packets = 0;
+  client.onUpdateEnd([&packets]() { ++packets; });
+
+  StaticJsonDocument<200> request;
+  request[GroupStateFieldNames::STATUS] = "ON";
+  request[GroupStateFieldNames::HUE] = 120;
+  request[GroupStateFieldNames::SATURATION] = 80;
+  request[GroupStateFieldNames::BRIGHTNESS] = 200;
+  request[GroupStateFieldNames::EFFECT] = "white_mode";
+  const JsonObject requestObj = request.as<JsonObject>();
+
+  char message[120];
+
+  for (const size_t numTargets : { 1, 8, 64 }) {
+    // What every multi-target request used to do: parse the JSON again for each bulb
+    packets = 0;
+    unsigned long start = micros();
+    for (size_t i = 0; i < numTargets; ++i) {
+      client.prepare(REMOTE_TYPE_RGB_CCT, 1234, i % 8 + 1);
+      client.update(requestObj);
+    }
+    const unsigned long jsonTime = micros() - start;
+    const size_t jsonPackets = packets;
+
+    packets = 0;
+    start = micros();
+    const CommandPlan plan = client.planUpdate(requestObj);
+    for (size_t i = 0; i < numTargets; ++i) {
+      client.prepare(REMOTE_TYPE_RGB_CCT, 1234, i % 8 + 1);
+      client.update(plan);
+    }
+    const unsigned long planTime = micros() - start;
+
+    TEST_ASSERT_EQUAL_MESSAGE(jsonPackets, packets, "Plan should send the same updates");
+    TEST_ASSERT_EQUAL(numTargets, packets);
+
+    sprintf_P(
+      message,
+      PSTR("%u targets: JSON %luus, plan %luus"),
+      numTargets,
+      jsonTime,
+      planTime
+    );
+    TEST_MESSAGE(message);
+  }
+}
+
+void test_redundant_command_filter() {
+  const BulbId bulbId(0x2222, 1, REMOTE_TYPE_RGB_CCT);
+  ClientFixture& fixture = client_fixture();
+  MiLightClient* clientPtr = nullptr;
+  size_t sent = 0;
+
+  // Tracks state from sent packets and refreshes the filter, the same way the hub does
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    ++sent;
+
+    StaticJsonDocument<200> buffer;
+    const JsonObject result = buffer.to<JsonObject>();
+    const BulbId id = config.packetFormatter->parsePacket(packet, result);
+    const GroupState updates(fixture.stateStore.get(id), result);
+    fixture.stateStore.set(id, updates);
+    clientPtr->getRedundantCommandFilter().touch(id);
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+  clientPtr = &client;
+
+  fixture.stateStore.clear(bulbId);
+  fixture.settings.suppressRedundantCommands = true;
+  fixture.settings.redundantCommandWindow = 60000;
+
+  const auto queue = [&](const char* json) {
+    StaticJsonDocument<200> request;
+    deserializeJson(request, json);
+
+    client.prepare(bulbId.deviceType, bulbId.deviceId, bulbId.groupId);
+    client.update(request.as<JsonObject>());
+  };
+  const auto send = [&](const char* json) {
+    sent = 0;
+    queue(json);
+
+    while (sender.isSending()) {
+      sender.loop();
+    }
+    return sent;
+  };
+  const RedundantCommandStats& stats = client.getRedundantCommandFilter().getStats();
+
+  TEST_ASSERT_EQUAL_MESSAGE(2, send("{\"status\":\"ON\",\"level\":50}"), "Unknown state should be sent");
+  TEST_ASSERT_EQUAL_MESSAGE(0, send("{\"status\":\"ON\",\"level\":50}"), "Known state should be skipped");
+  TEST_ASSERT_EQUAL(2, stats.suppressed);
+  TEST_ASSERT_EQUAL(2 * fixture.settings.packetRepeats, stats.packetsAvoided);
+
+  TEST_ASSERT_EQUAL_MESSAGE(2, send("{\"status\":\"ON\",\"level\":50,\"force\":true}"), "Forced commands should be sent");
+  TEST_ASSERT_EQUAL_MESSAGE(1, send("{\"status\":\"ON\",\"level\":60}"), "Only the changed field should be sent");
+  TEST_ASSERT_EQUAL(1, send("{\"status\":\"OFF\"}"));
+  TEST_ASSERT_EQUAL(0, send("{\"status\":\"OFF\"}"));
+
+  // A packet heard from a remote may not have reached the bulb
+  client.getRedundantCommandFilter().invalidate(bulbId);
+  TEST_ASSERT_EQUAL_MESSAGE(1, send("{\"status\":\"OFF\"}"), "State should be sent after a remote was heard");
+
+  // State isn't updated until queued packets are sent, so it can't be trusted until then
+  sent = 0;
+  queue("{\"status\":\"ON\"}");
+  queue("{\"status\":\"OFF\"}");
+  while (sender.isSending()) {
+    sender.loop();
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(2, sent, "Commands behind queued packets should be sent");
+
+  fixture.settings.redundantCommandWindow = 0;
+  TEST_ASSERT_EQUAL_MESSAGE(1, send("{\"status\":\"OFF\"}"), "Stale state should be sent");
+  TEST_ASSERT_EQUAL(1, stats.stale);
+
+  fixture.settings.suppressRedundantCommands = false;
+  fixture.settings.redundantCommandWindow = 60000;
+  TEST_ASSERT_EQUAL_MESSAGE(1, send("{\"status\":\"OFF\"}"), "Nothing should be skipped when disabled");
+
+  // Stepped fields take a packet per step from the known value, or drive down first
+  const BulbId cctId(0x2222, 1, REMOTE_TYPE_CCT);
+  GroupState cctState;
+  cctState.setBrightness(20);
+  fixture.stateStore.set(cctId, cctState);
+  client.prepare(cctId.deviceType, cctId.deviceId, cctId.groupId);
+
+  const PacketFormatter* cctFormatter = MiLightRemoteConfig::fromType(REMOTE_TYPE_CCT)->packetFormatter;
+  TEST_ASSERT_EQUAL(3, cctFormatter->getFieldPacketCount(GroupStateField::BRIGHTNESS, 50));
+  TEST_ASSERT_EQUAL(0, cctFormatter->getFieldPacketCount(GroupStateField::BRIGHTNESS, 20));
+  TEST_ASSERT_EQUAL(CCT_INTERVALS + 5, cctFormatter->getFieldPacketCount(GroupStateField::KELVIN, 50));
+  fixture.stateStore.clear(cctId);
+}
+
+void test_command_debouncer() {
+  const BulbId bulbId(0x3333, 1, REMOTE_TYPE_RGB_CCT);
+  ClientFixture& fixture = client_fixture();
+  std::vector<uint16_t> sent;
+  CommandDebouncer debouncer(fixture.settings, [&](const BulbId& id, const GroupStateField field, const uint16_t value) {
+    TEST_ASSERT_TRUE(id == bulbId);
+    TEST_ASSERT_EQUAL(static_cast<int>(GroupStateField::LEVEL), static_cast<int>(field));
+    sent.push_back(value);
+  });
+  const CommandDebounceStats& stats = debouncer.getStats();
+
+  fixture.settings.httpCommandDebounce = 50;
+  fixture.settings.mqttCommandDebounce = 0;
+
+  TEST_ASSERT_TRUE_MESSAGE(debouncer.submit(CommandSource::HTTP, bulbId, GroupStateField::LEVEL, 10), "First command should be sent right away");
+  TEST_ASSERT_FALSE(debouncer.submit(CommandSource::HTTP, bulbId, GroupStateField::LEVEL, 20));
+  TEST_ASSERT_FALSE(debouncer.submit(CommandSource::HTTP, bulbId, GroupStateField::LEVEL, 30));
+  TEST_ASSERT_FALSE(debouncer.submit(CommandSource::HTTP, bulbId, GroupStateField::LEVEL, 40));
+  TEST_ASSERT_EQUAL(3, stats.deferred);
+  TEST_ASSERT_EQUAL(2, stats.collapsed);
+
+  TEST_ASSERT_TRUE_MESSAGE(debouncer.submit(CommandSource::HTTP, bulbId, GroupStateField::HUE, 100), "Fields should be debounced separately");
+  TEST_ASSERT_TRUE_MESSAGE(debouncer.submit(CommandSource::HTTP, bulbId, GroupStateField::STATUS, ON), "Status should never be debounced");
+  TEST_ASSERT_TRUE_MESSAGE(debouncer.submit(CommandSource::INTERNAL, BulbId(0x3333, 2, REMOTE_TYPE_RGB_CCT), GroupStateField::LEVEL, 10), "Internal commands should never be debounced");
+
+  debouncer.loop();
+  TEST_ASSERT_EQUAL_MESSAGE(0, sent.size(), "Held values should wait for the window to end");
+
+  delay(60);
+  debouncer.loop();
+  TEST_ASSERT_EQUAL(1, sent.size());
+  TEST_ASSERT_EQUAL_MESSAGE(40, sent.front(), "Only the newest value should be sent");
+  TEST_ASSERT_EQUAL(1, stats.trailing);
+
+  // Values are dropped when something newer takes over
+  sent.clear();
+  TEST_ASSERT_FALSE_MESSAGE(
+    debouncer.submit(CommandSource::HTTP, bulbId, CommandDebouncer::slotFor(GroupStateField::BRIGHTNESS), 50),
+    "Brightness should share a window with level"
+  );
+  TEST_ASSERT_TRUE_MESSAGE(debouncer.submit(CommandSource::MQTT, bulbId, GroupStateField::LEVEL, 60), "Sources without a window should always be sent");
+  TEST_ASSERT_FALSE(debouncer.submit(CommandSource::HTTP, bulbId, GroupStateField::LEVEL, 70));
+  debouncer.cancel(bulbId);
+
+  delay(60);
+  debouncer.loop();
+  TEST_ASSERT_EQUAL_MESSAGE(0, sent.size(), "Cancelled values shouldn't be sent");
+
+  fixture.settings.httpCommandDebounce = 0;
+}
+
+void test_restamped_packets() {
+  ClientFixture& fixture = client_fixture();
+  const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(REMOTE_TYPE_CCT);
+  std::vector<uint8_t> sequences;
+
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig&) {
+    sequences.push_back(packet[CCT_SEQUENCE_INDEX]);
+  });
+
+  // Scenes queue the same stored bytes each time they're recalled
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = {};
+  sender.enqueue(packet, config, 0, PacketSender::NO_TRANSACTION, true);
+  sender.enqueue(packet, config, 0, PacketSender::NO_TRANSACTION, true);
+  while (sender.isSending()) {
+    sender.loop();
+  }
+
+  TEST_ASSERT_EQUAL(2, sequences.size());
+  TEST_ASSERT_NOT_EQUAL_MESSAGE(sequences[0], sequences[1], "Stored packets should be restamped when they're sent");
+}
+
+void test_packet_transactions() {
+  const BulbId cctBulb(0x4444, 1, REMOTE_TYPE_CCT);
+  const BulbId rgbCctBulb(0x4444, 1, REMOTE_TYPE_RGB_CCT);
+  ClientFixture& fixture = client_fixture();
+  size_t sent = 0;
+  size_t transactions = 0;
+
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t*, const MiLightRemoteConfig&) {
+    ++sent;
+  });
+  sender.onTransactionEnd([&]() {
+    ++transactions;
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  const auto send = [&](const BulbId& bulbId, const char* json) {
+    StaticJsonDocument<200> request;
+    deserializeJson(request, json);
+
+    sent = 0;
+    transactions = 0;
+    client.prepare(bulbId.deviceType, bulbId.deviceId, bulbId.groupId);
+    client.update(request.as<JsonObject>());
+
+    while (sender.isSending()) {
+      sender.loop();
+    }
+  };
+
+  // Unknown CCT brightness is set by stepping all the way down, then back up
+  fixture.stateStore.clear(cctBulb);
+  send(cctBulb, "{\"level\":50}");
+  TEST_ASSERT_GREATER_THAN(1, sent);
+  TEST_ASSERT_EQUAL_MESSAGE(1, transactions, "Step packets should end one transaction");
+
+  send(rgbCctBulb, "{\"status\":\"ON\",\"level\":50,\"hue\":100}");
+  TEST_ASSERT_EQUAL(3, sent);
+  TEST_ASSERT_EQUAL_MESSAGE(1, transactions, "Every field of an update should be one transaction");
+
+  // Packets that aren't tagged each end their own
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = {};
+  transactions = 0;
+  sender.enqueue(packet, &FUT092Config);
+  sender.enqueue(packet, &FUT092Config);
+  while (sender.isSending()) {
+    sender.loop();
+  }
+  TEST_ASSERT_EQUAL(2, transactions);
+
+  // A transaction is sent once its packets and those of earlier ones are
+  const uint32_t first = sender.beginTransaction();
+  sender.enqueue(packet, &FUT092Config, 0, first);
+  const uint32_t second = sender.beginTransaction();
+  sender.enqueue(packet, &FUT092Config, 0, second);
+  sender.enqueue(packet, &FUT092Config);
+
+  TEST_ASSERT_FALSE(sender.isTransactionSent(first));
+  TEST_ASSERT_FALSE(sender.isTransactionSent(second));
+  while (! sender.isTransactionSent(first)) {
+    sender.loop();
+  }
+  TEST_ASSERT_FALSE_MESSAGE(sender.isTransactionSent(second), "Later transactions should still be queued");
+  while (! sender.isTransactionSent(second)) {
+    sender.loop();
+  }
+  TEST_ASSERT_TRUE_MESSAGE(sender.isSending(), "Untagged packets after it shouldn't be waited for");
+  while (sender.isSending()) {
+    sender.loop();
+  }
+
+  // Held HTTP responses are answered once their transaction is sent, even if later ones
+  // were queued behind it meanwhile
+  const uint32_t third = sender.beginTransaction();
+  sender.enqueue(packet, &FUT092Config, 0, third);
+  const uint32_t fourth = sender.beginTransaction();
+  sender.enqueue(packet, &FUT092Config, 0, fourth);
+
+  while (! sender.isTransactionSent(third)) {
+    sender.loop();
+  }
+  TEST_ASSERT_FALSE(sender.isTransactionSent(fourth));
+  while (sender.isSending()) {
+    sender.loop();
+  }
+  TEST_ASSERT_TRUE_MESSAGE(sender.isTransactionSent(fourth), "A sent transaction should stay sent");
+}
+
+void test_packet_delta_benchmark() {
+  constexpr size_t ITERATIONS = 200;
+  constexpr size_t MAX_PACKETS = 32;
+  static const char* REQUESTS[] = {
+    "{\"status\":\"ON\",\"level\":40}",
+    "{\"hue\":120,\"saturation\":50}",
+    "{\"kelvin\":30}",
+    "{\"command\":\"next_mode\"}",
+    "{\"command\":\"night_mode\"}"
+  };
+
+  ClientFixture& fixture = client_fixture();
+  uint8_t packets[MAX_PACKETS][MILIGHT_MAX_PACKET_LENGTH];
+  size_t numPackets = 0;
+
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    if (numPackets < MAX_PACKETS) {
+      memcpy(packets[numPackets++], packet, config.packetFormatter->getPacketLength());
+    }
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  char message[120];
+
+  for (size_t r = 0; r < MiLightRemoteConfig::NUM_REMOTES; ++r) {
+    const MiLightRemoteConfig* config = MiLightRemoteConfig::ALL_REMOTES[r];
+    PacketFormatter* formatter = config->packetFormatter;
+    const BulbId bulbId(0x5555, 1, config->type);
+
+    numPackets = 0;
+    fixture.stateStore.clear(bulbId);
+    for (const char* json : REQUESTS) {
+      StaticJsonDocument<200> request;
+      deserializeJson(request, json);
+
+      client.prepare(config, bulbId.deviceId, bulbId.groupId);
+      client.update(request.as<JsonObject>());
+      while (sender.isSending()) {
+        sender.loop();
+      }
+    }
+    TEST_ASSERT_GREATER_THAN(0, numPackets);
+
+    const GroupState* previous = fixture.stateStore.get(bulbId);
+
+    // Both paths should decode to the same thing and patch state the same way
+    for (size_t i = 0; i < numPackets; ++i) {
+      StaticJsonDocument<200> fromJson;
+      StaticJsonDocument<200> fromDelta;
+      PacketDelta delta;
+
+      const BulbId jsonId = formatter->parsePacket(packets[i], fromJson.to<JsonObject>());
+      const BulbId deltaId = formatter->parsePacket(packets[i], delta);
+      delta.toJson(fromDelta.to<JsonObject>());
+
+      TEST_ASSERT_TRUE_MESSAGE(jsonId == deltaId, "Both paths should decode the same bulb");
+      TEST_ASSERT_TRUE_MESSAGE(deltaId == delta.bulbId, "Delta should hold the decoded bulb");
+
+      char jsonOutput[200];
+      char deltaOutput[200];
+      serializeJson(fromJson, jsonOutput);
+      serializeJson(fromDelta, deltaOutput);
+      TEST_ASSERT_EQUAL_STRING_MESSAGE(jsonOutput, deltaOutput, "Delta should render the same JSON");
+
+      const GroupState jsonState(previous, fromJson.as<JsonObject>());
+      const GroupState deltaState(previous, delta);
+      TEST_ASSERT_TRUE_MESSAGE(jsonState == deltaState, "Both paths should patch state the same way");
+    }
+
+    // What every sent or heard packet used to go through
+    unsigned long start = micros();
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+      StaticJsonDocument<200> buffer;
+      const JsonObject result = buffer.to<JsonObject>();
+      formatter->parsePacket(packets[i % numPackets], result);
+      const GroupState updated(previous, result);
+    }
+    const unsigned long jsonTime = micros() - start;
+
+    start = micros();
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+      PacketDelta delta;
+      formatter->parsePacket(packets[i % numPackets], delta);
+      const GroupState updated(previous, delta);
+    }
+    const unsigned long deltaTime = micros() - start;
+
+    sprintf_P(
+      message,
+      PSTR("%s: %u packets, JSON %luus, delta %luus"),
+      MiLightRemoteTypeHelpers::remoteTypeToString(config->type).c_str(),
+      ITERATIONS,
+      jsonTime,
+      deltaTime
+    );
+    TEST_MESSAGE(message);
+  }
+}
+
+void test_packet_classification_benchmark() {
+  constexpr size_t ITERATIONS = 200;
+
+  ClientFixture& fixture = client_fixture();
+  uint8_t packets[MiLightRemoteConfig::NUM_REMOTES][MILIGHT_MAX_PACKET_LENGTH];
+  size_t numPackets = 0;
+
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    memcpy(packets[numPackets], packet, config.packetFormatter->getPacketLength());
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  // One packet from each remote, as if it had been heard
+  for (numPackets = 0; numPackets < MiLightRemoteConfig::NUM_REMOTES; ++numPackets) {
+    const MiLightRemoteConfig* config = MiLightRemoteConfig::ALL_REMOTES[numPackets];
+
+    client.prepare(config, 0x6666, 1);
+    client.updateStatus(ON);
+    while (sender.isSending()) {
+      sender.loop();
+    }
+  }
+
+  // What every received packet used to go through
+  const auto classifyEach = [](const uint8_t* packet, const MiLightRemoteConfig& radioRemote, PacketDelta& result) {
+    for (size_t i = 0; i < MiLightRemoteConfig::NUM_REMOTES; ++i) {
+      const MiLightRemoteConfig* config = MiLightRemoteConfig::ALL_REMOTES[i];
+      const size_t len = config->packetFormatter->getPacketLength();
+
+      if (&config->radioConfig == &radioRemote.radioConfig && config->packetFormatter->canHandle(packet, len)) {
+        config->packetFormatter->parsePacket(packet, result);
+        return config;
+      }
+    }
+    return static_cast<const MiLightRemoteConfig*>(nullptr);
+  };
+  const auto classifyOnce = [](const uint8_t* packet, const MiLightRemoteConfig& radioRemote, PacketDelta& result) {
+    uint8_t decoded[MILIGHT_MAX_PACKET_LENGTH];
+    const MiLightRemoteConfig* config = MiLightRemoteConfig::fromReceivedPacket(
+      radioRemote.radioConfig,
+      packet,
+      radioRemote.packetFormatter->getPacketLength(),
+      decoded
+    );
+
+    if (config != nullptr) {
+      config->packetFormatter->parseDecodedPacket(decoded, result);
+    }
+    return config;
+  };
+
+  for (size_t i = 0; i < numPackets; ++i) {
+    const MiLightRemoteConfig& remote = *MiLightRemoteConfig::ALL_REMOTES[i];
+    PacketDelta expected;
+    PacketDelta actual;
+
+    TEST_ASSERT_TRUE_MESSAGE(classifyEach(packets[i], remote, expected) == &remote, "Should find the sending remote");
+    TEST_ASSERT_TRUE_MESSAGE(classifyOnce(packets[i], remote, actual) == &remote, "Table should find the sending remote");
+    TEST_ASSERT_TRUE(expected.bulbId == actual.bulbId);
+    TEST_ASSERT_EQUAL(expected.fields, actual.fields);
+    TEST_ASSERT_EQUAL(expected.state, actual.state);
+  }
+
+  // Packets for a V2 protocol nothing speaks shouldn't match anything
+  uint8_t unknown[V2_PACKET_LEN] = { 0x00, 0x30 };
+  uint8_t decoded[MILIGHT_MAX_PACKET_LENGTH];
+  V2RFEncoding::encodeV2Packet(unknown);
+  TEST_ASSERT_NULL(MiLightRemoteConfig::fromReceivedPacket(FUT092Config.radioConfig, unknown, V2_PACKET_LEN, decoded));
+
+  unsigned long start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    PacketDelta result;
+    classifyEach(packets[i % numPackets], *MiLightRemoteConfig::ALL_REMOTES[i % numPackets], result);
+  }
+  const unsigned long eachTime = micros() - start;
+
+  start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    PacketDelta result;
+    classifyOnce(packets[i % numPackets], *MiLightRemoteConfig::ALL_REMOTES[i % numPackets], result);
+  }
+  const unsigned long onceTime = micros() - start;
+
+  char message[120];
+  sprintf_P(
+    message,
+    PSTR("%u packets: each remote %luus (%.1fus/packet), table %luus (%.1fus/packet)"),
+    ITERATIONS,
+    eachTime,
+    static_cast<float>(eachTime) / ITERATIONS,
+    onceTime,
+    static_cast<float>(onceTime) / ITERATIONS
+  );
+  TEST_MESSAGE(message);
+}
+
+void test_packet_output() {
+  PacketFormatter* rgbCct = FUT092Config.packetFormatter;
+  PacketFormatter* cct = FUT007Config.packetFormatter;
+
+  uint8_t rgbCctBuffer[PACKET_FORMATTER_BUFFER_SIZE];
+  uint8_t cctBuffer[PACKET_FORMATTER_BUFFER_SIZE];
+  PacketStream rgbCctStream(rgbCctBuffer, sizeof(rgbCctBuffer));
+  PacketStream cctStream(cctBuffer, sizeof(cctBuffer));
+
+  // Builds for different remotes don't share storage, so one doesn't overwrite the other
+  rgbCct->prepare(0x1111, 1, &rgbCctStream);
+  cct->prepare(0x2222, 2, &cctStream);
+  rgbCct->updateStatus(ON);
+  cct->updateStatus(OFF);
+  rgbCct->endPackets();
+  cct->endPackets();
+
+  TEST_ASSERT_EQUAL(1, rgbCctStream.numPackets);
+  TEST_ASSERT_EQUAL(1, cctStream.numPackets);
+
+  PacketDelta result;
+  TEST_ASSERT_TRUE(rgbCct->parsePacket(rgbCctStream.next(), result) == BulbId(0x1111, 1, REMOTE_TYPE_RGB_CCT));
+  TEST_ASSERT_EQUAL(ON, result.state);
+  TEST_ASSERT_TRUE(cct->parsePacket(cctStream.next(), result) == BulbId(0x2222, 2, REMOTE_TYPE_CCT));
+  TEST_ASSERT_EQUAL(OFF, result.state);
+
+  // Packets that don't fit are dropped rather than written past the end
+  uint8_t smallBuffer[V2_PACKET_LEN];
+  PacketStream smallStream(smallBuffer, sizeof(smallBuffer));
+  rgbCct->prepare(0x1111, 1, &smallStream);
+  rgbCct->updateStatus(ON);
+  rgbCct->updateStatus(OFF);
+  rgbCct->endPackets();
+  TEST_ASSERT_EQUAL(1, smallStream.numPackets);
+  TEST_ASSERT_TRUE(rgbCct->parsePacket(smallStream.next(), result) == BulbId(0x1111, 1, REMOTE_TYPE_RGB_CCT));
+  TEST_ASSERT_EQUAL(ON, result.state);
+
+  // The client builds straight into the send queue
+  ClientFixture& fixture = client_fixture();
+  std::vector<BulbId> sent;
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    PacketDelta delta;
+    sent.push_back(config.packetFormatter->parsePacket(packet, delta));
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  client.prepare(&FUT092Config, 0x3333, 3);
+  client.updateStatus(ON);
+  client.prepare(&FUT007Config, 0x4444, 4);
+  client.updateStatus(ON);
+  TEST_ASSERT_EQUAL(2, sender.queueLength());
+
+  while (sender.isSending()) {
+    sender.loop();
+  }
+  TEST_ASSERT_EQUAL(2, sent.size());
+  TEST_ASSERT_TRUE(sent[0] == BulbId(0x3333, 3, REMOTE_TYPE_RGB_CCT));
+  TEST_ASSERT_TRUE(sent[1] == BulbId(0x4444, 4, REMOTE_TYPE_CCT));
+}
+
+void test_run_length_queue() {
+  const BulbId cctBulb(0x7777, 1, REMOTE_TYPE_CCT);
+  ClientFixture& fixture = client_fixture();
+  std::vector<uint8_t> sequenceNums;
+  size_t transactions = 0;
+
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    if (config.type == REMOTE_TYPE_CCT) {
+      sequenceNums.push_back(packet[CCT_SEQUENCE_INDEX]);
+    } else {
+      sequenceNums.push_back(0);
+    }
+  });
+  sender.onTransactionEnd([&]() {
+    ++transactions;
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  // Unknown brightness is driven all the way down, then back up.  Each direction is one entry.
+  fixture.stateStore.clear(cctBulb);
+  const size_t droppedBefore = sender.droppedPackets();
+  const size_t enqueuedBefore = sender.enqueuedPackets();
+
+  client.prepare(cctBulb.deviceType, cctBulb.deviceId, cctBulb.groupId);
+  client.updateBrightness(50);
+
+  const size_t numPackets = sender.enqueuedPackets() - enqueuedBefore;
+  TEST_ASSERT_EQUAL_MESSAGE(2, sender.queueLength(), "Repeated steps should share an entry");
+  TEST_ASSERT_GREATER_THAN(CCT_INTERVALS, numPackets);
+
+  while (sender.isSending()) {
+    sender.loop();
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(numPackets, sequenceNums.size(), "Every copy should be sent");
+  TEST_ASSERT_EQUAL_MESSAGE(1, transactions, "Copies should be part of the command's transaction");
+  TEST_ASSERT_EQUAL(droppedBefore, sender.droppedPackets());
+  for (size_t i = 1; i < sequenceNums.size(); ++i) {
+    TEST_ASSERT_NOT_EQUAL_MESSAGE(sequenceNums[i - 1], sequenceNums[i], "Each copy should get a new sequence number");
+  }
+
+  // Pairing repeats the same command
+  sequenceNums.clear();
+  client.prepare(&FUT092Config, 0x7777, 1);
+  client.pair();
+  TEST_ASSERT_EQUAL(1, sender.queueLength());
+
+  while (sender.isSending()) {
+    sender.loop();
+  }
+  TEST_ASSERT_EQUAL(5, sequenceNums.size());
+}
+
+void test_full_packet_queue() {
+  PacketQueue queue;
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = {};
+
+  for (size_t i = 0; i < MILIGHT_MAX_QUEUED_PACKETS; ++i) {
+    packet[0] = i;
+    queue.push(packet, &FUT092Config, 0);
+  }
+
+  TEST_ASSERT_EQUAL(0, queue.getDroppedPacketCount());
+  TEST_ASSERT_NULL_MESSAGE(queue.reserve(&FUT092Config, 0), "A full queue should have no room to build in");
+  packet[0] = 0xFF;
+  queue.push(packet, &FUT092Config, 0);
+  TEST_ASSERT_EQUAL(2, queue.getDroppedPacketCount());
+  TEST_ASSERT_EQUAL(MILIGHT_MAX_QUEUED_PACKETS, queue.size());
+
+  // Packets already queued are left alone
+  for (size_t i = 0; i < MILIGHT_MAX_QUEUED_PACKETS; ++i) {
+    TEST_ASSERT_EQUAL(i, queue.pop()->packet[0]);
+  }
+
+  // A command built while the sender's queue is full goes to the formatter's overflow packet
+  ClientFixture& fixture = client_fixture();
+  size_t sent = 0;
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t*, const MiLightRemoteConfig&) {
+    ++sent;
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  packet[0] = 0;
+  for (size_t i = 0; i < MILIGHT_MAX_QUEUED_PACKETS; ++i) {
+    sender.enqueue(packet, &FUT092Config);
+  }
+
+  client.prepare(&FUT092Config, 0x8888, 1);
+  client.updateHue(100);
+  TEST_ASSERT_GREATER_THAN(0, sender.droppedPackets());
+  TEST_ASSERT_EQUAL(MILIGHT_MAX_QUEUED_PACKETS, sender.queueLength());
+
+  while (sender.isSending()) {
+    sender.loop();
+  }
+  TEST_ASSERT_EQUAL(MILIGHT_MAX_QUEUED_PACKETS, sent);
+}
+
+// Sends a plan's fields one at a time in CommandPlan's order, the way updates were sent
+// before they were planned
+static void send_fields_in_plan_order(MiLightClient& client, const CommandPlan& plan) {
+  for (const CommandPlan::FieldOp& op : plan.fields) {
+    switch (op.field) {
+      case GroupStateField::HUE:
+        client.updateHue(op.value);
+        break;
+      case GroupStateField::SATURATION:
+        client.updateSaturation(op.value);
+        break;
+      case GroupStateField::KELVIN:
+        client.updateTemperature(op.value);
+        break;
+      case GroupStateField::EFFECT:
+        TEST_ASSERT_EQUAL(CommandPlan::EFFECT_WHITE_MODE, op.value);
+        client.updateColorWhite();
+        break;
+      case GroupStateField::LEVEL:
+        client.updateBrightness(op.value);
+        break;
+      default:
+        TEST_FAIL_MESSAGE("Field not handled by the test");
+    }
+  }
+}
+
+void test_mode_planner() {
+  ClientFixture& fixture = client_fixture();
+  size_t sent = 0;
+
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    ++sent;
+
+    StaticJsonDocument<200> buffer;
+    const JsonObject result = buffer.to<JsonObject>();
+    const BulbId id = config.packetFormatter->parsePacket(packet, result);
+    const GroupState updates(fixture.stateStore.get(id), result);
+    fixture.stateStore.set(id, updates);
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  const bool automaticModeSwitching = fixture.settings.enableAutomaticModeSwitching;
+  fixture.settings.enableAutomaticModeSwitching = true;
+
+  const auto drain = [&]() {
+    sent = 0;
+    while (sender.isSending()) {
+      sender.loop();
+    }
+    return sent;
+  };
+
+  static const char COLOR_START[] = "{\"status\":\"ON\",\"hue\":100,\"saturation\":100,\"level\":50}";
+  static const char WHITE_START[] = "{\"status\":\"ON\",\"hue\":100,\"kelvin\":40,\"effect\":\"white_mode\",\"level\":50}";
+
+  const struct {
+    const MiLightRemoteConfig* remoteConfig;
+    const char* start;
+    BulbMode startMode;
+    const char* request;
+    BulbMode endMode;
+    size_t plannedPackets;
+  } cases[] = {
+    // Temperature and hue: set the temperature while passing through white, then the hue
+    {&FUT089Config, COLOR_START, BULB_MODE_COLOR, "{\"hue\":200,\"kelvin\":30,\"level\":80}", BULB_MODE_COLOR, 4},
+    // Temperature while already white, then into color
+    {&FUT089Config, WHITE_START, BULB_MODE_WHITE, "{\"hue\":200,\"saturation\":50,\"kelvin\":30,\"level\":80}", BULB_MODE_COLOR, 4},
+    {&FUT092Config, WHITE_START, BULB_MODE_WHITE, "{\"hue\":200,\"saturation\":50,\"kelvin\":30,\"level\":80}", BULB_MODE_COLOR, 4},
+    // The temperature already switches RGB+CCT bulbs to white
+    {&FUT092Config, COLOR_START, BULB_MODE_COLOR, "{\"kelvin\":30,\"effect\":\"white_mode\",\"level\":80}", BULB_MODE_WHITE, 2},
+    {&FUT089Config, COLOR_START, BULB_MODE_COLOR, "{\"kelvin\":30,\"effect\":\"white_mode\",\"level\":80}", BULB_MODE_WHITE, 3},
+    // Saturation or temperature alone still go back to the mode the bulb was in
+    {&FUT092Config, WHITE_START, BULB_MODE_WHITE, "{\"saturation\":50,\"level\":80}", BULB_MODE_WHITE, 4},
+    {&FUT089Config, COLOR_START, BULB_MODE_COLOR, "{\"kelvin\":30,\"level\":80}", BULB_MODE_COLOR, 4},
+  };
+
+  for (const auto& testCase : cases) {
+    const BulbId bulbId(0x8888, 1, testCase.remoteConfig->type);
+    StaticJsonDocument<200> request;
+
+    const auto start = [&]() {
+      fixture.stateStore.clear(bulbId);
+      deserializeJson(request, testCase.start);
+      client.prepare(testCase.remoteConfig, bulbId.deviceId, bulbId.groupId);
+      client.update(request.as<JsonObject>());
+      drain();
+
+      TEST_ASSERT_EQUAL_MESSAGE(testCase.startMode, fixture.stateStore.get(bulbId)->getBulbMode(), testCase.start);
+      deserializeJson(request, testCase.request);
+    };
+
+    start();
+    client.prepare(testCase.remoteConfig, bulbId.deviceId, bulbId.groupId);
+    send_fields_in_plan_order(client, client.planUpdate(request.as<JsonObject>()));
+    const size_t fixedOrderPackets = drain();
+
+    start();
+    client.prepare(testCase.remoteConfig, bulbId.deviceId, bulbId.groupId);
+    client.update(request.as<JsonObject>());
+    const size_t plannedPackets = drain();
+
+    char message[120];
+    sprintf_P(
+      message,
+      PSTR("%s %s: %u packets in field order, %u planned"),
+      testCase.remoteConfig->name.c_str(),
+      testCase.request,
+      fixedOrderPackets,
+      plannedPackets
+    );
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_MESSAGE(testCase.plannedPackets, plannedPackets, testCase.request);
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(fixedOrderPackets, plannedPackets, testCase.request);
+
+    const GroupState* state = fixture.stateStore.get(bulbId);
+    const JsonObject requested = request.as<JsonObject>();
+    TEST_ASSERT_EQUAL_MESSAGE(testCase.endMode, state->getBulbMode(), testCase.request);
+    if (requested.containsKey(GroupStateFieldNames::HUE)) {
+      TEST_ASSERT_INT_WITHIN_MESSAGE(2, requested[GroupStateFieldNames::HUE].as<int>(), state->getHue(), testCase.request);
+    }
+    if (requested.containsKey(GroupStateFieldNames::KELVIN)) {
+      TEST_ASSERT_INT_WITHIN_MESSAGE(2, requested[GroupStateFieldNames::KELVIN].as<int>(), state->getKelvin(), testCase.request);
+    }
+  }
+
+  fixture.settings.enableAutomaticModeSwitching = automaticModeSwitching;
+}
+
+void test_group_fanout() {
+  // Every group of a device collapses to one group 0 command
+  const std::vector<BulbId> allGroups = {
+    BulbId(0x1234, 1, REMOTE_TYPE_RGB_CCT),
+    BulbId(0x1234, 2, REMOTE_TYPE_RGB_CCT),
+    BulbId(0x1234, 3, REMOTE_TYPE_RGB_CCT),
+    BulbId(0x1234, 4, REMOTE_TYPE_RGB_CCT)
+  };
+  std::vector<GroupFanout::Target> planned = GroupFanout::plan(allGroups);
+  TEST_ASSERT_EQUAL(1, planned.size());
+  TEST_ASSERT_TRUE(planned[0].bulbId == BulbId(0x1234, 0, REMOTE_TYPE_RGB_CCT));
+  TEST_ASSERT_EQUAL(4, planned[0].numTargets);
+
+  // Some groups, or groups of a remote with more of them, are sent one at a time
+  const std::vector<BulbId> someGroups(allGroups.begin(), allGroups.end() - 1);
+  TEST_ASSERT_EQUAL(3, GroupFanout::plan(someGroups).size());
+
+  std::vector<BulbId> fut089Groups;
+  for (const BulbId& bulbId : allGroups) {
+    fut089Groups.emplace_back(bulbId.deviceId, bulbId.groupId, REMOTE_TYPE_FUT089);
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(4, GroupFanout::plan(fut089Groups).size(), "FUT089 has 8 groups");
+
+  // Other devices keep their order around the group 0 command
+  const std::vector<BulbId> mixed = {
+    BulbId(0x1111, 2, REMOTE_TYPE_CCT),
+    allGroups[0], allGroups[1],
+    BulbId(0x1234, 1, REMOTE_TYPE_RGBW),
+    allGroups[2], allGroups[3]
+  };
+  planned = GroupFanout::plan(mixed);
+  TEST_ASSERT_EQUAL(3, planned.size());
+  TEST_ASSERT_TRUE(planned[0].bulbId == mixed[0]);
+  TEST_ASSERT_TRUE(planned[1].bulbId == BulbId(0x1234, 0, REMOTE_TYPE_RGB_CCT));
+  TEST_ASSERT_TRUE(planned[2].bulbId == mixed[3]);
+
+  // Sending to all groups takes as many packets as sending to one, and still updates each
+  // group's state
+  ClientFixture& fixture = client_fixture();
+  size_t sent = 0;
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    ++sent;
+
+    StaticJsonDocument<200> buffer;
+    const JsonObject result = buffer.to<JsonObject>();
+    const BulbId id = config.packetFormatter->parsePacket(packet, result);
+    const GroupState updates(fixture.stateStore.get(id), result);
+    fixture.stateStore.set(id, updates);
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  for (const BulbId& bulbId : allGroups) {
+    fixture.stateStore.clear(bulbId);
+  }
+
+  StaticJsonDocument<200> request;
+  deserializeJson(request, "{\"status\":\"ON\",\"level\":40}");
+  const CommandPlan plan = client.planUpdate(request.as<JsonObject>());
+
+  client.updateMany(allGroups, plan);
+  while (sender.isSending()) {
+    sender.loop();
+  }
+
+  TEST_ASSERT_EQUAL(2, sent);
+  TEST_ASSERT_EQUAL(1, client.getFanoutStats().group0Commands);
+  TEST_ASSERT_EQUAL(3, client.getFanoutStats().commandsSaved);
+  TEST_ASSERT_EQUAL(6, client.getFanoutStats().packetsSaved);
+
+  for (const BulbId& bulbId : allGroups) {
+    const GroupState* state = fixture.stateStore.get(bulbId);
+    TEST_ASSERT_NOT_NULL(state);
+    TEST_ASSERT_TRUE(state->isOn());
+    TEST_ASSERT_EQUAL(40, state->getBrightness());
+  }
+
+  // Transitions depend on each group's state, so they're sent to each group
+  sent = 0;
+  deserializeJson(request, "{\"level\":10,\"transition\":1}");
+  client.updateMany(allGroups, client.planUpdate(request.as<JsonObject>()));
+  TEST_ASSERT_EQUAL(1, client.getFanoutStats().group0Commands);
+  transitions.clear();
+}
+
+void test_scene_program() {
+  const BulbId rgbCct(0x1234, 1, REMOTE_TYPE_RGB_CCT);
+  const BulbId cct(0x5678, 2, REMOTE_TYPE_CCT);
+  ClientFixture& fixture = client_fixture();
+  PacketSender sender(fixture.switchboard, fixture.settings, nullptr);
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  SceneProgram program;
+  const auto compile = [&](const BulbId& bulbId, const char* json) {
+    StaticJsonDocument<200> request;
+    deserializeJson(request, json);
+
+    program.addBulb(bulbId);
+    client.capture(bulbId, client.planUpdate(request.as<JsonObject>()), [&program](const uint8_t* packet, const MiLightRemoteConfig& config) {
+      program.addPacket(config, packet, 0);
+    });
+  };
+
+  // Known state isn't used, so CCT brightness is driven down to the minimum and back up
+  StaticJsonDocument<50> knownState;
+  knownState[GroupStateFieldNames::LEVEL] = 50;
+  fixture.stateStore.set(cct, GroupState(fixture.stateStore.get(cct), knownState.as<JsonObject>()));
+
+  compile(rgbCct, "{\"status\":\"ON\",\"hue\":120,\"level\":80}");
+  TEST_ASSERT_EQUAL(3, program.getNumPackets());
+  compile(cct, "{\"level\":30}");
+  TEST_ASSERT_EQUAL_MESSAGE(3 + CCT_INTERVALS + 3, program.getNumPackets(), "CCT steps should not depend on state");
+  TEST_ASSERT_FALSE_MESSAGE(sender.isSending(), "Captured packets should not be queued");
+
+  // Round trip through flash
+  File file = ProjectFS.open("/test_scene.bin", "w");
+  program.dump(file);
+  file.close();
+
+  SceneProgram loaded;
+  file = ProjectFS.open("/test_scene.bin", "r");
+  TEST_ASSERT_TRUE(loaded.load(file, file.size()));
+  file.close();
+  ProjectFS.remove("/test_scene.bin");
+
+  TEST_ASSERT_EQUAL(program.getSize(), loaded.getSize());
+  TEST_ASSERT_EQUAL(program.getNumPackets(), loaded.getNumPackets());
+  TEST_ASSERT_EQUAL(2, loaded.getBulbs().size());
+  TEST_ASSERT_TRUE(loaded.getBulbs()[1] == cct);
+
+  // Restamped packets get a new sequence number, but still decode to the same command
+  size_t offset = 0;
+  SceneProgram::Packet packet;
+  while (loaded.nextPacket(offset, packet)) {
+    PacketFormatter* formatter = packet.remoteConfig->packetFormatter;
+    const size_t length = formatter->getPacketLength();
+    uint8_t restamped[MILIGHT_MAX_PACKET_LENGTH];
+    memcpy(restamped, packet.packet, length);
+    formatter->restampPacket(restamped);
+
+    StaticJsonDocument<200> expected;
+    StaticJsonDocument<200> actual;
+    const BulbId expectedId = formatter->parsePacket(packet.packet, expected.to<JsonObject>());
+    const BulbId actualId = formatter->parsePacket(restamped, actual.to<JsonObject>());
+
+    char expectedJson[200];
+    char actualJson[200];
+    serializeJson(expected, expectedJson);
+    serializeJson(actual, actualJson);
+
+    TEST_ASSERT_TRUE(expectedId == actualId);
+    TEST_ASSERT_EQUAL_STRING(expectedJson, actualJson);
+    TEST_ASSERT_TRUE_MESSAGE(memcmp(restamped, packet.packet, length) != 0, "Sequence number should change");
+  }
+  TEST_ASSERT_EQUAL(loaded.getSize() - SceneProgram::HEADER_SIZE - 2 * SceneProgram::BULB_SIZE, offset);
+}
+
+struct FadePacketCounts {
+  size_t total;
+  size_t maxPerStep;
+  uint8_t endBrightness;
+};
+
+// Runs a fade on a CCT bulb whose brightness isn't known, and counts the packets sent.  The
+// radio only catches up every sendEvery steps, so state tracked from sent packets lags.
+FadePacketCounts run_cct_fade(bool useIncrements, size_t sendEvery) {
+  const BulbId bulbId(0x1234, 1, REMOTE_TYPE_CCT);
+  ClientFixture& fixture = client_fixture();
+  FadePacketCounts counts = { 0, 0, 0 };
+
+  PacketSender sender(fixture.switchboard, fixture.settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    ++counts.total;
+
+    // Track state from sent packets the same way the hub does
+    StaticJsonDocument<200> buffer;
+    const JsonObject result = buffer.to<JsonObject>();
+    const BulbId id = config.packetFormatter->parsePacket(packet, result);
+    const GroupState updates(fixture.stateStore.get(id), result);
+    fixture.stateStore.set(id, updates);
+  });
+  TransitionController transitions;
+  MiLightClient client(fixture.switchboard, sender, &fixture.stateStore, fixture.settings, transitions);
+
+  transitions.addListener([&client](const BulbId& id, GroupStateField field, uint16_t value) {
+    client.updateField(id, field, value);
+  });
+  transitions.addIncrementListener([&client](const BulbId& id, GroupStateField field, IncrementDirection direction) {
+    client.updateIncrement(id, field, direction);
+  });
+
+  fixture.stateStore.clear(bulbId);
+
+  std::shared_ptr<Transition::Builder> builder = useIncrements
+    ? transitions.buildIncrementTransition(bulbId, GroupStateField::LEVEL, IncrementTransition::UNKNOWN_STEP, CCT_INTERVALS, CCT_INTERVALS, CCT_INTERVALS)
+    : transitions.buildFieldTransition(bulbId, GroupStateField::LEVEL, 0, 100);
+  builder->setDuration(10);
+  builder->setPeriod(500);
+  transitions.addTransition(builder->build(), 0);
+
+  size_t steps = 0;
+  for (unsigned long now = 0; transitions.size() > 0 && now < 20000; now += 10) {
+    const size_t queued = sender.enqueuedPackets();
+    transitions.loop(now);
+
+    if (sender.enqueuedPackets() != queued) {
+      counts.maxPerStep = std::max(counts.maxPerStep, sender.enqueuedPackets() - queued);
+      ++steps;
+    }
+    if (steps % sendEvery == 0) {
+      while (sender.isSending()) {
+        sender.loop();
+      }
+    }
+  }
+  while (sender.isSending()) {
+    sender.loop();
+  }
+
+  counts.endBrightness = fixture.stateStore.get(bulbId)->getBrightness();
+  return counts;
+}
+
+void test_increment_transition_packets() {
+  char message[120];
+
+  for (const size_t sendEvery : {1, 2}) {
+    const FadePacketCounts fieldCounts = run_cct_fade(false, sendEvery);
+    const FadePacketCounts incrementCounts = run_cct_fade(true, sendEvery);
+
+    TEST_ASSERT_EQUAL_MESSAGE(2 * CCT_INTERVALS, incrementCounts.total, "Should reset, then step up once per interval");
+    TEST_ASSERT_EQUAL_MESSAGE(1, incrementCounts.maxPerStep, "Should send one packet per step");
+    TEST_ASSERT_EQUAL(100, incrementCounts.endBrightness);
+    TEST_ASSERT_TRUE(incrementCounts.total <= fieldCounts.total);
+
+    sprintf_P(
+      message,
+      PSTR("radio catches up every %u steps: field %u packets (max %u/step, ends at %u), increments %u packets"),
+      sendEvery,
+      fieldCounts.total,
+      fieldCounts.maxPerStep,
+      fieldCounts.endBrightness,
+      incrementCounts.total
+    );
+    TEST_MESSAGE(message);
+  }
+}
+
+//================================================================================
+// Color math
+//================================================================================
+
+// Double versions of the conversions, as RGBConverter did them.  Used as a reference for the
+// integer versions in ColorMath.
+void reference_rgb_to_hsv(const uint8_t r, const uint8_t g, const uint8_t b, uint16_t& hue, uint8_t& saturation) {
+  const double rd = r / 255.0, gd = g / 255.0, bd = b / 255.0;
+  const double max = std::max(rd, std::max(gd, bd)), min = std::min(rd, std::min(gd, bd));
+  const double d = max - min;
+  double h = 0;
+
+  if (max != min) {
+    if (max == rd) {
+      h = (gd - bd) / d + (gd < bd ? 6 : 0);
+    } else if (max == gd) {
+      h = (bd - rd) / d + 2;
+    } else {
+      h = (rd - gd) / d + 4;
+    }
+    h /= 6;
+  }
+
+  hue = round(h * 360);
+  saturation = round((max == 0 ? 0 : d / max) * 100);
+}
+
+void reference_hsv_to_rgb(const uint16_t hue, const uint8_t saturation, uint8_t rgb[3]) {
+  const double h = hue / 360.0, s = saturation / 100.0;
+  const int i = static_cast<int>(h * 6);
+  const double f = h * 6 - i;
+  const double p = 1 - s, q = 1 - f * s, t = 1 - (1 - f) * s;
+  double r, g, b;
+
+  switch (i % 6) {
+    case 0: r = 1, g = t, b = p; break;
+    case 1: r = q, g = 1, b = p; break;
+    case 2: r = p, g = 1, b = t; break;
+    case 3: r = p, g = q, b = 1; break;
+    case 4: r = t, g = p, b = 1; break;
+    default: r = 1, g = p, b = q; break;
+  }
+
+  rgb[0] = r * 255;
+  rgb[1] = g * 255;
+  rgb[2] = b * 255;
+}
+
+void test_color_math() {
+  uint16_t hue;
+  uint8_t saturation;
+  uint8_t rgb[3];
+
+  ColorMath::rgbToHsv(255, 0, 0, hue, saturation);
+  TEST_ASSERT_EQUAL(0, hue);
+  TEST_ASSERT_EQUAL(100, saturation);
+  ColorMath::rgbToHsv(0, 255, 0, hue, saturation);
+  TEST_ASSERT_EQUAL(120, hue);
+  ColorMath::rgbToHsv(0, 0, 255, hue, saturation);
+  TEST_ASSERT_EQUAL(240, hue);
+  ColorMath::rgbToHsv(255, 0, 128, hue, saturation);
+  TEST_ASSERT_EQUAL(330, hue);
+  ColorMath::rgbToHsv(128, 128, 128, hue, saturation);
+  TEST_ASSERT_EQUAL(0, hue);
+  TEST_ASSERT_EQUAL(0, saturation);
+  ColorMath::rgbToHsv(0, 0, 0, hue, saturation);
+  TEST_ASSERT_EQUAL(0, saturation);
+
+  const uint8_t red[] = {255, 0, 0};
+  const uint8_t blue[] = {0, 0, 255};
+  const uint8_t paleYellow[] = {255, 255, 127};
+  const uint8_t white[] = {255, 255, 255};
+
+  ColorMath::hsvToRgb(0, 100, rgb);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(red, rgb, 3);
+  ColorMath::hsvToRgb(240, 100, rgb);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(blue, rgb, 3);
+  ColorMath::hsvToRgb(360, 100, rgb);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(red, rgb, 3);
+  ColorMath::hsvToRgb(60, 50, rgb);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(paleYellow, rgb, 3);
+  ColorMath::hsvToRgb(123, 0, rgb);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(white, rgb, 3);
+
+  // Within 1 of the double versions everywhere
+  for (uint16_t r = 0; r < 256; r += 5) {
+    for (uint16_t g = 0; g < 256; g += 3) {
+      for (uint16_t b = 0; b < 256; b += 7) {
+        uint16_t expectedHue;
+        uint8_t expectedSaturation;
+
+        ColorMath::rgbToHsv(r, g, b, hue, saturation);
+        reference_rgb_to_hsv(r, g, b, expectedHue, expectedSaturation);
+        TEST_ASSERT_INT_WITHIN(1, expectedHue, hue);
+        TEST_ASSERT_INT_WITHIN(1, expectedSaturation, saturation);
+      }
+    }
+    yield();
+  }
+
+  for (uint16_t h = 0; h <= 360; ++h) {
+    for (uint8_t s = 0; s <= 100; ++s) {
+      uint8_t expected[3];
+
+      ColorMath::hsvToRgb(h, s, rgb);
+      reference_hsv_to_rgb(h, s, expected);
+      for (size_t i = 0; i < 3; ++i) {
+        TEST_ASSERT_INT_WITHIN(1, expected[i], rgb[i]);
+      }
+    }
+    yield();
+  }
+
+  // rescale rounds the same way the float version did
+  for (uint16_t v = 0; v <= 255; ++v) {
+    TEST_ASSERT_EQUAL(round(v * (100 / 255.0f)), Units::rescale(v, 100, 255));
+    TEST_ASSERT_EQUAL(round(v * (360 / 255.0f)), Units::rescale(v, 360, 255));
+  }
+  TEST_ASSERT_EQUAL(-4, Units::rescale(static_cast<int16_t>(-1), 100, 25));
+  TEST_ASSERT_EQUAL(255, Units::miredsToWhiteVal(COLOR_TEMP_MAX_MIREDS));
+  TEST_ASSERT_EQUAL(COLOR_TEMP_MIN_MIREDS, Units::whiteValToMireds(0));
+}
+
+void test_color_math_benchmark() {
+  constexpr size_t ITERATIONS = 2000;
+  uint16_t hue;
+  uint8_t saturation;
+  uint8_t rgb[3];
+  uint32_t sink = 0;
+
+  unsigned long start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    reference_rgb_to_hsv(i, i * 7, i * 13, hue, saturation);
+    reference_hsv_to_rgb(i % 361, i % 101, rgb);
+    sink += hue + saturation + rgb[0];
+  }
+  const unsigned long referenceTime = micros() - start;
+
+  start = micros();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    ColorMath::rgbToHsv(i, i * 7, i * 13, hue, saturation);
+    ColorMath::hsvToRgb(i % 361, i % 101, rgb);
+    sink += hue + saturation + rgb[0];
+  }
+  const unsigned long integerTime = micros() - start;
+
+  char message[100];
+  sprintf_P(
+    message,
+    PSTR("%u round trips: double %luus, integer %luus (%u)"),
+    ITERATIONS,
+    referenceTime,
+    integerTime,
+    sink
+  );
+  TEST_MESSAGE(message);
+}
+
+//================================================================================
+// Packet sniffer
+//================================================================================
+
+void test_packet_sniffer() {
+  // Never started, so sending to a client only fails
+  static WebSocketsServer wsServer(8001);
+  PacketSniffer sniffer(wsServer);
+
+  const auto sendMessage = [&](const uint8_t num, const char* message) {
+    return sniffer.handleMessage(num, reinterpret_cast<const uint8_t*>(message), strlen(message));
+  };
+
+  TEST_ASSERT_FALSE(sniffer.isActive());
+  TEST_ASSERT_FALSE_MESSAGE(sendMessage(0, "{\"t\":\"other\"}"), "Other messages should be left alone");
+  TEST_ASSERT_FALSE(sniffer.takePacket(0, REMOTE_TYPE_RGB_CCT, 0));
+
+  TEST_ASSERT_TRUE(sendMessage(0, "{\"t\":\"sniff\",\"rt\":\"nope\"}"));
+  TEST_ASSERT_FALSE_MESSAGE(sniffer.isActive(), "An unknown type shouldn't start a session");
+
+  // Client 0 only wants RGB+CCT packets, client 1 wants everything
+  TEST_ASSERT_TRUE(sendMessage(0, "{\"t\":\"sniff\",\"rt\":\"rgb_cct\"}"));
+  TEST_ASSERT_TRUE(sendMessage(1, "{\"t\":\"sniff\"}"));
+  TEST_ASSERT_TRUE(sniffer.isActive());
+
+  const unsigned long start = millis();
+  TEST_ASSERT_FALSE(sniffer.takePacket(0, REMOTE_TYPE_CCT, start));
+  TEST_ASSERT_TRUE(sniffer.takePacket(1, REMOTE_TYPE_CCT, start));
+  TEST_ASSERT_FALSE_MESSAGE(sniffer.takePacket(2, REMOTE_TYPE_CCT, start), "Client 2 has no session");
+
+  // Packets past the rate limit are dropped until the next second
+  for (size_t i = 0; i < MILIGHT_SNIFFER_MAX_RATE; ++i) {
+    TEST_ASSERT_TRUE(sniffer.takePacket(0, REMOTE_TYPE_RGB_CCT, start + i));
+  }
+  TEST_ASSERT_FALSE(sniffer.takePacket(0, REMOTE_TYPE_RGB_CCT, start + 500));
+  TEST_ASSERT_FALSE(sniffer.takePacket(0, REMOTE_TYPE_RGB_CCT, start + 999));
+  TEST_ASSERT_EQUAL(2, sniffer.droppedPackets(0));
+  TEST_ASSERT_EQUAL_MESSAGE(0, sniffer.droppedPackets(1), "Each client should have its own limit");
+  TEST_ASSERT_TRUE(sniffer.takePacket(0, REMOTE_TYPE_RGB_CCT, start + 1000));
+
+  // Filtered packets don't count against the limit
+  for (size_t i = 0; i < 2 * MILIGHT_SNIFFER_MAX_RATE; ++i) {
+    sniffer.takePacket(0, REMOTE_TYPE_FUT089, start + 1000);
+  }
+  TEST_ASSERT_TRUE(sniffer.takePacket(0, REMOTE_TYPE_RGB_CCT, start + 1000));
+
+  TEST_ASSERT_TRUE(sendMessage(0, "{\"t\":\"sniff_stop\"}"));
+  TEST_ASSERT_FALSE(sniffer.takePacket(0, REMOTE_TYPE_RGB_CCT, start + 5000));
+  TEST_ASSERT_TRUE(sniffer.isActive());
+
+  sniffer.handleDisconnect(1);
+  TEST_ASSERT_FALSE(sniffer.isActive());
+}
+
 // setup connects serial, runs test cases (upcoming)
 void setup() {
   delay(2000);
@@ -355,9 +2405,40 @@ void setup() {
   RUN_TEST(test_init_state);
   RUN_TEST(test_state_updates);
   RUN_TEST(test_cache);
+  RUN_TEST(test_cache_stats);
   RUN_TEST(test_persistence);
   RUN_TEST(test_store);
   RUN_TEST(test_group_0);
+  RUN_TEST(test_store_versions);
+  RUN_TEST(test_state_mask_equivalence);
+  RUN_TEST(test_state_patch_benchmark);
+  RUN_TEST(test_state_serializer);
+  RUN_TEST(test_state_serializer_benchmark);
+  RUN_TEST(test_transition_schedule);
+  RUN_TEST(test_transition_conflicts);
+  RUN_TEST(test_transition_pacing);
+  RUN_TEST(test_transition_min_period);
+  RUN_TEST(test_scene_transition_lockstep);
+  RUN_TEST(test_transition_easing);
+  RUN_TEST(test_transition_scheduler_benchmark);
+  RUN_TEST(test_transition_step_benchmark);
+  RUN_TEST(test_command_plan_benchmark);
+  RUN_TEST(test_redundant_command_filter);
+  RUN_TEST(test_command_debouncer);
+  RUN_TEST(test_packet_transactions);
+  RUN_TEST(test_restamped_packets);
+  RUN_TEST(test_packet_delta_benchmark);
+  RUN_TEST(test_packet_classification_benchmark);
+  RUN_TEST(test_packet_output);
+  RUN_TEST(test_run_length_queue);
+  RUN_TEST(test_full_packet_queue);
+  RUN_TEST(test_mode_planner);
+  RUN_TEST(test_group_fanout);
+  RUN_TEST(test_scene_program);
+  RUN_TEST(test_increment_transition_packets);
+  RUN_TEST(test_color_math);
+  RUN_TEST(test_color_math_benchmark);
+  RUN_TEST(test_packet_sniffer);
 
   RUN_TEST(test_fut091_packet_formatter);
   RUN_TEST(test_fut092_packet_formatter);
@@ -190,6 +190,18 @@ var UI_FIELDS = [ {
     help: "Connection status messages will be published to this topic.  This includes LWT and birth.  See README for further detail.",
     type: "string",
     tab: "tab-mqtt"
+  }, {
+    tag:   "mqtt_transition_topic",
+    friendly: "MQTT Transition Topic",
+    help: "Scene transitions, which move several bulbs together, can be started by publishing to this topic.  Leave blank to disable.",
+    type: "string",
+    tab: "tab-mqtt"
+  }, {
+    tag:   "mqtt_scene_topic",
+    friendly: "MQTT Scene Topic",
+    help: "Stored scenes can be recalled by publishing their ID to this topic.  Leave blank to disable.",
+    type: "string",
+    tab: "tab-mqtt"
   }, {
     tag:   "mqtt_retain",
     friendly: "Publish state messages with retain flag",
@@ -331,6 +343,43 @@ var UI_FIELDS = [ {
       false: 'Disable'
     },
     tab: "tab-radio"
+  }, {
+    tag:   "suppress_redundant_commands",
+    friendly: "Skip commands that don't change anything",
+    help: "Don't send packets for fields a bulb is already known to be in (for example, when Home Assistant "
+      + "resends a bulb's whole state).  Add \"force\": true to a command to always send it.",
+    type: "option_buttons",
+    options: {
+      true: 'Enable',
+      false: 'Disable'
+    },
+    tab: "tab-radio"
+  }, {
+    tag:   "redundant_command_window",
+    friendly: "Redundant command window",
+    help: "Number of milliseconds after a packet for a bulb is sent or heard that its state is trusted to skip "
+      + "commands.  After this, commands are always sent (defaults to 60000)",
+    type: "string",
+    tab: "tab-radio"
+  }, {
+    tag:   "http_command_debounce",
+    friendly: "HTTP command debounce",
+    help: "Minimum number of milliseconds between HTTP commands for the same brightness, color or temperature "
+      + "field of a bulb.  Commands in between are combined, and only the newest is sent.  0 to disable.",
+    type: "string",
+    tab: "tab-radio"
+  }, {
+    tag:   "mqtt_command_debounce",
+    friendly: "MQTT command debounce",
+    help: "Same as HTTP command debounce, for commands received over MQTT.  0 to disable.",
+    type: "string",
+    tab: "tab-radio"
+  }, {
+    tag:   "udp_command_debounce",
+    friendly: "UDP command debounce",
+    help: "Same as HTTP command debounce, for commands received from UDP gateways.  0 to disable.",
+    type: "string",
+    tab: "tab-radio"
   }, {
     tag:   "led_mode_wifi_config",
     friendly: "LED mode during wifi config",
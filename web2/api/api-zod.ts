@@ -378,6 +378,16 @@ const Settings = z
     mqtt_client_status_topic: z
       .string()
       .describe("Topic client status will be sent to."),
+    mqtt_transition_topic: z
+      .string()
+      .describe(
+        "Topic to listen on for scene transitions.  Payload is the same as a scene transition sent to POST /transitions."
+      ),
+    mqtt_scene_topic: z
+      .string()
+      .describe(
+        "Topic to listen on for stored scenes to recall.  Payload is the scene ID."
+      ),
     mqtt_retain: z
       .boolean()
       .describe(
@@ -460,6 +470,40 @@ const Settings = z
         "When making updates to hue or white temperature in a different bulb mode, switch back to the original bulb mode after applying the setting change."
       )
       .default(false),
+    suppress_redundant_commands: z
+      .boolean()
+      .describe(
+        "Skip sending fields a bulb is already known to be in.  Commands with force set are always sent."
+      )
+      .default(false),
+    redundant_command_window: z
+      .number()
+      .int()
+      .describe(
+        "Milliseconds after a packet for a bulb is sent or heard that its known state is trusted to skip commands."
+      )
+      .default(60000),
+    http_command_debounce: z
+      .number()
+      .int()
+      .describe(
+        "Minimum milliseconds between HTTP commands for the same field of a bulb.  Commands in between are combined, and only the newest is sent.  0 disables."
+      )
+      .default(0),
+    mqtt_command_debounce: z
+      .number()
+      .int()
+      .describe(
+        "Minimum milliseconds between MQTT commands for the same field of a bulb.  0 disables."
+      )
+      .default(0),
+    udp_command_debounce: z
+      .number()
+      .int()
+      .describe(
+        "Minimum milliseconds between UDP gateway commands for the same field of a bulb.  0 disables."
+      )
+      .default(0),
     led_mode_wifi_config: LedMode,
     led_mode_wifi_failed: LedMode,
     led_mode_operating: LedMode,